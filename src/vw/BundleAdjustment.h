@@ -21,6 +21,7 @@
 #include <vw/BundleAdjustment/AdjustSparse.h>
 #include <vw/BundleAdjustment/AdjustRobustRef.h>
 #include <vw/BundleAdjustment/AdjustRobustSparse.h>
+#include <vw/BundleAdjustment/AdjustBlockSparse.h>
 
 // Reporter
 #include <vw/BundleAdjustment/BundleAdjustReport.h>
@@ -28,6 +29,7 @@
 // Loading Utilities
 #include <vw/BundleAdjustment/CameraRelation.h>
 #include <vw/BundleAdjustment/ControlNetwork.h>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
 #include <vw/BundleAdjustment/ControlNetworkLoader.h>
 
 #endif // __VW_BUNDLE_ADJUSTMENT_H__
@@ -309,6 +309,21 @@ namespace ba {
       }
     }
 
+  protected:
+    // For adjusters that read the measures from somewhere other than
+    // the model's control network, such as a CompactControlNetwork.
+    // m_control_net is set to control_net, which may be null.
+    AdjustBase( BundleAdjustModelT &model,
+                RobustCostT const& robust_cost_func,
+                bool use_camera_constraint,
+                bool use_gcp_constraint,
+                boost::shared_ptr<ControlNetwork> const& control_net ) :
+      m_control_net(control_net), m_model(model), m_robust_cost_func(robust_cost_func),
+      m_control(0), m_lambda(1e-3), m_nu(2), g_tol(1e-10), d_tol(1e-10), m_iterations(0),
+      m_use_camera_constraint(use_camera_constraint),
+      m_use_gcp_constraint(use_gcp_constraint) {}
+
+  public:
     // Access to inner templates
     typedef BundleAdjustModelT model_type;
     typedef RobustCostT cost_type;
@@ -0,0 +1,812 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file AdjustBlockSparse.h
+///
+/// Sparse implementation of bundle adjustment for large networks.
+/// This takes the same steps as AdjustSparse, but the reduced camera
+/// system S is held in a block sparse matrix, which several threads
+/// build at once, each the block rows of its own cameras, and it is
+/// solved with a supernodal Cholesky factorization.
+///
+/// For networks whose S is too large to factor, set_solver(
+/// CONJUGATE_GRADIENT) instead solves for the camera step with
+/// preconditioned conjugate gradients.  S is then never formed: its
+/// products with a vector are taken from the per-measure W blocks,
+/// a pass over the points followed by a pass over the cameras, so
+/// memory stays linear in the number of measures.  Each step is only
+/// solved to the given tolerance, which makes this an inexact Newton
+/// method.
+
+#ifndef __VW_BUNDLEADJUSTMENT_ADJUST_BLOCK_SPARSE_H__
+#define __VW_BUNDLEADJUSTMENT_ADJUST_BLOCK_SPARSE_H__
+
+// Vision Workbench
+#include <vw/Math/MatrixBlockSparse.h>
+#include <vw/Math/ConjugateGradient.h>
+#include <vw/Core/Debugging.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/BundleAdjustment/AdjustBase.h>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
+
+#include <boost/exception_ptr.hpp>
+
+namespace vw {
+namespace ba {
+
+  // update() runs on the calling thread unless set_threads() asks for
+  // more.  The model's projection and Jacobians are then evaluated by
+  // several threads at once, so they must be safe to call
+  // concurrently.  An exception thrown on one of the threads is
+  // rethrown from update().
+  template <class BundleAdjustModelT, class RobustCostT>
+  class AdjustBlockSparse : public AdjustBase<BundleAdjustModelT, RobustCostT> {
+
+    // Common Types
+    typedef Matrix<double, 2, BundleAdjustModelT::camera_params_n> matrix_2_camera;
+    typedef Matrix<double, 2, BundleAdjustModelT::point_params_n> matrix_2_point;
+    typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::camera_params_n> matrix_camera_camera;
+    typedef Matrix<double,BundleAdjustModelT::point_params_n,BundleAdjustModelT::point_params_n> matrix_point_point;
+    typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
+    typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
+    typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
+    typedef math::MatrixBlockSparse<double,BundleAdjustModelT::camera_params_n> sparse_type;
+
+    // The control network, flattened.  The measures of point i are
+    // [m_point_start[i], m_point_start[i+1]).
+    std::vector<size_t> m_point_start;
+    std::vector<uint32> m_camera;
+    std::vector<Vector2> m_location, m_sigma;
+    std::vector<bool> m_ground_control;
+
+  public:
+    /// How the reduced camera system is solved
+    enum SolverT { CHOLESKY, CONJUGATE_GRADIENT };
+
+    /// The preconditioner for CONJUGATE_GRADIENT.  BLOCK_JACOBI uses
+    /// the inverse of U_j for camera j, SCHUR_JACOBI the inverse of the
+    /// diagonal block of S, which costs a little more to build.
+    enum PreconditionerT { BLOCK_JACOBI, SCHUR_JACOBI };
+
+  private:
+    SolverT m_solver;
+    PreconditionerT m_preconditioner;
+    double m_cg_tolerance;
+    int m_cg_max_iterations;
+
+    // The block of S that each pair of measures (a,b) of a point adds
+    // to, for every pair with camera(a) >= camera(b), in the order
+    // they are visited: a in camera order, then b in point order.  The
+    // pairs of the k'th measure in camera order start at
+    // m_pair_start[k].  Only built for CHOLESKY.
+    std::vector<size_t> m_pair_start;
+    std::vector<uint32> m_pair_block;
+
+    sparse_type m_S;
+    math::BlockSparseCholesky<double,BundleAdjustModelT::camera_params_n> m_cholesky;
+    bool m_analyzed;
+
+    // The measures in camera order.  The measures of camera j are
+    // m_camera_measure[k] for k in [m_camera_start[j],
+    // m_camera_start[j+1]).
+    std::vector<size_t> m_camera_start;
+    std::vector<uint32> m_camera_measure, m_measure_point;
+
+    // One thread's share of the points, along with its own copies of
+    // the camera terms that the other threads also add to.
+    struct PointRange {
+      size_t begin, end;
+      double error;
+      std::vector<matrix_camera_camera> U;
+      std::vector<vector_camera> epsilon_a;
+    };
+    std::vector<PointRange> m_ranges;
+
+    // One thread's share of the cameras, and of the block rows of S
+    struct CameraRange {
+      size_t begin, end;
+    };
+    std::vector<CameraRange> m_camera_ranges;
+
+    // The threads that run the ranges, kept for as long as the
+    // adjuster so that each stage of update() doesn't start its own.
+    // Null with a single range, which runs on the calling thread.
+    boost::scoped_ptr<WorkStealingQueue> m_pool;
+
+    // Runs func on one range, keeping any exception that it throws
+    // for for_each_range() to rethrow on the calling thread.
+    template <class RangeT>
+    class RangeTask : public Task {
+      AdjustBlockSparse& m_adjust;
+      void (AdjustBlockSparse::*m_func)( RangeT& );
+      RangeT& m_range;
+    public:
+      boost::exception_ptr error;
+      RangeTask( AdjustBlockSparse& adjust, void (AdjustBlockSparse::*func)( RangeT& ),
+                 RangeT& range ) : m_adjust(adjust), m_func(func), m_range(range) {}
+      void operator()() {
+        try {
+          (m_adjust.*m_func)( m_range );
+        } catch ( ... ) {
+          error = boost::current_exception();
+        }
+      }
+    };
+
+    // The two functors that preconditioned_conjugate_gradient() needs
+    struct ReducedCameraProduct {
+      AdjustBlockSparse& m_adjust;
+      ReducedCameraProduct( AdjustBlockSparse& adjust ) : m_adjust(adjust) {}
+      void operator()( Vector<double> const& x, Vector<double>& result ) const {
+        m_adjust.multiply_S( x, result );
+      }
+    };
+
+    struct BlockDiagonalPreconditioner {
+      AdjustBlockSparse& m_adjust;
+      BlockDiagonalPreconditioner( AdjustBlockSparse& adjust ) : m_adjust(adjust) {}
+      void operator()( Vector<double> const& r, Vector<double>& result ) const {
+        const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+        result.set_size( r.size() );
+        for ( size_t j = 0; j < m_adjust.m_inverse_diagonal.size(); ++j )
+          subvector( result, j*num_cam_params, num_cam_params ) =
+            m_adjust.m_inverse_diagonal[j] * subvector( r, j*num_cam_params, num_cam_params );
+      }
+    };
+
+    // Reused structures
+    std::vector< matrix_camera_camera > U;
+    std::vector< matrix_point_point > V, V_inverse;
+    std::vector< vector_camera > epsilon_a;
+    std::vector< vector_point > epsilon_b;
+    std::vector< matrix_camera_point > W;  // One for each measure
+    Vector<double> m_delta_a;
+    std::vector< vector_point > m_delta_b;
+
+    // Work space for CONJUGATE_GRADIENT
+    std::vector< matrix_camera_camera > m_inverse_diagonal;
+    std::vector< vector_point > m_product_points;
+    Vector<double> const* m_product_in;
+    Vector<double>* m_product_out;
+
+    // Splits the points into num_threads ranges with about the same
+    // number of measures each.
+    void split_points( int num_threads ) {
+      if ( num_threads < 1 ) num_threads = 1;
+      const size_t num_points = m_point_start.size()-1;
+      m_ranges.clear();
+      for ( int t = 0, i = 0; t < num_threads; ++t ) {
+        PointRange range;
+        range.begin = i;
+        size_t goal = m_camera.size()*(t+1)/num_threads;
+        while ( i < int(num_points) && ( t+1 == num_threads || m_point_start[i+1] <= goal ) )
+          ++i;
+        range.end = i;
+        range.error = 0;
+        m_ranges.push_back( range );
+      }
+      if ( !m_camera_start.empty() )
+        split_cameras();
+      m_pool.reset( num_threads > 1 ? new WorkStealingQueue( num_threads ) : 0 );
+    }
+
+    // Splits the cameras the same way, once they are in camera order.
+    void split_cameras() {
+      const size_t num_threads = m_ranges.size();
+      const size_t num_cameras = m_camera_start.size()-1;
+      m_camera_ranges.clear();
+      for ( size_t t = 0, j = 0; t < num_threads; ++t ) {
+        CameraRange range;
+        range.begin = j;
+        size_t goal = m_camera.size()*(t+1)/num_threads;
+        while ( j < num_cameras && ( t+1 == num_threads || m_camera_start[j+1] <= goal ) )
+          ++j;
+        range.end = j;
+        m_camera_ranges.push_back( range );
+      }
+    }
+
+    template <class RangeT>
+    void for_each_range( std::vector<RangeT>& ranges, void (AdjustBlockSparse::*func)( RangeT& ) ) {
+      if ( !m_pool ) {
+        for ( size_t t = 0; t < ranges.size(); ++t )
+          (this->*func)( ranges[t] );
+        return;
+      }
+      std::vector<boost::shared_ptr<RangeTask<RangeT> > > tasks;
+      for ( size_t t = 0; t < ranges.size(); ++t ) {
+        tasks.push_back( boost::shared_ptr<RangeTask<RangeT> >( new RangeTask<RangeT>( *this, func, ranges[t] ) ) );
+        m_pool->add_task( tasks.back() );
+      }
+      m_pool->join_all();
+      for ( size_t t = 0; t < tasks.size(); ++t )
+        if ( tasks[t]->error )
+          boost::rethrow_exception( tasks[t]->error );
+    }
+
+    // Finds the blocks of S that each measure adds to.
+    void build_reduced_pattern() {
+      std::vector<std::pair<size_t,size_t> > blocks;
+      m_pair_start.push_back( 0 );
+      for ( size_t k = 0; k < m_camera_measure.size(); ++k ) {
+        const size_t a = m_camera_measure[k], i = m_measure_point[a];
+        for ( size_t b = m_point_start[i]; b < m_point_start[i+1]; ++b )
+          if ( m_camera[a] >= m_camera[b] )
+            blocks.push_back( std::make_pair( m_camera[a], m_camera[b] ) );
+        m_pair_start.push_back( blocks.size() );
+      }
+
+      m_S = sparse_type( this->m_model.num_cameras(), blocks );
+      m_pair_block.resize( blocks.size() );
+      for ( size_t k = 0; k < blocks.size(); ++k )
+        m_pair_block[k] = m_S.find_block( blocks[k].first, blocks[k].second );
+    }
+
+    // Sorts the measures by camera.
+    void build_camera_order() {
+      const size_t num_cameras = this->m_model.num_cameras();
+      m_camera_start.assign( num_cameras+1, 0 );
+      for ( size_t m = 0; m < m_camera.size(); ++m )
+        ++m_camera_start[m_camera[m]+1];
+      for ( size_t j = 0; j < num_cameras; ++j )
+        m_camera_start[j+1] += m_camera_start[j];
+
+      std::vector<size_t> next( m_camera_start.begin(), m_camera_start.end()-1 );
+      m_camera_measure.resize( m_camera.size() );
+      m_measure_point.resize( m_camera.size() );
+      for ( size_t i = 0; i+1 < m_point_start.size(); ++i )
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m ) {
+          m_measure_point[m] = i;
+          m_camera_measure[next[m_camera[m]]++] = m;
+        }
+
+      m_inverse_diagonal.resize( num_cameras );
+      m_product_points.resize( m_point_start.size()-1 );
+      split_cameras();
+    }
+
+    // The weighted image error of measure m of point i
+    Vector2 image_error( size_t i, size_t m, vector_camera const& a_j, vector_point const& b_i ) {
+      Vector2 error;
+      try {
+        error = m_location[m] - this->m_model( i, m_camera[m], a_j, b_i );
+      } catch ( camera::PixelToRayErr &e ) {}
+
+      // Apply robust cost function weighting
+      if ( error != Vector2() ) {
+        double mag = norm_2(error);
+        double weight = sqrt(this->m_robust_cost_func(mag)) / mag;
+        error *= weight;
+      }
+      return error;
+    }
+
+    static Matrix2x2 inverse_covariance( Vector2 const& pixel_sigma ) {
+      Matrix2x2 inverse_cov;
+      inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
+      inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
+      return inverse_cov;
+    }
+
+    // Jacobians, U, V, W and epsilon for the measures of a range
+    void jacobian_stage( PointRange& range ) {
+      const size_t num_cameras = this->m_model.num_cameras();
+      range.error = 0;
+      range.U.assign( num_cameras, matrix_camera_camera() );
+      range.epsilon_a.assign( num_cameras, vector_camera() );
+      for ( size_t i = range.begin; i < range.end; ++i ) {
+        V[i] = matrix_point_point();
+        epsilon_b[i] = vector_point();
+        vector_point b_i = this->m_model.B_parameters(i);
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m ) {
+          const size_t j = m_camera[m];
+          vector_camera a_j = this->m_model.A_parameters(j);
+          matrix_2_camera A = this->m_model.A_jacobian( i, j, a_j, b_i );
+          matrix_2_point B = this->m_model.B_jacobian( i, j, a_j, b_i );
+          Vector2 error = image_error( i, m, a_j, b_i );
+          Matrix2x2 inverse_cov = inverse_covariance( m_sigma[m] );
+          range.error += .5 * transpose(error) * inverse_cov * error;
+
+          range.U[j] += transpose(A) * inverse_cov * A;
+          V[i] += transpose(B) * inverse_cov * B;
+          range.epsilon_a[j] += transpose(A) * inverse_cov * error;
+          epsilon_b[i] += transpose(B) * inverse_cov * error;
+          W[m] = transpose(A) * inverse_cov * B;
+        }
+      }
+    }
+
+    // inverse(V), and each point's terms of e = epsilon_a -
+    // W*inverse(V)*epsilon_b
+    void schur_stage( PointRange& range ) {
+      range.epsilon_a.assign( this->m_model.num_cameras(), vector_camera() );
+      for ( size_t i = range.begin; i < range.end; ++i ) {
+        Matrix<double> V_temp = V[i];
+        chol_inverse( V_temp );
+        V_inverse[i] = transpose(V_temp)*V_temp;
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m )
+          range.epsilon_a[m_camera[m]] -= W[m] * ( V_inverse[i] * epsilon_b[i] );
+      }
+    }
+
+    // The block rows of S = U - W*inverse(V)*W^T for a range of
+    // cameras.  Only this range writes to them, so the threads need
+    // neither locks nor copies of S.
+    void reduced_camera_stage( CameraRange& range ) {
+      const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      for ( size_t j = range.begin; j < range.end; ++j ) {
+        double* block = m_S.block( m_S.find_block( j, j ) );
+        for ( size_t r = 0; r < num_cam_params; ++r )
+          for ( size_t c = 0; c < num_cam_params; ++c )
+            block[r*num_cam_params+c] += U[j](r,c);
+
+        for ( size_t k = m_camera_start[j]; k < m_camera_start[j+1]; ++k ) {
+          const size_t a = m_camera_measure[k], i = m_measure_point[a];
+          matrix_camera_point Y = W[a] * V_inverse[i];
+          const uint32* pair = &m_pair_block[0] + m_pair_start[k];
+          for ( size_t b = m_point_start[i]; b < m_point_start[i+1]; ++b ) {
+            if ( m_camera[a] < m_camera[b] )
+              continue;
+            matrix_camera_camera S_ab = Y * transpose( W[b] );
+            block = m_S.block( *pair++ );
+            for ( size_t r = 0; r < num_cam_params; ++r )
+              for ( size_t c = 0; c < num_cam_params; ++c )
+                block[r*num_cam_params+c] -= S_ab(r,c);
+          }
+        }
+      }
+    }
+
+    // The inverses of the diagonal blocks of the preconditioner
+    void preconditioner_stage( CameraRange& range ) {
+      for ( size_t j = range.begin; j < range.end; ++j ) {
+        matrix_camera_camera block = U[j];
+        if ( m_preconditioner == SCHUR_JACOBI )
+          for ( size_t k = m_camera_start[j]; k < m_camera_start[j+1]; ++k ) {
+            const size_t m = m_camera_measure[k];
+            block -= W[m] * V_inverse[m_measure_point[m]] * transpose( W[m] );
+          }
+        Matrix<double> block_temp = block;
+        chol_inverse( block_temp );
+        m_inverse_diagonal[j] = transpose(block_temp)*block_temp;
+      }
+    }
+
+    // S*x in two passes.  First u_i = inverse(V_i)*sum_across_cam(
+    // WijT * x_j ) for every point ...
+    void product_point_stage( PointRange& range ) {
+      const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      for ( size_t i = range.begin; i < range.end; ++i ) {
+        vector_point sum;
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m )
+          sum += transpose( W[m] ) *
+            subvector( *m_product_in, m_camera[m]*num_cam_params, num_cam_params );
+        m_product_points[i] = V_inverse[i] * sum;
+      }
+    }
+
+    // ... then (S*x)_j = U_j*x_j - sum_across_points( Wij * u_i ) for
+    // every camera.
+    void product_camera_stage( CameraRange& range ) {
+      const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      for ( size_t j = range.begin; j < range.end; ++j ) {
+        vector_camera y = U[j] * subvector( *m_product_in, j*num_cam_params, num_cam_params );
+        for ( size_t k = m_camera_start[j]; k < m_camera_start[j+1]; ++k ) {
+          const size_t m = m_camera_measure[k];
+          y -= W[m] * m_product_points[m_measure_point[m]];
+        }
+        subvector( *m_product_out, j*num_cam_params, num_cam_params ) = y;
+      }
+    }
+
+    void multiply_S( Vector<double> const& x, Vector<double>& result ) {
+      result.set_size( x.size() );
+      m_product_in = &x;
+      m_product_out = &result;
+      for_each_range( m_ranges, &AdjustBlockSparse::product_point_stage );
+      for_each_range( m_camera_ranges, &AdjustBlockSparse::product_camera_stage );
+    }
+
+    // Solves S*delta_a = e by factoring S.  Returns false if S is not
+    // positive definite.
+    bool solve_cholesky( Vector<double> const& e ) {
+      boost::scoped_ptr<Timer> time;
+
+      time.reset(new Timer("Build Sparse", DebugMessage, "ba"));
+      m_S.set_zero();
+      for_each_range( m_camera_ranges, &AdjustBlockSparse::reduced_camera_stage );
+      time.reset();
+
+      if ( !m_analyzed ) {
+        time.reset(new Timer("Solving for ordering", DebugMessage, "ba"));
+        m_cholesky.analyze( m_S );
+        m_analyzed = true;
+        time.reset();
+      }
+
+      time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
+      if ( !m_cholesky.factor( m_S ) ) {
+        vw_out(DebugMessage,"ba") << "Reduced camera system is not positive definite.\n";
+        return false;
+      }
+      m_delta_a = m_cholesky.solve( e );
+      return true;
+    }
+
+    // Solves S*delta_a = e approximately, without forming S.
+    void solve_conjugate_gradient( Vector<double> const& e ) {
+      Timer time("Solve Delta A (PCG)", DebugMessage, "ba");
+      for_each_range( m_camera_ranges, &AdjustBlockSparse::preconditioner_stage );
+      m_delta_a = Vector<double>( e.size() );
+      int steps = math::preconditioned_conjugate_gradient( ReducedCameraProduct( *this ),
+                                                           BlockDiagonalPreconditioner( *this ),
+                                                           e, m_delta_a, m_cg_tolerance,
+                                                           m_cg_max_iterations );
+      vw_out(DebugMessage,"ba") << "Conjugate gradient steps: " << steps << "\n";
+    }
+
+    // delta_b = inverse(V)*( epsilon_b - sum_across_cam( WijT * delta_aj ) )
+    void delta_b_stage( PointRange& range ) {
+      const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      for ( size_t i = range.begin; i < range.end; ++i ) {
+        vector_point right = epsilon_b[i];
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m )
+          right -= transpose( W[m] ) *
+            subvector( m_delta_a, m_camera[m]*num_cam_params, num_cam_params );
+        m_delta_b[i] = V_inverse[i] * right;
+      }
+    }
+
+    // The image error after the update
+    void new_error_stage( PointRange& range ) {
+      const size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      range.error = 0;
+      for ( size_t i = range.begin; i < range.end; ++i ) {
+        vector_point new_b = this->m_model.B_parameters(i) + m_delta_b[i];
+        for ( size_t m = m_point_start[i]; m < m_point_start[i+1]; ++m ) {
+          const size_t j = m_camera[m];
+          vector_camera new_a = this->m_model.A_parameters(j) +
+            subvector( m_delta_a, num_cam_params*j, num_cam_params );
+          Vector2 error = image_error( i, m, new_a, new_b );
+          range.error += .5 * transpose(error) * inverse_covariance( m_sigma[m] ) * error;
+        }
+      }
+    }
+
+    // Sizes the work space, once the network is flattened.
+    void init() {
+      const size_t num_cameras = this->m_model.num_cameras(), num_points = this->m_model.num_points();
+      VW_ASSERT( m_point_start.size() == num_points+1,
+                 ArgumentErr() << "AdjustBlockSparse: the control network has " << m_point_start.size()-1
+                 << " points, but the model has " << num_points << "." );
+      for ( size_t m = 0; m < m_camera.size(); ++m )
+        VW_ASSERT( m_camera[m] < num_cameras,
+                   ArgumentErr() << "AdjustBlockSparse: a measure is of camera " << m_camera[m]
+                   << ", but the model has " << num_cameras << " cameras." );
+
+      U.resize( num_cameras );
+      epsilon_a.resize( num_cameras );
+      V.resize( num_points );
+      V_inverse.resize( num_points );
+      epsilon_b.resize( num_points );
+      m_delta_b.resize( num_points );
+      W.resize( m_camera.size() );
+
+      split_points( 1 );
+      vw_out(DebugMessage,"ba") << "Constructed Block Sparse Bundle Adjuster.\n";
+    }
+
+    // Raises lambda after a step that didn't make progress
+    void reject_step() {
+      if ( this->m_control == 0 ) {
+        this->m_lambda *= this->m_nu;
+        this->m_nu*=2;
+      } else if ( this->m_control == 1 )
+        this->m_lambda *= 10;
+    }
+
+  public:
+
+    AdjustBlockSparse( BundleAdjustModelT & model,
+                       RobustCostT const& robust_cost_func,
+                       bool use_camera_constraint=true,
+                       bool use_gcp_constraint=true) :
+    AdjustBase<BundleAdjustModelT,RobustCostT>( model, robust_cost_func,
+                                                use_camera_constraint,
+                                                use_gcp_constraint ),
+      m_solver(CHOLESKY), m_preconditioner(SCHUR_JACOBI),
+      m_cg_tolerance(1e-6), m_cg_max_iterations(500), m_analyzed(false) {
+
+      // Flatten the control network
+      ControlNetwork const& cnet = *(this->m_control_net);
+      m_point_start.push_back( 0 );
+      for ( size_t i = 0; i < cnet.size(); ++i ) {
+        for ( ControlPoint::const_iterator cmeasure = cnet[i].begin();
+              cmeasure != cnet[i].end(); ++cmeasure ) {
+          m_camera.push_back( cmeasure->image_id() );
+          m_location.push_back( cmeasure->position() );
+          m_sigma.push_back( cmeasure->sigma() );
+        }
+        m_point_start.push_back( m_camera.size() );
+        m_ground_control.push_back( cnet[i].type() == ControlPoint::GroundControlPoint );
+      }
+      init();
+    }
+
+    /// Takes the measures from cnet rather than from the model's
+    /// control network, which the model then need not provide.  The
+    /// points of cnet must be the model's points, in order.
+    AdjustBlockSparse( BundleAdjustModelT & model,
+                       CompactControlNetwork const& cnet,
+                       RobustCostT const& robust_cost_func,
+                       bool use_camera_constraint=true,
+                       bool use_gcp_constraint=true) :
+    AdjustBase<BundleAdjustModelT,RobustCostT>( model, robust_cost_func,
+                                                use_camera_constraint,
+                                                use_gcp_constraint,
+                                                boost::shared_ptr<ControlNetwork>() ),
+      m_solver(CHOLESKY), m_preconditioner(SCHUR_JACOBI),
+      m_cg_tolerance(1e-6), m_cg_max_iterations(500), m_analyzed(false) {
+
+      m_point_start.reserve( cnet.num_points()+1 );
+      m_point_start.push_back( 0 );
+      for ( size_t i = 0; i < cnet.num_points(); ++i ) {
+        m_point_start.push_back( cnet.point_end(i) );
+        m_ground_control.push_back( cnet.point_type(i) == ControlPoint::GroundControlPoint );
+      }
+      m_camera.assign( cnet.measure_cameras(), cnet.measure_cameras() + cnet.num_measures() );
+      m_location.resize( cnet.num_measures() );
+      m_sigma.resize( cnet.num_measures() );
+      for ( size_t m = 0; m < cnet.num_measures(); ++m ) {
+        m_location[m] = cnet.position(m);
+        m_sigma[m] = cnet.sigma(m);
+      }
+      init();
+    }
+
+    /// The reduced camera system of the last update.  Empty unless
+    /// the solver is CHOLESKY.
+    sparse_type const& S() const { return m_S; }
+
+    SolverT solver() const { return m_solver; }
+    void set_solver( SolverT solver ) { m_solver = solver; }
+
+    PreconditionerT preconditioner() const { return m_preconditioner; }
+    void set_preconditioner( PreconditionerT preconditioner ) { m_preconditioner = preconditioner; }
+
+    /// Each conjugate gradient solve stops once the residual is below
+    /// tolerance times the norm of the right hand side, or after
+    /// max_iterations steps.
+    void set_cg_tolerance( double tolerance, int max_iterations ) {
+      m_cg_tolerance = tolerance;
+      m_cg_max_iterations = max_iterations;
+    }
+
+    /// The number of threads that update() uses.  One, the calling
+    /// thread, unless set otherwise.
+    int threads() const { return m_ranges.size(); }
+    void set_threads( int num_threads ) { split_points( num_threads ); }
+
+    // UPDATE IMPLEMENTATION
+    //-------------------------------------------------------------
+    // This is the sparse levenberg marquardt update step.  Returns
+    // the average improvement in the cost function.
+    double update(double &abs_tol, double &rel_tol) {
+      ++this->m_iterations;
+      boost::scoped_ptr<Timer> time;
+
+      VW_DEBUG_ASSERT(m_ground_control.size() == this->m_model.num_points(), LogicErr() << "BundleAdjustment::update() : Number of bundles does not match the number of points in the bundle adjustment model.");
+
+      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      size_t num_pt_params = BundleAdjustModelT::point_params_n;
+
+      // Populate the Jacobian, which is broken into two sparse
+      // matrices A & B, as well as the error matrix and the W
+      // matrix.
+      time.reset(new Timer("Solve for Image Error, Jacobian, U, V, and W:", DebugMessage, "ba"));
+      for_each_range( m_ranges, &AdjustBlockSparse::jacobian_stage );
+      double error_total = 0; // assume this is r^T\Sigma^{-1}r
+      for ( uint32 j = 0; j < this->m_model.num_cameras(); j++ ) {
+        U[j] = matrix_camera_camera();
+        epsilon_a[j] = vector_camera();
+        for ( size_t t = 0; t < m_ranges.size(); ++t ) {
+          U[j] += m_ranges[t].U[j];
+          epsilon_a[j] += m_ranges[t].epsilon_a[j];
+        }
+      }
+      for ( size_t t = 0; t < m_ranges.size(); ++t )
+        error_total += m_ranges[t].error;
+      time.reset();
+
+      // Add in the camera position and pose constraint terms and covariances.
+      time.reset(new Timer("Solving for Camera and GCP error:",DebugMessage,"ba"));
+      if ( this->m_use_camera_constraint )
+        for ( size_t j = 0; j < U.size(); ++j ) {
+          matrix_camera_camera inverse_cov;
+          inverse_cov = this->m_model.A_inverse_covariance(j);
+          U[j] += inverse_cov;
+          vector_camera eps_a = this->m_model.A_target(j)-this->m_model.A_parameters(j);
+          error_total += .5  * transpose(eps_a) * inverse_cov * eps_a;
+          epsilon_a[j] += inverse_cov * eps_a;
+        }
+
+      // Add in the 3D point position constraint terms and
+      // covariances. We only add constraints for Ground Control
+      // Points (GCPs), not for 3D tie points.
+      if (this->m_use_gcp_constraint)
+        for ( size_t i = 0; i < V.size(); ++i )
+          if ( m_ground_control[i] ) {
+            matrix_point_point inverse_cov;
+            inverse_cov = this->m_model.B_inverse_covariance(i);
+            V[i] += inverse_cov;
+            vector_point eps_b = this->m_model.B_target(i)-this->m_model.B_parameters(i);
+            error_total += .5 * transpose(eps_b) * inverse_cov * eps_b;
+            epsilon_b[i] += inverse_cov * eps_b;
+          }
+      time.reset();
+
+      // set initial lambda, and ignore if the user has touched it
+      if ( this->m_iterations == 1 && this->m_lambda == 1e-3 ) {
+        double max = 0.0;
+        for (size_t i = 0; i < U.size(); ++i)
+          for (size_t j = 0; j < num_cam_params; ++j)
+            if (fabs(U[i](j,j)) > max)
+              max = fabs(U[i](j,j));
+        for (size_t i = 0; i < V.size(); ++i)
+          for (size_t j = 0; j < num_pt_params; ++j)
+            if ( fabs(V[i](j,j)) > max)
+              max = fabs(V[i](j,j));
+        this->m_lambda = max * 1e-10;
+      }
+
+      // "Augment" the diagonal entries of the U and V matrices with
+      // the parameter lambda.
+      {
+        matrix_camera_camera u_lambda;
+        u_lambda.set_identity();
+        u_lambda *= this->m_lambda;
+        for ( uint32 i = 0; i < U.size(); ++i )
+          U[i] += u_lambda;
+      }
+
+      {
+        matrix_point_point v_lambda;
+        v_lambda.set_identity();
+        v_lambda *= this->m_lambda;
+        for ( uint32 i = 0; i < V.size(); ++i )
+          V[i] += v_lambda;
+      }
+
+      // --- BUILD SPARSE, SOLVE A'S UPDATE STEP -------------------------
+      if ( m_camera_start.empty() )
+        build_camera_order();
+      if ( m_solver == CHOLESKY && m_pair_start.empty() )
+        build_reduced_pattern();
+
+      time.reset(new Timer("Solve for Schur complement", DebugMessage, "ba"));
+      for_each_range( m_ranges, &AdjustBlockSparse::schur_stage );
+      Vector<double> e(this->m_model.num_cameras() * num_cam_params);
+      for ( size_t j = 0; j < epsilon_a.size(); ++j ) {
+        vector_camera e_j = epsilon_a[j];
+        for ( size_t t = 0; t < m_ranges.size(); ++t )
+          e_j += m_ranges[t].epsilon_a[j];
+        subvector(e, j*num_cam_params, num_cam_params) = e_j;
+      }
+      time.reset();
+
+      if ( m_solver == CONJUGATE_GRADIENT )
+        solve_conjugate_gradient( e );
+      else if ( !solve_cholesky( e ) ) {
+        reject_step();
+        return 0;
+      }
+      BOOST_FOREACH( double& e, m_delta_a )
+        if ( std::isnan( e ) ) e = 0;
+
+      // --- SOLVE B'S UPDATE STEP ---------------------------------
+      time.reset(new Timer("Solve Delta B", DebugMessage, "ba"));
+      for_each_range( m_ranges, &AdjustBlockSparse::delta_b_stage );
+      time.reset();
+
+      // Predicted improvement for Fletcher modification,
+      // g^T*delta - 0.5*delta^T*J^T*J*delta, computed from the step
+      // itself, since CONJUGATE_GRADIENT only solves for it roughly.
+      // With delta_b eliminated, delta^T*(J^T*J + lambda*I)*delta =
+      // delta_a^T*S*delta_a + sum( epsilon_b^T*inverse(V)*epsilon_b ),
+      // and the lambda*delta^T*delta part is added back so that this
+      // agrees with the other adjusters.
+      time.reset(new Timer("Predicted Improvement", DebugMessage, "ba"));
+      Vector<double> S_delta_a;
+      multiply_S( m_delta_a, S_delta_a );
+      double dS = 0.5 * transpose(m_delta_a) * ( this->m_lambda * m_delta_a - S_delta_a );
+      for ( uint32 j = 0; j < this->m_model.num_cameras(); j++ )
+        dS += transpose(epsilon_a[j]) * subvector(m_delta_a,j*num_cam_params,num_cam_params);
+      for ( uint32 i = 0; i < this->m_model.num_points(); i++ )
+        dS += transpose(epsilon_b[i]) * ( m_delta_b[i] - 0.5 * V_inverse[i] * epsilon_b[i] ) +
+          0.5 * this->m_lambda * transpose(m_delta_b[i]) * m_delta_b[i];
+      time.reset();
+
+      // -------------------------------
+      // Compute the update error vector and predicted change
+      // -------------------------------
+      time.reset(new Timer("Solve for Updated Error", DebugMessage, "ba"));
+      for_each_range( m_ranges, &AdjustBlockSparse::new_error_stage );
+      double new_error_total = 0;
+      for ( size_t t = 0; t < m_ranges.size(); ++t )
+        new_error_total += m_ranges[t].error;
+
+      // Camera Constraints
+      if ( this->m_use_camera_constraint )
+        for (size_t j = 0; j < U.size(); ++j) {
+          vector_camera new_a = this->m_model.A_parameters(j) +
+            subvector(m_delta_a, num_cam_params*j, num_cam_params);
+          vector_camera eps_a = this->m_model.A_target(j)-new_a;
+
+          matrix_camera_camera inverse_cov;
+          inverse_cov = this->m_model.A_inverse_covariance(j);
+          new_error_total += .5 * transpose(eps_a) * inverse_cov * eps_a;
+        }
+
+      // GCP Error
+      if ( this->m_use_gcp_constraint )
+        for ( size_t i = 0; i < V.size(); ++i )
+          if ( m_ground_control[i] ) {
+            vector_point new_b = this->m_model.B_parameters(i) + m_delta_b[i];
+            vector_point eps_b = this->m_model.B_target(i)-new_b;
+            matrix_point_point inverse_cov;
+            inverse_cov = this->m_model.B_inverse_covariance(i);
+            new_error_total += .5 * transpose(eps_b) * inverse_cov * eps_b;
+          }
+      time.reset();
+
+      //Fletcher modification
+      double Splus = new_error_total;     //Compute new objective
+      double SS = error_total;            //Compute old objective
+      double R = (SS - Splus)/dS;         // Compute ratio
+      vw_out(DebugMessage,"ba") << "New Error: " << new_error_total << std::endl;
+      vw_out(DebugMessage,"ba") << "Old Error: " << error_total << std::endl;
+
+      rel_tol = -1e30;
+      BOOST_FOREACH( vector_camera const& a, epsilon_a )
+        rel_tol = std::max( rel_tol, math::max( abs( a ) ) );
+      BOOST_FOREACH( vector_point const& b, epsilon_b )
+        rel_tol = std::max( rel_tol, math::max( abs( b ) ) );
+      abs_tol = Splus;
+
+      if ( R > 0 ) {
+
+        time.reset(new Timer("Setting Parameters",DebugMessage,"ba"));
+        for (size_t j = 0; j < this->m_model.num_cameras(); ++j)
+          this->m_model.set_A_parameters(j, this->m_model.A_parameters(j) +
+                                         subvector(m_delta_a, num_cam_params*j,num_cam_params));
+        for (size_t i = 0; i < this->m_model.num_points(); ++i)
+          this->m_model.set_B_parameters(i, this->m_model.B_parameters(i) + m_delta_b[i]);
+        time.reset();
+
+        if ( this->m_control == 0 ) {
+          double temp = 1 - pow((2*R - 1),3);
+          if (temp < 1.0/3.0)
+            temp = 1.0/3.0;
+
+          this->m_lambda *= temp;
+          this->m_nu = 2;
+        } else if (this->m_control == 1)
+          this->m_lambda /= 10;
+
+        return SS-Splus;
+      }
+
+      // Didn't make progress ...
+      reject_step();
+      return 0;
+    }
+
+  };
+
+}} // namespace vw::ba
+
+#endif//__VW_BUNDLEADJUSTMENT_ADJUST_BLOCK_SPARSE_H__
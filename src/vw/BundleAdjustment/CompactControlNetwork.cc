@@ -0,0 +1,348 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file CompactControlNetwork.cc
+///
+
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
+#include <vw/Core/Exception.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if VW_HAVE_PKG_BOOST_IOSTREAMS
+#include <boost/iostreams/device/mapped_file.hpp>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+using namespace vw;
+using namespace vw::ba;
+
+namespace {
+
+  const char compact_magic[8] = { 'V', 'W', 'C', 'N', 'E', 'T', 0, 0 };
+  const uint32 compact_byte_order = 0x01020304;
+
+  // The file starts with this, and the arrays follow in the order
+  // of Layout, each starting on an 8 byte boundary.
+  struct Header {
+    char magic[8];
+    uint32 byte_order;
+    uint32 version;
+    uint64 num_points, num_measures, num_cameras;
+    uint32 network_type;
+    uint32 reserved;
+  };
+
+  inline size_t align8( size_t n ) { return (n + 7) & ~size_t(7); }
+
+  // Byte offsets of the arrays
+  struct Layout {
+    size_t point_position, point_sigma, point_type, point_start;
+    size_t measure_position, measure_sigma, measure_camera, measure_point;
+    size_t camera_start, camera_measure, size;
+
+    Layout( uint64 np, uint64 nm, uint64 nc ) {
+      point_position   = align8( sizeof(Header) );
+      point_sigma      = align8( point_position + 3*np*sizeof(double) );
+      point_type       = align8( point_sigma + 3*np*sizeof(double) );
+      point_start      = align8( point_type + np*sizeof(uint8) );
+      measure_position = align8( point_start + (np+1)*sizeof(uint64) );
+      measure_sigma    = align8( measure_position + 2*nm*sizeof(float) );
+      measure_camera   = align8( measure_sigma + 2*nm*sizeof(float) );
+      measure_point    = align8( measure_camera + nm*sizeof(uint32) );
+      camera_start     = align8( measure_point + nm*sizeof(uint32) );
+      camera_measure   = align8( camera_start + (nc+1)*sizeof(uint64) );
+      size             = align8( camera_measure + nm*sizeof(uint32) );
+    }
+  };
+
+  template <class T>
+  inline T* array_at( uint8* data, size_t offset ) {
+    return reinterpret_cast<T*>( data + offset );
+  }
+
+  // The arrays of a new buffer, to be filled in
+  struct Arrays {
+    double* point_position;
+    double* point_sigma;
+    uint8* point_type;
+    uint64* point_start;
+    float* measure_position;
+    float* measure_sigma;
+    uint32* measure_camera;
+    uint32* measure_point;
+    uint64* camera_start;
+    uint32* camera_measure;
+  };
+
+  // Allocates a zeroed buffer for a network of the given size and
+  // writes its header.
+  boost::shared_ptr<std::vector<uint64> > allocate( ControlNetwork::ControlNetworkType type,
+                                                    uint64 np, uint64 nm, uint64 nc,
+                                                    Arrays& arrays ) {
+    if ( np > 0xffffffffu || nm > 0xffffffffu || nc > 0xffffffffu )
+      vw_throw( ArgumentErr() << "CompactControlNetwork: too many points or measures." );
+
+    Layout layout( np, nm, nc );
+    boost::shared_ptr<std::vector<uint64> > buffer( new std::vector<uint64>( layout.size/8 ) );
+    uint8* data = reinterpret_cast<uint8*>( &(*buffer)[0] );
+
+    Header* header = reinterpret_cast<Header*>( data );
+    std::memcpy( header->magic, compact_magic, sizeof(compact_magic) );
+    header->byte_order = compact_byte_order;
+    header->version = CompactControlNetwork::file_version;
+    header->num_points = np;
+    header->num_measures = nm;
+    header->num_cameras = nc;
+    header->network_type = type;
+
+    arrays.point_position = array_at<double>( data, layout.point_position );
+    arrays.point_sigma = array_at<double>( data, layout.point_sigma );
+    arrays.point_type = array_at<uint8>( data, layout.point_type );
+    arrays.point_start = array_at<uint64>( data, layout.point_start );
+    arrays.measure_position = array_at<float>( data, layout.measure_position );
+    arrays.measure_sigma = array_at<float>( data, layout.measure_sigma );
+    arrays.measure_camera = array_at<uint32>( data, layout.measure_camera );
+    arrays.measure_point = array_at<uint32>( data, layout.measure_point );
+    arrays.camera_start = array_at<uint64>( data, layout.camera_start );
+    arrays.camera_measure = array_at<uint32>( data, layout.camera_measure );
+    return buffer;
+  }
+
+  // Fills in the camera index from the measure cameras.
+  void index_cameras( Arrays const& arrays, uint64 nm, uint64 nc ) {
+    for ( size_t m = 0; m < nm; ++m )
+      ++arrays.camera_start[arrays.measure_camera[m]+1];
+    for ( size_t j = 0; j < nc; ++j )
+      arrays.camera_start[j+1] += arrays.camera_start[j];
+    std::vector<uint64> next( arrays.camera_start, arrays.camera_start + nc );
+    for ( size_t m = 0; m < nm; ++m )
+      arrays.camera_measure[next[arrays.measure_camera[m]]++] = m;
+  }
+
+#if !VW_HAVE_PKG_BOOST_IOSTREAMS
+  struct PosixMapping {
+    void* data;
+    size_t size;
+    PosixMapping( void* data, size_t size ) : data(data), size(size) {}
+    ~PosixMapping() { munmap( data, size ); }
+  };
+#endif
+
+} // namespace
+
+CompactControlNetwork::CompactControlNetwork() {
+  // The smallest valid buffer: a header with no points or cameras.
+  Layout layout( 0, 0, 0 );
+  boost::shared_ptr<std::vector<uint64> > buffer( new std::vector<uint64>( layout.size/8 ) );
+  uint8* data = reinterpret_cast<uint8*>( &(*buffer)[0] );
+  Header* header = reinterpret_cast<Header*>( data );
+  std::memcpy( header->magic, compact_magic, sizeof(compact_magic) );
+  header->byte_order = compact_byte_order;
+  header->version = file_version;
+  header->network_type = ControlNetwork::ImageToImage;
+  set_buffer( buffer, data, layout.size );
+}
+
+CompactControlNetwork::CompactControlNetwork( ControlNetwork const& cnet ) {
+  uint64 num_measures = 0, num_cameras = 0;
+  for ( size_t i = 0; i < cnet.size(); ++i )
+    for ( ControlPoint::const_iterator cm = cnet[i].begin(); cm != cnet[i].end(); ++cm ) {
+      ++num_measures;
+      num_cameras = std::max( num_cameras, uint64(cm->image_id()) + 1 );
+    }
+
+  Arrays a;
+  boost::shared_ptr<std::vector<uint64> > buffer =
+    allocate( cnet.type(), cnet.size(), num_measures, num_cameras, a );
+
+  // The points, and their measures in point order
+  size_t m = 0;
+  a.point_start[0] = 0;
+  for ( size_t i = 0; i < cnet.size(); ++i ) {
+    ControlPoint const& cp = cnet[i];
+    for ( size_t k = 0; k < 3; ++k ) {
+      a.point_position[3*i+k] = cp.position()[k];
+      a.point_sigma[3*i+k] = cp.sigma()[k];
+    }
+    a.point_type[i] = cp.type();
+    for ( ControlPoint::const_iterator cm = cp.begin(); cm != cp.end(); ++cm, ++m ) {
+      a.measure_position[2*m] = cm->position()[0];
+      a.measure_position[2*m+1] = cm->position()[1];
+      a.measure_sigma[2*m] = cm->sigma()[0];
+      a.measure_sigma[2*m+1] = cm->sigma()[1];
+      a.measure_camera[m] = cm->image_id();
+      a.measure_point[m] = i;
+    }
+    a.point_start[i+1] = m;
+  }
+  index_cameras( a, num_measures, num_cameras );
+
+  set_buffer( buffer, reinterpret_cast<const uint8*>( &(*buffer)[0] ), buffer->size()*8 );
+}
+
+CompactControlNetwork::CompactControlNetwork( ControlNetwork::ControlNetworkType type,
+                                              std::vector<Vector3> const& point_positions,
+                                              std::vector<uint64> const& point_start,
+                                              std::vector<float> const& measure_positions,
+                                              std::vector<float> const& measure_sigmas,
+                                              std::vector<uint32> const& measure_cameras,
+                                              size_t num_cameras ) {
+  const size_t num_points = point_positions.size(), num_measures = measure_cameras.size();
+  if ( point_start.size() != num_points + 1 || point_start.front() != 0 ||
+       point_start.back() != num_measures || measure_positions.size() != 2*num_measures ||
+       measure_sigmas.size() != 2*num_measures )
+    vw_throw( ArgumentErr() << "CompactControlNetwork: the point and measure arrays do not agree." );
+  for ( size_t m = 0; m < num_measures; ++m )
+    if ( measure_cameras[m] >= num_cameras )
+      vw_throw( ArgumentErr() << "CompactControlNetwork: measure " << m << " has no camera." );
+
+  Arrays a;
+  boost::shared_ptr<std::vector<uint64> > buffer =
+    allocate( type, num_points, num_measures, num_cameras, a );
+
+  for ( size_t i = 0; i < num_points; ++i ) {
+    for ( size_t k = 0; k < 3; ++k )
+      a.point_position[3*i+k] = point_positions[i][k];
+    a.point_type[i] = ControlPoint::TiePoint;
+    a.point_start[i+1] = point_start[i+1];
+    for ( size_t m = point_start[i]; m < point_start[i+1]; ++m )
+      a.measure_point[m] = i;
+  }
+  if ( num_measures ) {
+    std::copy( measure_positions.begin(), measure_positions.end(), a.measure_position );
+    std::copy( measure_sigmas.begin(), measure_sigmas.end(), a.measure_sigma );
+    std::copy( measure_cameras.begin(), measure_cameras.end(), a.measure_camera );
+  }
+  index_cameras( a, num_measures, num_cameras );
+
+  set_buffer( buffer, reinterpret_cast<const uint8*>( &(*buffer)[0] ), buffer->size()*8 );
+}
+
+void CompactControlNetwork::set_buffer( boost::shared_ptr<const void> storage,
+                                        const uint8* data, size_t size ) {
+  if ( size < sizeof(Header) )
+    vw_throw( IOErr() << "CompactControlNetwork: truncated header." );
+  Header const* header = reinterpret_cast<Header const*>( data );
+  if ( std::memcmp( header->magic, compact_magic, sizeof(compact_magic) ) != 0 )
+    vw_throw( IOErr() << "CompactControlNetwork: not a compact control network." );
+  if ( header->byte_order != compact_byte_order )
+    vw_throw( IOErr() << "CompactControlNetwork: written with the other byte order." );
+  if ( header->version > file_version )
+    vw_throw( IOErr() << "CompactControlNetwork: unsupported version " << header->version << "." );
+
+  // Each point, measure and camera takes at least this many bytes,
+  // so bounding the counts by the size first keeps the arithmetic in
+  // Layout from overflowing.  Measures and points are also indexed
+  // with 32 bits.
+  const uint64 np = header->num_points, nm = header->num_measures, nc = header->num_cameras;
+  const size_t point_bytes = 6*sizeof(double) + sizeof(uint8) + sizeof(uint64);
+  const size_t measure_bytes = 4*sizeof(float) + 3*sizeof(uint32);
+  if ( np > 0xffffffffu || nm > 0xffffffffu || nc > 0xffffffffu ||
+       np > size / point_bytes || nm > size / measure_bytes || nc > size / sizeof(uint64) )
+    vw_throw( IOErr() << "CompactControlNetwork: " << np << " points, " << nm << " measures and "
+              << nc << " cameras don't fit in " << size << " bytes." );
+
+  Layout layout( np, nm, nc );
+  if ( size < layout.size )
+    vw_throw( IOErr() << "CompactControlNetwork: expected " << layout.size
+              << " bytes, found " << size << "." );
+
+  m_storage = storage;
+  m_data = data;
+  m_size = size;
+  m_num_points = header->num_points;
+  m_num_measures = header->num_measures;
+  m_num_cameras = header->num_cameras;
+  m_type = ControlNetwork::ControlNetworkType( header->network_type );
+
+  uint8* bytes = const_cast<uint8*>( data );
+  m_point_position = array_at<double>( bytes, layout.point_position );
+  m_point_sigma = array_at<double>( bytes, layout.point_sigma );
+  m_point_type = array_at<uint8>( bytes, layout.point_type );
+  m_point_start = array_at<uint64>( bytes, layout.point_start );
+  m_measure_position = array_at<float>( bytes, layout.measure_position );
+  m_measure_sigma = array_at<float>( bytes, layout.measure_sigma );
+  m_measure_camera = array_at<uint32>( bytes, layout.measure_camera );
+  m_measure_point = array_at<uint32>( bytes, layout.measure_point );
+  m_camera_start = array_at<uint64>( bytes, layout.camera_start );
+  m_camera_measure = array_at<uint32>( bytes, layout.camera_measure );
+
+  // The accessors don't check their indices, so check every index in
+  // the file once, here.
+  if ( m_point_start[0] != 0 || m_point_start[m_num_points] != m_num_measures ||
+       m_camera_start[0] != 0 || m_camera_start[m_num_cameras] != m_num_measures )
+    vw_throw( IOErr() << "CompactControlNetwork: inconsistent measure counts." );
+  for ( size_t i = 0; i < m_num_points; ++i )
+    if ( m_point_start[i+1] < m_point_start[i] )
+      vw_throw( IOErr() << "CompactControlNetwork: the measures of point " << i << " are out of order." );
+  for ( size_t j = 0; j < m_num_cameras; ++j )
+    if ( m_camera_start[j+1] < m_camera_start[j] )
+      vw_throw( IOErr() << "CompactControlNetwork: the measures of camera " << j << " are out of order." );
+  for ( size_t m = 0; m < m_num_measures; ++m )
+    if ( m_measure_camera[m] >= m_num_cameras || m_measure_point[m] >= m_num_points ||
+         m_camera_measure[m] >= m_num_measures )
+      vw_throw( IOErr() << "CompactControlNetwork: measure " << m << " is out of range." );
+}
+
+void CompactControlNetwork::expand( ControlNetwork& cnet ) const {
+  cnet.clear();
+  cnet.set_type( m_type );
+  for ( size_t i = 0; i < m_num_points; ++i ) {
+    ControlPoint cp( point_type(i) );
+    cp.set_position( point_position(i) );
+    cp.set_sigma( point_sigma(i) );
+    for ( size_t m = point_begin(i); m < point_end(i); ++m )
+      cp.add_measure( ControlMeasure( m_measure_position[2*m], m_measure_position[2*m+1],
+                                      m_measure_sigma[2*m], m_measure_sigma[2*m+1],
+                                      m_measure_camera[m] ) );
+    cnet.add_control_point( cp );
+  }
+}
+
+void CompactControlNetwork::read_binary( std::string const& filename ) {
+  if ( !is_compact_file( filename ) )
+    vw_throw( IOErr() << "Failed to open \"" << filename << "\" as a compact Control Network." );
+
+#if VW_HAVE_PKG_BOOST_IOSTREAMS
+  boost::shared_ptr<boost::iostreams::mapped_file_source> mapping
+    ( new boost::iostreams::mapped_file_source( filename.c_str() ) );
+  set_buffer( mapping, reinterpret_cast<const uint8*>( mapping->data() ), mapping->size() );
+#else
+  int filedes = open( filename.c_str(), O_RDONLY );
+  off_t length = lseek( filedes, 0, SEEK_END );
+  void* data = mmap( 0, length, PROT_READ, MAP_PRIVATE, filedes, 0 );
+  close( filedes );
+  if ( data == MAP_FAILED )
+    vw_throw( IOErr() << "Failed to map \"" << filename << "\"." );
+  boost::shared_ptr<PosixMapping> mapping( new PosixMapping( data, length ) );
+  set_buffer( mapping, reinterpret_cast<const uint8*>( data ), length );
+#endif
+}
+
+void CompactControlNetwork::write_binary( std::string const& filename ) const {
+  std::ofstream f( filename.c_str(), std::ios::binary );
+  if ( !f.is_open() )
+    vw_throw( IOErr() << "Failed to open \"" << filename << "\" for writing." );
+  f.write( reinterpret_cast<const char*>( m_data ), m_size );
+  if ( !f )
+    vw_throw( IOErr() << "Failed to write \"" << filename << "\"." );
+}
+
+bool CompactControlNetwork::is_compact_file( std::string const& filename ) {
+  std::ifstream f( filename.c_str(), std::ios::binary );
+  char magic[sizeof(compact_magic)];
+  if ( !f.read( magic, sizeof(magic) ) )
+    return false;
+  return std::memcmp( magic, compact_magic, sizeof(compact_magic) ) == 0;
+}
@@ -0,0 +1,142 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file CompactControlNetwork.h
+///
+/// A read-only control network held as flat arrays, for networks too
+/// large for ControlNetwork.  Only what bundle adjustment needs is
+/// kept: the position, sigma and type of each point, and the
+/// position, sigma, camera and point of each measure.  The measures
+/// are ordered by point, and are also indexed by camera.  This costs
+/// 28 bytes per measure, plus 57 per point and 8 per camera.
+/// build_control_network() in ControlNetworkLoader.h can build one
+/// straight from match files.
+///
+/// All of the arrays live in one buffer, which is also the file
+/// format, so reading a file just maps it into memory.  The format is
+/// native endian and versioned; files written on a machine of the
+/// other byte order are rejected.
+///
+#ifndef __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
+#define __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Math/Vector.h>
+#include <vw/BundleAdjustment/ControlNetwork.h>
+
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace vw {
+namespace ba {
+
+  class CompactControlNetwork {
+    // Keeps the buffer alive, whether it is owned or mapped
+    boost::shared_ptr<const void> m_storage;
+    const uint8* m_data;
+    size_t m_size;
+
+    uint64 m_num_points, m_num_measures, m_num_cameras;
+    ControlNetwork::ControlNetworkType m_type;
+
+    const double* m_point_position;
+    const double* m_point_sigma;
+    const uint8* m_point_type;
+    const uint64* m_point_start;
+    const float* m_measure_position;
+    const float* m_measure_sigma;
+    const uint32* m_measure_camera;
+    const uint32* m_measure_point;
+    const uint64* m_camera_start;
+    const uint32* m_camera_measure;
+
+    // Points the arrays into the buffer, checking its header.
+    void set_buffer( boost::shared_ptr<const void> storage, const uint8* data, size_t size );
+
+  public:
+    /// The current version of the file format
+    static const uint32 file_version = 1;
+
+    /// An empty network
+    CompactControlNetwork();
+
+    /// Flattens cnet.  There is one camera for each image_id up to
+    /// the largest one in use.
+    explicit CompactControlNetwork( ControlNetwork const& cnet );
+
+    /// Builds a network of tie points straight from flat arrays.  The
+    /// measures of point i are [point_start[i], point_start[i+1]), and
+    /// their positions and sigmas are interleaved (col, row) pairs.
+    CompactControlNetwork( ControlNetwork::ControlNetworkType type,
+                           std::vector<Vector3> const& point_positions,
+                           std::vector<uint64> const& point_start,
+                           std::vector<float> const& measure_positions,
+                           std::vector<float> const& measure_sigmas,
+                           std::vector<uint32> const& measure_cameras,
+                           size_t num_cameras );
+
+    /// Maps a file written by write_binary().
+    explicit CompactControlNetwork( std::string const& filename ) { read_binary( filename ); }
+
+    ControlNetwork::ControlNetworkType type() const { return m_type; }
+    size_t num_points() const { return m_num_points; }
+    size_t num_measures() const { return m_num_measures; }
+    size_t num_cameras() const { return m_num_cameras; }
+
+    /// Control point i
+    Vector3 point_position( size_t i ) const {
+      return Vector3( m_point_position[3*i], m_point_position[3*i+1], m_point_position[3*i+2] );
+    }
+    Vector3 point_sigma( size_t i ) const {
+      return Vector3( m_point_sigma[3*i], m_point_sigma[3*i+1], m_point_sigma[3*i+2] );
+    }
+    ControlPoint::ControlPointType point_type( size_t i ) const {
+      return ControlPoint::ControlPointType( m_point_type[i] );
+    }
+
+    /// The measures of point i are [point_begin(i), point_end(i)).
+    size_t point_begin( size_t i ) const { return m_point_start[i]; }
+    size_t point_end( size_t i ) const { return m_point_start[i+1]; }
+
+    /// Measure m
+    Vector2 position( size_t m ) const {
+      return Vector2( m_measure_position[2*m], m_measure_position[2*m+1] );
+    }
+    Vector2 sigma( size_t m ) const {
+      return Vector2( m_measure_sigma[2*m], m_measure_sigma[2*m+1] );
+    }
+    uint32 camera( size_t m ) const { return m_measure_camera[m]; }
+    uint32 point( size_t m ) const { return m_measure_point[m]; }
+
+    /// The measures of camera j are camera_measure(k) for k in
+    /// [camera_begin(j), camera_end(j)), in point order.
+    size_t camera_begin( size_t j ) const { return m_camera_start[j]; }
+    size_t camera_end( size_t j ) const { return m_camera_start[j+1]; }
+    uint32 camera_measure( size_t k ) const { return m_camera_measure[k]; }
+
+    /// The arrays themselves.  Positions and sigmas are interleaved
+    /// (col, row) pairs.
+    const float* measure_positions() const { return m_measure_position; }
+    const float* measure_sigmas() const { return m_measure_sigma; }
+    const uint32* measure_cameras() const { return m_measure_camera; }
+    const uint32* measure_points() const { return m_measure_point; }
+
+    /// Rebuilds a ControlNetwork with the same points and measures.
+    void expand( ControlNetwork& cnet ) const;
+
+    /// File I/O
+    void read_binary( std::string const& filename );
+    void write_binary( std::string const& filename ) const;
+
+    /// Whether filename starts like a file written by write_binary().
+    static bool is_compact_file( std::string const& filename );
+  };
+
+}} // namespace vw::ba
+
+#endif // __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
@@ -134,55 +134,272 @@ void vw::ba::build_control_network( ControlNetwork& cnet,
   }
 }
 
+namespace {
+  // Averages the positions triangulated from each consecutive pair
+  // of measures that are far enough apart.
+  Vector3 triangulate_measures( std::vector<Vector2> const& positions,
+                                std::vector<uint32> const& cameras,
+                                std::vector<boost::shared_ptr<camera::CameraModel> > const& camera_models,
+                                double const& minimum_angle ) {
+    std::vector< Vector3 > points;
+    double error = 0, error_sum = 0;
+
+    // 4.1.) Building a listing of triangulation
+    for ( unsigned j = 0, k = 1; k < positions.size(); j++, k++ ) {
+      // Make sure camera centers are not equal
+      uint32 j_cam_id = cameras[j];
+      uint32 k_cam_id = cameras[k];
+      if ( norm_2( camera_models[j_cam_id]->camera_center( positions[j] ) -
+                   camera_models[k_cam_id]->camera_center( positions[k] ) ) > 1e-6 ) {
+
+        try {
+          stereo::StereoModel sm( camera_models[ j_cam_id ].get(),
+                                  camera_models[ k_cam_id ].get() );
+
+          if ( sm.convergence_angle( positions[j], positions[k] ) >
+               minimum_angle ) {
+            points.push_back( sm( positions[j], positions[k], error ) );
+            error_sum += error;
+          }
+        } catch ( camera::PixelToRayErr e ) { /* Just let it go */ }
+      }
+    }
+
+    // 4.2.) Summing, Averaging, and Storing
+    if ( points.empty() ) {
+      vw_out(WarningMessage,"ba") << "Unable to triangulation position for point!\n";
+      // At the very least we can provide a point that is some
+      // distance out from the camera center and is in the 'general'
+      // area.
+      uint32 j = cameras[0];
+      try {
+        return camera_models[j]->camera_center(positions[0]) +
+          camera_models[j]->pixel_to_vector(positions[0])*10;
+      } catch ( camera::PixelToRayErr e ) {
+        return camera_models[j]->camera_center(positions[0]) +
+          camera_models[j]->camera_pose(positions[0]).rotate(Vector3(0,0,10));
+      }
+    }
+    error_sum /= points.size();
+    Vector3 position_avg;
+    for ( unsigned j = 0; j < points.size(); j++ )
+      position_avg += points[j]/points.size();
+    return position_avg;
+  }
+}
+
 void vw::ba::triangulate_control_point( ControlPoint& cp,
                                         std::vector<boost::shared_ptr<camera::CameraModel> > const& camera_models,
                                         double const& minimum_angle ) {
-  std::vector< Vector3 > positions;
-  double error = 0, error_sum = 0;
+  std::vector<Vector2> positions;
+  std::vector<uint32> cameras;
+  for ( unsigned j = 0; j < cp.size(); j++ ) {
+    positions.push_back( cp[j].position() );
+    cameras.push_back( cp[j].image_id() );
+  }
+  cp.set_position( triangulate_measures( positions, cameras, camera_models, minimum_angle ) );
+}
 
-  // 4.1.) Building a listing of triangulation
-  for ( unsigned j = 0, k = 1; k < cp.size(); j++, k++ ) {
-    // Make sure camera centers are not equal
-    int j_cam_id = cp[j].image_id();
-    int k_cam_id = cp[k].image_id();
-    if ( norm_2( camera_models[j_cam_id]->camera_center( cp[j].position() ) -
-                 camera_models[k_cam_id]->camera_center( cp[k].position() ) ) > 1e-6 ) {
+namespace {
+  // One side of a match: an interest point in a camera
+  struct Observation {
+    uint32 camera;
+    float x, y, scale;
+  };
 
-      try {
-        stereo::StereoModel sm( camera_models[ j_cam_id ].get(),
-                                camera_models[ k_cam_id ].get() );
-
-        if ( sm.convergence_angle( cp[j].position(),
-                                   cp[k].position() ) >
-             minimum_angle ) {
-          positions.push_back( sm( cp[j].position(),
-                                   cp[k].position(),
-                                   error ) );
-          error_sum += error;
+  // Orders observations by camera and position, so that the
+  // observations of one feature are next to each other.
+  struct ObservationLess {
+    std::vector<Observation> const& m_obs;
+    ObservationLess( std::vector<Observation> const& obs ) : m_obs(obs) {}
+    bool operator()( uint32 a, uint32 b ) const {
+      Observation const& oa = m_obs[a];
+      Observation const& ob = m_obs[b];
+      if ( oa.camera != ob.camera ) return oa.camera < ob.camera;
+      if ( oa.x != ob.x ) return oa.x < ob.x;
+      return oa.y < ob.y;
+    }
+  };
+
+  inline bool same_feature( Observation const& a, Observation const& b ) {
+    return a.camera == b.camera && a.x == b.x && a.y == b.y;
+  }
+
+  // Disjoint sets of observations
+  class ObservationSets {
+    std::vector<uint32> m_parent;
+  public:
+    ObservationSets( size_t size ) : m_parent( size ) {
+      for ( size_t i = 0; i < size; ++i )
+        m_parent[i] = i;
+    }
+    uint32 find( uint32 i ) {
+      while ( m_parent[i] != i ) {
+        m_parent[i] = m_parent[m_parent[i]];
+        i = m_parent[i];
+      }
+      return i;
+    }
+    void join( uint32 a, uint32 b ) {
+      a = find( a );
+      b = find( b );
+      if ( a < b ) m_parent[b] = a;
+      else if ( b < a ) m_parent[a] = b;
+    }
+  };
+}
+
+void vw::ba::build_control_network( CompactControlNetwork& cnet,
+                                    std::vector<boost::shared_ptr<camera::CameraModel> > const& camera_models,
+                                    std::vector<std::string> const& image_files,
+                                    int min_matches ) {
+  // 1.) Load every match as a pair of observations
+  std::vector<Observation> obs;
+  {
+    TerminalProgressCallback progress("ba","Match Files: ");
+    progress.report_progress(0);
+    int32 num_load_rejected = 0, num_loaded = 0;
+    for ( unsigned i = 0; i < image_files.size(); ++i ) {
+      progress.report_progress(float(i)/float(image_files.size()));
+      for ( unsigned j = i+1; j < image_files.size(); ++j ) {
+        std::string match_filename =
+          fs::path( image_files[i] ).replace_extension().string() + "__" +
+          fs::path( image_files[j] ).stem() + ".match";
+
+        if ( !fs::exists( match_filename ) )
+          continue;
+
+        std::vector<ip::InterestPoint> ip1, ip2;
+        ip::read_binary_match_file( match_filename, ip1, ip2 );
+        if ( int( ip1.size() ) < min_matches ) {
+          vw_out(VerboseDebugMessage,"ba") << "\t" << match_filename << "    "
+                                           << i << " <-> " << j << " : "
+                                           << ip1.size() << " matches. [rejected]\n";
+          num_load_rejected += ip1.size();
+          continue;
         }
-      } catch ( camera::PixelToRayErr e ) { /* Just let it go */ }
+        vw_out(VerboseDebugMessage,"ba") << "\t" << match_filename << "    "
+                                         << i << " <-> " << j << " : "
+                                         << ip1.size() << " matches.\n";
+        num_loaded += ip1.size();
+
+        std::for_each( ip1.begin(), ip1.end(), safe_measurement );
+        std::for_each( ip2.begin(), ip2.end(), safe_measurement );
+        for ( size_t k = 0; k < ip1.size(); ++k ) {
+          Observation o1 = { i, ip1[k].x, ip1[k].y, ip1[k].scale };
+          Observation o2 = { j, ip2[k].x, ip2[k].y, ip2[k].scale };
+          obs.push_back( o1 );
+          obs.push_back( o2 );
+        }
+      }
+    }
+    progress.report_finished();
+    if ( num_load_rejected != 0 ) {
+      vw_out(WarningMessage,"ba") << "\tDidn't load " << num_load_rejected
+                                  << " matches due to inadequacy.\n";
+      vw_out(WarningMessage,"ba") << "\tLoaded " << num_loaded << " matches.\n";
     }
   }
+  if ( obs.size() > 0xffffffffu )
+    vw_throw( ArgumentErr() << "build_control_network: too many matches." );
 
-  // 4.2.) Summing, Averaging, and Storing
-  if ( positions.empty() ) {
-    vw_out(WarningMessage,"ba") << "Unable to triangulation position for point!\n";
-    // At the very least we can provide a point that is some
-    // distance out from the camera center and is in the 'general'
-    // area.
-    int j = cp[0].image_id();
-    try {
-      cp.set_position( camera_models[j]->camera_center(cp[0].position()) +
-                       camera_models[j]->pixel_to_vector(cp[0].position())*10 );
-    } catch ( camera::PixelToRayErr e ) {
-      cp.set_position( camera_models[j]->camera_center(cp[0].position()) +
-                       camera_models[j]->camera_pose(cp[0].position()).rotate(Vector3(0,0,10)) );
+  // 2.) Merging.  The two sides of a match belong to the same point,
+  // and so do observations of the same feature: the same position in
+  // the same camera.  A stable sort keeps the first observation of
+  // each feature, and so its scale, at the front of its run.
+  std::vector<uint32> order( obs.size() );
+  for ( size_t k = 0; k < order.size(); ++k )
+    order[k] = k;
+  std::stable_sort( order.begin(), order.end(), ObservationLess( obs ) );
+
+  ObservationSets sets( obs.size() );
+  for ( size_t k = 0; k + 1 < obs.size(); k += 2 )
+    sets.join( k, k+1 );
+  std::vector<uint32> features;
+  for ( size_t k = 0; k < order.size(); ++k ) {
+    if ( k > 0 && same_feature( obs[order[k-1]], obs[order[k]] ) )
+      sets.join( order[k-1], order[k] );
+    else
+      features.push_back( order[k] );
+  }
+  std::vector<uint32>().swap( order );
+
+  // 3.) Grouping features into points, numbered in the order their
+  // first feature is reached.  Features arrive in camera order, and
+  // so do the measures of each point.
+  const uint32 unassigned = 0xffffffffu;
+  std::vector<uint32> point_of_root( obs.size(), unassigned );
+  std::vector<uint32> feature_point( features.size() );
+  std::vector<uint64> group_start( 1, 0 );
+  for ( size_t f = 0; f < features.size(); ++f ) {
+    uint32& point = point_of_root[sets.find( features[f] )];
+    if ( point == unassigned ) {
+      point = group_start.size() - 1;
+      group_start.push_back( 0 );
     }
-  } else {
-    error_sum /= positions.size();
-    Vector3 position_avg;
-    for ( unsigned j = 0; j < positions.size(); j++ )
-      position_avg += positions[j]/positions.size();
-    cp.set_position( position_avg );
+    feature_point[f] = point;
+    ++group_start[point+1];
+  }
+  std::vector<uint32>().swap( point_of_root );
+  for ( size_t p = 1; p < group_start.size(); ++p )
+    group_start[p] += group_start[p-1];
+  std::vector<uint32> grouped( features.size() );
+  {
+    std::vector<uint64> next( group_start.begin(), group_start.end() - 1 );
+    for ( size_t f = 0; f < features.size(); ++f )
+      grouped[next[feature_point[f]]++] = features[f];
   }
+
+  // 4.) Assembling the points, but not those that reach the same
+  // camera twice ('spiral' errors), then triangulating them.
+  std::vector<Vector3> point_positions;
+  std::vector<uint64> point_start( 1, 0 );
+  std::vector<float> measure_positions, measure_sigmas;
+  std::vector<uint32> measure_cameras;
+  int spiral_error_count = 0;
+  {
+    TerminalProgressCallback progress("ba", "Triangulating:");
+    progress.report_progress(0);
+    const size_t num_groups = group_start.size() - 1;
+    const double min_angle = 5.0*M_PI/180.0;
+    std::vector<Vector2> positions;
+    std::vector<uint32> cameras;
+    for ( size_t p = 0; p < num_groups; ++p ) {
+      if ( p % 1024 == 0 )
+        progress.report_progress( float(p)/float(num_groups) );
+      bool spiral = false;
+      for ( size_t g = group_start[p] + 1; g < group_start[p+1]; ++g )
+        if ( obs[grouped[g]].camera == obs[grouped[g-1]].camera )
+          spiral = true;
+      if ( spiral ) {
+        spiral_error_count++;
+        continue;
+      }
+
+      positions.clear();
+      cameras.clear();
+      for ( size_t g = group_start[p]; g < group_start[p+1]; ++g ) {
+        Observation const& o = obs[grouped[g]];
+        positions.push_back( Vector2( o.x, o.y ) );
+        cameras.push_back( o.camera );
+        measure_positions.push_back( o.x );
+        measure_positions.push_back( o.y );
+        measure_sigmas.push_back( o.scale );
+        measure_sigmas.push_back( o.scale );
+        measure_cameras.push_back( o.camera );
+      }
+      point_start.push_back( measure_cameras.size() );
+      point_positions.push_back( triangulate_measures( positions, cameras, camera_models, min_angle ) );
+    }
+    progress.report_finished();
+  }
+  if ( spiral_error_count != 0 )
+    vw_out(WarningMessage,"ba") << "\t" << spiral_error_count
+                                << " control points removed due to spiral errors.\n";
+  VW_ASSERT( !point_positions.empty(),
+             Aborted() << "Failed to load any points, Control Network empty\n" );
+
+  cnet = CompactControlNetwork( ControlNetwork::ImageToImage, point_positions, point_start,
+                                measure_positions, measure_sigmas, measure_cameras,
+                                image_files.size() );
 }
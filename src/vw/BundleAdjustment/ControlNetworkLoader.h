@@ -9,6 +9,7 @@
 #define __VW_BUNDLEADJUSTMENT_CONTROL_NETWORK_LOADER_H__
 
 #include <vw/BundleAdjustment/ControlNetwork.h>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
 #include <vw/BundleAdjustment/CameraRelation.h>
 #include <vw/Camera/CameraModel.h>
 #include <vw/Cartography/SimplePointImageManipulation.h>
@@ -28,6 +29,17 @@ namespace ba {
                               std::vector<std::string> const& image_files,
                               int min_matches = 30 );
 
+  // Builds the same network straight into flat arrays, for networks
+  // too large for ControlNetwork.  Matches are merged into points
+  // without building ControlMeasures or linking features to each
+  // other.  The points and their measures come out in a different
+  // order than above: points by their first camera, and measures by
+  // camera.
+  void build_control_network( CompactControlNetwork& cnet,
+                              std::vector<boost::shared_ptr<camera::CameraModel> > const& camera_models,
+                              std::vector<std::string> const& image_files,
+                              int min_matches = 30 );
+
   void triangulate_control_point( ControlPoint& cp,
                                   std::vector<boost::shared_ptr<camera::CameraModel> > const& camera_models,
                                   double const& minimum_angle );
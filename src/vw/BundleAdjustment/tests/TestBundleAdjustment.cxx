@@ -34,11 +34,13 @@ class TestBAModel : public ba::ModelBase< TestBAModel, 6, 3 > {
   std::vector<camera_vector_t> a, a_target;
   std::vector<point_vector_t> b, b_target;
   size_t m_num_pixel_observations;
+  size_t m_throw_camera;
 
 public:
   // Constructor
   TestBAModel( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
-               boost::shared_ptr<ControlNetwork> network ) : m_cameras(cameras), m_cnet(network) {
+               boost::shared_ptr<ControlNetwork> network ) : m_cameras(cameras), m_cnet(network),
+                                                             m_throw_camera(cameras.size()) {
 
     // Compute the number of observations from the bundle.
     m_num_pixel_observations = 0;
@@ -69,6 +71,9 @@ public:
   Vector2 operator() ( size_t /*i*/, size_t j,
                        camera_vector_t const& a_j,
                        point_vector_t const& b_i ) const {
+    if ( j == m_throw_camera )
+      vw_throw( ArgumentErr() << "TestBAModel: camera " << j << " was told to fail." );
+
     // Quaternions are the last half of this equation
     AdjustedCameraModel cam( m_cameras[j],
                              subvector(a_j,0,3),
@@ -100,6 +105,9 @@ public:
   void set_A_parameters(size_t j, camera_vector_t const& a_j) { a[j] = a_j; }
   void set_B_parameters(size_t i, point_vector_t const& b_i) { b[i] = b_i; }
 
+  // Make every observation of camera j throw.
+  void throw_on_camera( size_t j ) { m_throw_camera = j; }
+
   boost::shared_ptr<ControlNetwork> control_network(void) {
     return m_cnet; }
 };
@@ -231,6 +239,53 @@ TEST_F( NullTest, AdjustSparse ) {
   }
 }
 
+TEST_F( NullTest, AdjustBlockSparse ) {
+  TestBAModel model( cameras, cnet );
+  AdjustBlockSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+  // Running BA
+  double abs_tol = 1e10, rel_tol = 1e10;
+  for ( uint32 i = 0; i < 5; i++ )
+    adjuster.update(abs_tol,rel_tol);
+
+  // Checking solutions
+  Vector<double,6> zero_vector;
+  for ( uint32 i = 0; i < 5; i++ ) {
+    Vector<double> solution = model.A_parameters(i);
+    EXPECT_VECTOR_NEAR( solution, zero_vector, 1e-1 );
+  }
+}
+
+TEST_F( NullTest, AdjustBlockSparseThrows ) {
+  TestBAModel model( cameras, cnet );
+  AdjustBlockSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+  adjuster.set_threads( 3 );
+  model.throw_on_camera( 2 );
+
+  // The worker's error comes back out of update(), not std::terminate.
+  double abs_tol = 1e10, rel_tol = 1e10;
+  EXPECT_THROW( adjuster.update(abs_tol,rel_tol), ArgumentErr );
+}
+
+TEST_F( NullTest, AdjustBlockSparseCG ) {
+  TestBAModel model( cameras, cnet );
+  AdjustBlockSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+  adjuster.set_solver( AdjustBlockSparse< TestBAModel, L2Error >::CONJUGATE_GRADIENT );
+
+  // Running BA
+  double abs_tol = 1e10, rel_tol = 1e10;
+  for ( uint32 i = 0; i < 5; i++ )
+    adjuster.update(abs_tol,rel_tol);
+  EXPECT_EQ( 0u, adjuster.S().num_blocks() );
+
+  // Checking solutions
+  Vector<double,6> zero_vector;
+  for ( uint32 i = 0; i < 5; i++ ) {
+    Vector<double> solution = model.A_parameters(i);
+    EXPECT_VECTOR_NEAR( solution, zero_vector, 1e-1 );
+  }
+}
+
 TEST_F( NullTest, AdjustRobustRef ) {
   TestBAModel model( cameras, cnet );
   AdjustRobustRef< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
@@ -306,6 +361,124 @@ TEST_F( ComparisonTest, Ref_VS_Sparse ) {
                         1e-3 );
 }
 
+TEST_F( ComparisonTest, Ref_VS_BlockSparse ) {
+  std::vector<Vector<double> > ref_solution;
+  std::vector<Vector<double> > blk_solution;
+
+  { // Performing Ref BA
+    TestBAModel model( cameras, cnet );
+    AdjustRef< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+    // Running BA
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    // Storing result
+    for ( uint32 i = 0; i < 5; i++ )
+      ref_solution.push_back( model.A_parameters(i) );
+  }
+
+  { // Performing Block Sparse BA, splitting the points between threads
+    TestBAModel model( cameras, cnet );
+    AdjustBlockSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+    adjuster.set_threads(3);
+    EXPECT_EQ( 3, adjuster.threads() );
+
+    // Running BA
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    // Storing result
+    for ( uint32 i = 0; i < 5; i++ )
+      blk_solution.push_back( model.A_parameters(i) );
+  }
+
+  // Comparison
+  for ( uint32 i = 0; i < 5; i++ )
+    ASSERT_VECTOR_NEAR( ref_solution[i],
+                        blk_solution[i],
+                        1e-3 );
+}
+
+TEST_F( ComparisonTest, BlockSparse_VS_BlockSparseCG ) {
+  typedef AdjustBlockSparse< TestBAModel, L2Error > AdjusterT;
+  std::vector<Vector<double> > chol_solution;
+  std::vector<Vector<double> > cg_solution[2];
+
+  { // Performing Block Sparse BA with Cholesky
+    TestBAModel model( cameras, cnet );
+    AdjusterT adjuster( model, L2Error(), false, false);
+
+    // Running BA
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    // Storing result
+    for ( uint32 i = 0; i < 5; i++ )
+      chol_solution.push_back( model.A_parameters(i) );
+  }
+
+  // Performing Block Sparse BA with conjugate gradient, with each
+  // preconditioner, solving each step almost exactly
+  for ( int p = 0; p < 2; ++p ) {
+    TestBAModel model( cameras, cnet );
+    AdjusterT adjuster( model, L2Error(), false, false);
+    adjuster.set_solver( AdjusterT::CONJUGATE_GRADIENT );
+    adjuster.set_preconditioner( p == 0 ? AdjusterT::BLOCK_JACOBI : AdjusterT::SCHUR_JACOBI );
+    adjuster.set_cg_tolerance( 1e-12, 1000 );
+    adjuster.set_threads(3);
+
+    // Running BA
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    // Storing result
+    for ( uint32 i = 0; i < 5; i++ )
+      cg_solution[p].push_back( model.A_parameters(i) );
+  }
+
+  // Comparison
+  for ( int p = 0; p < 2; ++p )
+    for ( uint32 i = 0; i < 5; i++ )
+      ASSERT_VECTOR_NEAR( chol_solution[i],
+                          cg_solution[p][i],
+                          1e-3 );
+}
+
+TEST_F( ComparisonTest, BlockSparse_VS_BlockSparseCompact ) {
+  typedef AdjustBlockSparse< TestBAModel, L2Error > AdjusterT;
+  std::vector<Vector<double> > solution[2];
+
+  // The same adjustment, with the measures read from the control
+  // network and from its compact form
+  CompactControlNetwork compact( *cnet );
+  for ( int c = 0; c < 2; ++c ) {
+    TestBAModel model( cameras, cnet );
+    boost::scoped_ptr<AdjusterT> adjuster( c == 0 ?
+                                           new AdjusterT( model, L2Error(), false, false ) :
+                                           new AdjusterT( model, compact, L2Error(), false, false ) );
+
+    // Running BA
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster->update(abs_tol,rel_tol);
+
+    // Storing result
+    for ( uint32 i = 0; i < 5; i++ )
+      solution[c].push_back( model.A_parameters(i) );
+  }
+
+  // Comparison
+  for ( uint32 i = 0; i < 5; i++ )
+    ASSERT_VECTOR_NEAR( solution[0][i],
+                        solution[1][i],
+                        1e-8 );
+}
+
 // For whatever reason .. RobustRef and RobustSparse diverge
 // quickly. This is probably do to unwise application of floats or
 // arithmetic ordering.
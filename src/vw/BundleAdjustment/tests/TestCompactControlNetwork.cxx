@@ -0,0 +1,150 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
+
+#include <test/Helpers.h>
+
+using namespace vw;
+using namespace vw::ba;
+using namespace vw::test;
+
+// Point i is seen by cameras 3-i .. 3, and point 1 is a GCP.
+ControlNetwork make_test_network() {
+  ControlNetwork cnet( "TestCNET", ControlNetwork::ImageToGround );
+  for ( uint32 i = 0; i < 4; i++ ) {
+    ControlPoint cpoint( i == 1 ? ControlPoint::GroundControlPoint : ControlPoint::TiePoint );
+    cpoint.set_position( i, 2*i, 3*i );
+    cpoint.set_sigma( 1, 2, 3+i );
+    for ( uint32 j = 3-i; j < 4; j++ )
+      cpoint.add_measure( ControlMeasure( 10*i+j, 100+j, 1, 0.5, j ) );
+    cnet.add_control_point( cpoint );
+  }
+  return cnet;
+}
+
+void expect_same_network( ControlNetwork const& cnet, CompactControlNetwork const& compact ) {
+  ASSERT_EQ( cnet.size(), compact.num_points() );
+  EXPECT_EQ( cnet.type(), compact.type() );
+  size_t m = 0;
+  for ( size_t i = 0; i < cnet.size(); i++ ) {
+    EXPECT_VECTOR_DOUBLE_EQ( cnet[i].position(), compact.point_position(i) );
+    EXPECT_VECTOR_DOUBLE_EQ( cnet[i].sigma(), compact.point_sigma(i) );
+    EXPECT_EQ( cnet[i].type(), compact.point_type(i) );
+    ASSERT_EQ( m, compact.point_begin(i) );
+    ASSERT_EQ( m + cnet[i].size(), compact.point_end(i) );
+    for ( size_t k = 0; k < cnet[i].size(); k++, m++ ) {
+      EXPECT_VECTOR_DOUBLE_EQ( cnet[i][k].position(), compact.position(m) );
+      EXPECT_VECTOR_DOUBLE_EQ( cnet[i][k].sigma(), compact.sigma(m) );
+      EXPECT_EQ( cnet[i][k].image_id(), compact.camera(m) );
+      EXPECT_EQ( i, compact.point(m) );
+    }
+  }
+  EXPECT_EQ( m, compact.num_measures() );
+}
+
+TEST( CompactControlNetwork, Construction ) {
+  ControlNetwork cnet = make_test_network();
+  CompactControlNetwork compact( cnet );
+
+  EXPECT_EQ( 4u, compact.num_cameras() );
+  EXPECT_EQ( 10u, compact.num_measures() );
+  expect_same_network( cnet, compact );
+
+  // Camera j sees points 3-j .. 3
+  for ( size_t j = 0; j < 4; j++ ) {
+    ASSERT_EQ( j+1, compact.camera_end(j) - compact.camera_begin(j) );
+    for ( size_t k = compact.camera_begin(j); k < compact.camera_end(j); k++ ) {
+      uint32 m = compact.camera_measure(k);
+      EXPECT_EQ( j, compact.camera(m) );
+      EXPECT_EQ( 3 - j + k - compact.camera_begin(j), compact.point(m) );
+    }
+  }
+
+  ControlNetwork expanded( "Expanded" );
+  compact.expand( expanded );
+  ASSERT_EQ( cnet.size(), expanded.size() );
+  for ( size_t i = 0; i < cnet.size(); i++ )
+    for ( size_t k = 0; k < cnet[i].size(); k++ )
+      EXPECT_EQ( cnet[i][k], expanded[i][k] );
+  EXPECT_EQ( 1u, expanded.num_ground_control_points() );
+
+  CompactControlNetwork empty;
+  EXPECT_EQ( 0u, empty.num_points() );
+  EXPECT_EQ( 0u, empty.num_cameras() );
+}
+
+TEST( CompactControlNetwork, ReadWrite ) {
+  ControlNetwork cnet = make_test_network();
+  UnlinkName filename( "compact.ccnet" );
+  CompactControlNetwork( cnet ).write_binary( filename );
+
+  EXPECT_TRUE( CompactControlNetwork::is_compact_file( filename ) );
+  CompactControlNetwork mapped( filename );
+  EXPECT_EQ( 4u, mapped.num_cameras() );
+  expect_same_network( cnet, mapped );
+
+  // The mapping outlives the original object
+  CompactControlNetwork copy = mapped;
+  mapped = CompactControlNetwork();
+  expect_same_network( cnet, copy );
+}
+
+// Overwrites the bytes of filename at offset with those of value.
+template <class T>
+void patch_file( std::string const& filename, size_t offset, T value ) {
+  std::fstream f( filename.c_str(), std::ios::binary | std::ios::in | std::ios::out );
+  f.seekp( offset );
+  f.write( reinterpret_cast<const char*>( &value ), sizeof(value) );
+}
+
+TEST( CompactControlNetwork, BadFiles ) {
+  UnlinkName filename( "not_compact.ccnet" );
+  {
+    std::ofstream f( filename.c_str() );
+    f << "This is not a control network.";
+  }
+  EXPECT_FALSE( CompactControlNetwork::is_compact_file( filename ) );
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+
+  // A file cut short
+  CompactControlNetwork( make_test_network() ).write_binary( filename );
+  {
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    std::string bytes( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+    in.close();
+    std::ofstream out( filename.c_str(), std::ios::binary );
+    out.write( bytes.data(), bytes.size() / 2 );
+  }
+  EXPECT_TRUE( CompactControlNetwork::is_compact_file( filename ) );
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+
+  // Corrupted counts and indices.  The header is 48 bytes, and the
+  // test network has 4 points, 10 measures and 4 cameras, which puts
+  // point_start at 248, measure_camera at 448, measure_point at 488
+  // and camera_measure at 568.
+  CompactControlNetwork compact( make_test_network() );
+  compact.write_binary( filename );
+  EXPECT_NO_THROW( CompactControlNetwork mapped( filename ) );
+  patch_file( filename, 16, uint64(1) << 61 );      // num_points
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+  compact.write_binary( filename );
+  patch_file( filename, 248 + 8, uint64(5) );       // point_start[1]
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+  compact.write_binary( filename );
+  patch_file( filename, 448 + 4*3, uint32(4) );     // measure_camera[3]
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+  compact.write_binary( filename );
+  patch_file( filename, 488 + 4*9, uint32(7) );     // measure_point[9]
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+  compact.write_binary( filename );
+  patch_file( filename, 568, uint32(10) );          // camera_measure[0]
+  EXPECT_THROW( CompactControlNetwork mapped( filename ), IOErr );
+}
@@ -7,8 +7,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <sstream>
 #include <vw/BundleAdjustment/ControlNetworkLoader.h>
+#include <vw/Camera/PinholeModel.h>
 
 #include <test/Helpers.h>
 
@@ -67,3 +69,99 @@ TEST( ControlNetworkLoad, LoadingGCPNET ) {
   ASSERT_EQ( 2u, net.size() );
   EXPECT_EQ( ControlPoint::GroundControlPoint, net[1].type() );
 }
+
+// A control point as a sorted list of (camera, col, row, sigma)
+// measures, so that networks can be compared regardless of order.
+struct LoadedPoint {
+  std::vector<Vector4> measures;
+  Vector3 position;
+  bool operator<( LoadedPoint const& other ) const {
+    return std::lexicographical_compare( measures.begin(), measures.end(),
+                                         other.measures.begin(), other.measures.end(),
+                                         vector_less );
+  }
+  static bool vector_less( Vector4 const& a, Vector4 const& b ) {
+    return std::lexicographical_compare( a.begin(), a.end(), b.begin(), b.end() );
+  }
+};
+
+TEST( ControlNetworkLoad, CompactMatchesControlNetwork ) {
+  // Three cameras side by side, looking at a row of points.
+  std::vector<boost::shared_ptr<camera::CameraModel> > cameras;
+  std::vector<std::string> image_names;
+  for ( int c = 0; c < 3; c++ ) {
+    cameras.push_back( boost::shared_ptr<camera::CameraModel>(
+      new camera::PinholeModel( Vector3( 5*c-5, 0, 0 ), math::identity_matrix<3>(),
+                                500, 500, 320, 240, camera::NullLensDistortion() ) ) );
+    std::ostringstream name;
+    name << TEST_OBJDIR << "/cnload_" << c << ".tif";
+    image_names.push_back( name.str() );
+  }
+  std::vector<Vector3> points;
+  for ( int k = 0; k < 12; k++ )
+    points.push_back( Vector3( k-5.5, 0.5*(k%3), 20 ) );
+
+  // Cameras 0 and 1 see points 0-9, plus point 11 matched to two
+  // places in camera 1, which neither loader keeps.  Cameras 1 and 2
+  // see points 5-11.  Cameras 0 and 2 share too few matches to load.
+  UnlinkName match01( "cnload_0__cnload_1.match" ), match12( "cnload_1__cnload_2.match" ),
+    match02( "cnload_0__cnload_2.match" );
+  const int first[] = { 0, 1, 0 }, second[] = { 1, 2, 2 }, begin[] = { 0, 5, 0 }, end[] = { 10, 12, 4 };
+  const std::string* files[] = { &match01, &match12, &match02 };
+  for ( int f = 0; f < 3; f++ ) {
+    std::vector<ip::InterestPoint> ip1, ip2;
+    for ( int k = begin[f]; k < end[f]; k++ ) {
+      Vector2 px1 = cameras[first[f]]->point_to_pixel( points[k] );
+      Vector2 px2 = cameras[second[f]]->point_to_pixel( points[k] );
+      ip1.push_back( ip::InterestPoint( px1.x(), px1.y(), k%2 ? 2 : 0 ) );
+      ip2.push_back( ip::InterestPoint( px2.x(), px2.y(), 3 ) );
+    }
+    if ( f == 0 ) {
+      Vector2 px1 = cameras[0]->point_to_pixel( points[11] );
+      Vector2 px2 = cameras[1]->point_to_pixel( points[11] );
+      ip1.push_back( ip::InterestPoint( px1.x(), px1.y(), 1 ) );
+      ip2.push_back( ip::InterestPoint( px2.x(), px2.y(), 1 ) );
+      ip1.push_back( ip::InterestPoint( px1.x(), px1.y(), 1 ) );
+      ip2.push_back( ip::InterestPoint( px2.x() + 3, px2.y(), 1 ) );
+    }
+    ip::write_binary_match_file( *files[f], ip1, ip2 );
+  }
+
+  ControlNetwork cnet( "loaded" );
+  build_control_network( cnet, cameras, image_names, 5 );
+  CompactControlNetwork compact;
+  build_control_network( compact, cameras, image_names, 5 );
+
+  std::vector<LoadedPoint> expected( cnet.size() ), loaded( compact.num_points() );
+  for ( size_t i = 0; i < cnet.size(); i++ ) {
+    for ( size_t k = 0; k < cnet[i].size(); k++ )
+      expected[i].measures.push_back( Vector4( cnet[i][k].image_id(), cnet[i][k].position()[0],
+                                               cnet[i][k].position()[1], cnet[i][k].sigma()[0] ) );
+    std::sort( expected[i].measures.begin(), expected[i].measures.end(), LoadedPoint::vector_less );
+    expected[i].position = cnet[i].position();
+  }
+  for ( size_t i = 0; i < compact.num_points(); i++ ) {
+    for ( size_t m = compact.point_begin(i); m < compact.point_end(i); m++ ) {
+      loaded[i].measures.push_back( Vector4( compact.camera(m), compact.position(m)[0],
+                                             compact.position(m)[1], compact.sigma(m)[0] ) );
+      EXPECT_EQ( compact.sigma(m)[0], compact.sigma(m)[1] );
+      if ( m > compact.point_begin(i) )
+        EXPECT_LT( compact.camera(m-1), compact.camera(m) );
+    }
+    loaded[i].position = compact.point_position(i);
+    EXPECT_EQ( ControlPoint::TiePoint, compact.point_type(i) );
+  }
+  std::sort( expected.begin(), expected.end() );
+  std::sort( loaded.begin(), loaded.end() );
+
+  ASSERT_EQ( 11u, expected.size() );
+  ASSERT_EQ( expected.size(), loaded.size() );
+  EXPECT_EQ( 3u, compact.num_cameras() );
+  EXPECT_EQ( 27u, compact.num_measures() );
+  for ( size_t i = 0; i < expected.size(); i++ ) {
+    ASSERT_EQ( expected[i].measures.size(), loaded[i].measures.size() );
+    for ( size_t k = 0; k < expected[i].measures.size(); k++ )
+      EXPECT_VECTOR_DOUBLE_EQ( expected[i].measures[k], loaded[i].measures[k] );
+    EXPECT_VECTOR_NEAR( expected[i].position, loaded[i].position, 1e-3 );
+  }
+}
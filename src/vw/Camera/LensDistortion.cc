@@ -8,6 +8,7 @@
 #include <vw/Camera/LensDistortion.h>
 #include <vw/Camera/PinholeModel.h>
 #include <vw/Math/LevenbergMarquardt.h>
+#include <vw/Core/ThreadPool.h>
 
 using namespace vw;
 
@@ -141,6 +142,100 @@ vw::camera::AdjustableTsaiLensDistortion::distorted_coordinates(const camera::Pi
   return elem_prod(result+Vector2(m_distortion[m_distortion.size()-1]*result.y(),0),focal)+offset;
 }
 
+// UndistortionMap ----------------------------------------------
+
+namespace {
+  // Computes the undistorted coordinates of the nodes in rows
+  // [begin,end) of an n by n grid over area that are not already in
+  // the half-density grid coarse, which is copied into the even
+  // nodes.  With no coarse grid, every node is computed.
+  class UndistortionGridTask : public Task {
+    camera::PinholeModel const& m_cam;
+    BBox2 m_area;
+    int32 m_n, m_begin, m_end;
+    std::vector<Vector2> const& m_coarse;
+    std::vector<Vector2>& m_table;
+  public:
+    UndistortionGridTask( camera::PinholeModel const& cam, BBox2 const& area, int32 n,
+                          int32 begin, int32 end, std::vector<Vector2> const& coarse,
+                          std::vector<Vector2>& table )
+      : m_cam(cam), m_area(area), m_n(n), m_begin(begin), m_end(end),
+        m_coarse(coarse), m_table(table) {}
+
+    void operator()() {
+      camera::LensDistortion const* distortion = m_cam.lens_distortion();
+      Vector2 step = elem_quot( m_area.size(), Vector2( m_n-1, m_n-1 ) );
+      for ( int32 j = m_begin; j < m_end; ++j ) {
+        for ( int32 i = 0; i < m_n; ++i ) {
+          if ( !m_coarse.empty() && i%2 == 0 && j%2 == 0 ) {
+            m_table[j*m_n+i] = m_coarse[(j/2)*(m_n/2+1) + i/2];
+          } else {
+            Vector2 pix = m_area.min() + elem_prod( Vector2(i,j), step );
+            m_table[j*m_n+i] = distortion->undistorted_coordinates( m_cam, pix*m_cam.pixel_pitch() );
+          }
+        }
+      }
+    }
+  };
+
+  // Fills in the grid, a band of rows per task.
+  void fill_undistortion_grid( camera::PinholeModel const& cam, BBox2 const& area,
+                               int32 n, std::vector<Vector2> const& coarse,
+                               std::vector<Vector2>& table ) {
+    table.resize( n*n );
+    std::vector<boost::shared_ptr<Task> > tasks;
+    const int32 band = 16;
+    for ( int32 j = 0; j < n; j += band )
+      tasks.push_back( boost::shared_ptr<Task>( new UndistortionGridTask( cam, area, n, j, std::min(j+band, n),
+                                                                          coarse, table ) ) );
+    run_tasks( tasks );
+  }
+}
+
+vw::camera::UndistortionMap::UndistortionMap( PinholeModel const& cam, BBox2 const& area,
+                                              double tolerance )
+  : m_area( area ), m_size( 0 ), m_error( 0 ) {
+  VW_ASSERT( area.width() > 0 && area.height() > 0,
+             ArgumentErr() << "UndistortionMap: the area must not be empty." );
+  // The largest table that is kept.  It is checked against a grid
+  // of twice the density.
+  static const int32 max_size = 257;
+
+  int32 n = 9;
+  std::vector<Vector2> coarse, fine, none;
+  fill_undistortion_grid( cam, area, n, none, coarse );
+
+  // Each refinement computes the nodes at the centre and edge
+  // midpoints of every cell of the previous grid, which are exactly
+  // the points where that grid is checked.
+  while ( n <= max_size ) {
+    int32 m = 2*n-1;
+    fill_undistortion_grid( cam, area, m, coarse, fine );
+
+    double max_err = 0;
+    for ( int32 j = 0; j < m; ++j ) {
+      for ( int32 i = 0; i < m; ++i ) {
+        if ( i%2 == 0 && j%2 == 0 )
+          continue;
+        Vector2 interp = ( fine[(j-j%2)*m + (i-i%2)] + fine[(j+j%2)*m + (i+i%2)] +
+                           fine[(j-j%2)*m + (i+i%2)] + fine[(j+j%2)*m + (i-i%2)] ) / 4.0;
+        max_err = std::max( max_err, norm_2( interp - fine[j*m+i] ) );
+      }
+    }
+    max_err /= cam.pixel_pitch();
+
+    if ( max_err <= tolerance ) {
+      m_table.swap( coarse );
+      m_size = n;
+      m_scale = elem_quot( Vector2( n-1, n-1 ), area.size() );
+      m_error = max_err;
+      return;
+    }
+    coarse.swap( fine );
+    n = m;
+  }
+}
+
 std::ostream& vw::camera::operator<<(std::ostream & os,
                                      const camera::LensDistortion& ld) {
   ld.write(os);
@@ -35,8 +35,10 @@
 #define __VW_CAMERA_LENSDISTORTION_H__
 
 #include <vw/Math/Vector.h>
+#include <vw/Math/BBox.h>
 #include <boost/shared_ptr.hpp>
 #include <string>
+#include <vector>
 
 namespace vw {
 namespace camera {
@@ -219,6 +221,55 @@ namespace camera {
     }
   };
 
+  /// A table of the undistorted coordinates of a camera over an area
+  /// of its image, for cameras whose lens distortion has no closed
+  /// form inverse.
+  ///
+  /// The table is a regular grid of nodes, each holding the result of
+  /// LensDistortion::undistorted_coordinates() for that pixel, that
+  /// is bilinearly interpolated between nodes.  The grid starts at
+  /// 9x9 nodes and is doubled in density until the interpolated
+  /// result is within the requested tolerance (in pixels) of the
+  /// exact one at the centre and edge midpoints of every cell.  If
+  /// that takes more than 257x257 nodes the table is left empty.
+  class UndistortionMap {
+    BBox2 m_area;
+    int32 m_size;
+    Vector2 m_scale;
+    std::vector<Vector2> m_table;
+    double m_error;
+
+  public:
+    UndistortionMap( PinholeModel const& camera, BBox2 const& area, double tolerance );
+
+    /// False if the lens could not be tabulated to within the tolerance.
+    bool is_valid() const { return !m_table.empty(); }
+
+    /// The area of the image, in pixels, covered by the table.
+    BBox2 const& area() const { return m_area; }
+
+    /// The number of nodes along each side of the grid.
+    int32 size() const { return m_size; }
+
+    /// The largest interpolation error found while checking the
+    /// table, in pixels.
+    double error() const { return m_error; }
+
+    /// The undistorted coordinates of a pixel inside area(), in the
+    /// same units as LensDistortion::undistorted_coordinates().
+    Vector2 operator()( Vector2 const& pix ) const {
+      double px = ( pix.x() - m_area.min().x() ) * m_scale.x();
+      double py = ( pix.y() - m_area.min().y() ) * m_scale.y();
+      int32 ix = std::min( std::max( int32( floor( px ) ), 0 ), m_size-2 );
+      int32 iy = std::min( std::max( int32( floor( py ) ), 0 ), m_size-2 );
+      double fx = px - ix, fy = py - iy;
+      Vector2 const* row0 = &m_table[ iy*m_size + ix ];
+      Vector2 const* row1 = row0 + m_size;
+      return (1-fy) * ( (1-fx)*row0[0] + fx*row0[1] ) +
+                fy  * ( (1-fx)*row1[0] + fx*row1[1] );
+    }
+  };
+
 }} // namespace vw::camera
 
 #endif // __VW_CAMERA_LENSDISTORTION_H__
@@ -22,10 +22,44 @@ using google::protobuf::RepeatedFieldBackInserter;
 #endif
 
 #include <boost/filesystem/convenience.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 namespace fs = boost::filesystem;
 
 using namespace vw;
 
+// The undistortion map of a camera and its settings.  The map is
+// built once, by whichever thread asks for it first, and is read
+// without locking from then on.  Whether there is any lens
+// distortion to tabulate is decided when the cache is made, since a
+// new cache is made whenever the distortion changes.
+struct camera::PinholeModel::UndistortionCache : private boost::noncopyable {
+  BBox2 area;
+  double tolerance;
+  bool distorted;
+  RunOnce once;
+  boost::scoped_ptr<UndistortionMap> map;
+  UndistortionMap const* valid_map;
+
+  UndistortionCache( BBox2 const& area, double tolerance, LensDistortion const* distortion )
+    : area(area), tolerance(tolerance),
+      distorted( !dynamic_cast<NullLensDistortion const*>(distortion) ),
+      valid_map(0) {
+    RunOnce init = VW_RUNONCE_INIT;
+    once = init;
+  }
+
+  void build( PinholeModel const& camera ) {
+    map.reset( new UndistortionMap(camera, area, tolerance) );
+    if ( map->is_valid() )
+      valid_map = map.get();
+    else
+      vw_out(WarningMessage,"camera") << "PinholeModel: the lens distortion could not be tabulated to within "
+                                       << tolerance << " pixels; solving for every pixel instead.\n";
+  }
+};
+
 // Old deprecated format of Pinhole I/O. Didn't support all distortion options.
 // Reads in a file containing parameters of a pinhole model with
 // a tsai lens distortion model. An example is provided at the end of this file.
@@ -146,6 +180,7 @@ void camera::PinholeModel::read_old_file(std::string const& filename) {
     m_distortion.reset(new NullLensDistortion());
   else
     m_distortion.reset(new TsaiLensDistortion(distortion_params));
+  reset_undistortion_map();
 }
 
 
@@ -215,6 +250,7 @@ void camera::PinholeModel::read(std::string const& filename) {
                  IOErr() << "Pinhole::read_file: Unexpected distortion vector." );
       m_distortion.reset( new AdjustableTsaiLensDistortion(VectorProxy<double>(file.distortion_vector_size(),file.mutable_distortion_vector()->mutable_data())));
     }
+    reset_undistortion_map();
 #else
     // If you hit this point, you need to install Google Protobuffers to
     // be in order to write.
@@ -296,8 +332,14 @@ bool camera::PinholeModel::projection_valid(Vector3 const& point) const {
 }
 
 Vector3 camera::PinholeModel::pixel_to_vector (Vector2 const& pix) const {
-  // Apply the inverse lens distortion model
-  Vector2 undistorted_pix = m_distortion->undistorted_coordinates(*this, pix*m_pixel_pitch);
+  // Apply the inverse lens distortion model, from the undistortion
+  // map if there is one that covers this pixel.
+  Vector2 undistorted_pix;
+  UndistortionMap const* map = undistortion_map();
+  if ( map && map->area().contains(pix) )
+    undistorted_pix = (*map)(pix);
+  else
+    undistorted_pix = m_distortion->undistorted_coordinates(*this, pix*m_pixel_pitch);
 
   // Compute the direction of the ray emanating from the camera center.
   Vector3 p(0,0,1);
@@ -305,6 +347,32 @@ Vector3 camera::PinholeModel::pixel_to_vector (Vector2 const& pix) const {
   return normalize( m_inv_camera_transform * p);
 }
 
+void camera::PinholeModel::set_undistortion_map(BBox2 const& area, double tolerance) {
+  VW_ASSERT( area.width() > 0 && area.height() > 0,
+             ArgumentErr() << "PinholeModel::set_undistortion_map: the area must not be empty." );
+  VW_ASSERT( tolerance > 0,
+             ArgumentErr() << "PinholeModel::set_undistortion_map: the tolerance must be positive." );
+  m_undistortion.reset( new UndistortionCache(area, tolerance, m_distortion.get()) );
+}
+
+// Copies of this camera may still be using the old map, so a new
+// one takes its place rather than it being cleared.
+void camera::PinholeModel::reset_undistortion_map() {
+  if ( m_undistortion )
+    m_undistortion.reset( new UndistortionCache(m_undistortion->area, m_undistortion->tolerance,
+                                                m_distortion.get()) );
+}
+
+camera::UndistortionMap const* camera::PinholeModel::undistortion_map() const {
+  // A camera without lens distortion has nothing to tabulate.
+  if ( !m_undistortion || !m_undistortion->distorted )
+    return 0;
+
+  UndistortionCache& cache = *m_undistortion;
+  cache.once.run( boost::bind( &UndistortionCache::build, &cache, boost::cref(*this) ) );
+  return cache.valid_map;
+}
+
 void camera::PinholeModel::intrinsic_parameters(double& f_u, double& f_v,
                                                 double& c_u, double& c_v) const {
   f_u = m_fu;  f_v = m_fv;  c_u = m_cu;  c_v = m_cv;
@@ -313,6 +381,7 @@ void camera::PinholeModel::intrinsic_parameters(double& f_u, double& f_v,
 void camera::PinholeModel::set_intrinsic_parameters(double f_u, double f_v,
                                                     double c_u, double c_v) {
   m_fu = f_u;  m_fv = f_v;  m_cu = c_u;  m_cv = c_v;
+  reset_undistortion_map();
   rebuild_camera_matrix();
 }
 
@@ -356,6 +425,7 @@ void camera::PinholeModel::set_camera_matrix( Matrix<double,3,4> const& p ) {
     vw_out(WarningMessage,"camera") << "Significant skew not modelled by pinhole camera\n";
 
   // Rebuild
+  reset_undistortion_map();
   rebuild_camera_matrix();
 #else
   vw_throw( NoImplErr() << "PinholeModel::set_Camera_Matrix is unavailable without LAPACK" );
@@ -103,6 +103,11 @@ namespace camera {
     // Cached values for pixel_to_vector
     Matrix<double,3,3> m_inv_camera_transform;
 
+    // The optional undistortion map, built on first use and shared
+    // with copies of this camera until the intrinsics change.
+    struct UndistortionCache;
+    boost::shared_ptr<UndistortionCache> m_undistortion;
+
   public:
     //------------------------------------------------------------------
     // Constructors / Destructors
@@ -298,8 +303,26 @@ namespace camera {
     const LensDistortion* lens_distortion() const { return m_distortion.get(); };
     void set_lens_distortion(LensDistortion const& distortion) {
       m_distortion = distortion.copy();
+      reset_undistortion_map();
     }
 
+    /// Enables an UndistortionMap over the given area of the image
+    /// (usually the whole image), which pixel_to_vector() then
+    /// interpolates instead of inverting the lens distortion model
+    /// numerically at every pixel.  The map is built, within the
+    /// given tolerance in pixels, the first time it is needed, and
+    /// is shared by all copies of this camera and the threads using
+    /// them until the intrinsic parameters or the lens distortion
+    /// change, at which point it is rebuilt on demand.  Pixels
+    /// outside the area, and lenses the map can't represent to the
+    /// tolerance, fall back to the exact solution.
+    void set_undistortion_map(BBox2 const& area, double tolerance = 1e-2);
+    void clear_undistortion_map() { m_undistortion.reset(); }
+
+    /// Returns the undistortion map, building it if necessary, or
+    /// null if none is enabled or it could not meet its tolerance.
+    UndistortionMap const* undistortion_map() const;
+
     //  f_u and f_v :  focal length in horiz and vert. pixel units
     //  c_u and c_v :  principal point in pixel units
     void intrinsic_parameters(double& f_u, double& f_v,
@@ -310,15 +333,20 @@ namespace camera {
     Vector2 focal_length() const { return Vector2(m_fu,m_fv); }
     void set_focal_length(Vector2 const& f, bool rebuild=true ) {
       m_fu = f[0]; m_fv = f[1];
+      reset_undistortion_map();
       if (rebuild) rebuild_camera_matrix();
     }
     Vector2 point_offset() const { return Vector2(m_cu,m_cv); }
     void set_point_offset(Vector2 const& c, bool rebuild=true ) {
       m_cu = c[0]; m_cv = c[1];
+      reset_undistortion_map();
       if (rebuild) rebuild_camera_matrix();
     }
     double pixel_pitch() const { return m_pixel_pitch; }
-    void set_pixel_pitch( double pitch ) { m_pixel_pitch = pitch; }
+    void set_pixel_pitch( double pitch ) {
+      m_pixel_pitch = pitch;
+      reset_undistortion_map();
+    }
 
     // Ingest camera matrix
     // This performs a camera matrix decomposition and rewrites most variables
@@ -331,6 +359,10 @@ namespace camera {
   private:
     /// This must be called whenever camera parameters are modified.
     void rebuild_camera_matrix();
+
+    /// This must be called whenever the intrinsic parameters or the
+    /// lens distortion are modified.
+    void reset_undistortion_map();
   };
 
   //   /// Given two pinhole camera models, this method returns two new camera
@@ -104,6 +104,47 @@ TEST( PinholeModel, TsaiDistortion ) {
 #endif
 }
 
+#if defined(VW_HAVE_PKG_LAPACK) && VW_HAVE_PKG_LAPACK==1
+TEST( PinholeModel, UndistortionMap ) {
+  PinholeModel pinhole( Vector3(0,0,0), math::identity_matrix<3>(),
+                        605.3, 606.4, 518.9, 387.6,
+                        TsaiLensDistortion(Vector4(-0.2796604335308075,
+                                                   0.1031486615538597,
+                                                   -0.0007824968779459596,
+                                                   0.0009675505571067333)));
+  PinholeModel exact = pinhole;
+  const double tolerance = 0.05;
+  pinhole.set_undistortion_map( BBox2(200,150,640,480), tolerance );
+
+  UndistortionMap const* map = pinhole.undistortion_map();
+  ASSERT_TRUE( map );
+  EXPECT_LE( map->error(), tolerance );
+  EXPECT_FALSE( exact.undistortion_map() );
+
+  // Copies share the map until their intrinsics change.
+  PinholeModel copy = pinhole;
+  EXPECT_EQ( map, copy.undistortion_map() );
+  copy.set_focal_length( Vector2(600,600) );
+  EXPECT_NE( map, copy.undistortion_map() );
+  EXPECT_EQ( map, pinhole.undistortion_map() );
+
+  const LensDistortion* distortion = pinhole.lens_distortion();
+  for ( double y = 150.5; y < 630; y += 23.3 ) {
+    for ( double x = 200.5; x < 840; x += 31.7 ) {
+      Vector2 pix(x,y);
+      EXPECT_VECTOR_NEAR( (*map)(pix), distortion->undistorted_coordinates( pinhole, pix ),
+                          2*tolerance );
+      EXPECT_VECTOR_NEAR( pinhole.pixel_to_vector(pix), exact.pixel_to_vector(pix),
+                          2*tolerance / 600 );
+    }
+  }
+
+  // Pixels off the map are solved for exactly.
+  EXPECT_VECTOR_NEAR( pinhole.pixel_to_vector( Vector2(-20,900) ),
+                      exact.pixel_to_vector( Vector2(-20,900) ), 1e-12 );
+}
+#endif
+
 TEST( PinholeModel, ScalePinhole ) {
   Matrix<double,3,3> rot = vw::math::euler_to_quaternion(1.15, 0.0, -1.57, "xyz").rotation_matrix();
   PinholeModel pinhole4(Vector3(-0.329, 0.065, -0.82),
@@ -325,69 +325,106 @@ namespace cartography {
   /// For a given pixel coordinate, compute the position of that
   /// pixel in this georeferenced space.
   Vector2 GeoReference::pixel_to_point(Vector2 pix) const {
-    Vector2 loc;
-    Matrix<double,3,3> M = this->vw_native_transform();
-    double denom = pix[0] * M(2,0) + pix[1] * M(2,1) + M(2,2);
-    loc[0] = (pix[0] * M(0,0) + pix[1] * M(0,1) + M(0,2)) / denom;
-    loc[1] = (pix[0] * M(1,0) + pix[1] * M(1,1) + M(1,2)) / denom;
-    return loc;
+    pixels_to_points(&pix[0], &pix[1], 1);
+    return pix;
   }
 
   /// For a given location 'loc' in projected space, compute the
   /// corresponding pixel coordinates in the image.
   Vector2 GeoReference::point_to_pixel(Vector2 loc) const {
-    Vector2 pix;
-    Matrix<double,3,3> M = this->vw_native_inverse_transform();
-    double denom = loc[0] * M(2,0) + loc[1] * M(2,1) + M(2,2);
-    pix[0] = (loc[0] * M(0,0) + loc[1] * M(0,1) + M(0,2)) / denom;
-    pix[1] = (loc[0] * M(1,0) + loc[1] * M(1,1) + M(1,2)) / denom;
-    return pix;
+    points_to_pixels(&loc[0], &loc[1], 1);
+    return loc;
   }
 
 
   /// For a point in the projected space, compute the position of
   /// that point in unprojected (Geographic) coordinates (lat,lon).
   Vector2 GeoReference::point_to_lonlat(Vector2 loc) const {
-    if ( ! m_is_projected ) return loc;
+    points_to_lonlats(&loc[0], &loc[1], 1);
+    return loc;
+  }
+
+  /// Given a position in geographic coordinates (lat,lon), compute
+  /// the location in the projected coordinate system.
+  Vector2 GeoReference::lonlat_to_point(Vector2 lon_lat) const {
+    lonlats_to_points(&lon_lat[0], &lon_lat[1], 1);
+    return lon_lat;
+  }
+
+  void GeoReference::pixels_to_points(double* x, double* y, size_t n) const {
+    Matrix3x3 const& M = this->vw_native_transform();
+    for (size_t i = 0; i < n; ++i) {
+      double denom = x[i] * M(2,0) + y[i] * M(2,1) + M(2,2);
+      double u = (x[i] * M(0,0) + y[i] * M(0,1) + M(0,2)) / denom;
+      y[i] = (x[i] * M(1,0) + y[i] * M(1,1) + M(1,2)) / denom;
+      x[i] = u;
+    }
+  }
+
+  void GeoReference::points_to_pixels(double* x, double* y, size_t n) const {
+    Matrix3x3 const& M = this->vw_native_inverse_transform();
+    for (size_t i = 0; i < n; ++i) {
+      double denom = x[i] * M(2,0) + y[i] * M(2,1) + M(2,2);
+      double u = (x[i] * M(0,0) + y[i] * M(0,1) + M(0,2)) / denom;
+      y[i] = (x[i] * M(1,0) + y[i] * M(1,1) + M(1,2)) / denom;
+      x[i] = u;
+    }
+  }
 
-    XY projected;
-    LP unprojected;
+  void GeoReference::points_to_lonlats(double* x, double* y, size_t n) const {
+    if ( ! m_is_projected ) return;
+    PJ* proj = m_proj_context->proj_ptr();
 
-    projected.u = loc[0];
-    projected.v = loc[1];
+    for (size_t i = 0; i < n; ++i) {
+      XY projected;
+      projected.u = x[i];
+      projected.v = y[i];
 
-    unprojected = pj_inv(projected, m_proj_context->proj_ptr());
-    CHECK_PROJ_ERROR;
+      LP unprojected = pj_inv(projected, proj);
+      CHECK_PROJ_ERROR;
 
-    // Convert from radians to degrees.
-    return Vector2(unprojected.u * RAD_TO_DEG, unprojected.v * RAD_TO_DEG);
+      // Convert from radians to degrees.
+      x[i] = unprojected.u * RAD_TO_DEG;
+      y[i] = unprojected.v * RAD_TO_DEG;
+    }
   }
 
-  /// Given a position in geographic coordinates (lat,lon), compute
-  /// the location in the projected coordinate system.
-  Vector2 GeoReference::lonlat_to_point(Vector2 lon_lat) const {
-    if ( ! m_is_projected ) return lon_lat;
+  void GeoReference::lonlats_to_points(double* x, double* y, size_t n) const {
+    if ( ! m_is_projected ) return;
     // This value is proj's internal limit
     static const double BOUND = HALFPI-(1e-10)-std::numeric_limits<double>::epsilon();
+    PJ* proj = m_proj_context->proj_ptr();
+
+    for (size_t i = 0; i < n; ++i) {
+      LP unprojected;
+
+      // Proj.4 expects the (lon,lat) pair to be in radians
+      unprojected.u = x[i] * DEG_TO_RAD;
+      unprojected.v = y[i] * DEG_TO_RAD;
 
-    XY projected;
-    LP unprojected;
+      // Clamp the latitude range to [-HALFPI,HALFPI] ([-90, 90]) as occasionally
+      // we get edge pixels that extend slightly beyond that range (probably due
+      // to pixel as area vs point) and cause Proj.4 to fail. We use HALFPI
+      // rather than other incantations for pi/2 because that's what proj.4 uses.
+      if(unprojected.v > BOUND)        unprojected.v = BOUND;
+      else if(unprojected.v < -BOUND) unprojected.v = -BOUND;
 
-    // Proj.4 expects the (lon,lat) pair to be in radians
-    unprojected.u = lon_lat[0] * DEG_TO_RAD;
-    unprojected.v = lon_lat[1] * DEG_TO_RAD;
+      XY projected = pj_fwd(unprojected, proj);
+      CHECK_PROJ_ERROR;
 
-    // Clamp the latitude range to [-HALFPI,HALFPI] ([-90, 90]) as occasionally
-    // we get edge pixels that extend slightly beyond that range (probably due
-    // to pixel as area vs point) and cause Proj.4 to fail. We use HALFPI
-    // rather than other incantations for pi/2 because that's what proj.4 uses.
-    if(unprojected.v > BOUND)        unprojected.v = BOUND;
-    else if(unprojected.v < -BOUND) unprojected.v = -BOUND;
+      x[i] = projected.u;
+      y[i] = projected.v;
+    }
+  }
 
-    projected = pj_fwd(unprojected, m_proj_context->proj_ptr());
-    CHECK_PROJ_ERROR;
+  void GeoReference::pixels_to_lonlats(double* x, double* y, size_t n) const {
+    pixels_to_points(x, y, n);
+    points_to_lonlats(x, y, n);
+  }
 
-    return Vector2(projected.u, projected.v);
+  void GeoReference::lonlats_to_pixels(double* x, double* y, size_t n) const {
+    lonlats_to_points(x, y, n);
+    points_to_pixels(x, y, n);
   }
 
   /************** Functions for class ProjContext *******************/
@@ -168,6 +168,18 @@ namespace cartography {
     /// Given a position in geographic coordinates (lat,lon), compute
     /// the location in the projected coordinate system.
     virtual Vector2 lonlat_to_point(Vector2 lon_lat) const;
+
+    /// Batch versions of the conversions above.  Each one converts
+    /// the n points (x[i],y[i]) in place, and is much cheaper than n
+    /// calls to its single point counterpart: proj.4 is driven in a
+    /// tight loop and no per-point temporaries are made.  Throws
+    /// ProjectionErr if proj.4 fails on any of the points.
+    void pixels_to_points(double* x, double* y, size_t n) const;
+    void points_to_pixels(double* x, double* y, size_t n) const;
+    void points_to_lonlats(double* x, double* y, size_t n) const;
+    void lonlats_to_points(double* x, double* y, size_t n) const;
+    void pixels_to_lonlats(double* x, double* y, size_t n) const;
+    void lonlats_to_pixels(double* x, double* y, size_t n) const;
   };
 
   inline std::ostream& operator<<(std::ostream& os, const GeoReference& georef) {
@@ -11,6 +11,9 @@
 // Vision Workbench
 #include <vw/Image/ImageView.h>
 
+// Boost
+#include <boost/numeric/conversion/cast.hpp>
+
 // Proj.4
 #include <projects.h>
 
@@ -63,59 +66,112 @@ namespace cartography {
 
   // Performs a forward or reverse datum conversion.
   Vector2 GeoTransform::datum_convert(Vector2 const& v, bool forward) const {
-    double x = v[0];
-    double y = v[1];
-    double z = 0;
+    Vector2 result = v;
+    datum_convert(&result[0], &result[1], 1, forward);
+    return result;
+  }
+
+  void GeoTransform::datum_convert(double* x, double* y, size_t n, bool forward) const {
+    if (n == 0) return;
+    std::vector<double> z(n, 0.0);
 
     if(forward)
-      pj_transform(m_src_datum->proj_ptr(), m_dst_datum->proj_ptr(), 1, 0, &x, &y, &z);
+      pj_transform(m_src_datum->proj_ptr(), m_dst_datum->proj_ptr(), boost::numeric_cast<long>(n), 0, x, y, &z[0]);
     else
-      pj_transform(m_dst_datum->proj_ptr(), m_src_datum->proj_ptr(), 1, 0, &x, &y, &z);
+      pj_transform(m_dst_datum->proj_ptr(), m_src_datum->proj_ptr(), boost::numeric_cast<long>(n), 0, x, y, &z[0]);
     CHECK_PROJ_ERROR;
+  }
 
-    return Vector2(x, y);
+  void GeoTransform::reverse_batch(double* x, double* y, size_t n) const {
+    if (m_skip_map_projection) {
+      m_dst_georef.pixels_to_points(x, y, n);
+      m_src_georef.points_to_pixels(x, y, n);
+      return;
+    }
+    m_dst_georef.pixels_to_lonlats(x, y, n);
+    if (!m_skip_datum_conversion)
+      datum_convert(x, y, n, false);
+    m_src_georef.lonlats_to_pixels(x, y, n);
   }
 
-  BBox2i GeoTransform::forward_bbox( BBox2i const& bbox ) const {
-    BBox2 r = TransformHelper<GeoTransform,ContinuousFunction,ContinuousFunction>::forward_bbox(bbox);
-    BresenhamLine l1( bbox.min(), bbox.max() );
-    while ( l1.is_good() ) {
-      try {
-        r.grow( this->forward( *l1 ) );
-      } catch ( cartography::ProjectionErr const& e ) {}
-      ++l1;
+  void GeoTransform::forward_batch(double* x, double* y, size_t n) const {
+    if (m_skip_map_projection) {
+      m_src_georef.pixels_to_points(x, y, n);
+      m_dst_georef.points_to_pixels(x, y, n);
+      return;
     }
-    BresenhamLine l2( bbox.min() + Vector2i(bbox.width(),0),
-        bbox.max() + Vector2i(-bbox.width(),0) );
-    while ( l2.is_good() ) {
-      try {
-        r.grow( this->forward( *l2 ) );
-      } catch ( cartography::ProjectionErr const& e ) {}
-      ++l2;
+    m_src_georef.pixels_to_lonlats(x, y, n);
+    if (!m_skip_datum_conversion)
+      datum_convert(x, y, n, true);
+    m_dst_georef.lonlats_to_pixels(x, y, n);
+  }
+
+  namespace {
+    typedef void (GeoTransform::*BatchFunc)(double*, double*, size_t) const;
+
+    // Computes the same box as TransformBase::forward_bbox() or
+    // reverse_bbox() does for a continuous function, followed by a
+    // walk along both diagonals of bbox to catch images that cross
+    // the poles, but maps each set of points in one batch.
+    BBox2i transform_bbox(GeoTransform const& tx, BatchFunc func, BBox2i const& bbox) {
+      std::vector<double> xs, ys;
+
+      // The edges of the box; failures here are errors, as they are
+      // in TransformBase.
+      for (int32 x = bbox.min().x(); x < bbox.max().x(); ++x) { // Top and bottom
+        xs.push_back(x); ys.push_back(bbox.min().y());
+        xs.push_back(x); ys.push_back(bbox.max().y()-1);
+      }
+      for (int32 y = bbox.min().y()+1; y < bbox.max().y()-1; ++y) { // Left and right
+        xs.push_back(bbox.min().x());   ys.push_back(y);
+        xs.push_back(bbox.max().x()-1); ys.push_back(y);
+      }
+      BBox2 edges;
+      if (!xs.empty()) {
+        (tx.*func)(&xs[0], &ys[0], xs.size());
+        for (size_t i = 0; i < xs.size(); ++i)
+          edges.grow(Vector2(xs[i], ys[i]));
+      }
+      BBox2 r = grow_bbox_to_int(edges);
+
+      // The diagonals, where points that proj.4 can't handle are
+      // skipped.  If the whole batch fails, find them one at a time.
+      xs.clear(); ys.clear();
+      BresenhamLine l1( bbox.min(), bbox.max() );
+      for ( ; l1.is_good(); ++l1 ) {
+        xs.push_back((*l1)[0]); ys.push_back((*l1)[1]);
+      }
+      BresenhamLine l2( bbox.min() + Vector2i(bbox.width(),0),
+          bbox.max() + Vector2i(-bbox.width(),0) );
+      for ( ; l2.is_good(); ++l2 ) {
+        xs.push_back((*l2)[0]); ys.push_back((*l2)[1]);
+      }
+      if (!xs.empty()) {
+        std::vector<double> bx = xs, by = ys;
+        try {
+          (tx.*func)(&bx[0], &by[0], bx.size());
+          for (size_t i = 0; i < bx.size(); ++i)
+            r.grow(Vector2(bx[i], by[i]));
+        } catch ( cartography::ProjectionErr const& ) {
+          for (size_t i = 0; i < xs.size(); ++i) {
+            try {
+              (tx.*func)(&xs[i], &ys[i], 1);
+              r.grow(Vector2(xs[i], ys[i]));
+            } catch ( cartography::ProjectionErr const& ) {}
+          }
+        }
+      }
+
+      return grow_bbox_to_int(r);
     }
+  }
 
-    return grow_bbox_to_int(r);
+  BBox2i GeoTransform::forward_bbox( BBox2i const& bbox ) const {
+    return transform_bbox(*this, &GeoTransform::forward_batch, bbox);
   }
 
   BBox2i GeoTransform::reverse_bbox( BBox2i const& bbox ) const {
-    BBox2 r = TransformHelper<GeoTransform,ContinuousFunction,ContinuousFunction>::reverse_bbox(bbox);
-    BresenhamLine l1( bbox.min(), bbox.max() );
-    while ( l1.is_good() ) {
-      try {
-        r.grow( this->reverse( *l1 ) );
-      } catch ( cartography::ProjectionErr const& e ) {}
-      ++l1;
-    }
-    BresenhamLine l2( bbox.min() + Vector2i(bbox.width(),0),
-        bbox.max() + Vector2i(-bbox.width(),0) );
-    while ( l2.is_good() ) {
-      try {
-        r.grow( this->reverse( *l2 ) );
-      } catch ( cartography::ProjectionErr const& e ) {}
-      ++l2;
-    }
-
-    return grow_bbox_to_int(r);
+    return transform_bbox(*this, &GeoTransform::reverse_batch, bbox);
   }
 
   void reproject_point_image(ImageView<Vector3> const& point_image,
@@ -125,17 +181,25 @@ namespace cartography {
     GeoTransform gtx(src_georef, dst_georef);
 
     // Iterate over the image, transforming the first two coordinates
-    // in the Vector one at a time.  The third coordinate is taken to
-    // be the altitude value, and this value is not touched.
+    // in the Vector a row at a time.  The third coordinate is taken
+    // to be the altitude value, and this value is not touched.
+    std::vector<double> xs, ys;
+    std::vector<int32> cols;
     for (int32 j=0; j < point_image.rows(); ++j) {
+      xs.clear(); ys.clear(); cols.clear();
       for (int32 i=0; i < point_image.cols(); ++i) {
         if (point_image(i,j) != Vector3()) {
-          Vector2 in(point_image(i,j)[0], point_image(i,j)[1]);
-          Vector2 out = gtx.forward(in);
-          point_image(i,j).x() = out[0];
-          point_image(i,j).y() = out[1];
+          xs.push_back(point_image(i,j)[0]);
+          ys.push_back(point_image(i,j)[1]);
+          cols.push_back(i);
         }
       }
+      if (cols.empty()) continue;
+      gtx.forward_batch(&xs[0], &ys[0], xs.size());
+      for (size_t k=0; k < cols.size(); ++k) {
+        point_image(cols[k],j).x() = xs[k];
+        point_image(cols[k],j).y() = ys[k];
+      }
     }
   }
 
@@ -32,6 +32,11 @@ namespace cartography {
     */
     Vector2 datum_convert(Vector2 const& v, bool forward) const;
 
+    /* The batch version of datum_convert(), converting the n points
+     * (x[i],y[i]) in place with a single call to proj.4.
+    */
+    void datum_convert(double* x, double* y, size_t n, bool forward) const;
+
   public:
     /// Normal constructor
     GeoTransform(GeoReference const& src_georef, GeoReference const& dst_georef);
@@ -62,6 +67,22 @@ namespace cartography {
       return m_dst_georef.lonlat_to_pixel(src_lonlat);
     }
 
+    /// Batch versions of reverse() and forward().  These convert the
+    /// n points (x[i],y[i]) in place, passing them through each
+    /// georeference and the datum conversion all at once, which is
+    /// several times faster than converting them one at a time.
+    void reverse_batch(double* x, double* y, size_t n) const;
+    void forward_batch(double* x, double* y, size_t n) const;
+
+    /// Maps a row of the output image with reverse_batch().
+    void reverse_row(int32 x, int32 y, int32 n, double* xs, double* ys) const {
+      for (int32 i = 0; i < n; ++i) {
+        xs[i] = x + i;
+        ys[i] = y;
+      }
+      reverse_batch(xs, ys, n);
+    }
+
     // We override forward_bbox so it understands to check if the image
     // crosses the poles or not.
     BBox2i forward_bbox( BBox2i const& bbox ) const;
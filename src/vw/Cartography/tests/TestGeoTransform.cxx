@@ -97,3 +97,67 @@ TEST( GeoTransform, StereographicSingularity ) {
   EXPECT_NO_THROW( output = geotx.forward_bbox(input) );
   EXPECT_NEAR( 0, output.min()[1], 2 );
 }
+
+namespace {
+  // A lon/lat georeference with tenth of a degree pixels, and a
+  // mercator one on a different datum covering the same area.
+  void make_reprojection(GeoReference& ll_georef, GeoReference& merc_georef) {
+    Matrix3x3 transform = math::identity_matrix<3>();
+    transform(0,0) = 0.1; transform(1,1) = -0.1;
+    transform(0,2) = -20; transform(1,2) = 60;
+    ll_georef.set_transform(transform);
+
+    merc_georef.set_well_known_geogcs("WGS72");
+    merc_georef.set_mercator(0,0);
+    transform = math::identity_matrix<3>();
+    transform(0,0) = 1e4; transform(1,1) = -1e4;
+    transform(0,2) = -2.2e6; transform(1,2) = 8.4e6;
+    merc_georef.set_transform(transform);
+  }
+}
+
+TEST( GeoTransform, BatchMatchesSinglePoint ) {
+  GeoReference ll_georef, merc_georef;
+  make_reprojection(ll_georef, merc_georef);
+  GeoTransform geotx(ll_georef, merc_georef);
+
+  std::vector<Vector2> points;
+  for (int j = 0; j < 300; j += 23)
+    for (int i = 0; i < 400; i += 31)
+      points.push_back(Vector2(i + 0.25, j + 0.5));
+  std::vector<double> xs(points.size()), ys(points.size());
+
+  for (size_t i = 0; i < points.size(); ++i) { xs[i] = points[i][0]; ys[i] = points[i][1]; }
+  merc_georef.pixels_to_lonlats(&xs[0], &ys[0], xs.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    EXPECT_VECTOR_NEAR( Vector2(xs[i], ys[i]), merc_georef.pixel_to_lonlat(points[i]), 1e-9 );
+
+  for (size_t i = 0; i < points.size(); ++i) { xs[i] = points[i][0]; ys[i] = points[i][1]; }
+  geotx.forward_batch(&xs[0], &ys[0], xs.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    EXPECT_VECTOR_NEAR( Vector2(xs[i], ys[i]), geotx.forward(points[i]), 1e-6 );
+
+  for (size_t i = 0; i < points.size(); ++i) { xs[i] = points[i][0]; ys[i] = points[i][1]; }
+  geotx.reverse_batch(&xs[0], &ys[0], xs.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    EXPECT_VECTOR_NEAR( Vector2(xs[i], ys[i]), geotx.reverse(points[i]), 1e-6 );
+
+  geotx.reverse_row(5, 7, 50, &xs[0], &ys[0]);
+  for (int i = 0; i < 50; ++i)
+    EXPECT_VECTOR_NEAR( Vector2(xs[i], ys[i]), geotx.reverse(Vector2(5+i, 7)), 1e-6 );
+}
+
+TEST( GeoTransform, ApproximationErrorBound ) {
+  GeoReference ll_georef, merc_georef;
+  make_reprojection(ll_georef, merc_georef);
+  GeoTransform geotx(ll_georef, merc_georef);
+
+  BBox2i bbox(100, 50, 256, 256);
+  ApproximateTransform<GeoTransform> approx(geotx, bbox);
+  ASSERT_TRUE( approx.is_approximated() );
+  EXPECT_LE( approx.approximation_error(), geotx.tolerance() );
+
+  for (int j = bbox.min().y(); j < bbox.max().y(); j += 5)
+    for (int i = bbox.min().x(); i < bbox.max().x(); i += 5)
+      EXPECT_VECTOR_NEAR( approx.reverse(Vector2(i,j)), geotx.reverse(Vector2(i,j)), geotx.tolerance() );
+}
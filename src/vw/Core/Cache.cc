@@ -12,7 +12,71 @@
 #include <vw/Core/Cache.h>
 #include <vw/Core/Debugging.h>
 
-void vw::Cache::allocate( size_t size ) {
+vw::Cache::Cache( size_t max_size, uint32 num_shards )
+  : m_shards(0), m_num_shards(0), m_max_size(max_size)
+{
+  set_num_shards( num_shards );
+}
+
+void vw::Cache::set_num_shards( uint32 num_shards ) {
+  VW_ASSERT( num_shards > 0, ArgumentErr() << "Cache must have at least one shard." );
+  Mutex::Lock lock(m_mutex);
+  if( num_shards == m_num_shards ) return;
+  for( uint32 i = 0; i < m_num_shards; ++i ) {
+    Mutex::Lock shard_lock(m_shards[i].m_mutex);
+    VW_ASSERT( m_shards[i].empty(), LogicErr() << "Cannot change the number of shards of a cache that is in use." );
+  }
+  m_shards.reset( new Shard[num_shards] );
+  m_num_shards = num_shards;
+  for( uint32 i = 0; i < m_num_shards; ++i )
+    m_shards[i].m_max_size = m_max_size / m_num_shards + ( i < m_max_size % m_num_shards ? 1 : 0 );
+}
+
+// Cache lines are spread over the shards by their address.  Heap
+// addresses are aligned and often allocated with a constant stride,
+// so we mix the bits before taking the modulus.
+vw::Cache::Shard& vw::Cache::shard_for( CacheLineBase const* line ) {
+  if( m_num_shards == 1 ) return m_shards[0];
+  size_t h = reinterpret_cast<size_t>(line) >> 4;
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return m_shards[h % m_num_shards];
+}
+
+void vw::Cache::resize( size_t size ) {
+  Mutex::Lock lock(m_mutex);
+  m_max_size = size;
+  for( uint32 i = 0; i < m_num_shards; ++i )
+    m_shards[i].resize( size / m_num_shards + ( i < size % m_num_shards ? 1 : 0 ) );
+}
+
+vw::uint64 vw::Cache::hits() const {
+  uint64 total = 0;
+  for( uint32 i = 0; i < m_num_shards; ++i ) total += m_shards[i].m_hits;
+  return total;
+}
+
+vw::uint64 vw::Cache::misses() const {
+  uint64 total = 0;
+  for( uint32 i = 0; i < m_num_shards; ++i ) total += m_shards[i].m_misses;
+  return total;
+}
+
+vw::uint64 vw::Cache::evictions() const {
+  uint64 total = 0;
+  for( uint32 i = 0; i < m_num_shards; ++i ) total += m_shards[i].m_evictions;
+  return total;
+}
+
+void vw::Cache::clear_stats() {
+  for( uint32 i = 0; i < m_num_shards; ++i ) {
+    Mutex::Lock shard_lock(m_shards[i].m_mutex);
+    m_shards[i].m_hits = m_shards[i].m_misses = m_shards[i].m_evictions = 0;
+  }
+}
+
+void vw::Cache::Shard::allocate( size_t size ) {
   while( m_size+size > m_max_size ) {
     if( ! m_last_valid ) {
       vw_out(WarningMessage, "console") << "Warning: Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current Size = " << m_size << "\n";
@@ -26,7 +90,7 @@ void vw::Cache::allocate( size_t size ) {
   VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache allocated " << size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
 }
 
-void vw::Cache::resize( size_t size ) {
+void vw::Cache::Shard::resize( size_t size ) {
   Mutex::Lock lock(m_mutex);
   m_max_size = size;
   while( m_size > m_max_size ) {
@@ -35,13 +99,13 @@ void vw::Cache::resize( size_t size ) {
   }
 }
 
-void vw::Cache::deallocate( size_t size ) {
+void vw::Cache::Shard::deallocate( size_t size ) {
   m_size -= size;
   VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache deallocated " << size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
 }
 
 // Move the cache line to the top of the valid list.
-void vw::Cache::validate( CacheLineBase *line ) {
+void vw::Cache::Shard::validate( CacheLineBase *line ) {
   if( line == m_first_valid ) return;
   if( line == m_last_valid ) m_last_valid = line->m_prev;
   if( line == m_first_invalid ) m_first_invalid = line->m_next;
@@ -55,7 +119,7 @@ void vw::Cache::validate( CacheLineBase *line ) {
 }
 
 // Move the cache line to the top of the invalid list.
-void vw::Cache::invalidate( CacheLineBase *line ) {
+void vw::Cache::Shard::invalidate( CacheLineBase *line ) {
   if( line == m_first_valid ) m_first_valid = line->m_next;
   if( line == m_last_valid ) m_last_valid = line->m_prev;
   if( line->m_next ) line->m_next->m_prev = line->m_prev;
@@ -67,7 +131,7 @@ void vw::Cache::invalidate( CacheLineBase *line ) {
 }
 
 // Remove the cache line from the cache lists.
-void vw::Cache::remove( CacheLineBase *line ) {
+void vw::Cache::Shard::remove( CacheLineBase *line ) {
   if( line == m_first_valid ) m_first_valid = line->m_next;
   if( line == m_last_valid ) m_last_valid = line->m_prev;
   if( line == m_first_invalid ) m_first_invalid = line->m_next;
@@ -77,7 +141,7 @@ void vw::Cache::remove( CacheLineBase *line ) {
 }
 
 // Move the cache line to the bottom of the valid list.
-void vw::Cache::deprioritize( CacheLineBase *line ) {
+void vw::Cache::Shard::deprioritize( CacheLineBase *line ) {
   if( line == m_last_valid ) return;
   if( line == m_first_valid ) m_first_valid = line->m_next;
   if( line->m_next ) line->m_next->m_prev = line->m_prev;
@@ -32,13 +32,23 @@
 ///  The entire Handle<GeneratorT> class
 ///
 /// No other functions are guaranteed to be thread-safe.  There are
-/// two levels of synchronization: one lock per cache to protect the
-/// cache data structure itself, and one lock per cache line to
+/// two levels of synchronization: one lock per cache shard to protect
+/// the cache data structure itself, and one lock per cache line to
 /// protect the m_value pointer and synchronize the (potentially very
 /// expensive) generation operation.  However, the lock on the cache
 /// line ends just before the generate() method is called on the
 /// m_value object itself, so that object is responsible for its own
-/// thread safety.
+/// thread safety.  Concurrent misses on the same cache line are
+/// coalesced: one thread generates the value while the others either
+/// wait for it, or (using Handle::try_get()) go and do something else.
+///
+/// By default a cache has a single shard, and behaves as one global
+/// LRU list.  A cache constructed with several shards splits its LRU
+/// list (and its size budget) evenly across them, and each cache line
+/// is assigned to a shard by its address.  Lines in different shards
+/// never contend for the same lock, which lets many threads hit the
+/// cache at once, at the cost of the eviction order only being LRU
+/// within each shard.
 ///
 /// Note also that the valid() function is only useful as a heuristic:
 /// there is no guarantee that the cache line won't be invalidated
@@ -60,6 +70,8 @@
 #include <vw/Core/System.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/noncopyable.hpp>
 #include <typeinfo>
 #include <sstream>
 
@@ -91,25 +103,51 @@ namespace vw {
   // shared pointer to CacheLine
 
   // An LRU-based regeneratable-data cache
-  class Cache {
+  class Cache : private boost::noncopyable {
+
+    class CacheLineBase;
+
+    // One independently-locked LRU list.  Each shard owns an equal
+    // share of the cache's size budget and keeps its own statistics.
+    // All members are protected by m_mutex.
+    struct Shard : private boost::noncopyable {
+      CacheLineBase *m_first_valid, *m_last_valid, *m_first_invalid;
+      size_t m_size, m_max_size;
+      Mutex m_mutex;
+      vw::uint64 m_hits, m_misses, m_evictions;
+
+      void allocate( size_t size );
+      void deallocate( size_t size );
+      void validate( CacheLineBase *line );
+      void invalidate( CacheLineBase *line );
+      void remove( CacheLineBase *line );
+      void deprioritize( CacheLineBase *line );
+      void resize( size_t size );
+      bool empty() const { return !m_first_valid && !m_first_invalid; }
+
+      Shard() : m_first_valid(0), m_last_valid(0), m_first_invalid(0),
+                m_size(0), m_max_size(0),
+                m_hits(0), m_misses(0), m_evictions(0) {}
+    };
 
     // The abstract base class for all cache line objects.
     class CacheLineBase {
-      Cache& m_cache;
+      Shard& m_shard;
       CacheLineBase *m_prev, *m_next;
       const size_t m_size;
       friend class Cache;
+      friend struct Shard;
     protected:
-      Cache& cache() const { return m_cache; }
-      inline void allocate() { m_cache.allocate(m_size); }
-      inline void deallocate() { m_cache.deallocate(m_size); }
-      inline void validate() { m_cache.validate(this); }
-      inline void remove() { m_cache.remove( this ); }
-      inline void deprioritize() { m_cache.deprioritize(this); }
+      Shard& shard() const { return m_shard; }
+      inline void allocate() { m_shard.allocate(m_size); }
+      inline void deallocate() { m_shard.deallocate(m_size); }
+      inline void validate() { m_shard.validate(this); }
+      inline void remove() { m_shard.remove( this ); }
+      inline void deprioritize() { m_shard.deprioritize(this); }
     public:
-      CacheLineBase( Cache& cache, size_t size ) : m_cache(cache), m_prev(0), m_next(0), m_size(size) {}
+      CacheLineBase( Cache& cache, size_t size ) : m_shard(cache.shard_for(this)), m_prev(0), m_next(0), m_size(size) {}
       virtual ~CacheLineBase() {}
-      virtual inline void invalidate() { m_cache.invalidate(this); }
+      virtual inline void invalidate() { m_shard.invalidate(this); }
       virtual size_t size() const { return m_size; }
     };
     friend class CacheLineBase;
@@ -121,19 +159,21 @@ namespace vw {
       typedef typename boost::shared_ptr<typename core::detail::GenValue<GeneratorT>::type> value_type;
       value_type m_value;
       Mutex m_mutex; // Mutex for m_value and generation of this cache line
+      Condition m_generated_event;
+      bool m_generating;
       unsigned m_generation_count;
 
     public:
       CacheLine( Cache& cache, GeneratorT const& generator )
-        : CacheLineBase(cache,core::detail::pointerish(generator)->size()), m_generator(generator), m_generation_count(0)
+        : CacheLineBase(cache,core::detail::pointerish(generator)->size()), m_generator(generator), m_generating(false), m_generation_count(0)
       {
         VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache creating CacheLine " << info() << "\n"; )
-        Mutex::Lock cache_lock(cache.m_mutex);
+        Mutex::Lock cache_lock(shard().m_mutex);
         CacheLineBase::invalidate();
       }
 
       virtual ~CacheLine() {
-        Mutex::Lock cache_lock(cache().m_mutex);
+        Mutex::Lock cache_lock(shard().m_mutex);
         invalidate();
         VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache destroying CacheLine " << info() << "\n"; )
         remove();
@@ -155,33 +195,74 @@ namespace vw {
         return oss.str();
       }
 
-      value_type const& value() {
+      value_type value() {
+        value_type result;
+        fetch( result, true );
+        return result;
+      }
+
+      bool try_value( value_type& result ) {
+        return fetch( result, false );
+      }
+
+    private:
+      // Look up the value, generating it if necessary.  Only one thread
+      // generates a given line at a time, and the line lock is released
+      // while it does so.  Other threads that want the same line either
+      // wait for that generation to finish and share its result (if
+      // 'wait' is set), or return false immediately.
+      bool fetch( value_type& result, bool wait ) {
         bool hit = true;
         Mutex::Lock line_lock(m_mutex);
+        if( m_generating ) {
+          if( !wait ) return false;
+          while( m_generating )
+            m_generated_event.wait(line_lock);
+        }
         if( !m_value ) {
           m_generation_count++;
           hit = false;
+          m_generating = true;
           VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache generating CacheLine " << info() << "\n"; )
           {
-            Mutex::Lock cache_lock(cache().m_mutex);
+            Mutex::Lock cache_lock(shard().m_mutex);
             CacheLineBase::allocate();
           }
-          ScopedWatch sw((std::string("Cache ")
-                          + (m_generation_count == 1 ? "generating " : "regenerating ")
-                          + typeid(this).name()).c_str());
-          m_value = core::detail::pointerish(m_generator)->generate();
+          line_lock.unlock();
+          value_type generated;
+          try {
+            ScopedWatch sw((std::string("Cache ")
+                            + (m_generation_count == 1 ? "generating " : "regenerating ")
+                            + typeid(this).name()).c_str());
+            generated = core::detail::pointerish(m_generator)->generate();
+          } catch (...) {
+            line_lock.lock();
+            {
+              Mutex::Lock cache_lock(shard().m_mutex);
+              CacheLineBase::deallocate();
+            }
+            m_generating = false;
+            m_generated_event.notify_all();
+            throw;
+          }
+          line_lock.lock();
+          m_value = generated;
+          m_generating = false;
+          m_generated_event.notify_all();
         }
         {
-          Mutex::Lock cache_lock(cache().m_mutex);
+          Mutex::Lock cache_lock(shard().m_mutex);
           CacheLineBase::validate();
           if (hit)
-            cache().m_hits++;
+            shard().m_hits++;
           else
-            cache().m_misses++;
+            shard().m_misses++;
         }
-        return m_value;
+        result = m_value;
+        return true;
       }
 
+    public:
       bool valid() {
         Mutex::Lock line_lock(m_mutex);
         return (bool)m_value;
@@ -190,24 +271,19 @@ namespace vw {
       void deprioritize() {
         Mutex::Lock line_lock(m_mutex);
         if( m_value ) {
-          Mutex::Lock cache_lock(cache().m_mutex);
+          Mutex::Lock cache_lock(shard().m_mutex);
           CacheLineBase::deprioritize();
         }
       }
     };
 
 
-    CacheLineBase *m_first_valid, *m_last_valid, *m_first_invalid;
-    size_t m_size, m_max_size;
-    Mutex m_mutex;
-    vw::uint64 m_hits, m_misses, m_evictions;
+    boost::scoped_array<Shard> m_shards;
+    uint32 m_num_shards;
+    size_t m_max_size;
+    Mutex m_mutex; // Serializes resize() and set_num_shards()
 
-    void allocate( size_t size );
-    void deallocate( size_t size );
-    void validate( CacheLineBase *line );
-    void invalidate( CacheLineBase *line );
-    void remove( CacheLineBase *line );
-    void deprioritize( CacheLineBase *line );
+    Shard& shard_for( CacheLineBase const* line );
 
   public:
 
@@ -236,6 +312,16 @@ namespace vw {
         VW_ASSERT( m_line_ptr, NullPtrErr() << "Invalid cache handle!" );
         return m_line_ptr->valid();
       }
+      /// Non-blocking lookup.  If the value is cached (or this thread
+      /// generates it) it is stored in 'value' and this returns true.
+      /// If another thread is already generating it, this returns false
+      /// right away, so the caller can do other work and come back
+      /// later.  The blocking accessors above attach to a generation
+      /// already in flight rather than starting a second one.
+      bool try_get( boost::shared_ptr<value_type>& value ) const {
+        VW_ASSERT( m_line_ptr, NullPtrErr() << "Invalid cache handle!" );
+        return m_line_ptr->try_value( value );
+      }
       size_t size() const {
         VW_ASSERT( m_line_ptr, NullPtrErr() << "Invalid cache handle!" );
         return m_line_ptr->size();
@@ -250,10 +336,9 @@ namespace vw {
       }
     };
 
-    Cache( size_t max_size ) :
-      m_first_valid(0), m_last_valid(0), m_first_invalid(0),
-      m_size(0), m_max_size(max_size),
-      m_hits(0), m_misses(0), m_evictions(0) {}
+    /// Create a cache holding at most max_size bytes, split across
+    /// num_shards independently-locked LRU lists.
+    Cache( size_t max_size, uint32 num_shards = 1 );
 
     template <class GeneratorT>
     Handle<GeneratorT> insert( GeneratorT const& generator ) {
@@ -265,13 +350,15 @@ namespace vw {
     void resize( size_t size );
     size_t max_size() { return m_max_size; }
 
-    uint64 hits() const { return m_hits; }
-    uint64 misses() const { return m_misses; }
-    uint64 evictions() const {return m_evictions; }
-    void clear_stats() {
-      Mutex::Lock cache_lock(m_mutex);
-      m_hits = m_misses = m_evictions = 0;
-    }
+    /// Change the number of shards.  This is only permitted while no
+    /// cache lines are attached to the cache.
+    void set_num_shards( uint32 num_shards );
+    uint32 num_shards() const { return m_num_shards; }
+
+    uint64 hits() const;
+    uint64 misses() const;
+    uint64 evictions() const;
+    void clear_stats();
   };
 } // namespace vw
 
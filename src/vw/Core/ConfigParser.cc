@@ -91,8 +91,12 @@ void vw::parse_config(std::basic_istream<char>& stream,
         settings.set_default_num_threads(boost::lexical_cast<uint32>(o.value[0]));
       else if (o.string_key == "general.system_cache_size")
         settings.set_system_cache_size(boost::lexical_cast<size_t>(o.value[0]));
+      else if (o.string_key == "general.system_cache_shards")
+        settings.set_system_cache_shards(boost::lexical_cast<uint32>(o.value[0]));
       else if (o.string_key == "general.default_tile_size")
         settings.set_default_tile_size(boost::lexical_cast<uint32>(o.value[0]));
+      else if (o.string_key == "general.default_prefetch_blocks")
+        settings.set_default_prefetch_blocks(boost::lexical_cast<uint32>(o.value[0]));
       else if (o.string_key == "general.write_pool_size")
         settings.set_write_pool_size(boost::lexical_cast<uint32>(o.value[0]));
       else if (o.string_key == "general.tmp_directory")
@@ -90,6 +90,12 @@
 /// default_throw() which the handler may call to have the exception
 /// throw itself in a type-aware manner.
 ///
+/// default_throw() throws the exception by way of
+/// boost::enable_current_exception(), so that an exception thrown on
+/// a worker thread can be captured there with boost::current_exception()
+/// and rethrown, with its original type, on the thread waiting for the
+/// work.
+///
 #ifndef __VW_CORE_EXCEPTION_H__
 #define __VW_CORE_EXCEPTION_H__
 
@@ -102,6 +108,7 @@
 
 #if defined(VW_ENABLE_EXCEPTIONS) && (VW_ENABLE_EXCEPTIONS==1)
 #include <exception>
+#include <boost/exception/enable_current_exception.hpp>
 #define VW_IF_EXCEPTIONS(x) x
 #else
 #define VW_IF_EXCEPTIONS(x)
@@ -150,7 +157,7 @@ namespace vw {
     void set( std::string const& s ) { m_desc.str(s); }
     void reset() { m_desc.str(""); }
 
-    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )
+    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw boost::enable_current_exception(*this); } )
 
   protected:
       virtual std::ostringstream& stream() {return m_desc;}
@@ -206,7 +213,8 @@ namespace vw {
 
   #define VW_EXCEPTION_API(exception_type)                                     \
     virtual std::string name() const { return #exception_type; }               \
-    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )    \
+    VW_IF_EXCEPTIONS( virtual void default_throw() const {                     \
+      throw boost::enable_current_exception(*this); } )                        \
     template <class T>                                                         \
     exception_type& operator<<( T const& t ) { stream() << t; return *this; }
 
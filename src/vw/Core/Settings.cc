@@ -169,8 +169,10 @@ namespace {
 Settings::Settings()
   : _VW_SET1(default_num_threads, VW_NUM_THREADS),
     _VW_SET1(system_cache_size, 768 * 1024 * 1024),
+    _VW_SET1(system_cache_shards, 1),
     _VW_SET1(write_pool_size, 21), // 21 threads is about 252MB of back data for RGB f32 1024x1024 blocks
     _VW_SET1(default_tile_size, 256),
+    _VW_SET1(default_prefetch_blocks, 0),
     _VW_SET1(tmp_directory, default_tmp_dir()),
     m_rc_poll_period(5.0f)
 {
@@ -193,8 +195,10 @@ Settings::Settings()
 
 GETSET(default_num_threads, uint32, ;);
 GETSET(system_cache_size, size_t, vw_system_cache().resize(x););
+GETSET(system_cache_shards, uint32, ;);
 GETSET(write_pool_size, uint32, ;);
 GETSET(default_tile_size, uint32, ;);
+GETSET(default_prefetch_blocks, uint32, ;);
 GETSET(tmp_directory, std::string, ;);
 
 } // namespace vw
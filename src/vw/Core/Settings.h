@@ -53,14 +53,24 @@ namespace vw {
     // all BlockRasterizeView<>'s, including DiskImageView<>'s.
     VW_DECLARE_SETTING(system_cache_size, size_t);
 
-    // Write cache is only used in block writing. This is the number of threads
-    // that can be blocked on IO before the code stops creating more jobs (to
-    // let the writes catch up).
+    // The number of independently-locked shards in the system cache. More
+    // shards reduce lock contention between threads hitting the cache, at
+    // the cost of only approximate LRU eviction. This only takes effect
+    // before the system cache is first used.
+    VW_DECLARE_SETTING(system_cache_shards, uint32);
+
+    // Write cache is only used in block writing. This is the number of
+    // rasterized blocks that can be waiting on IO before the code stops
+    // rasterizing more (to let the writes catch up).
     VW_DECLARE_SETTING(write_pool_size, uint32);
 
     // The default tile size (in pixels) used for block processing ops.
     VW_DECLARE_SETTING(default_tile_size, uint32);
 
+    // The number of blocks a DiskImageView reads ahead of the block being
+    // rasterized, on a background thread. Zero disables read-ahead.
+    VW_DECLARE_SETTING(default_prefetch_blocks, uint32);
+
     // The directory used to store temporary files.
     VW_DECLARE_SETTING(tmp_directory, std::string);
 
@@ -3,6 +3,9 @@
 #include <vw/Core/Log.h>
 #include <vw/Core/Settings.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <cstdlib>
 
 namespace {
   vw::RunOnce settings_once      = VW_RUNONCE_INIT;
@@ -10,17 +13,24 @@ namespace {
   vw::RunOnce stopwatch_set_once = VW_RUNONCE_INIT;
   vw::RunOnce system_cache_once  = VW_RUNONCE_INIT;
   vw::RunOnce log_once           = VW_RUNONCE_INIT;
+  vw::RunOnce prefetch_once      = VW_RUNONCE_INIT;
+  vw::RunOnce task_once          = VW_RUNONCE_INIT;
 
   vw::Settings     *settings_ptr      = 0;
   vw::StopwatchSet *stopwatch_set_ptr = 0;
   vw::Cache        *system_cache_ptr  = 0;
   vw::Log          *log_ptr           = 0;
+  vw::WorkStealingQueue *prefetch_queue_ptr = 0;
+  vw::WorkStealingQueue *task_queue_ptr     = 0;
 
   void init_settings() {
     settings_ptr = new vw::Settings();
   }
 
   void resize_cache() {
+    // This runs before any cache line can be attached to the system cache,
+    // so it is the only safe place to change the number of shards.
+    system_cache_ptr->set_num_shards(settings_ptr->system_cache_shards());
     if (system_cache_ptr->max_size() == 0)
       system_cache_ptr->resize(settings_ptr->system_cache_size());
   }
@@ -36,6 +46,28 @@ namespace {
   void init_log() {
     log_ptr = new vw::Log();
   }
+
+  // Waits for the tasks that are still queued, then joins the workers,
+  // so that none of them is left running while the process exits.
+  void destroy_prefetch_queue() {
+    delete prefetch_queue_ptr;
+    prefetch_queue_ptr = 0;
+  }
+
+  void init_prefetch_queue() {
+    prefetch_queue_ptr = new vw::WorkStealingQueue(vw::vw_settings().default_num_threads());
+    std::atexit( destroy_prefetch_queue );
+  }
+
+  void destroy_task_queue() {
+    delete task_queue_ptr;
+    task_queue_ptr = 0;
+  }
+
+  void init_task_queue() {
+    task_queue_ptr = new vw::WorkStealingQueue(vw::vw_settings().default_num_threads());
+    std::atexit( destroy_task_queue );
+  }
 }
 
 vw::Settings &vw::vw_settings() {
@@ -61,3 +93,13 @@ vw::Log &vw::vw_log() {
   log_once.run( init_log );
   return *log_ptr;
 }
+
+vw::WorkStealingQueue &vw::vw_prefetch_queue() {
+  prefetch_once.run( init_prefetch_queue );
+  return *prefetch_queue_ptr;
+}
+
+vw::WorkStealingQueue &vw::vw_task_queue() {
+  task_once.run( init_task_queue );
+  return *task_queue_ptr;
+}
@@ -16,6 +16,7 @@ namespace vw {
   class Log;
   class Settings;
   class StopwatchSet;
+  class WorkStealingQueue;
 
   // This cache is used by default for all new BlockImageView<>'s such as
   // DiskImageView<>.
@@ -31,6 +32,18 @@ namespace vw {
 
   // Global instance of StopwatchSet
   StopwatchSet& vw_stopwatch_set();
+
+  // The background thread pool shared by everything that reads ahead,
+  // such as BlockRasterizeViews with prefetch enabled.  It is created
+  // the first time it is used, and its workers are joined when the
+  // process exits.
+  WorkStealingQueue& vw_prefetch_queue();
+
+  // The thread pool that run_tasks() runs its tasks on.  It is kept
+  // apart from vw_prefetch_queue() so that the tasks never wait behind
+  // speculative reads.  It too is created the first time it is used
+  // and joined when the process exits.
+  WorkStealingQueue& vw_task_queue();
 }
 
 #endif
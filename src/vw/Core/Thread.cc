@@ -34,6 +34,13 @@ namespace thread {
     return *ptr;
   }
 
+  // Set on thread pool workers.  Like the ID above, it may be checked
+  // from destructors, so it is never destroyed.
+  static boost::thread_specific_ptr<bool>& vw_thread_pool_worker_ptr() {
+    static boost::thread_specific_ptr<bool>* ptr = new boost::thread_specific_ptr<bool>();
+    return *ptr;
+  }
+
 }} // namespace vw::thread
 
 vw::uint64 vw::Thread::id() {
@@ -49,3 +56,12 @@ vw::uint64 vw::Thread::id() {
   vw::uint64* result = thread::vw_thread_id_ptr().get();
   return *result;
 }
+
+bool vw::Thread::is_pool_worker() {
+  return thread::vw_thread_pool_worker_ptr().get() != 0;
+}
+
+void vw::Thread::set_pool_worker() {
+  if (thread::vw_thread_pool_worker_ptr().get() == 0)
+    thread::vw_thread_pool_worker_ptr().reset(new bool(true));
+}
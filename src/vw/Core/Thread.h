@@ -38,11 +38,14 @@
 ///
 /// * A RunOnce class, implementing run-once semantics.  This must be
 ///   a POD class with an initializer macro VW_RUNONCE_INIT.  It must
-///   implement a single method, run( void (*func)() ), which runs the
-///   given function exactly once no matter how many times it is
-///   called.  (This behavior is only defined for RunOnce objects
+///   implement a method, run( void (*func)() ), which runs the given
+///   function exactly once no matter how many times it is called, and
+///   a run() that does the same for a function object taking no
+///   arguments.  (This behavior is only defined for RunOnce objects
 ///   that are statically allocated at global or namespace scope and
-///   statically initialized to VW_RUNONCE_INIT.)
+///   statically initialized to VW_RUNONCE_INIT, or that are members
+///   of an object and are assigned a copy of a RunOnce initialized to
+///   VW_RUNONCE_INIT before any other thread can see the object.)
 
 #ifndef __VW_CORE_THREAD_H__
 #define __VW_CORE_THREAD_H__
@@ -72,6 +75,11 @@ namespace vw {
     inline void run( void (*func)() ) {
       boost::call_once( func, m_flag );
     }
+
+    template <class FuncT>
+    inline void run( FuncT const& func ) {
+      boost::call_once( m_flag, func );
+    }
   };
 
   // --------------------------------------------------------------
@@ -89,6 +97,10 @@ namespace vw {
     void lock()   { boost::mutex::lock(); }
     void unlock() { boost::mutex::unlock(); }
 
+    // Lock the mutex if it is free, without blocking.  Returns true
+    // if the lock was acquired.
+    bool try_lock() { return boost::mutex::try_lock(); }
+
     // A scoped lock class, used to lock and unlock a Mutex.
     class Lock : private boost::unique_lock<Mutex>,
                  private boost::noncopyable {
@@ -240,6 +252,16 @@ namespace vw {
     /// will be assigned in the same order that threads are created.
     static vw::uint64 id();
 
+    /// Returns true if the current thread is a worker of a WorkQueue
+    /// or a WorkStealingQueue.  Code that may run on such a thread
+    /// should do its own parallel work inline there rather than start
+    /// more threads of its own.
+    static bool is_pool_worker();
+
+    /// Marks the current thread as a thread pool worker.  Only the
+    /// thread pools in ThreadPool.h should call this.
+    static void set_pool_worker();
+
     /// Cause the current thread to yield the remainder of its
     /// execution time to the kernel's scheduler.
     static inline void yield() { boost::thread::yield(); }
@@ -15,6 +15,7 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 
 #include <vw/Core/Settings.h>
 #include <vw/Core/Thread.h>
@@ -24,6 +25,10 @@
 // STL
 #include <map>
 
+#include <boost/detail/atomic_count.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/scoped_array.hpp>
+
 namespace vw {
   // ----------------------  --------------  ---------------------------
   // ----------------------       Task       ---------------------------
@@ -80,6 +85,7 @@ namespace vw {
         m_queue(queue), m_task(initial_task), m_thread_id(thread_id), m_should_die(should_die) {}
       ~WorkerThread() {}
       void operator()() {
+        Thread::set_pool_worker();
         do {
           vw_out(DebugMessage, "thread") << "ThreadPool: running worker thread "
                                          << m_thread_id << "\n";
@@ -295,6 +301,226 @@ namespace vw {
     }
   };
 
+  /// A work queue that gives each worker thread its own task deque.
+  ///
+  /// Unlike the WorkQueue subclasses above, which hand out every task
+  /// under a single queue-wide mutex, a WorkStealingQueue keeps a
+  /// fixed pool of worker threads, each with a private deque of
+  /// tasks.  Tasks added from one of the queue's own workers go onto
+  /// that worker's deque; tasks added from any other thread are dealt
+  /// out round-robin.  A worker runs the tasks on its own deque in the
+  /// order they were added, and when its deque runs dry it steals the
+  /// oldest task from another worker.  Steals only ever try_lock() the
+  /// victim's deque, so a thief never blocks on a busy worker.  As a
+  /// result, tasks added in order also start in (roughly) that order,
+  /// which ThreadedBlockWriter relies upon to keep the next block to
+  /// be written from being starved.
+  ///
+  /// The deques are guarded by a mutex each rather than being
+  /// lock-free (Chase-Lev) deques.  A lock-free deque needs atomic
+  /// loads and stores with explicit memory ordering, which neither
+  /// C++98 nor the versions of Boost that we support provide
+  /// portably.  Since the lock on a deque is only contended when a
+  /// thief and its owner meet, and a thief never waits for it, the
+  /// cost is small next to the size of the tasks we run.
+  ///
+  /// The add_task()/join_all() contract is the same as FifoWorkQueue.
+  class WorkStealingQueue : private boost::noncopyable {
+
+    struct WorkerDeque {
+      Mutex m_mutex;
+      std::deque<boost::shared_ptr<Task> > m_tasks;
+    };
+
+    class WorkerThread {
+      WorkStealingQueue &m_queue;
+      int m_index;
+    public:
+      WorkerThread(WorkStealingQueue& queue, int index) : m_queue(queue), m_index(index) {}
+      void operator()() { m_queue.worker_loop(m_index); }
+    };
+
+    int m_num_workers;
+    boost::scoped_array<WorkerDeque> m_deques;
+    std::vector<boost::shared_ptr<Thread> > m_threads;
+    boost::thread_specific_ptr<int> m_worker_index;
+
+    // Tasks that have been added but not yet picked up by a worker,
+    // and tasks that have been added but not yet finished.
+    boost::detail::atomic_count m_queued, m_outstanding;
+    boost::detail::atomic_count m_next_deque;
+
+    // Used only to put idle workers to sleep and to wake up join_all().
+    Mutex m_mutex;
+    Condition m_work_event, m_finished_event;
+    bool m_should_die;
+
+    boost::shared_ptr<Task> pop(int index) {
+      boost::shared_ptr<Task> task;
+      {
+        Mutex::Lock lock(m_deques[index].m_mutex);
+        if (m_deques[index].m_tasks.empty())
+          return task;
+        task = m_deques[index].m_tasks.front();
+        m_deques[index].m_tasks.pop_front();
+      }
+      --m_queued;
+      return task;
+    }
+
+    boost::shared_ptr<Task> steal(int thief) {
+      boost::shared_ptr<Task> task;
+      for (int i = 1; i < m_num_workers && !task; ++i) {
+        WorkerDeque &victim = m_deques[(thief + i) % m_num_workers];
+        if (!victim.m_mutex.try_lock())
+          continue;
+        if (!victim.m_tasks.empty()) {
+          task = victim.m_tasks.front();
+          victim.m_tasks.pop_front();
+        }
+        victim.m_mutex.unlock();
+      }
+      if (task)
+        --m_queued;
+      return task;
+    }
+
+    void worker_loop(int index) {
+      m_worker_index.reset(new int(index));
+      Thread::set_pool_worker();
+      while (true) {
+        boost::shared_ptr<Task> task = pop(index);
+        if (!task)
+          task = steal(index);
+
+        if (task) {
+          (*task)();
+          task->signal_finished();
+          if (--m_outstanding == 0) {
+            Mutex::Lock lock(m_mutex);
+            m_finished_event.notify_all();
+          }
+          continue;
+        }
+
+        // Nothing to pop or steal.  If tasks are still queued, they
+        // are sitting in deques we failed to try_lock(), so yield and
+        // go around again. Otherwise, sleep until there is more work.
+        Mutex::Lock lock(m_mutex);
+        if (m_should_die)
+          return;
+        if (long(m_queued) != 0) {
+          lock.unlock();
+          Thread::yield();
+          continue;
+        }
+        m_work_event.wait(lock);
+        if (m_should_die)
+          return;
+      }
+    }
+
+  public:
+    WorkStealingQueue(int num_threads = vw_settings().default_num_threads())
+      : m_num_workers(num_threads > 0 ? num_threads : 1), m_deques(new WorkerDeque[m_num_workers]),
+        m_queued(0), m_outstanding(0), m_next_deque(0), m_should_die(false) {
+      for (int i = 0; i < m_num_workers; ++i)
+        m_threads.push_back(boost::shared_ptr<Thread>(new Thread(WorkerThread(*this, i))));
+    }
+
+    ~WorkStealingQueue() {
+      this->join_all();
+      {
+        Mutex::Lock lock(m_mutex);
+        m_should_die = true;
+        m_work_event.notify_all();
+      }
+      for (int i = 0; i < m_num_workers; ++i)
+        m_threads[i]->join();
+    }
+
+    /// The number of tasks waiting to be picked up by a worker.
+    size_t size() const { return size_t(long(m_queued)); }
+
+    /// The number of worker threads.
+    int max_threads() const { return m_num_workers; }
+
+    // Add a task that is being tracked by a shared pointer.
+    void add_task(boost::shared_ptr<Task> task) {
+      int *self = m_worker_index.get();
+      int index = self ? *self : int((++m_next_deque) % m_num_workers);
+
+      ++m_outstanding;
+      ++m_queued;
+      {
+        Mutex::Lock lock(m_deques[index].m_mutex);
+        m_deques[index].m_tasks.push_back(task);
+      }
+
+      // Taking the lock here pairs with the check in worker_loop(), so
+      // a worker cannot miss this wakeup on its way to sleep.
+      Mutex::Lock lock(m_mutex);
+      m_work_event.notify_one();
+    }
+
+    // Wait for every task that has been added to finish.
+    void join_all() {
+      Mutex::Lock lock(m_mutex);
+      while (long(m_outstanding) != 0)
+        m_finished_event.wait(lock);
+    }
+  };
+
+  namespace detail {
+    // Runs one of run_tasks()'s tasks, keeping any exception that it
+    // throws for run_tasks() to rethrow.
+    class GuardedTask : public Task {
+      boost::shared_ptr<Task> m_task;
+    public:
+      boost::exception_ptr error;
+      GuardedTask(boost::shared_ptr<Task> const& task) : m_task(task) {}
+      virtual void operator()() {
+        try {
+          (*m_task)();
+        } catch (...) {
+          error = boost::current_exception();
+        }
+        m_task->signal_finished();
+      }
+    };
+  }
+
+  /// Runs tasks and waits for them to finish.  On a thread pool
+  /// worker, which already has the rest of the pool running beside
+  /// it, the tasks simply run one after another on that thread.
+  /// Anywhere else they are run by the vw_task_queue() workers, so
+  /// that the caller does not start threads of its own every time it
+  /// is called.  If any of the tasks throws, the rest still run, and
+  /// then the exception thrown by the first of them in the list is
+  /// rethrown.
+  inline void run_tasks(std::vector<boost::shared_ptr<Task> > const& tasks) {
+    std::vector<boost::shared_ptr<detail::GuardedTask> > guarded;
+    for (size_t i = 0; i < tasks.size(); ++i)
+      guarded.push_back(boost::shared_ptr<detail::GuardedTask>(new detail::GuardedTask(tasks[i])));
+
+    if (tasks.size() < 2 || Thread::is_pool_worker()) {
+      for (size_t i = 0; i < guarded.size(); ++i)
+        (*guarded[i])();
+    }
+    else {
+      // Other callers share the queue, so wait for just these tasks.
+      WorkStealingQueue &queue = vw_task_queue();
+      for (size_t i = 0; i < guarded.size(); ++i)
+        queue.add_task(guarded[i]);
+      for (size_t i = 0; i < guarded.size(); ++i)
+        guarded[i]->join();
+    }
+
+    for (size_t i = 0; i < guarded.size(); ++i)
+      if (guarded[i]->error)
+        boost::rethrow_exception(guarded[i]->error);
+  }
+
 } // namespace vw
 
 #endif // __VW_CORE_THREADPOOL_H__
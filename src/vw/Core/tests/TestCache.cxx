@@ -10,6 +10,8 @@
 
 #include <vw/Core/Cache.h>
 #include <vw/Core/FundamentalTypes.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Thread.h>
 #include <boost/shared_array.hpp>
 
 using namespace vw;
@@ -224,3 +226,177 @@ TEST(Cache, Stats) {
   EXPECT_EQ(0u, cache.misses());
   EXPECT_EQ(0u, cache.evictions());
 }
+
+TEST(Cache, Sharded) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+
+  const int num_blocks = 64;
+  vw::Cache cache(num_blocks*sizeof(handle_t::value_type), 8);
+  EXPECT_EQ(8u, cache.num_shards());
+  EXPECT_EQ(num_blocks*sizeof(handle_t::value_type), cache.max_size());
+
+  std::vector<handle_t> h;
+  for (int i = 0; i < num_blocks; ++i)
+    h.push_back(cache.insert(BlockGenerator(1, uint8(i))));
+
+  for (int i = 0; i < num_blocks; ++i)
+    EXPECT_EQ(i, *h[i]);
+  for (int i = 0; i < num_blocks; ++i)
+    EXPECT_EQ(i, *h[i]);
+
+  // Each shard gets an eighth of the budget, so some shards will have had to
+  // evict, but every access must be counted exactly once.
+  EXPECT_EQ(uint64(2*num_blocks), cache.hits() + cache.misses());
+  EXPECT_GE(cache.misses(), uint64(num_blocks));
+  EXPECT_GE(cache.evictions(), cache.misses() - num_blocks);
+
+  // Shrinking the cache must shrink every shard.
+  cache.resize(0);
+  for (int i = 0; i < num_blocks; ++i)
+    EXPECT_FALSE(h[i].valid());
+
+  // Cannot reshard while cache lines are attached
+  EXPECT_THROW(cache.set_num_shards(4), LogicErr);
+  h.clear();
+  cache.set_num_shards(4);
+  EXPECT_EQ(4u, cache.num_shards());
+
+  cache.clear_stats();
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(0u, cache.misses());
+  EXPECT_EQ(0u, cache.evictions());
+}
+
+// Hammers a set of (already generated) cache lines from one thread.
+class CacheHitTask {
+  std::vector<Cache::Handle<BlockGenerator> > *m_handles;
+  int m_offset, m_iterations;
+public:
+  CacheHitTask(std::vector<Cache::Handle<BlockGenerator> > *handles, int offset, int iterations)
+    : m_handles(handles), m_offset(offset), m_iterations(iterations) {}
+  void operator()() {
+    size_t n = m_handles->size();
+    for (int i = 0; i < m_iterations; ++i)
+      *(*m_handles)[(m_offset + i) % n];
+  }
+};
+
+// Measures hit-path throughput with several threads for a single-shard
+// cache and a sharded cache. The timings are only reported; this checks that
+// every access is accounted for.
+TEST(Cache, DISABLED_ShardedHitBenchmark) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+  const int num_threads = 8, num_blocks = 256, iterations = 20000;
+
+  uint32 shard_counts[] = {1, 16};
+  for (int s = 0; s < 2; ++s) {
+    vw::Cache cache(num_blocks*sizeof(handle_t::value_type), shard_counts[s]);
+    std::vector<handle_t> h;
+    for (int i = 0; i < num_blocks; ++i)
+      h.push_back(cache.insert(BlockGenerator(1, uint8(i))));
+    // Make sure everything fits, even with the budget split across shards.
+    cache.resize(2*num_blocks*sizeof(handle_t::value_type));
+    for (int i = 0; i < num_blocks; ++i)
+      *h[i];
+    cache.clear_stats();
+
+    Stopwatch sw;
+    sw.start();
+    std::vector<boost::shared_ptr<Thread> > threads;
+    for (int t = 0; t < num_threads; ++t)
+      threads.push_back(boost::shared_ptr<Thread>(new Thread(CacheHitTask(&h, t*num_blocks/num_threads, iterations))));
+    for (int t = 0; t < num_threads; ++t)
+      threads[t]->join();
+    sw.stop();
+
+    EXPECT_EQ(uint64(num_threads*iterations), cache.hits() + cache.misses());
+    std::cout << "Cache with " << shard_counts[s] << " shard(s): "
+              << num_threads*iterations / sw.elapsed_seconds() << " hits/sec with "
+              << num_threads << " threads" << std::endl;
+  }
+}
+
+// Lets a test hold a generator inside generate() until it is released.
+struct GenerationGate {
+  Mutex mutex;
+  Condition cond;
+  bool started, released;
+  GenerationGate() : started(false), released(false) {}
+
+  void enter() {
+    Mutex::Lock lock(mutex);
+    started = true;
+    cond.notify_all();
+    while (!released)
+      cond.wait(lock);
+  }
+  void wait_started() {
+    Mutex::Lock lock(mutex);
+    while (!started)
+      cond.wait(lock);
+  }
+  void release() {
+    Mutex::Lock lock(mutex);
+    released = true;
+    cond.notify_all();
+  }
+};
+
+// A generator that blocks on a gate, and counts how many times it has run.
+class GatedGenerator {
+  boost::shared_ptr<int> m_count;
+  boost::shared_ptr<GenerationGate> m_gate;
+public:
+  typedef int value_type;
+  GatedGenerator(boost::shared_ptr<int> count, boost::shared_ptr<GenerationGate> gate)
+    : m_count(count), m_gate(gate) {}
+  size_t size() const { return sizeof(int); }
+  boost::shared_ptr<int> generate() const {
+    m_gate->enter();
+    return boost::shared_ptr<int>(new int(++*m_count));
+  }
+};
+
+class LookupTask {
+  Cache::Handle<GatedGenerator> m_handle;
+  boost::shared_ptr<int> m_result;
+public:
+  LookupTask(Cache::Handle<GatedGenerator> handle, boost::shared_ptr<int> result)
+    : m_handle(handle), m_result(result) {}
+  void operator()() { *m_result = *m_handle; }
+};
+
+TEST(Cache, CoalescedMiss) {
+  vw::Cache cache(sizeof(int));
+  boost::shared_ptr<int> count(new int(0));
+  boost::shared_ptr<GenerationGate> gate(new GenerationGate());
+  Cache::Handle<GatedGenerator> h = cache.insert(GatedGenerator(count, gate));
+
+  boost::shared_ptr<int> r1(new int(0)), r2(new int(0));
+  Thread t1(LookupTask(h, r1));
+  gate->wait_started();
+
+  // The value is being generated by t1, so a non-blocking lookup must not
+  // wait for it, and must not start another generation.
+  boost::shared_ptr<int> value;
+  EXPECT_FALSE(h.try_get(value));
+  EXPECT_FALSE(value);
+
+  // A blocking lookup attaches to the generation already in flight.
+  // Whether or not t2 gets there before the release, it must share t1's
+  // result and count as a hit.
+  Thread t2(LookupTask(h, r2));
+  gate->release();
+  t1.join();
+  t2.join();
+
+  EXPECT_EQ(1, *count);
+  EXPECT_EQ(1, *r1);
+  EXPECT_EQ(1, *r2);
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_EQ(1u, cache.hits());
+
+  ASSERT_TRUE(h.try_get(value));
+  EXPECT_EQ(1, *value);
+  EXPECT_EQ(2u, cache.hits());
+}
@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include <vw/Core/ThreadPool.h>
+#include <vw/Core/Stopwatch.h>
 
 #include <iostream>
 
@@ -212,3 +213,171 @@ TEST(ThreadPool, OrderedWorkQueue) {
 
   queue.join_all();
 }
+
+// A trivial task that bumps a shared counter, for measuring dispatch overhead.
+class CountTask : public Task {
+  Mutex &m_mutex;
+  int &m_count;
+public:
+  CountTask(Mutex &mutex, int &count) : m_mutex(mutex), m_count(count) {}
+  void operator()() {
+    Mutex::Lock lock(m_mutex);
+    m_count++;
+  }
+};
+
+// A task that adds more tasks to the queue it is running on.
+class SpawnTask : public Task {
+  WorkStealingQueue &m_queue;
+  Mutex &m_mutex;
+  int &m_count;
+  int m_children;
+public:
+  SpawnTask(WorkStealingQueue &queue, Mutex &mutex, int &count, int children)
+    : m_queue(queue), m_mutex(mutex), m_count(count), m_children(children) {}
+  void operator()() {
+    for (int i = 0; i < m_children; ++i)
+      m_queue.add_task(boost::shared_ptr<Task>(new CountTask(m_mutex, m_count)));
+  }
+};
+
+TEST(ThreadPool, WorkStealingQueue) {
+  boost::shared_ptr<TestTask> task1 (new TestTask);
+  boost::shared_ptr<TestTask> task2 (new TestTask);
+  boost::shared_ptr<TestTask> task3 (new TestTask);
+
+  WorkStealingQueue queue(2);
+  EXPECT_EQ( 2, queue.max_threads() );
+  queue.add_task(task1);
+  queue.add_task(task2);
+  queue.add_task(task3);
+
+  Thread::sleep_ms(200);
+  EXPECT_EQ( 1, task1->value() );
+  EXPECT_EQ( 1, task2->value() );
+  EXPECT_EQ( 0, task3->value() );
+  EXPECT_EQ( 1u, queue.size() );
+
+  // Whichever worker frees up first must steal or pop task3
+  task1->kill();
+  task1->join();
+  Thread::sleep_ms(100);
+  EXPECT_EQ( 3, task1->value() );
+  EXPECT_EQ( 1, task3->value() );
+
+  task2->kill();
+  task3->kill();
+  queue.join_all();
+  EXPECT_TRUE( task2->is_finished() );
+  EXPECT_TRUE( task3->is_finished() );
+}
+
+TEST(ThreadPool, WorkStealingQueueSpawn) {
+  Mutex mutex;
+  int count = 0;
+  WorkStealingQueue queue(4);
+  for (int i = 0; i < 10; ++i)
+    queue.add_task(boost::shared_ptr<Task>(new SpawnTask(queue, mutex, count, 100)));
+  queue.join_all();
+  EXPECT_EQ( 1000, count );
+  EXPECT_EQ( 0u, queue.size() );
+}
+
+class WhereTask : public Task {
+public:
+  bool on_worker;
+  uint64 thread_id;
+  WhereTask() : on_worker(false), thread_id(0) {}
+  void operator()() {
+    on_worker = Thread::is_pool_worker();
+    thread_id = Thread::id();
+  }
+};
+
+class RunTasksTask : public Task {
+public:
+  uint64 thread_id;
+  std::vector<boost::shared_ptr<WhereTask> > tasks;
+  RunTasksTask() : thread_id(0) {
+    for (int i = 0; i < 3; ++i)
+      tasks.push_back(boost::shared_ptr<WhereTask>(new WhereTask));
+  }
+  void operator()() {
+    thread_id = Thread::id();
+    run_tasks(std::vector<boost::shared_ptr<Task> >(tasks.begin(), tasks.end()));
+  }
+};
+
+TEST(ThreadPool, RunTasks) {
+  // From a thread of our own, the tasks go to the shared pool...
+  EXPECT_FALSE( Thread::is_pool_worker() );
+  RunTasksTask outer;
+  outer();
+  for (size_t i = 0; i < outer.tasks.size(); ++i) {
+    EXPECT_TRUE( outer.tasks[i]->is_finished() );
+    EXPECT_TRUE( outer.tasks[i]->on_worker );
+    EXPECT_NE( outer.thread_id, outer.tasks[i]->thread_id );
+  }
+
+  // ...but on a pool worker they run inline.
+  boost::shared_ptr<RunTasksTask> nested(new RunTasksTask);
+  FifoWorkQueue queue(1);
+  queue.add_task(nested);
+  queue.join_all();
+  for (size_t i = 0; i < nested->tasks.size(); ++i) {
+    EXPECT_TRUE( nested->tasks[i]->is_finished() );
+    EXPECT_EQ( nested->thread_id, nested->tasks[i]->thread_id );
+  }
+}
+
+class ThrowTask : public Task {
+public:
+  void operator()() { vw_throw(ArgumentErr() << "ThrowTask"); }
+};
+
+TEST(ThreadPool, RunTasksThrows) {
+  std::vector<boost::shared_ptr<Task> > tasks;
+  tasks.push_back(boost::shared_ptr<Task>(new WhereTask));
+  tasks.push_back(boost::shared_ptr<Task>(new ThrowTask));
+  tasks.push_back(boost::shared_ptr<Task>(new WhereTask));
+
+  // The exception reaches the caller with its type, after the other
+  // tasks have run.
+  EXPECT_THROW(run_tasks(tasks), ArgumentErr);
+  for (size_t i = 0; i < tasks.size(); ++i)
+    EXPECT_TRUE(tasks[i]->is_finished());
+}
+
+// Compares the per-task dispatch overhead of FifoWorkQueue and
+// WorkStealingQueue on many tiny tasks. The timings are only reported.
+TEST(ThreadPool, DISABLED_DispatchBenchmark) {
+  const int num_threads = 8, num_tasks = 20000;
+
+  Mutex mutex;
+  int count = 0;
+  Stopwatch fifo_sw;
+  fifo_sw.start();
+  {
+    FifoWorkQueue queue(num_threads);
+    for (int i = 0; i < num_tasks; ++i)
+      queue.add_task(boost::shared_ptr<Task>(new CountTask(mutex, count)));
+    queue.join_all();
+  }
+  fifo_sw.stop();
+  EXPECT_EQ( num_tasks, count );
+
+  count = 0;
+  Stopwatch ws_sw;
+  ws_sw.start();
+  {
+    WorkStealingQueue queue(num_threads);
+    for (int i = 0; i < num_tasks; ++i)
+      queue.add_task(boost::shared_ptr<Task>(new CountTask(mutex, count)));
+    queue.join_all();
+  }
+  ws_sw.stop();
+  EXPECT_EQ( num_tasks, count );
+
+  std::cout << "FifoWorkQueue:     " << 1e6 * fifo_sw.elapsed_seconds() / num_tasks << " us/task\n"
+            << "WorkStealingQueue: " << 1e6 * ws_sw.elapsed_seconds() / num_tasks << " us/task\n";
+}
@@ -197,6 +197,30 @@ namespace vw {
     // be holding the lock when they release it, too.)
     Mutex::Lock lock(d::gdal());
     m_read_dataset_ptr.reset();
+    m_read_pool.reset();
+  }
+
+  bool DiskImageResourceGDAL::default_parallel_read = false;
+
+  // open() reads the setting while holding the global lock.
+  void DiskImageResourceGDAL::set_default_parallel_read(bool parallel) {
+    Mutex::Lock lock(d::gdal());
+    default_parallel_read = parallel;
+  }
+
+  bool DiskImageResourceGDAL::has_concurrent_read() const {
+    return bool(m_read_pool);
+  }
+
+  // Only tiled datasets take blocks in any order.  Striped and
+  // untiled ones are written sequentially by some drivers, so they
+  // are always given their blocks in row order.
+  bool DiskImageResourceGDAL::has_unordered_block_write() const {
+    if (!m_write_dataset_ptr) return false;
+    Mutex::Lock lock(d::gdal());
+    int xsize, ysize;
+    m_write_dataset_ptr->GetRasterBand(1)->GetBlockSize(&xsize,&ysize);
+    return xsize < cols();
   }
 
   bool DiskImageResourceGDAL::nodata_read_ok(double& value) const {
@@ -308,6 +332,9 @@ namespace vw {
     }
 
     m_blocksize = default_block_size();
+
+    if( default_parallel_read )
+      m_read_pool.reset( new d::GdalDatasetPool( filename ) );
   }
 
   /// Bind the resource to a file for writing.
@@ -329,6 +356,7 @@ namespace vw {
     m_format = format;
     m_blocksize = block_size;
     m_options = user_options;
+    m_read_pool.reset();
 
     Mutex::Lock lock(d::gdal());
     initialize_write_resource_locked();
@@ -427,36 +455,44 @@ namespace vw {
     boost::scoped_array<uint8> src_data(new uint8[src_fmt.byte_size()]);
     ImageBuffer src(src_fmt, src_data.get());
 
-    {
+    if( m_read_pool ) {
+      d::GdalDatasetPool::Handle dataset( *m_read_pool );
+      read_dataset( dataset.get(), src, bbox );
+    }
+    else {
       Mutex::Lock lock(d::gdal());
+      read_dataset( get_dataset_ptr().get(), src, bbox );
+    }
+
+    convert( dest, src, m_rescale );
+  }
 
-      boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
-
-      if( m_palette.empty() ) {
-        for ( int32 p = 0; p < planes(); ++p ) {
-          for ( int32 c = 0; c < channels(); ++c ) {
-            // Only one of channels() or planes() will be nonzero.
-            GDALRasterBand  *band = dataset->GetRasterBand(c+p+1);
-            GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(channel_type());
-            band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                            (uint8*)src(0,0,p) + channel_size(src.format.channel_type)*c,
-                            src.format.cols, src.format.rows, gdal_pix_fmt, src.cstride, src.rstride );
-          }
+  // Read from the given dataset into a buffer in the native format.
+  // The caller must ensure that no other thread is using the dataset.
+  void DiskImageResourceGDAL::read_dataset( GDALDataset* dataset, ImageBuffer const& src, BBox2i const& bbox ) const
+  {
+    if( m_palette.empty() ) {
+      for ( int32 p = 0; p < planes(); ++p ) {
+        for ( int32 c = 0; c < channels(); ++c ) {
+          // Only one of channels() or planes() will be nonzero.
+          GDALRasterBand  *band = dataset->GetRasterBand(c+p+1);
+          GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(channel_type());
+          band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                          (uint8*)src(0,0,p) + channel_size(src.format.channel_type)*c,
+                          src.format.cols, src.format.rows, gdal_pix_fmt, src.cstride, src.rstride );
         }
       }
-      else { // palette conversion
-        GDALRasterBand  *band = dataset->GetRasterBand(1);
-        uint8 *index_data = new uint8[bbox.width() * bbox.height()];
-        band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                        index_data, bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
-        PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) src.data;
-        for( int i=0; i<bbox.width()*bbox.height(); ++i )
-          rgba_data[i] = m_palette[index_data[i]];
-        delete [] index_data;
-      }
     }
-
-    convert( dest, src, m_rescale );
+    else { // palette conversion
+      GDALRasterBand  *band = dataset->GetRasterBand(1);
+      uint8 *index_data = new uint8[bbox.width() * bbox.height()];
+      band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                      index_data, bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
+      PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) src.data;
+      for( int i=0; i<bbox.width()*bbox.height(); ++i )
+        rgba_data[i] = m_palette[index_data[i]];
+      delete [] index_data;
+    }
   }
 
 
@@ -9,6 +9,12 @@
 ///
 /// Provides support for georeferenced files via the GDAL library.
 ///
+/// By default every call into GDAL holds a global lock, so reads of
+/// a GDAL resource are serialized with all other GDAL calls in the
+/// process.  With set_default_parallel_read(true), resources opened for
+/// reading keep a pool of dataset handles instead, and block reads from
+/// several threads run in parallel.
+///
 /// Advanced users can pass custom options to GDAL when creating a
 /// resource.  Here is an example showing how to make a tiled,
 /// compressed BigTIFF (assuming libtiff 4.0 or greater):
@@ -41,6 +47,10 @@
 class GDALDataset;
 namespace vw {
   class Mutex;
+namespace fileio {
+namespace detail {
+  class GdalDatasetPool;
+}}
 }
 
 namespace vw {
@@ -87,7 +97,9 @@ namespace vw {
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
     virtual bool has_block_read()   const {return true;}
+    virtual bool has_concurrent_read() const;
     virtual bool has_block_write()  const {return true;}
+    virtual bool has_unordered_block_write() const;
     virtual bool has_nodata_read()  const;
     virtual bool has_nodata_write() const {return true;}
 
@@ -144,9 +156,18 @@ namespace vw {
     // tinkering around in GDAL directly for some reason.
     static Mutex &global_lock();
 
+    // Specify whether resources opened for reading after this call
+    // read in parallel.  Such a resource gives each concurrent read
+    // its own dataset handle from a per-file pool, and does not take
+    // the global GDAL lock to read.  Defaults to false.  This takes
+    // the global GDAL lock, so it is safe to call while other threads
+    // open resources.
+    static void set_default_parallel_read(bool parallel);
+
   private:
     void initialize_write_resource_locked();
     Vector2i default_block_size();
+    void read_dataset( GDALDataset* dataset, ImageBuffer const& src, BBox2i const& bbox ) const;
 
     std::string m_filename;
     boost::shared_ptr<GDALDataset> m_write_dataset_ptr;
@@ -154,6 +175,8 @@ namespace vw {
     Vector2i m_blocksize;
     Options m_options;
     boost::shared_ptr<GDALDataset> m_read_dataset_ptr;
+    boost::shared_ptr<fileio::detail::GdalDatasetPool> m_read_pool;
+    static bool default_parallel_read;
   };
 
   void UnloadGDAL();
@@ -20,8 +20,13 @@
 
 #include <tiffio.h>
 
+#include <boost/utility.hpp>
+#include <boost/thread/tss.hpp>
+
 #include <vw/Core/Exception.h>
 #include <vw/Core/Debugging.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Thread.h>
 #include <vw/FileIO/DiskImageResourceTIFF.h>
 
 #ifndef VW_ERROR_BUFFER_SIZE
@@ -38,27 +43,68 @@ namespace vw {
     TIFF *tif;
     Vector2i block_size;
     std::string filename;
-    int current_line;
-    bool striped;
+    bool writable;
+    Mutex mutex;
 
-    DiskImageResourceInfoTIFF() : tif(0), block_size(), current_line(0) {}
+    DiskImageResourceInfoTIFF() : tif(0), block_size(), writable(false) {}
     ~DiskImageResourceInfoTIFF() {
       close();
+      for( size_t i=0; i<free_handles.size(); ++i )
+        TIFFClose(free_handles[i]);
     }
 
-    void reopen_read() {
-      close();
-      tif = TIFFOpen(filename.c_str(), "r");
-      if( !tif ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to open \"" << filename << "\" for reading!" );
-      current_line = 0;
-    }
-
+    // Must be called with mutex held, or from the destructor.
     void close() {
       if( tif ) {
         TIFFClose(tif);
         tif=NULL;
       }
     }
+
+    /// Checks a read handle out of the pool for the lifetime of the
+    /// object.  Each reader decodes through its own handle, so reads
+    /// from several threads never share libtiff state.
+    class ReadHandle : private boost::noncopyable {
+      DiskImageResourceInfoTIFF& m_info;
+      TIFF* m_tif;
+    public:
+      ReadHandle( DiskImageResourceInfoTIFF& info ) : m_info(info), m_tif(info.acquire()) {}
+      ~ReadHandle() { m_info.release(m_tif); }
+      TIFF* get() const { return m_tif; }
+    };
+
+  private:
+    std::vector<TIFF*> free_handles;
+
+    TIFF* acquire() {
+      {
+        Mutex::Lock lock(mutex);
+        // Flush a file we have been writing before reading it back.
+        // Holding the mutex keeps this from racing with write().
+        close();
+        if( !free_handles.empty() ) {
+          TIFF* handle = free_handles.back();
+          free_handles.pop_back();
+          return handle;
+        }
+      }
+      TIFF* handle = TIFFOpen(filename.c_str(), "r");
+      if( !handle ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to open \"" << filename << "\" for reading!" );
+      return handle;
+    }
+
+    // Keeps at most one idle handle per thread that might read
+    // concurrently, and closes the rest.
+    void release( TIFF* handle ) {
+      {
+        Mutex::Lock lock(mutex);
+        if( free_handles.size() < size_t(vw_settings().default_num_threads()) ) {
+          free_handles.push_back(handle);
+          return;
+        }
+      }
+      TIFFClose(handle);
+    }
   };
 }
 
@@ -80,14 +126,23 @@ static void tiff_warning_handler(const char* module, const char* frmt, va_list a
 */
 
 // Handle libTIFF error conditions by writing the error and hope the calling
-// program checks the return value for the function
-static char tiff_error_msg[VW_ERROR_BUFFER_SIZE];
+// program checks the return value for the function.  libTIFF calls the
+// handler on the thread that hit the error, so the message is kept per
+// thread, where check_retval() on the same thread will find it.  The
+// pointer is never deleted, for the same reason as in Thread.cc.
+static boost::thread_specific_ptr<std::string>& tiff_error_msg() {
+  static boost::thread_specific_ptr<std::string>* ptr = new boost::thread_specific_ptr<std::string>();
+  return *ptr;
+}
+
 static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
-  char msg[VW_ERROR_BUFFER_SIZE];
+  char msg[VW_ERROR_BUFFER_SIZE], error[VW_ERROR_BUFFER_SIZE];
   vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
-  snprintf( tiff_error_msg, VW_ERROR_BUFFER_SIZE,
+  snprintf( error, VW_ERROR_BUFFER_SIZE,
     "DiskImageResourceTIFF (%s) Error: %s",
     (module?module:"none"), msg );
+  if( !tiff_error_msg().get() ) tiff_error_msg().reset( new std::string );
+  *tiff_error_msg() = error;
 }
 
 
@@ -290,6 +345,11 @@ void vw::DiskImageResourceTIFF::create( std::string const& filename,
   m_info->block_size = Vector2i(cols(),rows_per_strip);
 
   m_info->tif = tif;
+  m_info->writable = true;
+}
+
+bool vw::DiskImageResourceTIFF::has_concurrent_read() const {
+  return !m_info->writable;
 }
 
 /// Read the disk image into the given buffer.
@@ -298,33 +358,31 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
   VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
              ArgumentErr() << "DiskImageResourceTIFF (read) Error: Destination buffer has wrong dimensions!" );
 
-  // Only support sequential reading on striped TIFFs right now.
-  if( !m_info || !(m_info->tif) || !(m_info->striped) || (m_info->striped && m_info->current_line > bbox.min().y()) )
-    m_info->reopen_read();
+  DiskImageResourceInfoTIFF::ReadHandle handle( *m_info );
+  TIFF* tif = handle.get();
 
   uint16 config = 0, bpsample = 0, nsamples = 0, photometric = 0;
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PLANARCONFIG, &config), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_BITSPERSAMPLE, &bpsample), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_SAMPLESPERPIXEL, &nsamples), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PHOTOMETRIC, &photometric), 0);
+  check_retval(TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &config), 0);
+  check_retval(TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bpsample), 0);
+  check_retval(TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &nsamples), 0);
+  check_retval(TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric), 0);
 
   bool is_planar = (config == PLANARCONFIG_SEPARATE) && (m_format.pixel_format != VW_PIXEL_SCALAR);
-  bool is_tiled = TIFFIsTiled(m_info->tif);
-  m_info->striped = !is_tiled;
+  bool is_tiled = TIFFIsTiled(tif);
 
   // Compute the tile or strip geometry
   uint32 block_cols, block_rows, block_size, blocks_per_row, blocks_per_plane;
   if( is_tiled ) {
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILEWIDTH, &block_cols), 0);
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILELENGTH, &block_rows), 0);
-    block_size = TIFFTileSize(m_info->tif);
+    check_retval(TIFFGetField(tif, TIFFTAG_TILEWIDTH, &block_cols), 0);
+    check_retval(TIFFGetField(tif, TIFFTAG_TILELENGTH, &block_rows), 0);
+    block_size = TIFFTileSize(tif);
     blocks_per_row = (cols()-1) / block_cols + 1;
     blocks_per_plane = blocks_per_row * ( (rows()-1) / block_rows + 1 );
   }
   else {
     block_cols = cols();
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_ROWSPERSTRIP, &block_rows ), 0);
-    block_size = TIFFStripSize(m_info->tif);
+    check_retval(TIFFGetField( tif, TIFFTAG_ROWSPERSTRIP, &block_rows ), 0);
+    block_size = TIFFStripSize(tif);
     blocks_per_row = 1;
     blocks_per_plane = (rows()-1) / block_rows + 1;
   }
@@ -348,7 +406,7 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
     buf = _TIFFmalloc( block_cols*block_rows*6 );
     if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
 
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_COLORMAP, &red_table, &green_table, &blue_table ), 0);
+    check_retval(TIFFGetField( tif, TIFFTAG_COLORMAP, &red_table, &green_table, &blue_table ), 0);
   }
 
   // Set up the source and destination image buffers
@@ -371,8 +429,8 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
       if( is_planar ) {
         // At the moment we make an extra copy here to spoof plane contiguity
         for( int i=0; i<nsamples; ++i ) {
-          if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), -1);
-          else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), 0);
+          if( is_tiled ) check_retval(TIFFReadEncodedTile( tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), -1);
+          else check_retval(TIFFReadEncodedStrip( tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), 0);
           // Oh man, this is horrible!
           switch(bpsample/8) {
           case 1:
@@ -402,8 +460,8 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
         }
       }
       else if( photometric == PHOTOMETRIC_PALETTE ) {
-        if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), -1);
-        else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), 0);
+        if( is_tiled ) check_retval(TIFFReadEncodedTile( tif, block_id, palette_buf, (tsize_t) -1 ), -1);
+        else check_retval(TIFFReadEncodedStrip( tif, block_id, palette_buf, (tsize_t) -1 ), 0);
         if( photometric == PHOTOMETRIC_PALETTE ) {
           for( int y=data_top; y<data_bottom; ++y ) {
             for( int x=data_left; x<data_right; ++x ) {
@@ -418,10 +476,9 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
       }
       else {
         if( is_tiled )  {
-          check_retval(TIFFReadEncodedTile( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
+          check_retval(TIFFReadEncodedTile( tif, block_id, buf, (tsize_t) -1 ), -1);
         } else {
-          check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
-          m_info->current_line++;
+          check_retval(TIFFReadEncodedStrip( tif, block_id, buf, (tsize_t) -1 ), -1);
         }
       }
 
@@ -438,8 +495,6 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
   _TIFFfree(buf);
   if( plane_buf ) _TIFFfree(plane_buf);
   if( palette_buf ) _TIFFfree(palette_buf);
-  // Sorry .. this keeps us from incrementally reading
-  m_info->close();
 }
 
 // Write the given buffer into the disk image.
@@ -463,6 +518,11 @@ void vw::DiskImageResourceTIFF::write( ImageBuffer const& src, BBox2i const& bbo
   dst.format.planes = 1;
 
   // Write the image data to disk.
+  Mutex::Lock lock(m_info->mutex);
+  if( !m_info->tif ) {
+    _TIFFfree(buf);
+    vw_throw( IOErr() << "DiskImageResourceTIFF: cannot write to \"" << m_filename << "\" after reading from it." );
+  }
   for (int32 p = 0; p < m_format.planes; p++) {
     ImageBuffer src_row = src_plane;
     for (int32 row = 0; row < bbox.height(); row++) {
@@ -492,7 +552,7 @@ vw::DiskImageResource* vw::DiskImageResourceTIFF::construct_create( std::string
 // if there was an error.
 void vw::DiskImageResourceTIFF::check_retval(const int retval, const int error_val) const {
   if (retval == error_val) {
-    vw_throw( vw::IOErr() << "check_retval: " << tiff_error_msg );
+    vw_throw( vw::IOErr() << "check_retval: " << (tiff_error_msg().get() ? *tiff_error_msg() : std::string()) );
   }
 }
 
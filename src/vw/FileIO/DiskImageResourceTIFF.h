@@ -9,6 +9,11 @@
 ///
 /// Provides support for TIFF image files.
 ///
+/// Reads decode through a pool of libtiff handles, one per concurrent
+/// reader, so several threads (e.g. the workers of a
+/// BlockRasterizeView) can decode different strips or tiles of the
+/// same file at once.
+///
 #ifndef __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 #define __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 
@@ -41,6 +46,9 @@ namespace vw {
     virtual bool has_nodata_write() const {return false;}
     virtual bool has_block_read()   const {return true;}
     virtual bool has_nodata_read()  const {return false;}
+    /// True only for a file opened for reading.  A file being
+    /// written may not be read until the writes are finished.
+    virtual bool has_concurrent_read() const;
 
     virtual Vector2i block_read_size() const;
 
@@ -17,6 +17,7 @@
 #include <vw/Image/ImageResourceView.h>
 #include <vw/Image/BlockRasterize.h>
 #include <vw/Core/Cache.h>
+#include <vw/Core/Settings.h>
 #include <vw/Core/TemporaryFile.h>
 
 #include <boost/filesystem/operations.hpp>
@@ -43,25 +44,27 @@ namespace vw {
 
     /// Constructs a DiskImageView of the given file on disk
     /// using the specified cache area. NULL cache means skip it.
+    /// When cached, blocks are read ahead according to the
+    /// default_prefetch_blocks setting.
     DiskImageView( std::string const& filename, Cache* cache = &vw_system_cache() )
-      : m_rsrc( DiskImageResource::open( filename ) ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( DiskImageResource::open( filename ) ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache, vw_settings().default_prefetch_blocks() ) {}
 
     /// Constructs a DiskImageView of the given resource using the
     /// specified cache area.
     DiskImageView( boost::shared_ptr<DiskImageResource> resource, Cache* cache = &vw_system_cache())
-      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache, vw_settings().default_prefetch_blocks() ) {}
 
     /// Constructs a DiskImageView of the given resource using the
     /// specified cache area.  Takes ownership of the resource object
     /// (i.e. deletes it when it's done using it).
     DiskImageView( DiskImageResource *resource, Cache* cache = &vw_system_cache() )
-      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache, vw_settings().default_prefetch_blocks() ) {}
 
     /// Constructs a DiskImageView of the given resource using the specified
     /// cache area. Does not take ownership, you must ensure resource stays
     /// valid for the lifetime of DiskImageView
     DiskImageView( DiskImageResource &resource, Cache* cache = &vw_system_cache() )
-      : m_rsrc( &resource, NOP() ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( &resource, NOP() ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache, vw_settings().default_prefetch_blocks() ) {}
 
     ~DiskImageView() {}
 
@@ -100,6 +100,34 @@ vw::Mutex& gdal() {
   return *_gdal_mutex;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Dataset Pool
+////////////////////////////////////////////////////////////////////////////////
+GdalDatasetPool::~GdalDatasetPool() {
+  for (size_t i = 0; i < m_free.size(); ++i)
+    GDALClose(m_free[i]);
+}
+
+GDALDataset* GdalDatasetPool::acquire() {
+  {
+    Mutex::Lock lock(m_mutex);
+    if (!m_free.empty()) {
+      GDALDataset* dataset = m_free.back();
+      m_free.pop_back();
+      return dataset;
+    }
+  }
+  GDALDataset* dataset = (GDALDataset*)GDALOpen(m_filename.c_str(), GA_ReadOnly);
+  if (!dataset)
+    vw_throw( IOErr() << "GDAL: Failed to open " << m_filename << "." );
+  return dataset;
+}
+
+void GdalDatasetPool::release(GDALDataset* dataset) {
+  Mutex::Lock lock(m_mutex);
+  m_free.push_back(dataset);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Decompress
 ////////////////////////////////////////////////////////////////////////////////
@@ -2,6 +2,10 @@
 #define __VW_FILEIO_GDALIO_H__
 
 #include <vw/FileIO/ScanlineIO.h>
+#include <vw/Core/Thread.h>
+
+#include <boost/utility.hpp>
+#include <vector>
 
 extern "C" {
 #include <gdal_priv.h>
@@ -16,6 +20,34 @@ namespace detail {
 
 Mutex& gdal() VW_WARN_UNUSED;
 
+// A pool of read-only dataset handles for one file.  A handle is used
+// by one thread at a time, and GDAL allows different handles to be
+// used concurrently, so reads through the pool do not need the global
+// GDAL lock.  The pool grows to the number of threads that read at
+// once.
+class GdalDatasetPool : private boost::noncopyable {
+    std::string m_filename;
+    std::vector<GDALDataset*> m_free;
+    Mutex m_mutex;
+
+    GDALDataset* acquire();
+    void release(GDALDataset* dataset);
+
+  public:
+    // Checks a handle out of the pool for the lifetime of the object.
+    class Handle : private boost::noncopyable {
+        GdalDatasetPool& m_pool;
+        GDALDataset* m_dataset;
+      public:
+        Handle(GdalDatasetPool& pool) : m_pool(pool), m_dataset(pool.acquire()) {}
+        ~Handle() { m_pool.release(m_dataset); }
+        GDALDataset* get() const { return m_dataset; }
+    };
+
+    GdalDatasetPool(const std::string& filename) : m_filename(filename) {}
+    ~GdalDatasetPool();
+};
+
 // These classes exist to share code between the on-disk and in-memory versions
 // of the relevant image resources. They are not intended for use by users
 // (thus the detail namespace).
@@ -11,9 +11,14 @@
 #include <vw/FileIO/DiskImageResource_internal.h>
 #include <vw/Image/PixelTypes.h>
 #include <vw/Image/ImageView.h>
+#include <vw/Image/ImageResourceView.h>
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/config.h>
 #include <test/Helpers.h>
 
+#include <iostream>
+
 using namespace vw;
 using namespace vw::internal;
 using namespace vw::test;
@@ -354,3 +359,97 @@ TEST( DiskImageResource, WrongFiles ) {
   EXPECT_THROW(r.reset(DiskImageResourcePBM::construct_open("rgb2x2.tif")),
                vw::ArgumentErr);
 }
+
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+// Reads a large uint16 TIFF as float, which spends most of its time in
+// convert().
+TEST( DiskImageResource, DISABLED_TIFFReadFloatBenchmark ) {
+  ImageView<PixelGray<uint16> > src(4096,4096);
+  for( int32 j=0; j<src.rows(); ++j )
+    for( int32 i=0; i<src.cols(); ++i )
+      src(i,j) = uint16( i*31 + j*17 );
+
+  UnlinkName fn("benchmark16.tif");
+  {
+    DiskImageResourceTIFF r( fn, src.format() );
+    write_image( r, src );
+  }
+
+  ImageView<PixelGray<float> > dst;
+  Stopwatch sw;
+  sw.start();
+  {
+    DiskImageResourceTIFF r( fn );
+    read_image( dst, r );
+  }
+  sw.stop();
+  std::cout << "Read 4096x4096 uint16 TIFF as float: " << sw.elapsed_seconds() << "s" << std::endl;
+
+  ASSERT_EQ( src.cols(), dst.cols() );
+  ASSERT_EQ( src.rows(), dst.rows() );
+  for( int32 j=0; j<src.rows(); j+=511 )
+    for( int32 i=0; i<src.cols(); i+=509 )
+      EXPECT_EQ( float(src(i,j).v()) * (1.0f/65535), dst(i,j).v() );
+}
+
+// Only a TIFF opened for reading may be read from several threads,
+// and the results are the same as reading it from one.
+TEST( DiskImageResource, TIFFConcurrentRead ) {
+  ImageView<PixelGray<uint16> > src(300,400);
+  for( int32 j=0; j<src.rows(); ++j )
+    for( int32 i=0; i<src.cols(); ++i )
+      src(i,j) = uint16( (i*31 + j*17) % 4093 );
+
+  UnlinkName fn("concurrent_lzw.tif");
+  {
+    DiskImageResourceTIFF r( fn, src.format(), true );
+    EXPECT_FALSE( r.has_concurrent_read() );
+    write_image( r, src );
+  }
+
+  boost::shared_ptr<DiskImageResourceTIFF> rsrc( new DiskImageResourceTIFF( fn ) );
+  EXPECT_TRUE( rsrc->has_concurrent_read() );
+  ImageResourceView<PixelGray<uint16> > view( rsrc );
+  for( int pass=0; pass<3; ++pass ) {
+    ImageView<PixelGray<uint16> > dst = block_rasterize( view, Vector2i(src.cols(),16), 4 );
+    ASSERT_EQ( src.rows(), dst.rows() );
+    EXPECT_TRUE( std::equal( src.begin(), src.end(), dst.begin() ) );
+  }
+}
+
+// Decodes an LZW-compressed TIFF with several threads at once, each
+// reading its own band of strips.
+TEST( DiskImageResource, DISABLED_TIFFParallelReadBenchmark ) {
+  ImageView<PixelGray<uint16> > src(4096,4096);
+  for( int32 j=0; j<src.rows(); ++j )
+    for( int32 i=0; i<src.cols(); ++i )
+      src(i,j) = uint16( (i*31 + j*17) % 4093 );
+
+  UnlinkName fn("benchmark_lzw.tif");
+  {
+    DiskImageResourceTIFF r( fn, src.format(), true );
+    write_image( r, src );
+  }
+
+  boost::shared_ptr<DiskImageResourceTIFF> rsrc( new DiskImageResourceTIFF( fn ) );
+  EXPECT_TRUE( rsrc->has_concurrent_read() );
+  ImageResourceView<PixelGray<uint16> > view( rsrc );
+
+  const int threads[] = { 1, 2, 4, 8 };
+  for( int t=0; t<4; ++t ) {
+    ImageView<PixelGray<uint16> > dst;
+    Stopwatch sw;
+    sw.start();
+    dst = block_rasterize( view, Vector2i(src.cols(),256), threads[t] );
+    sw.stop();
+    std::cout << "Read 4096x4096 LZW uint16 TIFF with " << threads[t] << " threads: "
+              << sw.elapsed_seconds() << "s" << std::endl;
+
+    ASSERT_EQ( src.cols(), dst.cols() );
+    ASSERT_EQ( src.rows(), dst.rows() );
+    for( int32 j=0; j<src.rows(); j+=127 )
+      for( int32 i=0; i<src.cols(); i+=131 )
+        EXPECT_EQ( src(i,j), dst(i,j) );
+  }
+}
+#endif
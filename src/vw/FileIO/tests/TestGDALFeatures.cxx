@@ -8,8 +8,12 @@
 #include <vw/FileIO.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageIO.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
 #include <test/Helpers.h>
 
+#include <iostream>
+
 using namespace vw;
 using namespace vw::test;
 
@@ -40,4 +44,131 @@ TEST( GDALFeatures, NoDataValue ) {
   EXPECT_EQ( -1, r_rsrc.nodata_read() );
 }
 
+namespace {
+  // Reads one block of a resource and compares it to the original.
+  class ReadBlockTask : public Task {
+    DiskImageResourceGDAL const& m_rsrc;
+    ImageView<float> const& m_expected;
+    BBox2i m_bbox;
+    bool m_ok;
+  public:
+    ReadBlockTask( DiskImageResourceGDAL const& rsrc, ImageView<float> const& expected, BBox2i const& bbox )
+      : m_rsrc(rsrc), m_expected(expected), m_bbox(bbox), m_ok(false) {}
+
+    virtual void operator()() {
+      ImageView<float> block;
+      read_image( block, m_rsrc, m_bbox );
+      m_ok = true;
+      for( int32 j=0; j<block.rows(); ++j )
+        for( int32 i=0; i<block.cols(); ++i )
+          if( block(i,j) != m_expected(m_bbox.min().x()+i, m_bbox.min().y()+j) )
+            m_ok = false;
+    }
+
+    bool ok() const { return m_ok; }
+  };
+
+  // Reads every block of the resource with the given number of
+  // threads, returning the elapsed time.
+  double parallel_read( DiskImageResourceGDAL const& rsrc, ImageView<float> const& expected, int threads ) {
+    std::vector<boost::shared_ptr<ReadBlockTask> > tasks;
+    Vector2i block = rsrc.block_read_size();
+    Stopwatch sw;
+    sw.start();
+    {
+      FifoWorkQueue queue( threads );
+      for( int32 y=0; y<rsrc.rows(); y+=block.y() ) {
+        for( int32 x=0; x<rsrc.cols(); x+=block.x() ) {
+          BBox2i bbox( x, y, block.x(), block.y() );
+          bbox.crop( BBox2i(0,0,rsrc.cols(),rsrc.rows()) );
+          tasks.push_back( boost::shared_ptr<ReadBlockTask>( new ReadBlockTask( rsrc, expected, bbox ) ) );
+          queue.add_task( tasks.back() );
+        }
+      }
+      queue.join_all();
+    }
+    sw.stop();
+    for( size_t i=0; i<tasks.size(); ++i )
+      EXPECT_TRUE( tasks[i]->ok() ) << "Block " << i << " was read incorrectly.";
+    return sw.elapsed_seconds();
+  }
+}
+
+// Several threads reading overlapping blocks of one parallel read
+// resource get the same pixels as a serial read.
+TEST( GDALFeatures, ParallelRead ) {
+  ImageView<float> image(300,200);
+  for( int32 j=0; j<image.rows(); ++j )
+    for( int32 i=0; i<image.cols(); ++i )
+      image(i,j) = float( (i*7 + j*13) % 1021 ) / 1021;
+
+  UnlinkName fn("parallel_read_small.tif");
+  {
+    DiskImageResourceGDAL::Options options;
+    options["COMPRESS"] = "DEFLATE";
+    DiskImageResourceGDAL rsrc( fn, image.format(), Vector2i(64,64), options );
+    write_image( rsrc, image );
+  }
+
+  ImageView<float> serial;
+  {
+    DiskImageResourceGDAL rsrc( fn );
+    EXPECT_FALSE( rsrc.has_concurrent_read() );
+    read_image( serial, rsrc );
+  }
+  ASSERT_EQ( image.cols(), serial.cols() );
+  ASSERT_EQ( image.rows(), serial.rows() );
+
+  DiskImageResourceGDAL::set_default_parallel_read( true );
+  DiskImageResourceGDAL rsrc( fn );
+  DiskImageResourceGDAL::set_default_parallel_read( false );
+  EXPECT_TRUE( rsrc.has_concurrent_read() );
+
+  // 80x80 blocks every 48 pixels, so that neighbors share pixels and
+  // most blocks straddle several tiles.
+  for( int pass=0; pass<3; ++pass ) {
+    std::vector<boost::shared_ptr<ReadBlockTask> > tasks;
+    {
+      FifoWorkQueue queue( 4 );
+      for( int32 y=0; y<rsrc.rows(); y+=48 ) {
+        for( int32 x=0; x<rsrc.cols(); x+=48 ) {
+          BBox2i bbox( x, y, 80, 80 );
+          bbox.crop( BBox2i(0,0,rsrc.cols(),rsrc.rows()) );
+          tasks.push_back( boost::shared_ptr<ReadBlockTask>( new ReadBlockTask( rsrc, serial, bbox ) ) );
+          queue.add_task( tasks.back() );
+        }
+      }
+      queue.join_all();
+    }
+    for( size_t i=0; i<tasks.size(); ++i )
+      EXPECT_TRUE( tasks[i]->ok() ) << "Block " << i << " was read incorrectly.";
+  }
+}
+
+TEST( GDALFeatures, DISABLED_ParallelReadBenchmark ) {
+  ImageView<float> image(4096,4096);
+  for( int32 j=0; j<image.rows(); ++j )
+    for( int32 i=0; i<image.cols(); ++i )
+      image(i,j) = float( (i*7 + j*13) % 1021 ) / 1021;
+
+  UnlinkName fn("parallel_read.tif");
+  {
+    DiskImageResourceGDAL::Options options;
+    options["COMPRESS"] = "DEFLATE";
+    DiskImageResourceGDAL rsrc( fn, image.format(), Vector2i(256,256), options );
+    write_image( rsrc, image );
+  }
+
+  const int threads[] = { 1, 2, 4, 8, 16 };
+  for( int parallel=0; parallel<2; ++parallel ) {
+    DiskImageResourceGDAL::set_default_parallel_read( parallel );
+    DiskImageResourceGDAL rsrc( fn );
+    EXPECT_EQ( bool(parallel), rsrc.has_concurrent_read() );
+    for( int i=0; i<5; ++i )
+      std::cout << (parallel ? "Parallel" : "Locked") << " read of a tiled 4096x4096 float GeoTIFF with "
+                << threads[i] << " threads: " << parallel_read( rsrc, image, threads[i] ) << "s" << std::endl;
+  }
+  DiskImageResourceGDAL::set_default_parallel_read( false );
+}
+
 #endif
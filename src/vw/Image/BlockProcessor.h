@@ -25,8 +25,12 @@
 
 #include <vw/Core/Settings.h>
 #include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Math/BBox.h>
 
+#include <vector>
+#include <boost/exception_ptr.hpp>
+
 namespace vw {
 
   template <class FuncT>
@@ -120,6 +124,24 @@ namespace vw {
       Info &info;
     };
 
+    // In the multi-threaded case, each block becomes one task on a
+    // WorkStealingQueue.  A block that throws keeps its exception for
+    // operator() to rethrow once the queue has finished.
+    class BlockTask : public Task {
+      FuncT const& m_func;
+      BBox2i m_bbox;
+    public:
+      boost::exception_ptr error;
+      BlockTask( FuncT const& func, BBox2i const& bbox ) : m_func(func), m_bbox(bbox) {}
+      virtual void operator()() {
+        try {
+          m_func( m_bbox );
+        } catch ( ... ) {
+          error = boost::current_exception();
+        }
+      }
+    };
+
     inline void operator()( BBox2i bbox ) const {
       typename BlockThread::Info info( m_func, bbox, m_block_size );
 
@@ -130,19 +152,16 @@ namespace vw {
         return bt();
       }
 
-      std::vector<boost::shared_ptr<BlockThread> > generators;
-      std::vector<boost::shared_ptr<Thread> > threads;
-
-      for( int i=0; i<m_num_threads; ++i ) {
-        boost::shared_ptr<BlockThread> generator( new BlockThread( info ) );
-        generators.push_back( generator );
-        boost::shared_ptr<Thread> thread( new Thread( generator ) );
-        threads.push_back( thread );
-      }
-
-      for( int i=0; i<m_num_threads; ++i ) {
-        threads[i]->join();
+      WorkStealingQueue queue( m_num_threads );
+      std::vector<boost::shared_ptr<BlockTask> > tasks;
+      for( ; !info.complete(); info.advance() ) {
+        tasks.push_back( boost::shared_ptr<BlockTask>( new BlockTask( info.func(), info.bbox() ) ) );
+        queue.add_task( tasks.back() );
       }
+      queue.join_all();
+      for( size_t i = 0; i < tasks.size(); ++i )
+        if( tasks[i]->error )
+          boost::rethrow_exception( tasks[i]->error );
     }
 
   };
@@ -14,10 +14,18 @@
 /// block at a time can dramatically improve performance by reducing
 /// memory utilization.
 ///
+/// A cached BlockRasterizeView can optionally read ahead: whenever it
+/// rasterizes a block, it queues up generation of the next few blocks
+/// (in the row-major order that BlockProcessor visits them) on the
+/// background thread pool that all views share, vw_prefetch_queue().
+/// This lets slow sources, such as images on disk, be decoded while
+/// the caller is busy computing.
+///
 #ifndef __VW_IMAGE_BLOCKRASTERIZE_H__
 #define __VW_IMAGE_BLOCKRASTERIZE_H__
 
 #include <vw/Core/Cache.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/PixelAccessors.h>
 #include <vw/Image/Manipulation.h>
@@ -33,12 +41,15 @@ namespace vw {
     typedef typename ImageT::pixel_type result_type;
     typedef ProceduralPixelAccessor<BlockRasterizeView> pixel_accessor;
 
+    /// If a cache is given, prefetch sets how many blocks to read
+    /// ahead of each block that is rasterized.  Zero disables read-ahead.
     BlockRasterizeView( ImageT const& image, Vector2i const& block_size,
-                        int num_threads = 0, Cache *cache = NULL )
+                        int num_threads = 0, Cache *cache = NULL, int prefetch = 0 )
       : m_child( new ImageT(image) ),
         m_block_size( block_size ),
         m_num_threads( num_threads ),
-        m_cache_ptr( cache )
+        m_cache_ptr( cache ),
+        m_prefetch( prefetch )
     {
       initialize();
     }
@@ -54,8 +65,8 @@ namespace vw {
 #endif
       if ( m_cache_ptr ) {
         // Early-out optimization for single-block resources
-        if( m_block_table->size() == 1 ) {
-          return ((*m_block_table)[0])->operator()( x, y, p );
+        if( m_block_table->handles.size() == 1 ) {
+          return (m_block_table->handles[0])->operator()( x, y, p );
         }
         int32 ix = x/m_block_size.x(), iy = y/m_block_size.y();
         return block(ix,iy)->operator()( x-ix*m_block_size.x(), y - iy*m_block_size.y(), p );
@@ -73,24 +84,43 @@ namespace vw {
       return CropView<ImageView<pixel_type> >( buf, BBox2i(-bbox.min().x(),-bbox.min().y(),cols(),rows()) );
     }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i bbox ) const {
-      RasterizeFunctor<DestT> rasterizer( *this, dest, bbox.min() );
+      DeferredBlocks deferred;
+      RasterizeFunctor<DestT> rasterizer( *this, dest, bbox.min(), &deferred );
       BlockProcessor<RasterizeFunctor<DestT> > process( rasterizer, m_block_size, m_num_threads );
       process(bbox);
+
+      // Blocks that some other thread was already generating were
+      // skipped above.  By now they have most likely been generated, so
+      // finish them off, waiting on the generation in flight if need be.
+      RasterizeFunctor<DestT> finisher( *this, dest, bbox.min() );
+      for( size_t i = 0; i < deferred.bboxes.size(); ++i )
+        finisher( deferred.bboxes[i] );
     }
 
   private:
+    // The block bboxes that a rasterize() call put off until later
+    // because their cache lines were being generated by another thread.
+    struct DeferredBlocks {
+      Mutex mutex;
+      std::vector<BBox2i> bboxes;
+    };
+
     // These function objects are spawned to rasterize the child image.
     // One functor is created per child thread, and they are called
     // in succession with bounding boxes that are each contained
-    // within one block.
+    // within one block.  If the functor has a DeferredBlocks list,
+    // blocks that are already being generated by another thread are
+    // added to it instead of being waited on.
     template <class DestT>
     class RasterizeFunctor {
       BlockRasterizeView const& m_view;
       DestT const& m_dest;
       Vector2i m_offset;
+      DeferredBlocks *m_deferred;
     public:
-      RasterizeFunctor( BlockRasterizeView const& view, DestT const& dest, Vector2i const& offset )
-        : m_view(view), m_dest(dest), m_offset(offset) {}
+      RasterizeFunctor( BlockRasterizeView const& view, DestT const& dest, Vector2i const& offset,
+                        DeferredBlocks *deferred = 0 )
+        : m_view(view), m_dest(dest), m_offset(offset), m_deferred(deferred) {}
       void operator()( BBox2i const& bbox ) const {
 #if VW_DEBUG_LEVEL > 1
         vw_out(VerboseDebugMessage, "image") << "BlockRasterizeView::RasterizeFunctor( " << bbox << " )" << std::endl;
@@ -103,7 +133,18 @@ namespace vw {
             vw_throw(LogicErr() << "BlockRasterizeView::RasterizeFunctor: bbox spans more than one cache block!");
           }
 #endif
-          m_view.block(ix,iy)->rasterize( crop( m_dest, bbox-m_offset ), bbox-Vector2i(ix*m_view.m_block_size.x(),iy*m_view.m_block_size.y()) );
+          Cache::Handle<BlockGenerator> const& handle = m_view.block(ix,iy);
+          boost::shared_ptr<ImageView<pixel_type> > block_ptr;
+          if( m_deferred ) {
+            if( !handle.try_get( block_ptr ) ) {
+              Mutex::Lock lock( m_deferred->mutex );
+              m_deferred->bboxes.push_back( bbox );
+              return;
+            }
+          }
+          else block_ptr = handle;
+          m_view.prefetch( ix, iy );
+          block_ptr->rasterize( crop( m_dest, bbox-m_offset ), bbox-Vector2i(ix*m_view.m_block_size.x(),iy*m_view.m_block_size.y()) );
         }
         else m_view.child().rasterize( crop( m_dest, bbox-m_offset ), bbox );
       }
@@ -134,6 +175,87 @@ namespace vw {
       }
     };
 
+    // Shared by all copies of a view and by the PrefetchTasks it has
+    // queued.  mark is one past the last block index that has been
+    // queued for prefetching, and running is the number of tasks
+    // generating a block right now.  Once closed is set, tasks that
+    // have yet to run do nothing.
+    struct PrefetchState {
+      Mutex mutex;
+      Condition idle_event;
+      int32 mark, running;
+      bool closed;
+      PrefetchState() : mark(0), running(0), closed(false) {}
+    };
+
+    // The cache handles for the blocks, shared by all copies of a
+    // view.  The handles must not outlive the cache, but a queued
+    // PrefetchTask may outlive the view, so the tasks only point at
+    // the handles.  The destructor cancels the tasks that have not run
+    // yet and waits for any that are running before the handles go.
+    struct BlockTable {
+      std::vector<Cache::Handle<BlockGenerator> > handles;
+      boost::shared_ptr<PrefetchState> prefetch;
+      BlockTable( size_t size ) : handles( size ) {}
+      ~BlockTable() {
+        if( ! prefetch ) return;
+        Mutex::Lock lock( prefetch->mutex );
+        prefetch->closed = true;
+        while( prefetch->running > 0 )
+          prefetch->idle_event.wait( lock );
+      }
+    };
+
+    // Generates one block into the cache in the background.  Any
+    // error is left for whoever actually asks for the block to see.
+    class PrefetchTask : public Task {
+      boost::shared_ptr<PrefetchState> m_state;
+      Cache::Handle<BlockGenerator> const* m_handle;
+    public:
+      PrefetchTask( boost::shared_ptr<PrefetchState> const& state, Cache::Handle<BlockGenerator> const* handle )
+        : m_state( state ), m_handle( handle ) {}
+      virtual void operator()() {
+        {
+          Mutex::Lock lock( m_state->mutex );
+          if( m_state->closed ) return;
+          ++m_state->running;
+        }
+        try {
+          boost::shared_ptr<ImageView<pixel_type> > block_ptr;
+          if( ! m_handle->valid() )
+            m_handle->try_get( block_ptr );
+        } catch( const std::exception& e ) {
+          vw_out(DebugMessage, "image") << "BlockRasterizeView: prefetch failed: " << e.what() << "\n";
+        } catch( ... ) {
+          vw_out(DebugMessage, "image") << "BlockRasterizeView: prefetch failed.\n";
+        }
+        Mutex::Lock lock( m_state->mutex );
+        if( --m_state->running == 0 )
+          m_state->idle_event.notify_all();
+      }
+    };
+
+    // Queue up the m_prefetch blocks that follow block (ix,iy) in
+    // row-major order, skipping any that have already been queued.
+    void prefetch( int32 ix, int32 iy ) const {
+      if( !m_block_table->prefetch ) return;
+      PrefetchState& state = *m_block_table->prefetch;
+      int32 index = ix + iy*m_table_width;
+      int32 last = std::min( index + m_prefetch, int32(m_block_table->handles.size()) - 1 );
+      int32 first;
+      {
+        Mutex::Lock lock( state.mutex );
+        // Jumping well behind the mark means a new pass has started.
+        if( index + 1 < state.mark - 2*m_prefetch )
+          state.mark = index + 1;
+        first = std::max( index + 1, state.mark );
+        if( last >= first )
+          state.mark = last + 1;
+      }
+      for( int32 i = first; i <= last; ++i )
+        vw_prefetch_queue().add_task( boost::shared_ptr<Task>( new PrefetchTask( m_block_table->prefetch, &m_block_table->handles[i] ) ) );
+    }
+
     void initialize() {
       if( m_block_size.x() <= 0 || m_block_size.y() <= 0 ) {
         const int32 default_blocksize = 2*1024*1024; // 2 megabytes
@@ -149,7 +271,7 @@ namespace vw {
       if( m_cache_ptr ) {
         m_table_width = (cols()-1) / m_block_size.x() + 1;
         m_table_height = (rows()-1) / m_block_size.y() + 1;
-        m_block_table.reset( new std::vector<Cache::Handle<BlockGenerator> >( m_table_width * m_table_height ) );
+        m_block_table.reset( new BlockTable( m_table_width * m_table_height ) );
         BBox2i view_bbox(0,0,cols(),rows());
         for( int32 iy=0; iy<m_table_height; ++iy ) {
           for( int32 ix=0; ix<m_table_width; ++ix ) {
@@ -158,6 +280,8 @@ namespace vw {
             block(ix,iy) = m_cache_ptr->insert( BlockGenerator( m_child, bbox ) );
           }
         }
+        if( m_prefetch > 0 && m_block_table->handles.size() > 1 )
+          m_block_table->prefetch.reset( new PrefetchState );
       }
     }
 
@@ -165,7 +289,7 @@ namespace vw {
       if( ix<0 || ix>=m_table_width || iy<0 || iy>=m_table_height )
         vw_throw( ArgumentErr() << "BlockRasterizeView: Block indices out of bounds, (" << ix
                   << "," << iy << ") of (" << m_table_width << "," << m_table_height << ")" );
-      return (*m_block_table)[ix+iy*m_table_width];
+      return m_block_table->handles[ix+iy*m_table_width];
     }
 
     // We store this by shared pointer so it doesn't move when we copy
@@ -174,10 +298,11 @@ namespace vw {
     Vector2i m_block_size;
     int32 m_num_threads;
     Cache *m_cache_ptr;
+    int32 m_prefetch;
     int m_table_width, m_table_height;
     // We store this by shared pointer so copying a BlockRasterizeView
     // (i.e. to promote its scope) is not as expensive an operation.
-    boost::shared_ptr<std::vector<Cache::Handle<BlockGenerator> > > m_block_table;
+    boost::shared_ptr<BlockTable> m_block_table;
   };
 
   template <class ImageT>
@@ -190,9 +315,11 @@ namespace vw {
     return BlockRasterizeView<ImageT>( image.impl(), block_size, num_threads, &vw_system_cache() );
   }
 
+  /// Cache the image in blocks, reading ahead prefetch blocks past
+  /// each block that is rasterized.
   template <class ImageT>
-  inline BlockRasterizeView<ImageT> block_cache( ImageViewBase<ImageT> const& image, Vector2i const& block_size, int num_threads, Cache& cache ) {
-    return BlockRasterizeView<ImageT>( image.impl(), block_size, num_threads, &cache );
+  inline BlockRasterizeView<ImageT> block_cache( ImageViewBase<ImageT> const& image, Vector2i const& block_size, int num_threads, Cache& cache, int prefetch = 0 ) {
+    return BlockRasterizeView<ImageT>( image.impl(), block_size, num_threads, &cache, prefetch );
   }
 
 } // namespace vw
@@ -21,6 +21,7 @@
 #include <vw/Image/Manipulation.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/PixelMask.h>
+#include <vw/Image/ConvolutionSIMD.h>
 
 namespace vw {
 
@@ -127,16 +128,19 @@ namespace vw {
 
     /// Returns the pixel at the given position in the given plane.
     inline result_type operator()( int32 x, int32 y, int32 p=0 ) const {
+      typedef typename CompoundChannelType<result_type>::type channel_type;
       int32 ci = (m_kernel.cols()-1-m_ci), cj = (m_kernel.rows()-1-m_cj);
       if( (x >= ci) && (y >= cj) &&
           (x <= int(m_image.cols())-int(m_kernel.cols())+ci) &&
           (y <= int(m_image.rows())-int(m_kernel.rows())+cj) ) {
-        return (result_type) correlate_2d_at_point( m_image.origin().advance(x-ci,y-cj,p),
-                                                    m_kernel.origin(), m_kernel.cols(), m_kernel.rows() );
+        return channel_cast_clamp_if_int<channel_type>(
+          correlate_2d_at_point( m_image.origin().advance(x-ci,y-cj,p),
+                                 m_kernel.origin(), m_kernel.cols(), m_kernel.rows() ) );
       }
       else {
-        return (result_type) correlate_2d_at_point( edge_extend(m_image,m_edge).origin().advance(x-ci,y-cj,p),
-                                                    m_kernel.origin(), m_kernel.cols(), m_kernel.rows() );
+        return channel_cast_clamp_if_int<channel_type>(
+          correlate_2d_at_point( edge_extend(m_image,m_edge).origin().advance(x-ci,y-cj,p),
+                                 m_kernel.origin(), m_kernel.cols(), m_kernel.rows() ) );
       }
     }
 
@@ -151,8 +155,45 @@ namespace vw {
     }
 
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i bbox ) const {
+      rasterize_impl( dest, bbox, boolean_type<detail::UseConvolutionSIMD<pixel_type,typename KernelT::pixel_type>::value>() );
+    }
+
+    /// \cond INTERNAL
+  private:
+    template <bool B> struct boolean_type {};
+
+    template <class DestT> inline void rasterize_impl( DestT const& dest, BBox2i bbox, boolean_type<false> ) const {
       vw::rasterize( prerasterize(bbox), dest, bbox );
     }
+
+#if VW_CONVOLUTION_SIMD
+    // Correlates whole rows of the edge-extended source at a time with
+    // the vectorized kernels in ConvolutionSIMD.h.
+    template <class DestT> void rasterize_impl( DestT const& dest, BBox2i bbox, boolean_type<true> ) const {
+      typedef typename detail::ConvolutionSIMDPixel<pixel_type>::channel_type channel_type;
+      const int32 nc = detail::ConvolutionSIMDPixel<pixel_type>::num_channels;
+      int32 ci = (m_kernel.cols()-1-m_ci), cj = (m_kernel.rows()-1-m_cj);
+      BBox2i src_bbox( bbox.min().x() - ci, bbox.min().y() - cj,
+                       bbox.width() + (m_kernel.cols()-1), bbox.height() + (m_kernel.rows()-1) );
+      ImageView<pixel_type> src = edge_extend( m_image, src_bbox, m_edge );
+      ImageView<pixel_type> result( bbox.width(), bbox.height(), src.planes() );
+
+      std::vector<ssize_t> offsets;
+      std::vector<float> weights;
+      for( int32 j=0; j<m_kernel.rows(); ++j )
+        for( int32 i=0; i<m_kernel.cols(); ++i ) {
+          offsets.push_back( (ssize_t(j)*src.cols() + i) * nc );
+          weights.push_back( m_kernel(i,j) );
+        }
+
+      for( int32 p=0; p<result.planes(); ++p )
+        for( int32 y=0; y<result.rows(); ++y )
+          detail::correlate_span( (channel_type const*)&src(0,y,p), &offsets[0], &weights[0], weights.size(),
+                                  (channel_type*)&result(0,y,p), size_t(result.cols())*nc );
+      result.rasterize( dest, BBox2i(0,0,bbox.width(),bbox.height()) );
+    }
+#endif
+    /// \endcond
   };
 
 
@@ -260,6 +301,15 @@ namespace vw {
       if( ni==0 && nj==0 ) {
         return edge_extend(m_image,m_edge).rasterize(dest,bbox);
       }
+      rasterize_impl( dest, bbox, boolean_type<detail::UseConvolutionSIMD<pixel_type,KernelT>::value>() );
+    }
+
+  private:
+    template <bool B> struct boolean_type {};
+
+    template <class DestT>
+    void rasterize_impl( DestT const& dest, BBox2i bbox, boolean_type<false> ) const {
+      size_t ni = m_i_kernel.size(), nj = m_j_kernel.size();
       BBox2i child_bbox = bbox;
       child_bbox.min() -= Vector2i( int32(ni?(ni-m_ci-1):0), int32(nj?(nj-m_cj-1):0) );
       child_bbox.max() += Vector2i( int32(ni?m_ci:0), int32(nj?m_cj:0) );
@@ -278,6 +328,53 @@ namespace vw {
       }
     }
 
+#if VW_CONVOLUTION_SIMD
+    // The same two passes as above, but a whole row at a time using
+    // the vectorized kernels in ConvolutionSIMD.h.  The vertical pass
+    // correlates each output row with the rows above and below it
+    // rather than walking down columns, so every load is contiguous.
+    template <class DestT>
+    void rasterize_impl( DestT const& dest, BBox2i bbox, boolean_type<true> ) const {
+      size_t ni = m_i_kernel.size(), nj = m_j_kernel.size();
+      BBox2i child_bbox = bbox;
+      child_bbox.min() -= Vector2i( int32(ni?(ni-m_ci-1):0), int32(nj?(nj-m_cj-1):0) );
+      child_bbox.max() += Vector2i( int32(ni?m_ci:0), int32(nj?m_cj:0) );
+      ImageView<pixel_type> src_buf = edge_extend(m_image,child_bbox,m_edge);
+      ImageView<pixel_type> result( bbox.width(), bbox.height(), planes() );
+      if( ni>0 && nj>0 ) {
+        ImageView<pixel_type> work( bbox.width(), child_bbox.height(), planes() );
+        correlate_rows( src_buf, work, m_i_kernel, 1 );
+        src_buf.reset(); // Free up some memory
+        correlate_rows( work, result, m_j_kernel, work.cols() );
+      }
+      else if( ni>0 ) {
+        correlate_rows( src_buf, result, m_i_kernel, 1 );
+      }
+      else /* nj>0 */ {
+        correlate_rows( src_buf, result, m_j_kernel, src_buf.cols() );
+      }
+      result.rasterize( dest, BBox2i(0,0,bbox.width(),bbox.height()) );
+    }
+
+    // Correlates each row of dest with the kernel, whose taps are
+    // step pixels apart in src.
+    void correlate_rows( ImageView<pixel_type> const& src, ImageView<pixel_type> const& dest,
+                         std::vector<KernelT> const& kernel, ssize_t step ) const {
+      typedef typename detail::ConvolutionSIMDPixel<pixel_type>::channel_type channel_type;
+      const int32 nc = detail::ConvolutionSIMDPixel<pixel_type>::num_channels;
+      std::vector<ssize_t> offsets( kernel.size() );
+      std::vector<float> weights( kernel.rbegin(), kernel.rend() );
+      for( size_t k=0; k<kernel.size(); ++k )
+        offsets[k] = ssize_t(k) * step * nc;
+      for( int32 p=0; p<dest.planes(); ++p )
+        for( int32 y=0; y<dest.rows(); ++y )
+          detail::correlate_span( (channel_type const*)&src(0,y,p), &offsets[0], &weights[0], weights.size(),
+                                  (channel_type*)&dest(0,y,p), size_t(dest.cols())*nc );
+    }
+#endif
+
+  public:
+
     template <class SrcT, class DestT>
     void convolve_1d( SrcT const& src, DestT const& dest, std::vector<KernelT> const& kernel ) const {
       typedef typename SrcT::pixel_accessor SrcAccessT;
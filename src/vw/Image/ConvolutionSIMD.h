@@ -0,0 +1,199 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file ConvolutionSIMD.h
+///
+/// Vectorized correlation kernels used by the convolution views in
+/// \ref Convolution.h when the source is a contiguous image of float,
+/// uint8, or uint16 channels and the kernel is float.  The instruction
+/// set is chosen at compile time: AVX2 if the compiler is targeting
+/// it, otherwise SSE2.  If neither is available VW_CONVOLUTION_SIMD is
+/// defined to 0 and the views use their generic code paths.
+///
+#ifndef __VW_IMAGE_CONVOLUTIONSIMD_H__
+#define __VW_IMAGE_CONVOLUTIONSIMD_H__
+
+#include <cstring>
+
+#include <boost/integer_traits.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Image/PixelTypes.h>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define VW_CONVOLUTION_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VW_CONVOLUTION_SIMD 1
+#else
+# define VW_CONVOLUTION_SIMD 0
+#endif
+
+namespace vw {
+
+  /// \cond INTERNAL
+  namespace detail {
+
+    /// Describes how the vectorized convolution kernels see a pixel
+    /// type: as num_channels interleaved channels of channel_type.
+    /// Pixel types that the kernels cannot handle have
+    /// num_channels == 0.
+    template <class PixelT>
+    struct ConvolutionSIMDPixel {
+      typedef PixelT channel_type;
+      static const int num_channels = 0;
+    };
+
+#if VW_CONVOLUTION_SIMD
+#define VW_CONVOLUTION_SIMD_PIXEL(PixelT, ChannelT, N)      \
+    template <> struct ConvolutionSIMDPixel<PixelT > {      \
+      typedef ChannelT channel_type;                        \
+      static const int num_channels = N;                    \
+    };
+#define VW_CONVOLUTION_SIMD_CHANNEL(ChannelT)                            \
+    VW_CONVOLUTION_SIMD_PIXEL(ChannelT, ChannelT, 1)                     \
+    VW_CONVOLUTION_SIMD_PIXEL(PixelGray<ChannelT>, ChannelT, 1)          \
+    VW_CONVOLUTION_SIMD_PIXEL(PixelGrayA<ChannelT>, ChannelT, 2)         \
+    VW_CONVOLUTION_SIMD_PIXEL(PixelRGB<ChannelT>, ChannelT, 3)           \
+    VW_CONVOLUTION_SIMD_PIXEL(PixelRGBA<ChannelT>, ChannelT, 4)
+
+    VW_CONVOLUTION_SIMD_CHANNEL(float)
+    VW_CONVOLUTION_SIMD_CHANNEL(uint8)
+    VW_CONVOLUTION_SIMD_CHANNEL(uint16)
+
+#undef VW_CONVOLUTION_SIMD_CHANNEL
+#undef VW_CONVOLUTION_SIMD_PIXEL
+#endif
+
+    /// True if the vectorized kernels can convolve images of PixelT
+    /// with kernels of KernelT.
+    template <class PixelT, class KernelT>
+    struct UseConvolutionSIMD {
+      static const bool value = boost::is_same<KernelT, float>::value
+                             && ConvolutionSIMDPixel<PixelT>::num_channels > 0;
+    };
+
+    // Converts an accumulated value to the output channel type the
+    // same way channel_cast_clamp_if_int() does.
+    inline float convolution_store( float value, float* ) { return value; }
+    template <class ChannelT>
+    inline ChannelT convolution_store( float value, ChannelT* ) {
+      if( value > boost::integer_traits<ChannelT>::const_max ) return boost::integer_traits<ChannelT>::const_max;
+      if( value < boost::integer_traits<ChannelT>::const_min ) return boost::integer_traits<ChannelT>::const_min;
+      return ChannelT( value );
+    }
+
+#if VW_CONVOLUTION_SIMD == 2
+
+    // AVX2: eight channels at a time.
+    static const int convolution_simd_width = 8;
+    typedef __m256 convolution_simd_type;
+
+    inline __m256 convolution_simd_load( float const* p ) { return _mm256_loadu_ps( p ); }
+    inline __m256 convolution_simd_load( uint8 const* p ) {
+      return _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_loadl_epi64( (__m128i const*)p ) ) );
+    }
+    inline __m256 convolution_simd_load( uint16 const* p ) {
+      return _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( _mm_loadu_si128( (__m128i const*)p ) ) );
+    }
+
+    inline void convolution_simd_store( __m256 v, float* p ) { _mm256_storeu_ps( p, v ); }
+    inline void convolution_simd_store( __m256 v, uint8* p ) {
+      __m256i i = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps( 255.0f ) ) );
+      __m128i s = _mm_packs_epi32( _mm256_castsi256_si128( i ), _mm256_extracti128_si256( i, 1 ) );
+      _mm_storel_epi64( (__m128i*)p, _mm_packus_epi16( s, s ) );
+    }
+    inline void convolution_simd_store( __m256 v, uint16* p ) {
+      __m256i i = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps( 65535.0f ) ) );
+      _mm_storeu_si128( (__m128i*)p, _mm_packus_epi32( _mm256_castsi256_si128( i ), _mm256_extracti128_si256( i, 1 ) ) );
+    }
+
+    inline __m256 convolution_simd_zero() { return _mm256_setzero_ps(); }
+    inline __m256 convolution_simd_splat( float f ) { return _mm256_set1_ps( f ); }
+    // Multiply and add separately, rather than with an FMA, so that
+    // the results round exactly like the generic code path.
+    inline __m256 convolution_simd_madd( __m256 acc, __m256 w, __m256 x ) { return _mm256_add_ps( acc, _mm256_mul_ps( w, x ) ); }
+
+#elif VW_CONVOLUTION_SIMD == 1
+
+    // SSE2: four channels at a time.
+    static const int convolution_simd_width = 4;
+    typedef __m128 convolution_simd_type;
+
+    inline __m128 convolution_simd_load( float const* p ) { return _mm_loadu_ps( p ); }
+    inline __m128 convolution_simd_load( uint8 const* p ) {
+      int32 bytes;
+      std::memcpy( &bytes, p, sizeof(bytes) );
+      __m128i zero = _mm_setzero_si128();
+      __m128i i = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zero ), zero );
+      return _mm_cvtepi32_ps( i );
+    }
+    inline __m128 convolution_simd_load( uint16 const* p ) {
+      __m128i i = _mm_unpacklo_epi16( _mm_loadl_epi64( (__m128i const*)p ), _mm_setzero_si128() );
+      return _mm_cvtepi32_ps( i );
+    }
+
+    inline void convolution_simd_store( __m128 v, float* p ) { _mm_storeu_ps( p, v ); }
+    inline void convolution_simd_store( __m128 v, uint8* p ) {
+      __m128i i = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 255.0f ) ) );
+      __m128i s = _mm_packs_epi32( i, i );
+      int32 bytes = _mm_cvtsi128_si32( _mm_packus_epi16( s, s ) );
+      std::memcpy( p, &bytes, sizeof(bytes) );
+    }
+    inline void convolution_simd_store( __m128 v, uint16* p ) {
+      // SSE2 has no unsigned 32->16 bit pack, so shift into the signed
+      // range, pack with saturation, and shift back.
+      __m128i i = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 65535.0f ) ) );
+      __m128i s = _mm_packs_epi32( _mm_sub_epi32( i, _mm_set1_epi32( 32768 ) ), _mm_setzero_si128() );
+      _mm_storel_epi64( (__m128i*)p, _mm_add_epi16( s, _mm_set1_epi16( -32768 ) ) );
+    }
+
+    inline __m128 convolution_simd_zero() { return _mm_setzero_ps(); }
+    inline __m128 convolution_simd_splat( float f ) { return _mm_set1_ps( f ); }
+    inline __m128 convolution_simd_madd( __m128 acc, __m128 w, __m128 x ) { return _mm_add_ps( acc, _mm_mul_ps( w, x ) ); }
+
+#endif
+
+#if VW_CONVOLUTION_SIMD
+
+    /// Correlates a span of n channels with a set of taps:
+    ///
+    ///   dst[i] = sum over k of weights[k] * src[i + offsets[k]]
+    ///
+    /// with the sum accumulated in float, in tap order, starting from
+    /// zero, exactly as correlate_1d_at_point() and
+    /// correlate_2d_at_point() do.  Offsets are in channels.
+    template <class ChannelT>
+    void correlate_span( ChannelT const* src, ssize_t const* offsets, float const* weights, size_t ntaps,
+                         ChannelT* dst, size_t n ) {
+      const size_t width = convolution_simd_width;
+      size_t i = 0;
+      for( ; i + width <= n; i += width ) {
+        convolution_simd_type acc = convolution_simd_zero();
+        for( size_t k = 0; k < ntaps; ++k )
+          acc = convolution_simd_madd( acc, convolution_simd_splat( weights[k] ),
+                                       convolution_simd_load( src + i + offsets[k] ) );
+        convolution_simd_store( acc, dst + i );
+      }
+      for( ; i < n; ++i ) {
+        float acc = 0;
+        for( size_t k = 0; k < ntaps; ++k )
+          acc += weights[k] * float( src[i + offsets[k]] );
+        dst[i] = convolution_store( acc, dst );
+      }
+    }
+
+#endif
+
+  } // namespace detail
+  /// \endcond
+
+} // namespace vw
+
+#endif // __VW_IMAGE_CONVOLUTIONSIMD_H__
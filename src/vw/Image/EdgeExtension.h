@@ -362,6 +362,7 @@ namespace vw {
 
     ImageT const& child() const { return m_image; }
     ExtensionT const& func() const { return m_extension_func; }
+    Vector2i offset() const { return Vector2i( m_xoffset, m_yoffset ); }
     BBox2i source_bbox( BBox2i const& bbox ) const {
       return m_extension_func.source_bbox( m_image, bbox + Vector2i( m_xoffset, m_yoffset ) );
     }
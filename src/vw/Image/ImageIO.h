@@ -14,10 +14,15 @@
 #define __VW_IMAGE_IMAGEIO_H__
 
 #include <vw/Core/ProgressCallback.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageResource.h>
 #include <vw/Image/ImageView.h>
 
+#include <map>
+
+#include <boost/exception_ptr.hpp>
+
 namespace vw {
 
   // *******************************************************************
@@ -93,7 +98,7 @@ namespace vw {
   // large allocations of memory as rasterized tiles accumulate and
   // sit waiting to be written to disk.
   //
-  // To fix this, we need this semaphore to help us meet the following
+  // To fix this, ThreadedBlockWriter below meets the following
   // condition:
   //
   // We rasterize _at most_ N blocks at a time, and it will never
@@ -102,141 +107,294 @@ namespace vw {
   // Of course, one slow rasterization thread can hold up the entire
   // process, but this is the price we pay for guranteed ordering when
   // writing tiles.
-  class CountingSemaphore {
-    Condition m_block_condition;
-    Mutex m_mutex;
-    int m_max, m_last_job_index;
 
+  /// Per-stage statistics gathered by block_write_image().  Times
+  /// are wall-clock seconds; the rasterize times are summed over all
+  /// of the rasterizing threads.
+  struct BlockWriteStatistics {
+    int32 total_blocks;             ///< Number of blocks in the image
+    int32 blocks_written;           ///< Number of blocks written so far
+    int32 buffers_allocated;        ///< Number of block buffers allocated
+    int32 max_waiting_blocks;       ///< Most blocks ever waiting for the writer
+    double rasterize_seconds;       ///< Time spent rasterizing blocks
+    double rasterize_stall_seconds; ///< Time rasterizers spent waiting for room
+    double write_seconds;           ///< Time spent writing blocks
+    double write_stall_seconds;     ///< Time the writer spent waiting for a block
+
+    BlockWriteStatistics()
+      : total_blocks(0), blocks_written(0), buffers_allocated(0), max_waiting_blocks(0),
+        rasterize_seconds(0), rasterize_stall_seconds(0), write_seconds(0), write_stall_seconds(0) {}
+  };
+
+  /// Receives BlockWriteStatistics from block_write_image().  Both
+  /// methods are called from the thread that called
+  /// block_write_image().
+  class BlockWriteStatisticsCallback {
   public:
-    CountingSemaphore() : m_max( vw_settings().default_num_threads() ),
-                          m_last_job_index(-1) {}
-    CountingSemaphore( int max ) : m_max(max), m_last_job_index(-1) {}
-
-    // Call to wait for a turn until the number of threads in a area
-    // decrements.
-    void wait( int job_index ) {
-      Mutex::Lock lock(m_mutex);
-      while ( job_index > m_last_job_index + m_max ) {
-        m_block_condition.wait(lock);
-      }
-    }
+    virtual ~BlockWriteStatisticsCallback() {}
 
-    // Please call when ever a process finishes it's turn
-    void notify() {
-      {
-        Mutex::Lock lock(m_mutex);
-        m_last_job_index++;
-      }
-      m_block_condition.notify_all();
-    }
+    /// Called after each block is written.
+    virtual void report_block( BlockWriteStatistics const& /*stats*/ ) {}
+
+    /// Called once after the last block is written.
+    virtual void report_finished( BlockWriteStatistics const& /*stats*/ ) {}
   };
 
-  // This task generator manages the rasterizing and writing of images to disk.
+  /// Limits and hooks for block_write_image().
+  struct BlockWriteOptions {
+    /// The number of threads rasterizing blocks.  Zero means the
+    /// default_num_threads setting.
+    int32 rasterize_threads;
+
+    /// The number of rasterized blocks that may wait for the writer
+    /// before the rasterizers stall.  Zero means the write_pool_size
+    /// setting.
+    int32 max_waiting_blocks;
+
+    /// Write blocks in whatever order they finish rasterizing, if the
+    /// resource supports it.
+    bool unordered_writes;
+
+    /// If non-null, receives per-stage statistics as blocks are written.
+    BlockWriteStatisticsCallback* statistics;
+
+    BlockWriteOptions()
+      : rasterize_threads(0), max_waiting_blocks(0), unordered_writes(true), statistics(0) {}
+  };
+
+  // This class manages the rasterizing and writing of an image to a
+  // resource, one block at a time.
+  //
+  // Several threads rasterize blocks while the thread that calls
+  // write() writes them to the resource.  No more than
+  // rasterize_threads + max_waiting_blocks blocks are held between
+  // the two stages at any time; a rasterizing thread that would
+  // exceed that waits for the writer to catch up.  The block buffers
+  // are kept in a pool and reused, so the memory used is bounded by
+  // that limit regardless of the size of the image.
   //
-  // Only one thread can be writing to the ImageResource at any given
-  // time, however several threads can be rasterizing simultaneously.
+  // Blocks are written in row-major order unless the resource
+  // reports has_unordered_block_write(), in which case each block is
+  // written as soon as it is ready.
   //
+  template <class ViewT>
   class ThreadedBlockWriter : private boost::noncopyable {
+    typedef ImageView<typename ViewT::pixel_type> buffer_type;
 
-    boost::shared_ptr<FifoWorkQueue> m_rasterize_work_queue;
-    boost::shared_ptr<OrderedWorkQueue> m_write_work_queue;
-    CountingSemaphore m_write_queue_limit;
-
-    // ----------------------------- TASK TYPES (2) --------------------------
-
-    template <class PixelT>
-    class WriteBlockTask : public Task {
-      DstImageResource& m_resource;
-      ImageView<PixelT> m_image_block;
-      BBox2i m_bbox;
-      int m_idx;
-      CountingSemaphore& m_write_finish_event;
+    struct Block {
+      BBox2i bbox;
+      boost::shared_ptr<buffer_type> buffer;
+    };
 
+    class RasterizeBlockTask : public Task {
+      ThreadedBlockWriter& m_writer;
+      int32 m_index;
     public:
-      WriteBlockTask(DstImageResource& resource, ImageView<PixelT> const& image_block,
-                     BBox2i bbox, int idx, CountingSemaphore& write_finish_event) :
-      m_resource(resource), m_image_block(image_block), m_bbox(bbox), m_idx(idx), m_write_finish_event(write_finish_event) {}
-
-      virtual ~WriteBlockTask() {}
-      virtual void operator() () {
-        vw_out(DebugMessage, "image") << "Writing block " << m_idx << " at " << m_bbox << "\n";
-        m_resource.write( m_image_block.buffer(), m_bbox );
-        m_write_finish_event.notify();
-      }
+      RasterizeBlockTask( ThreadedBlockWriter& writer, int32 index ) : m_writer(writer), m_index(index) {}
+      virtual void operator()() { m_writer.rasterize_block( m_index ); }
     };
 
-    // -----------------------------
+    DstImageResource& m_resource;
+    ViewT const& m_image;
+    Vector2i m_block_size;
+    int32 m_col_blocks, m_num_blocks;
+    bool m_ordered;
+    int32 m_max_in_flight;
 
-    template <class ViewT>
-    class RasterizeBlockTask : public Task {
-      ThreadedBlockWriter &m_parent;
-      DstImageResource& m_resource;
-      ViewT const& m_image;
-      BBox2i m_bbox;
-      int m_index;
-      int m_total_num_blocks;
-      SubProgressCallback m_progress_callback;
-      CountingSemaphore& m_write_finish_event;
+    Mutex m_mutex;
+    Condition m_ready_event, m_space_event;
+    std::vector<boost::shared_ptr<buffer_type> > m_free_buffers;
+    std::map<int32, Block> m_ready;
+    int32 m_next_write, m_in_flight;
+    bool m_failed;
+    boost::exception_ptr m_error;
+    BlockWriteStatistics m_stats;
+    boost::shared_ptr<WorkStealingQueue> m_queue;
+
+    BBox2i block_bbox( int32 index ) const {
+      Vector2i pos( (index % m_col_blocks) * m_block_size.x(), (index / m_col_blocks) * m_block_size.y() );
+      return BBox2i( pos, Vector2i( std::min<int32>( pos.x() + m_block_size.x(), m_image.cols() ),
+                                    std::min<int32>( pos.y() + m_block_size.y(), m_image.rows() ) ) );
+    }
 
-    public:
-      RasterizeBlockTask(ThreadedBlockWriter &parent, DstImageResource& resource,
-                         ImageViewBase<ViewT> const& image, BBox2i const& bbox,
-                         int index, int total_num_blocks,
-                         CountingSemaphore& write_finish_event,
-                         const ProgressCallback &progress_callback = ProgressCallback::dummy_instance()) :
-      m_parent(parent), m_resource(resource), m_image(image.impl()), m_bbox(bbox), m_index(index),
-        m_progress_callback(progress_callback,0.0,1.0/float(total_num_blocks)), m_write_finish_event(write_finish_event) {}
+    // Must be called with m_mutex held.  When writing in order, a
+    // block may only start once it is close enough to the next block
+    // to be written; that block itself is always admitted, so the
+    // writer can never be starved.
+    bool admissible( int32 index ) const {
+      if( m_ordered ) return index < m_next_write + m_max_in_flight;
+      return m_in_flight < m_max_in_flight;
+    }
 
-      virtual ~RasterizeBlockTask() {}
-      virtual void operator()() {
+    // Must be called with m_mutex held.
+    bool block_ready() const {
+      if( m_ordered ) return m_ready.find( m_next_write ) != m_ready.end();
+      return ! m_ready.empty();
+    }
 
-        m_write_finish_event.wait(m_index);
+    void cancel() {
+      {
+        Mutex::Lock lock(m_mutex);
+        m_failed = true;
+      }
+      m_ready_event.notify_all();
+      m_space_event.notify_all();
+    }
 
-        vw_out(DebugMessage, "image") << "Rasterizing block " << m_index << " at " << m_bbox << "\n";
-        // Rasterize the block
-        ImageView<typename ViewT::pixel_type> image_block( crop(m_image, m_bbox) );
+    // Must be called from a catch block.  Records the exception that
+    // the first block to fail threw, and stops the others.
+    void fail_block() {
+      {
+        Mutex::Lock lock(m_mutex);
+        if( ! m_error )
+          m_error = boost::current_exception();
+      }
+      cancel();
+    }
 
-        // Report progress
-        m_progress_callback.report_incremental_progress(1.0);
+    void rasterize_block( int32 index ) {
+      Block block;
+      block.bbox = block_bbox( index );
+      uint64 start = Stopwatch::microtime();
+      {
+        Mutex::Lock lock(m_mutex);
+        while( ! m_failed && ! admissible( index ) )
+          m_space_event.wait(lock);
+        if( m_failed ) return;
+        ++m_in_flight;
+        if( ! m_free_buffers.empty() ) {
+          block.buffer = m_free_buffers.back();
+          m_free_buffers.pop_back();
+        }
+        else ++m_stats.buffers_allocated;
+      }
+      if( ! block.buffer )
+        block.buffer.reset( new buffer_type( m_block_size.x(), m_block_size.y(), m_image.planes() ) );
 
-        // With rasterization complete, we queue up a request to write this block to disk.
-        boost::shared_ptr<Task> write_task ( new WriteBlockTask<typename ViewT::pixel_type>( m_resource, image_block, m_bbox, m_index, m_write_finish_event ) );
+      uint64 rasterize_start = Stopwatch::microtime();
+      vw_out(DebugMessage, "image") << "Rasterizing block " << index << " at " << block.bbox << "\n";
+      try {
+        m_image.rasterize( crop( *block.buffer, 0, 0, block.bbox.width(), block.bbox.height() ), block.bbox );
+      }
+      catch( ... ) {
+        fail_block();
+        return;
+      }
+      uint64 end = Stopwatch::microtime();
 
-        m_parent.add_write_task(write_task, m_index);
+      {
+        Mutex::Lock lock(m_mutex);
+        m_ready[index] = block;
+        m_stats.max_waiting_blocks = std::max<int32>( m_stats.max_waiting_blocks, int32(m_ready.size()) );
+        m_stats.rasterize_stall_seconds += (rasterize_start - start) / 1e6;
+        m_stats.rasterize_seconds += (end - rasterize_start) / 1e6;
       }
-    };
+      m_ready_event.notify_all();
+    }
 
-    // -----------------------------
+    void write_blocks( ProgressCallback const& progress_callback, BlockWriteStatisticsCallback* statistics ) {
+      for( int32 written = 0; written < m_num_blocks; ++written ) {
+        Block block;
+        uint64 start = Stopwatch::microtime();
+        {
+          Mutex::Lock lock(m_mutex);
+          while( ! m_failed && ! block_ready() )
+            m_ready_event.wait(lock);
+          if( m_failed ) return;
+          typename std::map<int32, Block>::iterator it = m_ordered ? m_ready.find( m_next_write ) : m_ready.begin();
+          block = it->second;
+          m_ready.erase( it );
+        }
+
+        uint64 write_start = Stopwatch::microtime();
+        vw_out(DebugMessage, "image") << "Writing block at " << block.bbox << "\n";
+        // The pooled buffers are all full-sized, so trim the view of
+        // the buffer down to the size of this (possibly edge) block.
+        ImageBuffer buffer = block.buffer->buffer();
+        buffer.format.cols = block.bbox.width();
+        buffer.format.rows = block.bbox.height();
+        m_resource.write( buffer, block.bbox );
+        uint64 end = Stopwatch::microtime();
+
+        BlockWriteStatistics stats;
+        {
+          Mutex::Lock lock(m_mutex);
+          m_free_buffers.push_back( block.buffer );
+          --m_in_flight;
+          ++m_next_write;
+          ++m_stats.blocks_written;
+          m_stats.write_stall_seconds += (write_start - start) / 1e6;
+          m_stats.write_seconds += (end - write_start) / 1e6;
+          stats = m_stats;
+        }
+        m_space_event.notify_all();
 
-    void add_write_task(boost::shared_ptr<Task> task, int index) { m_write_work_queue->add_task(task, index); }
-    void add_rasterize_task(boost::shared_ptr<Task> task) { m_rasterize_work_queue->add_task(task); }
+        progress_callback.report_progress( float(written+1) / float(m_num_blocks) );
+        if( statistics ) statistics->report_block( stats );
+        if( progress_callback.abort_requested() )
+          vw_throw( Aborted() << "Aborted by ProgressCallback" );
+      }
+    }
 
   public:
-    ThreadedBlockWriter() : m_write_queue_limit(vw_settings().write_pool_size()) {
-      m_rasterize_work_queue = boost::shared_ptr<FifoWorkQueue>( new FifoWorkQueue() );
-      m_write_work_queue = boost::shared_ptr<OrderedWorkQueue>( new OrderedWorkQueue(1) );
+    ThreadedBlockWriter( DstImageResource& resource, ImageViewBase<ViewT> const& image,
+                         Vector2i const& block_size, BlockWriteOptions const& options )
+      : m_resource(resource), m_image(image.impl()), m_block_size(block_size),
+        m_col_blocks( (image.impl().cols()-1)/block_size.x()+1 ),
+        m_num_blocks( m_col_blocks * ((image.impl().rows()-1)/block_size.y()+1) ),
+        m_ordered( ! (options.unordered_writes && resource.has_unordered_block_write()) ),
+        m_next_write(0), m_in_flight(0), m_failed(false)
+    {
+      if( options.rasterize_threads > 0 )
+        m_queue.reset( new WorkStealingQueue( options.rasterize_threads ) );
+      else
+        m_queue.reset( new WorkStealingQueue() );
+      int32 max_waiting = options.max_waiting_blocks;
+      if( max_waiting <= 0 ) max_waiting = vw_settings().write_pool_size();
+      m_max_in_flight = int32(m_queue->max_threads()) + std::max<int32>( max_waiting, 1 );
+      m_stats.total_blocks = m_num_blocks;
     }
 
-    // Add a block to be rasterized.  You can optionally supply an
-    // index, which will indicate the order in which this block should
-    // be written to disk.
-    template <class ViewT>
-    void add_block(DstImageResource& resource, ImageViewBase<ViewT> const& image, BBox2i const& bbox, int index, int total_num_blocks,
-                   const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
-      boost::shared_ptr<Task> task( new RasterizeBlockTask<ViewT>(*this, resource, image, bbox, index, total_num_blocks, m_write_queue_limit, progress_callback) );
-      this->add_rasterize_task(task);
+    ~ThreadedBlockWriter() {
+      cancel();
+      m_queue->join_all();
     }
 
-    void process_blocks() {
-      m_rasterize_work_queue->join_all();
-      m_write_work_queue->join_all();
+    int32 num_blocks() const { return m_num_blocks; }
+
+    // Rasterize and write every block, returning once the last block
+    // has been written.  If rasterizing or writing any block throws,
+    // the remaining blocks are abandoned and the error is rethrown
+    // with its original type.
+    void write( ProgressCallback const& progress_callback = ProgressCallback::dummy_instance(),
+                BlockWriteStatisticsCallback* statistics = 0 ) {
+      for( int32 i = 0; i < m_num_blocks; ++i )
+        m_queue->add_task( boost::shared_ptr<Task>( new RasterizeBlockTask( *this, i ) ) );
+
+      try {
+        write_blocks( progress_callback, statistics );
+      }
+      catch( ... ) {
+        cancel();
+        m_queue->join_all();
+        throw;
+      }
+      m_queue->join_all();
+
+      if( m_error )
+        boost::rethrow_exception( m_error );
+      if( statistics ) statistics->report_finished( m_stats );
     }
   };
 
 
+  /// Rasterizes the image a block at a time, using several threads,
+  /// and writes the blocks to the resource.  See ThreadedBlockWriter
+  /// and BlockWriteOptions for how the work is bounded.
   template <class ImageT>
   void block_write_image( DstImageResource& resource, ImageViewBase<ImageT> const& image,
-                          const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
+                          const ProgressCallback &progress_callback = ProgressCallback::dummy_instance(),
+                          BlockWriteOptions const& options = BlockWriteOptions() ) {
 
     VW_ASSERT( image.impl().cols() != 0 && image.impl().rows() != 0 && image.impl().planes() != 0,
                ArgumentErr() << "write_image: cannot write an empty image to a resource" );
@@ -249,9 +407,6 @@ namespace vw {
     const int32 rows = boost::numeric_cast<int32>(image.impl().rows());
     const int32 cols = boost::numeric_cast<int32>(image.impl().cols());
 
-    // Write the image to disk in blocks.  We may need to revisit
-    // the order in which these blocks are rasterized, but for now
-    // it rasterizes blocks from left to right, then top to bottom.
     Vector2i block_size(cols, rows);
     if (resource.has_block_write())
       block_size = resource.block_write_size();
@@ -263,32 +418,14 @@ namespace vw {
     if (total_num_blocks == 1) {
       ImageView<typename ImageT::pixel_type> image_block = image.impl();
       resource.write( image_block.buffer(), BBox2i(0,0,image_block.cols(),image_block.rows()) );
-    } else {
-      // Set up the threaded block writer object, which will manage rasterizing
-      // and writing images to disk one block (and one thread) at a time.
-      ThreadedBlockWriter block_writer;
-
-      for (int32 j = 0; j < rows; j+= block_size.y()) {
-        for (int32 i = 0; i < cols; i+= block_size.x()) {
-          vw_out(DebugMessage, "image") << "ImageIO scheduling block at [" << i << " " << j << "]/[" << rows << " " << cols << "] blocksize = " << block_size.x() << " x " <<  block_size.y() << "\n";
-
-          // Rasterize and save this image block
-          BBox2i current_bbox(Vector2i(i,j),
-                              Vector2i(std::min<int32>(i+block_size.x(),cols),
-                                       std::min<int32>(j+block_size.y(),rows)));
-
-          // Rasterize this image block by scheduling it with the block_writer.
-          int col_blocks = int( ceil(float(cols)/float(block_size.x())) );
-          int i_block_index = int(i/block_size.x());
-          int j_block_index = int(j/block_size.y());
-          int index = j_block_index*col_blocks+i_block_index;
-
-          block_writer.add_block(resource, image, current_bbox, index, total_num_blocks, progress_callback );
-        }
+      if (options.statistics) {
+        BlockWriteStatistics stats;
+        stats.total_blocks = stats.blocks_written = 1;
+        options.statistics->report_finished( stats );
       }
-
-      // Start the threaded block writer and wait for all tasks to finish.
-      block_writer.process_blocks();
+    } else {
+      ThreadedBlockWriter<ImageT> block_writer( resource, image, block_size, options );
+      block_writer.write( progress_callback, options.statistics );
     }
     progress_callback.report_finished();
   }
@@ -16,9 +16,13 @@
 #include <vector>
 #endif
 
-#include <map>
+#include <cstring>
 
 #include <boost/integer_traits.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_same.hpp>
 
 #include <vw/Core/Debugging.h>
 #include <vw/Image/PixelTypes.h>
@@ -28,318 +32,461 @@
 
 using namespace vw;
 
-typedef void (*channel_convert_func)(void* src, void* dest);
+// convert() works a row at a time.  Each source row is unpremultiplied
+// or premultiplied if needed, converted into the destination channel
+// type, rearranged into the destination pixel format, and finally
+// premultiplied if needed.  Each of those steps is a kernel that
+// processes a whole row, and the kernels are chosen once per call to
+// convert().  The common uint8/uint16/float32 kernels are vectorized
+// with SSE2 when it is available.
+
+#if defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VW_CONVERT_SIMD 1
+#else
+# define VW_CONVERT_SIMD 0
+#endif
+
+namespace {
+
+// Channel Convert:
+//   Converts a span of n channels to another channel type
+typedef void (*channel_convert_func)(void const* src, void* dst, size_t n);
+
+// Converts a single channel value, optionally rescaling it from the
+// range of the source type to the range of the destination type.
+template <class SrcT, class DstT,
+          bool SrcIntT = boost::is_integral<SrcT>::value,
+          bool DstIntT = boost::is_integral<DstT>::value>
+struct ChannelRescale {
+  static inline DstT apply( SrcT src ) { return DstT(src); }
+};
+
+template <class SrcT, class DstT>
+struct ChannelRescale<SrcT,DstT,true,false> {
+  static inline DstT apply( SrcT src ) {
+    return DstT(src) * (DstT(1.0)/boost::integer_traits<SrcT>::const_max);
+  }
+};
+
+template <class SrcT, class DstT>
+struct ChannelRescale<SrcT,DstT,false,true> {
+  static inline DstT apply( SrcT src ) {
+    if( src > SrcT(1.0) ) return boost::integer_traits<DstT>::const_max;
+    else if( src < SrcT(0.0) ) return DstT(0);
+    else return DstT( src * boost::integer_traits<DstT>::const_max );
+  }
+};
+
+template <>
+struct ChannelRescale<uint16,uint8,true,true> {
+  static inline uint8 apply( uint16 src ) { return uint8( src / (65535/255) ); }
+};
 
-template <class SrcT, class DestT>
-void channel_convert_cast( SrcT* src, DestT* dest ) {
-  *dest = DestT(*src);
+template <>
+struct ChannelRescale<uint8,uint16,true,true> {
+  static inline uint16 apply( uint8 src ) { return uint16( src ) * (65535/255); }
+};
+
+// Vectorized conversions.  Each converts a prefix of the span and
+// returns its length; the rest is converted one channel at a time.
+template <class SrcT, class DstT>
+inline size_t channel_convert_simd( SrcT const* /*src*/, DstT* /*dst*/, size_t /*n*/, bool /*rescale*/ ) {
+  return 0;
 }
 
-void channel_convert_uint16_to_uint8( uint16* src, uint8* dest ) {
-  *dest = uint8( *src / (65535/255) );
+#if VW_CONVERT_SIMD
+
+// Packs the low 8 bits of sixteen int32s, as a cast would.
+inline __m128i convert_simd_pack8( __m128i a, __m128i b, __m128i c, __m128i d ) {
+  const __m128i mask = _mm_set1_epi32( 0xff );
+  return _mm_packus_epi16( _mm_packs_epi32( _mm_and_si128( a, mask ), _mm_and_si128( b, mask ) ),
+                           _mm_packs_epi32( _mm_and_si128( c, mask ), _mm_and_si128( d, mask ) ) );
 }
 
-void channel_convert_uint8_to_uint16( uint8* src, uint16* dest ) {
-  *dest = uint16( *src ) * (65535/255);
+// Packs the low 16 bits of eight int32s, as a cast would.
+inline __m128i convert_simd_pack16( __m128i a, __m128i b ) {
+  return _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 ),
+                          _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 ) );
 }
 
-template <class SrcT, class DestT>
-void channel_convert_int_to_float( SrcT* src, DestT* dest ) {
-  *dest = DestT(*src) * (DestT(1.0)/boost::integer_traits<SrcT>::const_max);
+// Truncates four floats to int32, first clamping them to [0,1] and
+// scaling them by max if rescaling.
+inline __m128i convert_simd_float_to_int( __m128 v, bool rescale, __m128 max ) {
+  if( rescale )
+    v = _mm_mul_ps( _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) ), max );
+  return _mm_cvttps_epi32( v );
 }
 
-template <class SrcT, class DestT>
-void channel_convert_float_to_int( SrcT* src, DestT* dest ) {
-  if( *src > SrcT(1.0) ) *dest = boost::integer_traits<DestT>::const_max;
-  else if( *src < SrcT(0.0) ) *dest = DestT(0);
-  else *dest = DestT( *src * boost::integer_traits<DestT>::const_max );
+inline size_t channel_convert_simd( uint8 const* src, float* dst, size_t n, bool rescale ) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps( rescale ? float(1.0)/boost::integer_traits<uint8>::const_max : 1.0f );
+  size_t i = 0;
+  for( ; i+16 <= n; i += 16 ) {
+    __m128i v = _mm_loadu_si128( (__m128i const*)(src+i) );
+    __m128i lo = _mm_unpacklo_epi8( v, zero ), hi = _mm_unpackhi_epi8( v, zero );
+    _mm_storeu_ps( dst+i,    _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( lo, zero ) ), scale ) );
+    _mm_storeu_ps( dst+i+4,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( lo, zero ) ), scale ) );
+    _mm_storeu_ps( dst+i+8,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( hi, zero ) ), scale ) );
+    _mm_storeu_ps( dst+i+12, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( hi, zero ) ), scale ) );
+  }
+  return i;
 }
 
-std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func> *channel_convert_map = 0, *channel_convert_rescale_map = 0;
+inline size_t channel_convert_simd( uint16 const* src, float* dst, size_t n, bool rescale ) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps( rescale ? float(1.0)/boost::integer_traits<uint16>::const_max : 1.0f );
+  size_t i = 0;
+  for( ; i+8 <= n; i += 8 ) {
+    __m128i v = _mm_loadu_si128( (__m128i const*)(src+i) );
+    _mm_storeu_ps( dst+i,   _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( v, zero ) ), scale ) );
+    _mm_storeu_ps( dst+i+4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( v, zero ) ), scale ) );
+  }
+  return i;
+}
 
-class ChannelConvertMapEntry {
-  void initialize() {
-    if( !channel_convert_map )
-      channel_convert_map = new std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func>();
-    if( !channel_convert_rescale_map )
-      channel_convert_rescale_map = new std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func>();
+inline size_t channel_convert_simd( float const* src, uint8* dst, size_t n, bool rescale ) {
+  const __m128 max = _mm_set1_ps( boost::integer_traits<uint8>::const_max );
+  size_t i = 0;
+  for( ; i+16 <= n; i += 16 ) {
+    __m128i a = convert_simd_float_to_int( _mm_loadu_ps( src+i ),    rescale, max );
+    __m128i b = convert_simd_float_to_int( _mm_loadu_ps( src+i+4 ),  rescale, max );
+    __m128i c = convert_simd_float_to_int( _mm_loadu_ps( src+i+8 ),  rescale, max );
+    __m128i d = convert_simd_float_to_int( _mm_loadu_ps( src+i+12 ), rescale, max );
+    _mm_storeu_si128( (__m128i*)(dst+i), convert_simd_pack8( a, b, c, d ) );
   }
-public:
-  template <class SrcT, class DstT>
-  ChannelConvertMapEntry( void (*func)(SrcT*,DstT*) ) {
-    initialize();
-    ChannelTypeEnum src = ChannelTypeID<SrcT>::value;
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_convert_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
-    channel_convert_rescale_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
+  return i;
+}
+
+inline size_t channel_convert_simd( float const* src, uint16* dst, size_t n, bool rescale ) {
+  const __m128 max = _mm_set1_ps( boost::integer_traits<uint16>::const_max );
+  size_t i = 0;
+  for( ; i+8 <= n; i += 8 ) {
+    __m128i a = convert_simd_float_to_int( _mm_loadu_ps( src+i ),   rescale, max );
+    __m128i b = convert_simd_float_to_int( _mm_loadu_ps( src+i+4 ), rescale, max );
+    _mm_storeu_si128( (__m128i*)(dst+i), convert_simd_pack16( a, b ) );
   }
-  template <class SrcT, class DstT>
-  ChannelConvertMapEntry( void (*func)(SrcT*,DstT*), void (*rescale_func)(SrcT*,DstT*) ) {
-    initialize();
-    ChannelTypeEnum src = ChannelTypeID<SrcT>::value;
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_convert_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
-    channel_convert_rescale_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)rescale_func;
+  return i;
+}
+
+inline size_t channel_convert_simd( uint8 const* src, uint16* dst, size_t n, bool rescale ) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for( ; i+16 <= n; i += 16 ) {
+    __m128i v = _mm_loadu_si128( (__m128i const*)(src+i) );
+    // Interleaving a byte with itself multiplies it by 257.
+    __m128i pad = rescale ? v : zero;
+    _mm_storeu_si128( (__m128i*)(dst+i),   _mm_unpacklo_epi8( v, pad ) );
+    _mm_storeu_si128( (__m128i*)(dst+i+8), _mm_unpackhi_epi8( v, pad ) );
   }
-};
+  return i;
+}
 
-ChannelConvertMapEntry _conv_i8i8  ( &channel_convert_cast<int8,int8>   );
-ChannelConvertMapEntry _conv_i8u8  ( &channel_convert_cast<int8,uint8>  );
-ChannelConvertMapEntry _conv_i8i16 ( &channel_convert_cast<int8,int16>  );
-ChannelConvertMapEntry _conv_i8u16 ( &channel_convert_cast<int8,uint16> );
-ChannelConvertMapEntry _conv_i8i32 ( &channel_convert_cast<int8,int32>  );
-ChannelConvertMapEntry _conv_i8u32 ( &channel_convert_cast<int8,uint32> );
-ChannelConvertMapEntry _conv_i8i64 ( &channel_convert_cast<int8,int64>  );
-ChannelConvertMapEntry _conv_i8u64 ( &channel_convert_cast<int8,uint64> );
-ChannelConvertMapEntry _conv_i8f32 ( &channel_convert_cast<int8,float>, &channel_convert_int_to_float<int8,float>  );
-ChannelConvertMapEntry _conv_i8f64 ( &channel_convert_cast<int8,double>, &channel_convert_int_to_float<int8,double> );
-ChannelConvertMapEntry _conv_u8i8  ( &channel_convert_cast<uint8,int8>   );
-ChannelConvertMapEntry _conv_u8u8  ( &channel_convert_cast<uint8,uint8>  );
-ChannelConvertMapEntry _conv_u8i16 ( &channel_convert_cast<uint8,int16>  );
-ChannelConvertMapEntry _conv_u8u16 ( &channel_convert_cast<uint8,uint16>, &channel_convert_uint8_to_uint16 );
-ChannelConvertMapEntry _conv_u8i32 ( &channel_convert_cast<uint8,int32>  );
-ChannelConvertMapEntry _conv_u8u32 ( &channel_convert_cast<uint8,uint32> );
-ChannelConvertMapEntry _conv_u8i64 ( &channel_convert_cast<uint8,int64>  );
-ChannelConvertMapEntry _conv_u8u64 ( &channel_convert_cast<uint8,uint64> );
-ChannelConvertMapEntry _conv_u8f32 ( &channel_convert_cast<uint8,float>, &channel_convert_int_to_float<uint8,float>  );
-ChannelConvertMapEntry _conv_u8f64 ( &channel_convert_cast<uint8,double>, &channel_convert_int_to_float<uint8,double> );
-ChannelConvertMapEntry _conv_i16i8 ( &channel_convert_cast<int16,int8>   );
-ChannelConvertMapEntry _conv_i16u8 ( &channel_convert_cast<int16,uint8>  );
-ChannelConvertMapEntry _conv_i16i16( &channel_convert_cast<int16,int16>  );
-ChannelConvertMapEntry _conv_i16u16( &channel_convert_cast<int16,uint16> );
-ChannelConvertMapEntry _conv_i16i32( &channel_convert_cast<int16,int32>  );
-ChannelConvertMapEntry _conv_i16u32( &channel_convert_cast<int16,uint32> );
-ChannelConvertMapEntry _conv_i16i64( &channel_convert_cast<int16,int64>  );
-ChannelConvertMapEntry _conv_i16u64( &channel_convert_cast<int16,uint64> );
-ChannelConvertMapEntry _conv_i16f32( &channel_convert_cast<int16,float>, &channel_convert_int_to_float<int16,float>  );
-ChannelConvertMapEntry _conv_i16f64( &channel_convert_cast<int16,double>, &channel_convert_int_to_float<int16,double> );
-ChannelConvertMapEntry _conv_u16i8 ( &channel_convert_cast<uint16,int8>   );
-ChannelConvertMapEntry _conv_u16u8 ( &channel_convert_cast<uint16,uint8>, &channel_convert_uint16_to_uint8 );
-ChannelConvertMapEntry _conv_u16i16( &channel_convert_cast<uint16,int16>  );
-ChannelConvertMapEntry _conv_u16u16( &channel_convert_cast<uint16,uint16> );
-ChannelConvertMapEntry _conv_u16i32( &channel_convert_cast<uint16,int32>  );
-ChannelConvertMapEntry _conv_u16u32( &channel_convert_cast<uint16,uint32> );
-ChannelConvertMapEntry _conv_u16i64( &channel_convert_cast<uint16,int64>  );
-ChannelConvertMapEntry _conv_u16u64( &channel_convert_cast<uint16,uint64> );
-ChannelConvertMapEntry _conv_u16f32( &channel_convert_cast<uint16,float>, &channel_convert_int_to_float<uint16,float>  );
-ChannelConvertMapEntry _conv_u16f64( &channel_convert_cast<uint16,double>, &channel_convert_int_to_float<uint16,double> );
-ChannelConvertMapEntry _conv_i32i8 ( &channel_convert_cast<int32,int8>   );
-ChannelConvertMapEntry _conv_i32u8 ( &channel_convert_cast<int32,uint8>  );
-ChannelConvertMapEntry _conv_i32i16( &channel_convert_cast<int32,int16>  );
-ChannelConvertMapEntry _conv_i32u16( &channel_convert_cast<int32,uint16> );
-ChannelConvertMapEntry _conv_i32i32( &channel_convert_cast<int32,int32>  );
-ChannelConvertMapEntry _conv_i32u32( &channel_convert_cast<int32,uint32> );
-ChannelConvertMapEntry _conv_i32i64( &channel_convert_cast<int32,int64>  );
-ChannelConvertMapEntry _conv_i32u64( &channel_convert_cast<int32,uint64> );
-ChannelConvertMapEntry _conv_i32f32( &channel_convert_cast<int32,float>, &channel_convert_int_to_float<int32,float>  );
-ChannelConvertMapEntry _conv_i32f64( &channel_convert_cast<int32,double>, &channel_convert_int_to_float<int32,double> );
-ChannelConvertMapEntry _conv_u32i8 ( &channel_convert_cast<uint32,int8>   );
-ChannelConvertMapEntry _conv_u32u8 ( &channel_convert_cast<uint32,uint8>  );
-ChannelConvertMapEntry _conv_u32i16( &channel_convert_cast<uint32,int16>  );
-ChannelConvertMapEntry _conv_u32u16( &channel_convert_cast<uint32,uint16> );
-ChannelConvertMapEntry _conv_u32i32( &channel_convert_cast<uint32,int32>  );
-ChannelConvertMapEntry _conv_u32u32( &channel_convert_cast<uint32,uint32> );
-ChannelConvertMapEntry _conv_u32i64( &channel_convert_cast<uint32,int64>  );
-ChannelConvertMapEntry _conv_u32u64( &channel_convert_cast<uint32,uint64> );
-ChannelConvertMapEntry _conv_u32f32( &channel_convert_cast<uint32,float>, &channel_convert_int_to_float<uint32,float>  );
-ChannelConvertMapEntry _conv_u32f64( &channel_convert_cast<uint32,double>, &channel_convert_int_to_float<uint32,double> );
-ChannelConvertMapEntry _conv_i64i8 ( &channel_convert_cast<int64,int8>   );
-ChannelConvertMapEntry _conv_i64u8 ( &channel_convert_cast<int64,uint8>  );
-ChannelConvertMapEntry _conv_i64i16( &channel_convert_cast<int64,int16>  );
-ChannelConvertMapEntry _conv_i64u16( &channel_convert_cast<int64,uint16> );
-ChannelConvertMapEntry _conv_i64i32( &channel_convert_cast<int64,int32>  );
-ChannelConvertMapEntry _conv_i64u32( &channel_convert_cast<int64,uint32> );
-ChannelConvertMapEntry _conv_i64i64( &channel_convert_cast<int64,int64>  );
-ChannelConvertMapEntry _conv_i64u64( &channel_convert_cast<int64,uint64> );
-ChannelConvertMapEntry _conv_i64f32( &channel_convert_cast<int64,float>, &channel_convert_int_to_float<int64,float>  );
-ChannelConvertMapEntry _conv_i64f64( &channel_convert_cast<int64,double>, &channel_convert_int_to_float<int64,double> );
-ChannelConvertMapEntry _conv_u64i8 ( &channel_convert_cast<uint64,int8>   );
-ChannelConvertMapEntry _conv_u64u8 ( &channel_convert_cast<uint64,uint8>  );
-ChannelConvertMapEntry _conv_u64i16( &channel_convert_cast<uint64,int16>  );
-ChannelConvertMapEntry _conv_u64u16( &channel_convert_cast<uint64,uint16> );
-ChannelConvertMapEntry _conv_u64i32( &channel_convert_cast<uint64,int32>  );
-ChannelConvertMapEntry _conv_u64u32( &channel_convert_cast<uint64,uint32> );
-ChannelConvertMapEntry _conv_u64i64( &channel_convert_cast<uint64,int64>  );
-ChannelConvertMapEntry _conv_u64u64( &channel_convert_cast<uint64,uint64> );
-ChannelConvertMapEntry _conv_u64f32( &channel_convert_cast<uint64,float>, &channel_convert_int_to_float<uint64,float>  );
-ChannelConvertMapEntry _conv_u64f64( &channel_convert_cast<uint64,double>, &channel_convert_int_to_float<uint64,double> );
-ChannelConvertMapEntry _conv_f32i8 ( &channel_convert_cast<float,int8>, &channel_convert_float_to_int<float,int8>   );
-ChannelConvertMapEntry _conv_f32u8 ( &channel_convert_cast<float,uint8>, &channel_convert_float_to_int<float,uint8>  );
-ChannelConvertMapEntry _conv_f32i16( &channel_convert_cast<float,int16>, &channel_convert_float_to_int<float,int16>  );
-ChannelConvertMapEntry _conv_f32u16( &channel_convert_cast<float,uint16>, &channel_convert_float_to_int<float,uint16> );
-ChannelConvertMapEntry _conv_f32i32( &channel_convert_cast<float,int32>, &channel_convert_float_to_int<float,int32>  );
-ChannelConvertMapEntry _conv_f32u32( &channel_convert_cast<float,uint32>, &channel_convert_float_to_int<float,uint32> );
-ChannelConvertMapEntry _conv_f32i64( &channel_convert_cast<float,int64>, &channel_convert_float_to_int<float,int64>  );
-ChannelConvertMapEntry _conv_f32u64( &channel_convert_cast<float,uint64>, &channel_convert_float_to_int<float,uint64> );
-ChannelConvertMapEntry _conv_f32f32( &channel_convert_cast<float,float>  );
-ChannelConvertMapEntry _conv_f32f64( &channel_convert_cast<float,double> );
-ChannelConvertMapEntry _conv_f64i8 ( &channel_convert_cast<double,int8>, &channel_convert_float_to_int<double,int8>   );
-ChannelConvertMapEntry _conv_f64u8 ( &channel_convert_cast<double,uint8>, &channel_convert_float_to_int<double,uint8>  );
-ChannelConvertMapEntry _conv_f64i16( &channel_convert_cast<double,int16>, &channel_convert_float_to_int<double,int16>  );
-ChannelConvertMapEntry _conv_f64u16( &channel_convert_cast<double,uint16>, &channel_convert_float_to_int<double,uint16> );
-ChannelConvertMapEntry _conv_f64i32( &channel_convert_cast<double,int32>, &channel_convert_float_to_int<double,int32>  );
-ChannelConvertMapEntry _conv_f64u32( &channel_convert_cast<double,uint32>, &channel_convert_float_to_int<double,uint32> );
-ChannelConvertMapEntry _conv_f64i64( &channel_convert_cast<double,int64>, &channel_convert_float_to_int<double,int64>  );
-ChannelConvertMapEntry _conv_f64u64( &channel_convert_cast<double,uint64>, &channel_convert_float_to_int<double,uint64> );
-ChannelConvertMapEntry _conv_f64f32( &channel_convert_cast<double,float>  );
-ChannelConvertMapEntry _conv_f64f64( &channel_convert_cast<double,double> );
-
-// Channel Set Max:
-//   Assigns a channel the maximum value
-typedef void (*channel_set_max_func)(void* dest);
-
-template <class DestT>
-void channel_set_max_int( DestT* dest ) {
-  *dest = boost::integer_traits<DestT>::const_max;
-}
-
-template <class DestT>
-void channel_set_max_float( DestT* dest ) {
-  *dest = DestT(1.0);
-}
-
-std::map<ChannelTypeEnum,channel_set_max_func> *channel_set_max_map = 0;
-
-class ChannelSetMaxMapEntry {
-public:
-  template <class DstT>
-  ChannelSetMaxMapEntry( void (*func)(DstT*) ) {
-    if( !channel_set_max_map )
-      channel_set_max_map = new std::map<ChannelTypeEnum,channel_set_max_func>();
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_set_max_map->operator[]( dst ) = (channel_set_max_func)func;
+inline size_t channel_convert_simd( uint16 const* src, uint8* dst, size_t n, bool rescale ) {
+  const __m128i mask = _mm_set1_epi16( 0xff );
+  // For every uint16 x, x/257 == ((x*0xff01) >> 16) >> 8.
+  const __m128i div = _mm_set1_epi16( short(0xff01) );
+  size_t i = 0;
+  for( ; i+16 <= n; i += 16 ) {
+    __m128i a = _mm_loadu_si128( (__m128i const*)(src+i) );
+    __m128i b = _mm_loadu_si128( (__m128i const*)(src+i+8) );
+    if( rescale ) {
+      a = _mm_srli_epi16( _mm_mulhi_epu16( a, div ), 8 );
+      b = _mm_srli_epi16( _mm_mulhi_epu16( b, div ), 8 );
+    } else {
+      a = _mm_and_si128( a, mask );
+      b = _mm_and_si128( b, mask );
+    }
+    _mm_storeu_si128( (__m128i*)(dst+i), _mm_packus_epi16( a, b ) );
   }
-};
+  return i;
+}
 
-ChannelSetMaxMapEntry _setmax_i8 ( &channel_set_max_int<int8> );
-ChannelSetMaxMapEntry _setmax_u8 ( &channel_set_max_int<uint8> );
-ChannelSetMaxMapEntry _setmax_i16( &channel_set_max_int<int16> );
-ChannelSetMaxMapEntry _setmax_u16( &channel_set_max_int<uint16> );
-ChannelSetMaxMapEntry _setmax_i32( &channel_set_max_int<int32> );
-ChannelSetMaxMapEntry _setmax_u32( &channel_set_max_int<uint32> );
-ChannelSetMaxMapEntry _setmax_i64( &channel_set_max_int<int64> );
-ChannelSetMaxMapEntry _setmax_u64( &channel_set_max_int<uint64> );
-ChannelSetMaxMapEntry _setmax_f32( &channel_set_max_float<float> );
-ChannelSetMaxMapEntry _setmax_f64( &channel_set_max_float<double> );
-
-// Channel Average:
-//   Reduces a number of channels into one by averaging
-typedef void (*channel_average_func)(void* src, void* dest, int32 len);
+#endif // VW_CONVERT_SIMD
 
-template <class T>
-void channel_average( T* src, T* dest, int32 len ) {
-  typename AccumulatorType<T>::type accum = typename AccumulatorType<T>::type();
-  for( int32 i=0; i<len; ++i ) accum += src[i];
-  *dest = accum / len;
-}
-
-std::map<ChannelTypeEnum,channel_average_func> *channel_average_map = 0;
-
-class ChannelAverageMapEntry {
-public:
-  template <class T>
-  ChannelAverageMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_average_map )
-      channel_average_map = new std::map<ChannelTypeEnum,channel_average_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_average_map->operator[]( ctid ) = (channel_average_func)func;
+template <class SrcT, class DstT, bool RescaleT>
+void channel_convert( void const* src_v, void* dst_v, size_t n ) {
+  if( boost::is_same<SrcT,DstT>::value ) {
+    std::memcpy( dst_v, src_v, n*sizeof(SrcT) );
+    return;
   }
-};
-
-ChannelAverageMapEntry _average_i8 ( &channel_average<int8> );
-ChannelAverageMapEntry _average_u8 ( &channel_average<uint8> );
-ChannelAverageMapEntry _average_i16( &channel_average<int16> );
-ChannelAverageMapEntry _average_u16( &channel_average<uint16> );
-ChannelAverageMapEntry _average_i32( &channel_average<int32> );
-ChannelAverageMapEntry _average_u32( &channel_average<uint32> );
-ChannelAverageMapEntry _average_i64( &channel_average<int64> );
-ChannelAverageMapEntry _average_u64( &channel_average<uint64> );
-ChannelAverageMapEntry _average_f32( &channel_average<float> );
-ChannelAverageMapEntry _average_f64( &channel_average<double> );
+  SrcT const* src = static_cast<SrcT const*>(src_v);
+  DstT* dst = static_cast<DstT*>(dst_v);
+  size_t i = channel_convert_simd( src, dst, n, RescaleT );
+  for( ; i<n; ++i ) {
+    if( RescaleT ) dst[i] = ChannelRescale<SrcT,DstT>::apply( src[i] );
+    else dst[i] = DstT( src[i] );
+  }
+}
 
 // Channel Premultiply:
-//   Applies the Alpha Channel to the rest of the channels:
-typedef void (*channel_premultiply_func)(void* src, void* dst, int32 len);
+//   Applies the alpha channel (the last channel of each pixel) to the
+//   rest of the channels, or removes it from them.
+typedef void (*channel_premultiply_func)(void const* src, void* dst, size_t npixels, int32 channels);
 
+// Vectorized premultiplication, in the same style as the vectorized
+// conversions above.  Only the two- and four-channel cases are
+// vectorized.
 template <class T>
-void channel_premultiply_int( T* src, T* dst, int32 len ) {
-  double scale = src[len-1] / (double)(boost::integer_traits<T>::const_max);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( round(src[i] * scale) );
-  dst[len-1] = src[len-1];
+inline size_t channel_premultiply_simd( T const* /*src*/, T* /*dst*/, size_t /*npixels*/, int32 /*channels*/, bool /*divide*/ ) {
+  return 0;
+}
+
+#if VW_CONVERT_SIMD
+
+// Premultiplies two pixels of GA or one pixel of RGBA.  Multiplying in
+// single precision gives the same result as the scalar code, which
+// multiplies in double precision and rounds to single precision.
+inline size_t channel_premultiply_simd( float const* src, float* dst, size_t npixels, int32 channels, bool divide ) {
+  if( channels != 2 && channels != 4 ) return 0;
+  const __m128 alpha_mask = _mm_castsi128_ps( channels == 2 ? _mm_set_epi32( -1, 0, -1, 0 ) : _mm_set_epi32( -1, 0, 0, 0 ) );
+  size_t n = npixels * channels, i = 0;
+  for( ; i+4 <= n; i += 4 ) {
+    __m128 v = _mm_loadu_ps( src+i );
+    __m128 a = ( channels == 2 ) ? _mm_shuffle_ps( v, v, _MM_SHUFFLE(3,3,1,1) ) : _mm_shuffle_ps( v, v, _MM_SHUFFLE(3,3,3,3) );
+    __m128 r = divide ? _mm_div_ps( v, a ) : _mm_mul_ps( v, a );
+    _mm_storeu_ps( dst+i, _mm_or_ps( _mm_and_ps( alpha_mask, v ), _mm_andnot_ps( alpha_mask, r ) ) );
+  }
+  return i / channels;
+}
+
+// Computes round(v*scale) or round(v/scale) for four int32 channel
+// values, with the first two scaled by s_lo and the last two by s_hi.
+// Results that would overflow the channel type saturate at max.
+inline __m128i premultiply_simd_int( __m128i v, __m128d s_lo, __m128d s_hi, bool divide, __m128d max ) {
+  const __m128d half = _mm_set1_pd( 0.5 ), one = _mm_set1_pd( 1.0 );
+  __m128d x[2] = { _mm_cvtepi32_pd( v ), _mm_cvtepi32_pd( _mm_shuffle_epi32( v, _MM_SHUFFLE(1,0,3,2) ) ) };
+  __m128d s[2] = { s_lo, s_hi };
+  __m128i r[2];
+  for( int k=0; k<2; ++k ) {
+    __m128d y = divide ? _mm_div_pd( x[k], s[k] ) : _mm_mul_pd( x[k], s[k] );
+    y = _mm_min_pd( max, y );
+    // y is non-negative, so rounding halfway cases away from zero
+    // means rounding up when the fraction is at least one half.
+    __m128d t = _mm_cvtepi32_pd( _mm_cvttpd_epi32( y ) );
+    t = _mm_add_pd( t, _mm_and_pd( _mm_cmpge_pd( _mm_sub_pd( y, t ), half ), one ) );
+    r[k] = _mm_cvttpd_epi32( t );
+  }
+  return _mm_unpacklo_epi64( r[0], r[1] );
 }
 
+// Returns the per-channel scale vectors for the next four values,
+// which are either two GA pixels or one RGBA pixel.  The alpha
+// channel is scaled by one so that it passes through unchanged.
 template <class T>
-void channel_premultiply_float( T* src, T* dst, int32 len ) {
-  double scale = (double)(src[len-1]);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( src[i] * scale );
-  dst[len-1] = src[len-1];
-}
-
-std::map<ChannelTypeEnum,channel_premultiply_func> *channel_premultiply_map = 0;
-
-class ChannelPremultiplyMapEntry {
-public:
-  template <class T>
-  ChannelPremultiplyMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_premultiply_map )
-      channel_premultiply_map = new std::map<ChannelTypeEnum,channel_premultiply_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_premultiply_map->operator[]( ctid ) = (channel_premultiply_func)func;
+inline void premultiply_simd_scales( T const* src, int32 channels, __m128d& s_lo, __m128d& s_hi ) {
+  const double max = boost::integer_traits<T>::const_max;
+  if( channels == 2 ) {
+    s_lo = _mm_set_pd( 1.0, src[1] / max );
+    s_hi = _mm_set_pd( 1.0, src[3] / max );
+  } else {
+    s_lo = _mm_set1_pd( src[3] / max );
+    s_hi = _mm_set_pd( 1.0, src[3] / max );
   }
-};
+}
+
+inline size_t channel_premultiply_simd( uint8 const* src, uint8* dst, size_t npixels, int32 channels, bool divide ) {
+  if( channels != 2 && channels != 4 ) return 0;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128d max = _mm_set1_pd( boost::integer_traits<uint8>::const_max );
+  size_t n = npixels * channels, i = 0;
+  for( ; i+4 <= n; i += 4 ) {
+    __m128d s_lo, s_hi;
+    premultiply_simd_scales( src+i, channels, s_lo, s_hi );
+    int32 bytes;
+    std::memcpy( &bytes, src+i, sizeof(bytes) );
+    __m128i v = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zero ), zero );
+    __m128i r = premultiply_simd_int( v, s_lo, s_hi, divide, max );
+    r = _mm_packus_epi16( _mm_packs_epi32( r, zero ), zero );
+    bytes = _mm_cvtsi128_si32( r );
+    std::memcpy( dst+i, &bytes, sizeof(bytes) );
+  }
+  return i / channels;
+}
+
+inline size_t channel_premultiply_simd( uint16 const* src, uint16* dst, size_t npixels, int32 channels, bool divide ) {
+  if( channels != 2 && channels != 4 ) return 0;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128d max = _mm_set1_pd( boost::integer_traits<uint16>::const_max );
+  size_t n = npixels * channels, i = 0;
+  for( ; i+4 <= n; i += 4 ) {
+    __m128d s_lo, s_hi;
+    premultiply_simd_scales( src+i, channels, s_lo, s_hi );
+    __m128i v = _mm_unpacklo_epi16( _mm_loadl_epi64( (__m128i const*)(src+i) ), zero );
+    __m128i r = premultiply_simd_int( v, s_lo, s_hi, divide, max );
+    _mm_storel_epi64( (__m128i*)(dst+i), convert_simd_pack16( r, zero ) );
+  }
+  return i / channels;
+}
 
-ChannelPremultiplyMapEntry _premultiply_i8 ( &channel_premultiply_int<int8> );
-ChannelPremultiplyMapEntry _premultiply_u8 ( &channel_premultiply_int<uint8> );
-ChannelPremultiplyMapEntry _premultiply_i16( &channel_premultiply_int<int16> );
-ChannelPremultiplyMapEntry _premultiply_u16( &channel_premultiply_int<uint16> );
-ChannelPremultiplyMapEntry _premultiply_i32( &channel_premultiply_int<int32> );
-ChannelPremultiplyMapEntry _premultiply_u32( &channel_premultiply_int<uint32> );
-ChannelPremultiplyMapEntry _premultiply_i64( &channel_premultiply_int<int64> );
-ChannelPremultiplyMapEntry _premultiply_u64( &channel_premultiply_int<uint64> );
-ChannelPremultiplyMapEntry _premultiply_f32( &channel_premultiply_float<float> );
-ChannelPremultiplyMapEntry _premultiply_f64( &channel_premultiply_float<double> );
-
-// Channel Unpremultiply:
-//   Removes the premultiply of alpha to other channels:
-typedef void (*channel_unpremultiply_func)(void* src, void* dst, int32 len);
+#endif // VW_CONVERT_SIMD
 
 template <class T>
-void channel_unpremultiply_int( T* src, T* dst, int32 len ) {
-  double scale = src[len-1] / (double)(boost::integer_traits<T>::const_max);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( round(src[i] / scale) );
-  dst[len-1] = src[len-1];
+inline T channel_premultiply_value( T value, T alpha, boost::true_type /*is_integral*/ ) {
+  double scale = alpha / (double)(boost::integer_traits<T>::const_max);
+  return T( round(value * scale) );
 }
 
 template <class T>
-void channel_unpremultiply_float( T* src, T* dst, int32 len ) {
-  double scale = (double)(src[len-1]);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( src[i] / scale );
-  dst[len-1] = src[len-1];
-}
-
-std::map<ChannelTypeEnum,channel_unpremultiply_func> *channel_unpremultiply_map = 0;
-
-class ChannelUnpremultiplyMapEntry {
-public:
-  template <class T>
-  ChannelUnpremultiplyMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_unpremultiply_map )
-      channel_unpremultiply_map = new std::map<ChannelTypeEnum,channel_unpremultiply_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_unpremultiply_map->operator[]( ctid ) = (channel_unpremultiply_func)func;
+inline T channel_premultiply_value( T value, T alpha, boost::false_type /*is_integral*/ ) {
+  double scale = (double)(alpha);
+  return T( value * scale );
+}
+
+template <class T>
+inline T channel_unpremultiply_value( T value, T alpha, boost::true_type /*is_integral*/ ) {
+  double scale = alpha / (double)(boost::integer_traits<T>::const_max);
+  double result = round(value / scale);
+  if( result > boost::integer_traits<T>::const_max ) return boost::integer_traits<T>::const_max;
+  return T( result );
+}
+
+template <class T>
+inline T channel_unpremultiply_value( T value, T alpha, boost::false_type /*is_integral*/ ) {
+  double scale = (double)(alpha);
+  return T( value / scale );
+}
+
+template <class T>
+void channel_premultiply( void const* src_v, void* dst_v, size_t npixels, int32 channels ) {
+  T const* src = static_cast<T const*>(src_v);
+  T* dst = static_cast<T*>(dst_v);
+  size_t p = channel_premultiply_simd( src, dst, npixels, channels, false );
+  for( src += p*channels, dst += p*channels; p<npixels; ++p, src += channels, dst += channels ) {
+    for( int32 i=0; i<channels-1; ++i )
+      dst[i] = channel_premultiply_value( src[i], src[channels-1], boost::is_integral<T>() );
+    dst[channels-1] = src[channels-1];
+  }
+}
+
+template <class T>
+void channel_unpremultiply( void const* src_v, void* dst_v, size_t npixels, int32 channels ) {
+  T const* src = static_cast<T const*>(src_v);
+  T* dst = static_cast<T*>(dst_v);
+  size_t p = channel_premultiply_simd( src, dst, npixels, channels, true );
+  for( src += p*channels, dst += p*channels; p<npixels; ++p, src += channels, dst += channels ) {
+    for( int32 i=0; i<channels-1; ++i )
+      dst[i] = channel_unpremultiply_value( src[i], src[channels-1], boost::is_integral<T>() );
+    dst[channels-1] = src[channels-1];
+  }
+}
+
+// Channel Rearrange:
+//   Converts a span of pixels between pixel formats with different
+//   numbers of channels, triplicating or averaging the color channels
+//   and copying, adding, or dropping the alpha channel as needed.
+typedef void (*channel_rearrange_func)(void const* src, int32 src_channels, void* dst, int32 dst_channels, size_t npixels);
+
+template <class T>
+inline T channel_max( boost::true_type /*is_integral*/ ) { return boost::integer_traits<T>::const_max; }
+
+template <class T>
+inline T channel_max( boost::false_type /*is_integral*/ ) { return T(1.0); }
+
+template <class T>
+void channel_rearrange( void const* src_v, int32 src_channels, void* dst_v, int32 dst_channels, size_t npixels ) {
+  T const* src = static_cast<T const*>(src_v);
+  T* dst = static_cast<T*>(dst_v);
+  const int32 copy_length = (src_channels==dst_channels) ? src_channels : (src_channels<3) ? 1 : (dst_channels>=3) ? 3 : 0;
+  const bool triplicate = src_channels<3 && dst_channels>=3;
+  const bool average = src_channels >=3 && dst_channels<3;
+  const bool add_alpha = src_channels%2==1 && dst_channels%2==0;
+  const bool copy_alpha = src_channels!=dst_channels && src_channels%2==0 && dst_channels%2==0;
+  const T max = channel_max<T>( boost::is_integral<T>() );
+  for( size_t p=0; p<npixels; ++p, src += src_channels, dst += dst_channels ) {
+    for( int32 ch=0; ch<copy_length; ++ch ) dst[ch] = src[ch];
+    if( triplicate ) {
+      dst[1] = src[0];
+      dst[2] = src[0];
+    }
+    else if( average ) {
+      typename AccumulatorType<T>::type accum = typename AccumulatorType<T>::type();
+      for( int32 ch=0; ch<3; ++ch ) accum += src[ch];
+      dst[0] = accum / int32(3);
+    }
+    if( copy_alpha ) dst[dst_channels-1] = src[src_channels-1];
+    else if( add_alpha ) dst[dst_channels-1] = max;
   }
+}
+
+// The kernels for a single channel type.
+struct ChannelKernels {
+  channel_premultiply_func premultiply, unpremultiply;
+  channel_rearrange_func rearrange;
 };
 
-ChannelUnpremultiplyMapEntry _unpremultiply_i8 ( &channel_unpremultiply_int<int8> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u8 ( &channel_unpremultiply_int<uint8> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i16( &channel_unpremultiply_int<int16> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u16( &channel_unpremultiply_int<uint16> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i32( &channel_unpremultiply_int<int32> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u32( &channel_unpremultiply_int<uint32> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i64( &channel_unpremultiply_int<int64> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u64( &channel_unpremultiply_int<uint64> );
-ChannelUnpremultiplyMapEntry _unpremultiply_f32( &channel_unpremultiply_float<float> );
-ChannelUnpremultiplyMapEntry _unpremultiply_f64( &channel_unpremultiply_float<double> );
+template <class T>
+ChannelKernels channel_kernels() {
+  ChannelKernels kernels;
+  kernels.premultiply = &channel_premultiply<T>;
+  kernels.unpremultiply = &channel_unpremultiply<T>;
+  kernels.rearrange = &channel_rearrange<T>;
+  return kernels;
+}
+
+template <class SrcT>
+channel_convert_func channel_convert_kernel( ChannelTypeEnum dst_type, bool rescale ) {
+  switch( dst_type ) {
+#define VW_CONVERT_CASE(type, T) \
+  case type: return rescale ? &channel_convert<SrcT,T,true> : &channel_convert<SrcT,T,false>;
+    VW_CONVERT_CASE( VW_CHANNEL_INT8,    int8 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT8,   uint8 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT16,   int16 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT16,  uint16 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT32,   int32 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT32,  uint32 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT64,   int64 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT64,  uint64 )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT32, float )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT64, double )
+#undef VW_CONVERT_CASE
+  default: return 0;
+  }
+}
+
+// Returns the conversion kernel between two channel types, or zero if
+// there is none.
+channel_convert_func channel_convert_kernel( ChannelTypeEnum src_type, ChannelTypeEnum dst_type, bool rescale ) {
+  switch( src_type ) {
+#define VW_CONVERT_CASE(type, T) \
+  case type: return channel_convert_kernel<T>( dst_type, rescale );
+    VW_CONVERT_CASE( VW_CHANNEL_INT8,    int8 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT8,   uint8 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT16,   int16 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT16,  uint16 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT32,   int32 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT32,  uint32 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT64,   int64 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT64,  uint64 )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT32, float )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT64, double )
+#undef VW_CONVERT_CASE
+  default: return 0;
+  }
+}
+
+// Looks up the kernels for a channel type, returning false if there
+// are none.
+bool channel_kernels( ChannelTypeEnum type, ChannelKernels& kernels ) {
+  switch( type ) {
+#define VW_CONVERT_CASE(type, T) \
+  case type: kernels = channel_kernels<T>(); return true;
+    VW_CONVERT_CASE( VW_CHANNEL_INT8,    int8 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT8,   uint8 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT16,   int16 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT16,  uint16 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT32,   int32 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT32,  uint32 )
+    VW_CONVERT_CASE( VW_CHANNEL_INT64,   int64 )
+    VW_CONVERT_CASE( VW_CHANNEL_UINT64,  uint64 )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT32, float )
+    VW_CONVERT_CASE( VW_CHANNEL_FLOAT64, double )
+#undef VW_CONVERT_CASE
+  default: return false;
+  }
+}
+
+} // namespace
 
 void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale ) {
   VW_ASSERT( dst.format.cols==src.format.cols && dst.format.rows==src.format.rows,
@@ -399,12 +546,10 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     }
   }
 
-  size_t src_channels = num_channels( src.format.pixel_format );
-  size_t dst_channels = num_channels( dst.format.pixel_format );
-  size_t src_chstride = channel_size( src.format.channel_type );
-  size_t dst_chstride = channel_size( dst.format.channel_type );
-
-  int32 copy_length = (src_channels==dst_channels) ? src_channels : (src_channels<3) ? 1 : (dst_channels>=3) ? 3 : 0;
+  const size_t src_channels = num_channels( src.format.pixel_format );
+  const size_t dst_channels = num_channels( dst.format.pixel_format );
+  const size_t src_chstride = channel_size( src.format.channel_type );
+  const size_t dst_chstride = channel_size( dst.format.channel_type );
 
   bool unpremultiply_src = false, premultiply_src = false, premultiply_dst = false;
   {
@@ -416,26 +561,25 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     premultiply_dst   = (src_alpha && dst_alpha && !srcf.premultiplied && dstf.premultiplied);
   }
 
-  bool triplicate = src_channels<3 && dst_channels>=3;
-  bool average = src_channels >=3 && dst_channels<3;
-  bool add_alpha = src_channels%2==1 && dst_channels%2==0;
-  bool copy_alpha = src_channels!=dst_channels && src_channels%2==0 && dst_channels%2==0;
-
-  channel_convert_func conv_func = rescale
-    ? channel_convert_rescale_map->operator[](std::make_pair(src.format.channel_type,dst.format.channel_type))
-    : channel_convert_map->operator[](std::make_pair(src.format.channel_type,dst.format.channel_type));
-  channel_set_max_func max_func = channel_set_max_map->operator[](dst.format.channel_type);
-  channel_average_func avg_func = channel_average_map->operator[](dst.format.channel_type);
-  channel_unpremultiply_func unpremultiply_src_func = channel_unpremultiply_map->operator[](src.format.channel_type);
-  channel_premultiply_func premultiply_src_func = channel_premultiply_map->operator[](src.format.channel_type);
-  channel_premultiply_func premultiply_dst_func = channel_premultiply_map->operator[](dst.format.channel_type);
-  if( !conv_func || !max_func || !avg_func || !unpremultiply_src_func || !premultiply_dst_func || !premultiply_src_func )
+  channel_convert_func conv_func = channel_convert_kernel( src.format.channel_type, dst.format.channel_type, rescale );
+  ChannelKernels src_kernels, dst_kernels;
+  if( !conv_func || !channel_kernels( src.format.channel_type, src_kernels ) || !channel_kernels( dst.format.channel_type, dst_kernels ) )
     vw_throw( NoImplErr() << "Unsupported channel type combination in convert (" << src.format.channel_type << ", " << dst.format.channel_type << ")!" );
 
-  int32 max_channels = std::max( src_channels, dst_channels );
-
-  boost::scoped_array<uint8> src_buf(new uint8[max_channels*src_chstride]);
-  boost::scoped_array<uint8> dst_buf(new uint8[max_channels*dst_chstride]);
+  // Rows are processed as contiguous spans of channels.  Rows whose
+  // pixels are not contiguous are gathered into (or scattered from) a
+  // scratch row, as are rows that need an intermediate step.
+  const size_t cols = src.format.cols;
+  const size_t src_pixel_size = src_channels * src_chstride;
+  const size_t dst_pixel_size = dst_channels * dst_chstride;
+  const bool src_packed = src.cstride == ssize_t(src_pixel_size);
+  const bool dst_packed = dst.cstride == ssize_t(dst_pixel_size);
+  const bool rearrange = src_channels != dst_channels;
+
+  boost::scoped_array<uint8> src_buf, conv_buf, dst_buf;
+  if( !src_packed || unpremultiply_src || premultiply_src ) src_buf.reset( new uint8[cols*src_pixel_size] );
+  if( rearrange ) conv_buf.reset( new uint8[cols*src_channels*dst_chstride] );
+  if( !dst_packed ) dst_buf.reset( new uint8[cols*dst_pixel_size] );
 
   uint8 *src_ptr_p = (uint8*)src.data;
   uint8 *dst_ptr_p = (uint8*)dst.data;
@@ -443,72 +587,42 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     uint8 *src_ptr_r = src_ptr_p;
     uint8 *dst_ptr_r = dst_ptr_p;
     for( uint32 r=0; r<src.format.rows; ++r ) {
-      uint8 *src_ptr_c = src_ptr_r;
-      uint8 *dst_ptr_c = dst_ptr_r;
-      for( uint32 c=0; c<src.format.cols; ++c ) {
-
-        // Setup the buffers, adjusting premultiplication if needed
-        uint8 *src_ptr = src_ptr_c;
-        uint8 *dst_ptr = dst_ptr_c;
-        if( unpremultiply_src ) {
-          unpremultiply_src_func( src_ptr, src_buf.get(), src_channels );
-          src_ptr = src_buf.get();
-        }
-        else if( premultiply_src ) {
-          premultiply_src_func( src_ptr, src_buf.get(), src_channels );
-          src_ptr = src_buf.get();
-        }
-
-        // Copy/convert, unrolling the common multi-channel cases
-        if( copy_length==4 ) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-          conv_func( src_ptr+2*src_chstride, dst_ptr+2*dst_chstride );
-          conv_func( src_ptr+3*src_chstride, dst_ptr+3*dst_chstride );
-        }
-        else if( copy_length==3 ) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-          conv_func( src_ptr+2*src_chstride, dst_ptr+2*dst_chstride );
-        }
-        else if( copy_length==2) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-        }
-        else if( copy_length==1 ) {
-          conv_func( src_ptr, dst_ptr );
-        }
-        else {
-          for( int32 ch=0; ch<copy_length; ++ch ) {
-            conv_func( src_ptr+ch*src_chstride, dst_ptr+ch*dst_chstride );
-          }
-        }
-
-        // Handle the special pixel format conversions
-        if( triplicate ) {
-          conv_func( src_ptr, dst_ptr+dst_chstride );
-          conv_func( src_ptr, dst_ptr+2*dst_chstride );
-        }
-        else if( average ) {
-          for( int32 ch=0; ch<3; ++ch ) {
-            conv_func( src_ptr+ch*src_chstride, dst_buf.get()+ch*dst_chstride );
-          }
-          avg_func( dst_buf.get(), dst_ptr, 3 );
-        }
-        if( copy_alpha ) {
-          conv_func( src_ptr+(src_channels-1)*src_chstride, dst_ptr+(dst_channels-1)*dst_chstride );
-        }
-        else if( add_alpha ) {
-          max_func( dst_ptr+(dst_channels-1)*dst_chstride );
-        }
-
-        // Finally, adjust destination premultiplication if needed
-        if( premultiply_dst ) {
-          premultiply_dst_func( dst_ptr, dst_ptr, dst_channels );
-        }
-        src_ptr_c += src.cstride;
-        dst_ptr_c += dst.cstride;
+
+      // Setup the source row, adjusting premultiplication if needed
+      const uint8 *src_row = src_ptr_r;
+      if( !src_packed ) {
+        for( size_t c=0; c<cols; ++c )
+          std::memcpy( src_buf.get() + c*src_pixel_size, src_ptr_r + c*src.cstride, src_pixel_size );
+        src_row = src_buf.get();
+      }
+      if( unpremultiply_src ) {
+        src_kernels.unpremultiply( src_row, src_buf.get(), cols, src_channels );
+        src_row = src_buf.get();
+      }
+      else if( premultiply_src ) {
+        src_kernels.premultiply( src_row, src_buf.get(), cols, src_channels );
+        src_row = src_buf.get();
+      }
+
+      // Convert the channels, and then the pixel format if needed
+      uint8 *dst_row = dst_packed ? dst_ptr_r : dst_buf.get();
+      if( rearrange ) {
+        conv_func( src_row, conv_buf.get(), cols*src_channels );
+        dst_kernels.rearrange( conv_buf.get(), src_channels, dst_row, dst_channels, cols );
+      }
+      else {
+        conv_func( src_row, dst_row, cols*src_channels );
+      }
+
+      // Finally, adjust destination premultiplication if needed
+      if( premultiply_dst ) {
+        dst_kernels.premultiply( dst_row, dst_row, cols, dst_channels );
+      }
+      if( !dst_packed ) {
+        for( size_t c=0; c<cols; ++c )
+          std::memcpy( dst_ptr_r + c*dst.cstride, dst_buf.get() + c*dst_pixel_size, dst_pixel_size );
       }
+
       src_ptr_r += src.rstride;
       dst_ptr_r += dst.rstride;
     }
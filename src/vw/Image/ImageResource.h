@@ -105,6 +105,10 @@ namespace vw {
       /// Returns the preferred block size/alignment for partial reads.
       virtual Vector2i block_read_size() const { return Vector2i(cols(),rows()); }
 
+      /// Can read() safely be called from several threads at once?
+      /// Views of a resource serialize their reads unless it can.
+      virtual bool has_concurrent_read() const { return false; }
+
       // Does this resource have a nodata value?
       // If you override this to true, you must implement the other nodata_read functions
       virtual bool has_nodata_read() const = 0;
@@ -143,6 +147,10 @@ namespace vw {
         vw_throw(NoImplErr() << "This ImageResource does not support block writes");
       }
 
+      /// Can the blocks of a block write be written in any order?
+      /// Only meaningful if has_block_write() is true.
+      virtual bool has_unordered_block_write() const { return false; }
+
       // Does this resource have an output nodata value?
       // If you override this to true, you must implement the other nodata_write functions
       virtual bool has_nodata_write() const = 0;
@@ -64,12 +64,11 @@ namespace vw {
 
     /// Returns the pixel at the given position in the given plane.
     result_type operator()( int32 x, int32 y, int32 plane=0 ) const {
-      Mutex::Lock lock(*m_rsrc_mutex);
 #if VW_DEBUG_LEVEL > 1
       vw_out(VerboseDebugMessage, "image") << "ImageResourceView rasterizing pixel (" << x << "," << y << ")" << std::endl;
 #endif
       ImageView<PixelT> buffer(1,1,m_planes);
-      read_image( buffer, *m_rsrc, BBox2i(x,y,1,1) );
+      read( buffer, BBox2i(x,y,1,1) );
       return buffer(0,0,plane);
     }
 
@@ -85,14 +84,24 @@ namespace vw {
       return CropView<ImageView<PixelT> >( buf, BBox2i(-bbox.min().x(),-bbox.min().y(),cols(),rows()) );
     }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i bbox ) const {
-      Mutex::Lock lock(*m_rsrc_mutex);
 #if VW_DEBUG_LEVEL > 1
       vw_out(VerboseDebugMessage, "image") << "ImageResourceView rasterizing bbox " << bbox << std::endl;
 #endif
-      read_image( dest, *m_rsrc, bbox );
+      read( dest, bbox );
     }
 
   private:
+    // Reads from the resource, serializing the reads unless the
+    // resource supports concurrent reads.
+    template <class DestT> void read( DestT& dest, BBox2i const& bbox ) const {
+      if( m_rsrc->has_concurrent_read() ) {
+        read_image( dest, *m_rsrc, bbox );
+        return;
+      }
+      Mutex::Lock lock(*m_rsrc_mutex);
+      read_image( dest, *m_rsrc, bbox );
+    }
+
     void initialize() {
       // If the user has requested a multi-channel pixel type, but the
       // file is a multi-plane, scalar-pixel file, we force a single-plane
@@ -23,6 +23,13 @@
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Interpolation.h>
 
+#include <boost/type_traits/is_base_of.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+
 static const double VW_DEFAULT_MIN_TRANSFORM_IMAGE_SIZE = 1;
 static const double VW_DEFAULT_MAX_TRANSFORM_IMAGE_SIZE = 1e10; // Ten gigapixels
 
@@ -158,6 +165,36 @@ namespace vw {
       return grow_bbox_to_int( transformed_bbox );
     }
 
+    /// Applies the reverse transformation to the n points (x,y),
+    /// (x+1,y), ..., (x+n-1,y) along a row of the output image,
+    /// storing the results in xs and ys.  Transforms that can step
+    /// along a row more cheaply than by calling reverse() for each
+    /// point override this.  Callers go through detail::reverse_row(),
+    /// which ignores an override that a subclass has left behind by
+    /// overriding reverse() alone.
+    void reverse_row( int32 x, int32 y, int32 n, double* xs, double* ys ) const {
+      ImplT const& txform = impl();
+      for( int32 i=0; i<n; ++i ) {
+        Vector2 pt = txform.reverse( Vector2(x+i,y) );
+        xs[i] = pt[0];
+        ys[i] = pt[1];
+      }
+    }
+
+    /// Applies the reverse transformation in place to the n points
+    /// (xs[i],ys[i]).  Transforms whose per-call overhead is large
+    /// compared to the work per point, such as the cartographic
+    /// ones, override this to handle all of the points at once.  As
+    /// with reverse_row(), callers go through detail::reverse_batch().
+    void reverse_batch( double* xs, double* ys, size_t n ) const {
+      ImplT const& txform = impl();
+      for( size_t i=0; i<n; ++i ) {
+        Vector2 pt = txform.reverse( Vector2(xs[i],ys[i]) );
+        xs[i] = pt[0];
+        ys[i] = pt[1];
+      }
+    }
+
     /// This function is deprecated, and provided for backwards
     /// compatibility only.  Use reverse(BBox2i) instead.
     BBox2i compute_input_bbox( BBox2i const& output_bbox ) const VW_DEPRECATED {
@@ -180,6 +217,72 @@ namespace vw {
   };
 
 
+  /// \cond INTERNAL
+  namespace detail {
+
+    template <class T> struct IsTransformBase : boost::false_type {};
+    template <class ImplT> struct IsTransformBase<TransformBase<ImplT> > : boost::true_type {};
+
+    // An override of reverse_row() or reverse_batch() computes the
+    // same thing as reverse() only if it was written alongside it,
+    // i.e. it is declared in the class that declares reverse() or in
+    // one derived from it.  The defaults in TransformBase call
+    // reverse() itself, so they are always safe.  ReverseT and RowT
+    // are the classes that declare the two.
+    template <class ReverseT, class RowT>
+    struct UseReverseRow {
+      static const bool value = boost::is_base_of<ReverseT, RowT>::value || IsTransformBase<RowT>::value;
+    };
+
+    template <class TransformT, class ReverseT, class RowT>
+    inline void reverse_row( TransformT const& txform, Vector2 (ReverseT::*)( Vector2 const& ) const,
+                             void (RowT::*)( int32, int32, int32, double*, double* ) const,
+                             int32 x, int32 y, int32 n, double* xs, double* ys ) {
+      if( UseReverseRow<ReverseT, RowT>::value ) {
+        txform.reverse_row( x, y, n, xs, ys );
+        return;
+      }
+      for( int32 i=0; i<n; ++i ) {
+        Vector2 pt = txform.reverse( Vector2(x+i,y) );
+        xs[i] = pt[0];
+        ys[i] = pt[1];
+      }
+    }
+
+    template <class TransformT, class ReverseT, class BatchT>
+    inline void reverse_batch( TransformT const& txform, Vector2 (ReverseT::*)( Vector2 const& ) const,
+                               void (BatchT::*)( double*, double*, size_t ) const,
+                               double* xs, double* ys, size_t n ) {
+      if( UseReverseRow<ReverseT, BatchT>::value ) {
+        txform.reverse_batch( xs, ys, n );
+        return;
+      }
+      for( size_t i=0; i<n; ++i ) {
+        Vector2 pt = txform.reverse( Vector2(xs[i],ys[i]) );
+        xs[i] = pt[0];
+        ys[i] = pt[1];
+      }
+    }
+
+    /// Calls txform.reverse_row(), unless that would bypass an
+    /// override of reverse(), in which case reverse() is called for
+    /// each point instead.
+    template <class TransformT>
+    inline void reverse_row( TransformT const& txform, int32 x, int32 y, int32 n, double* xs, double* ys ) {
+      reverse_row( txform, &TransformT::reverse, &TransformT::reverse_row, x, y, n, xs, ys );
+    }
+
+    /// Calls txform.reverse_batch(), or reverse() for each point, as
+    /// for reverse_row().
+    template <class TransformT>
+    inline void reverse_batch( TransformT const& txform, double* xs, double* ys, size_t n ) {
+      reverse_batch( txform, &TransformT::reverse, &TransformT::reverse_batch, xs, ys, n );
+    }
+
+  } // namespace detail
+  /// \endcond
+
+
   /// Resample image transform functor
   ///
   /// Transform points by applying a scaling in x and y.
@@ -212,6 +315,14 @@ namespace vw {
       return Vector2( p(0) - m_xtrans, p(1) - m_ytrans );
     }
 
+    void reverse_row( int32 x, int32 y, int32 n, double* xs, double* ys ) const {
+      double py = y - m_ytrans;
+      for( int32 i=0; i<n; ++i ) {
+        xs[i] = (x+i) - m_xtrans;
+        ys[i] = py;
+      }
+    }
+
     inline Vector2 forward(const Vector2 &p) const {
       return Vector2( p(0) + m_xtrans, p(1) + m_ytrans );
     }
@@ -267,6 +378,16 @@ namespace vw {
       return Vector2(m_ai*px+m_bi*py,
                      m_ci*px+m_di*py);
     }
+
+    // Each step along the row adds the first column of the inverse
+    // matrix to the result.
+    void reverse_row( int32 x, int32 y, int32 n, double* xs, double* ys ) const {
+      Vector2 start = reverse( Vector2(x,y) );
+      for( int32 i=0; i<n; ++i ) {
+        xs[i] = start[0] + i*m_ai;
+        ys[i] = start[1] + i*m_ci;
+      }
+    }
   };
 
   /// Rotate image transform functor
@@ -304,6 +425,20 @@ namespace vw {
                       ( m_H_inverse(1,0) * p(0) + m_H_inverse(1,1) * p(1) + m_H_inverse(1,2) ) / w);
     }
 
+    // The homogeneous coordinates are linear along the row, so only
+    // the final division is done per point.
+    void reverse_row( int32 x, int32 y, int32 n, double* xs, double* ys ) const {
+      Matrix3x3 const& H = m_H_inverse;
+      double u = H(0,0) * x + H(0,1) * y + H(0,2);
+      double v = H(1,0) * x + H(1,1) * y + H(1,2);
+      double w = H(2,0) * x + H(2,1) * y + H(2,2);
+      for( int32 i=0; i<n; ++i ) {
+        double wi = w + i*H(2,0);
+        xs[i] = ( u + i*H(0,0) ) / wi;
+        ys[i] = ( v + i*H(1,0) ) / wi;
+      }
+    }
+
     inline Vector2 forward(const Vector2 &p) const {
       double w = m_H(2,0) * p(0) + m_H(2,1) * p(1) + m_H(2,2);
       return Vector2( ( m_H(0,0) * p(0) + m_H(0,1) * p(1) + m_H(0,2) ) / w,
@@ -508,57 +643,95 @@ namespace vw {
   /// Mimics the behavior of a given transform functor, but attempts to
   /// build a lookup table to linearly interpolate approimate results
   /// to the reverse() function for arguments within the given bounding
-  /// box, to within the original transform functor's tolerance.
+  /// box, to within the original transform functor's tolerance.  The
+  /// points added at each refinement of the table are mapped with a
+  /// single call to the transform's reverse_batch().
   template <class TransformT>
   class ApproximateTransform : public TransformT {
     BBox2i m_bbox;
     ImageView<Vector2> m_table;
+    double m_error;
   public:
     ApproximateTransform( TransformT const& transform, BBox2i const& bbox )
-      : TransformT( transform ), m_bbox( bbox ), m_table(2,2)
+      : TransformT( transform ), m_bbox( bbox ), m_error( 0 )
     {
-      // Initialize with a simple 2x2 lookup table
+      // The table is built off to the side and only installed once
+      // it is good enough, so that any calls back into reverse()
+      // while it is being built go to the exact transform.
       int32 n=2;
-      m_table(0,0) = TransformT::reverse(bbox.min());
-      m_table(1,0) = TransformT::reverse(Vector2(bbox.max().x(),bbox.min().y()));
-      m_table(0,1) = TransformT::reverse(Vector2(bbox.min().x(),bbox.max().y()));
-      m_table(1,1) = TransformT::reverse(bbox.max());
+      ImageView<Vector2> table(2,2);
+      double xs[4] = { double(bbox.min().x()), double(bbox.max().x()), double(bbox.min().x()), double(bbox.max().x()) };
+      double ys[4] = { double(bbox.min().y()), double(bbox.min().y()), double(bbox.max().y()), double(bbox.max().y()) };
+      detail::reverse_batch( static_cast<TransformT const&>( *this ), xs, ys, 4 );
+      table(0,0) = Vector2( xs[0], ys[0] );
+      table(1,0) = Vector2( xs[1], ys[1] );
+      table(0,1) = Vector2( xs[2], ys[2] );
+      table(1,1) = Vector2( xs[3], ys[3] );
 
       // Double the grid density until the worst (squared) approximation error
       // is less than the allowed (squared) tolerance.
       double max_sqr_err = 0;
       double tol_sqr = TransformT::tolerance() * TransformT::tolerance();
       Vector2 origin = bbox.min(), diag = bbox.size();
+      std::vector<double> new_xs, new_ys;
       do {
         n = 2*n-1;
         // Fall back for unapproximatably crazy transform functions.
-        if( n>=bbox.width()|| n>=bbox.height() ) {
-          m_table.reset();
+        if( n>=bbox.width()|| n>=bbox.height() )
           return;
+        ImageView<Vector2> prev = table;
+        table.set_size(n,n);
+
+        // Map the points that are new at this level all at once.
+        new_xs.clear();
+        new_ys.clear();
+        for( int y=0; y<n; ++y ) {
+          for( int x=0; x<n; ++x ) {
+            if( (y%2)==0 && (x%2==0) ) continue;
+            Vector2 pos = origin + elem_prod( Vector2(x,y)/(n-1), diag );
+            new_xs.push_back( pos.x() );
+            new_ys.push_back( pos.y() );
+          }
         }
-        ImageView<Vector2> prev = m_table;
-        m_table.set_size(n,n);
+        detail::reverse_batch( static_cast<TransformT const&>( *this ), &new_xs[0], &new_ys[0], new_xs.size() );
+
         max_sqr_err = 0;
+        size_t k = 0;
         for( int y=0; y<n; ++y ) {
           for( int x=0; x<n; ++x ) {
             if( (y%2)==0 && (x%2==0) ) {
-              m_table(x,y) = prev(x/2,y/2);
+              table(x,y) = prev(x/2,y/2);
             }
             else {
-              Vector2 pos = Vector2(x,y)/(n-1);
-              m_table(x,y) = TransformT::reverse(origin+elem_prod(pos,diag));
+              table(x,y) = Vector2( new_xs[k], new_ys[k] );
+              ++k;
               Vector2 interp;
               if( (y%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2+1,y/2)) / 2.0;
               else if( (x%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2,y/2+1)) / 2.0;
               else interp = (prev(x/2,y/2) + prev(x/2,y/2+1) + prev(x/2+1,y/2) + prev(x/2+1,y/2+1)) / 4.0;
-              double sqr_err = norm_2_sqr( m_table(x,y) - interp );
+              double sqr_err = norm_2_sqr( table(x,y) - interp );
               if( sqr_err > max_sqr_err ) max_sqr_err = sqr_err;
             }
           }
         }
       } while( max_sqr_err > tol_sqr );
+
+      m_table = table;
+      m_error = sqrt( max_sqr_err );
     }
 
+    /// Returns true if the lookup table is in use, false if the
+    /// transform could not be approximated to within its tolerance
+    /// and every call is passed through to it.
+    bool is_approximated() const { return bool( m_table ); }
+
+    /// The error bound of the lookup table, in pixels: the largest
+    /// difference between the transform and the interpolated table
+    /// at the points added by its final refinement.  This is never
+    /// more than the transform's tolerance, and is zero when the
+    /// table is not in use.
+    double approximation_error() const { return m_error; }
+
     inline Vector2 reverse( Vector2 const& p ) const {
       // Fall back if the function was not approximatable.
       if( ! m_table ) return TransformT::reverse( p );
@@ -588,6 +761,50 @@ namespace vw {
                       (m10.y()*(1-normy)+m11.y()*normy)*normx );
     }
 
+    // The same interpolation as reverse(), but since the row lies at
+    // a fixed height in the lookup table, the vertical half of the
+    // interpolation is only done once per table cell.
+    void reverse_row( int32 x, int32 y, int32 n, double* xs, double* ys ) const {
+      if( ! m_table ) return detail::reverse_row( static_cast<TransformT const&>( *this ), x, y, n, xs, ys );
+
+      int tn = m_table.cols() - 1;
+      double py = tn * double(y - m_bbox.min().y()) / (m_bbox.max().y() - m_bbox.min().y());
+      int32 iy = math::impl::_floor(py);
+      if( iy < 0 ) iy = 0;
+      if( iy >= tn ) iy = tn-1;
+      double normy = py-iy;
+
+      int32 cell = -1;
+      Vector2 c0, c1;
+      for( int32 i=0; i<n; ++i ) {
+        double px = tn * double(x + i - m_bbox.min().x()) / (m_bbox.max().x() - m_bbox.min().x());
+        int32 ix = math::impl::_floor(px);
+        if( ix < 0 ) ix = 0;
+        if( ix >= tn ) ix = tn-1;
+        if( ix != cell ) {
+          Vector2 const& m00 = m_table(ix,  iy);
+          Vector2 const& m10 = m_table(ix+1,iy);
+          Vector2 const& m01 = m_table(ix,  iy+1);
+          Vector2 const& m11 = m_table(ix+1,iy+1);
+          c0 = Vector2( m00.x()*(1-normy)+m01.x()*normy, m00.y()*(1-normy)+m01.y()*normy );
+          c1 = Vector2( m10.x()*(1-normy)+m11.x()*normy, m10.y()*(1-normy)+m11.y()*normy );
+          cell = ix;
+        }
+        double normx = px-ix;
+        xs[i] = c0.x()*(1-normx) + c1.x()*normx;
+        ys[i] = c0.y()*(1-normx) + c1.y()*normx;
+      }
+    }
+
+    void reverse_batch( double* xs, double* ys, size_t n ) const {
+      if( ! m_table ) return detail::reverse_batch( static_cast<TransformT const&>( *this ), xs, ys, n );
+      for( size_t i=0; i<n; ++i ) {
+        Vector2 pt = reverse( Vector2(xs[i],ys[i]) );
+        xs[i] = pt[0];
+        ys[i] = pt[1];
+      }
+    }
+
     // Never re-approximate the approximation.
     virtual double tolerance() const { return 0; }
 
@@ -612,6 +829,71 @@ namespace vw {
   };
 
 
+  /// \cond INTERNAL
+  namespace detail {
+
+    /// True if ViewT's pixels are already in memory, so that reading
+    /// them in a different order than one at a time, as TransformView
+    /// does when it fetches a block of source rows, cannot change
+    /// them.  Procedural views, such as the noise views, are not.
+    template <class ViewT> struct IsMemoryView : boost::false_type {};
+    template <class PixelT> struct IsMemoryView<ImageView<PixelT> > : boost::true_type {};
+    template <class PixelT> struct IsMemoryView<CropView<ImageView<PixelT> > > : boost::true_type {};
+
+    /// True if TransformView can interpolate rows of PixelT with
+    /// InterpT eight points at a time.
+    template <class PixelT, class InterpT>
+    struct UseTransformSIMD {
+#if defined(__AVX2__)
+      static const bool value = boost::is_same<InterpT, BilinearInterpolation>::value
+                             && boost::is_same<typename CompoundChannelType<PixelT>::type, float>::value
+                             && CompoundNumChannels<PixelT>::value == 1;
+#else
+      static const bool value = false;
+#endif
+    };
+
+#if defined(__AVX2__)
+    // Bilinearly interpolates a single-channel float image at eight
+    // points, with exactly the arithmetic of BilinearInterpolationImpl.
+    // Pixel (x,y) of the image is at data[(y-y0)*rstride + (x-x0)].
+    inline void transform_bilinear8( float const* data, ssize_t rstride, int32 x0, int32 y0,
+                                     double const* xs, double const* ys, float* result ) {
+      __m256d xlo = _mm256_loadu_pd( xs ), xhi = _mm256_loadu_pd( xs+4 );
+      __m256d ylo = _mm256_loadu_pd( ys ), yhi = _mm256_loadu_pd( ys+4 );
+      __m256i ix = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm256_cvttpd_epi32( _mm256_floor_pd( xlo ) ) ),
+                                            _mm256_cvttpd_epi32( _mm256_floor_pd( xhi ) ), 1 );
+      __m256i iy = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm256_cvttpd_epi32( _mm256_floor_pd( ylo ) ) ),
+                                            _mm256_cvttpd_epi32( _mm256_floor_pd( yhi ) ), 1 );
+      __m256 fx = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm256_cvtpd_ps( xlo ) ), _mm256_cvtpd_ps( xhi ), 1 );
+      __m256 fy = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm256_cvtpd_ps( ylo ) ), _mm256_cvtpd_ps( yhi ), 1 );
+      __m256 normx = _mm256_sub_ps( fx, _mm256_cvtepi32_ps( ix ) ), norm1mx = _mm256_sub_ps( _mm256_set1_ps( 1 ), normx );
+      __m256 normy = _mm256_sub_ps( fy, _mm256_cvtepi32_ps( iy ) ), norm1my = _mm256_sub_ps( _mm256_set1_ps( 1 ), normy );
+
+      // Gathers are slow on many processors, so the corner pixels are
+      // fetched with ordinary loads.
+      int32 cols[8], rows[8];
+      float c00[8], c10[8], c01[8], c11[8];
+      _mm256_storeu_si256( (__m256i*)cols, ix );
+      _mm256_storeu_si256( (__m256i*)rows, iy );
+      for( int k=0; k<8; ++k ) {
+        float const* c = data + ssize_t(rows[k]-y0)*rstride + (cols[k]-x0);
+        c00[k] = c[0]; c10[k] = c[1]; c01[k] = c[rstride]; c11[k] = c[rstride+1];
+      }
+      __m256 p00 = _mm256_loadu_ps( c00 ), p10 = _mm256_loadu_ps( c10 );
+      __m256 p01 = _mm256_loadu_ps( c01 ), p11 = _mm256_loadu_ps( c11 );
+
+      __m256 sum = _mm256_add_ps( _mm256_mul_ps( p00, norm1mx ), _mm256_mul_ps( p10, normx ) );
+      sum = _mm256_mul_ps( sum, norm1my );
+      __m256 row = _mm256_add_ps( _mm256_mul_ps( p01, norm1mx ), _mm256_mul_ps( p11, normx ) );
+      _mm256_storeu_ps( result, _mm256_add_ps( sum, _mm256_mul_ps( row, normy ) ) );
+    }
+#endif
+
+  } // namespace detail
+  /// \endcond
+
+
   // ------------------------
   // class TransformView
   // ------------------------
@@ -663,10 +945,123 @@ namespace vw {
       if( m_mapper.tolerance() > 0.0 ) {
         ApproximateTransform<TransformT> approx_transform( m_mapper, bbox );
         TransformView<ImageT, ApproximateTransform<TransformT> > approx_view( m_image, approx_transform, m_width, m_height );
-        vw::rasterize( approx_view.prerasterize(bbox), dest, bbox );
+        approx_view.rasterize_rows( dest, bbox, m_image );
       }
       else {
+        rasterize_rows( dest, bbox, m_image );
+      }
+    }
+
+    // The general case: rasterize one pixel at a time.
+    template <class DestT, class OtherT>
+    void rasterize_rows( DestT const& dest, BBox2i const& bbox, OtherT const& /*image*/ ) const {
+      vw::rasterize( prerasterize(bbox), dest, bbox );
+    }
+
+    // Fetches the pixels of the edge-extended source image in bbox,
+    // returning them in a buffer whose pixel (0,0) lies at origin.
+    // The child must be in memory; see detail::IsMemoryView.
+    template <class ChildT, class EdgeT>
+    static ImageView<pixel_type> row_buffer( EdgeExtensionView<ChildT,EdgeT> const& view, BBox2i const& bbox, Vector2i& origin ) {
+      origin = bbox.min();
+      return crop( view, bbox );
+    }
+
+    // Images that are already in memory are used in place.
+    template <class EdgeT>
+    static ImageView<pixel_type> row_buffer( EdgeExtensionView<ImageView<pixel_type>,EdgeT> const& view, BBox2i const& bbox, Vector2i& origin ) {
+      BBox2i child_bbox = bbox + view.offset();
+      if( child_bbox.min().x() < 0 || child_bbox.min().y() < 0 ||
+          child_bbox.max().x() > view.child().cols() || child_bbox.max().y() > view.child().rows() ) {
+        origin = bbox.min();
+        return crop( view, bbox );
+      }
+      origin = -view.offset();
+      return view.child();
+    }
+
+    // The usual case, where the child is an interpolated, edge
+    // extended image that is in memory.  Each row of the output is
+    // mapped with reverse_row() and interpolated straight out of the
+    // source pixels, which are copied into one buffer per block if
+    // they are not in one already.  Points that land too near the edge
+    // of the source image fall back to the child view.  The results
+    // are the same as the general case, up to the rounding of
+    // reverse_row().  Other children are left to the general case,
+    // which evaluates each source pixel as it is interpolated.
+    template <class DestT, class ChildT, class EdgeT, class InterpT>
+    void rasterize_rows( DestT const& dest, BBox2i const& bbox,
+                         InterpolationView<EdgeExtensionView<ChildT,EdgeT>,InterpT> const& image ) const {
+      if( ! detail::IsMemoryView<ChildT>::value ) {
+        vw::rasterize( prerasterize(bbox), dest, bbox );
+        return;
+      }
+      BBox2i src_bbox = m_mapper.reverse_bbox( bbox );
+      src_bbox.expand( InterpT::pixel_buffer );
+      src_bbox.crop( BBox2i( 0, 0, image.cols(), image.rows() ) );
+      if( src_bbox.empty() ) {
         vw::rasterize( prerasterize(bbox), dest, bbox );
+        return;
+      }
+
+      Vector2i origin;
+      ImageView<pixel_type> buf = row_buffer( image.child(), src_bbox, origin );
+      typedef CropView<ImageView<pixel_type> > src_type;
+      src_type src( buf, BBox2i( -origin.x(), -origin.y(), image.cols(), image.rows() ) );
+      typedef typename InterpT::template Interpolator<src_type>::type interp_type;
+      interp_type interp = InterpT::interpolator( src );
+
+      // An interpolator reads from pixel_buffer-1 pixels before the
+      // point being interpolated to pixel_buffer pixels after it.
+      const int32 pb = std::max<int32>( InterpT::pixel_buffer, 1 );
+      const double xmin = src_bbox.min().x() + pb - 1, xmax = src_bbox.max().x() - pb;
+      const double ymin = src_bbox.min().y() + pb - 1, ymax = src_bbox.max().y() - pb;
+
+#if defined(__AVX2__)
+      // Single-channel float images are interpolated eight points at
+      // a time, as long as all eight land well inside the source.
+      const bool simd = detail::UseTransformSIMD<pixel_type,InterpT>::value && planes() == 1;
+      float const* simd_data = reinterpret_cast<float const*>( buf.data() );
+      float simd_result[8];
+#endif
+
+      std::vector<double> xs( bbox.width() ), ys( bbox.width() );
+      for( int32 y=0; y<bbox.height(); ++y ) {
+        detail::reverse_row( m_mapper, bbox.min().x(), bbox.min().y()+y, bbox.width(), &xs[0], &ys[0] );
+        for( int32 p=0; p<planes(); ++p ) {
+          typename DestT::pixel_accessor dcol = dest.origin().advance( 0, y, p );
+          int32 x = 0;
+#if defined(__AVX2__)
+          if( simd ) {
+            for( ; x+8 <= bbox.width(); x+=8 ) {
+              bool inside = true;
+              for( int32 k=0; k<8; ++k )
+                inside &= xs[x+k] >= xmin && xs[x+k] < xmax && ys[x+k] >= ymin && ys[x+k] < ymax;
+              if( inside ) {
+                detail::transform_bilinear8( simd_data, buf.cols(), origin.x(), origin.y(), &xs[x], &ys[x], simd_result );
+                for( int32 k=0; k<8; ++k ) {
+                  *dcol = pixel_type( simd_result[k] );
+                  dcol.next_col();
+                }
+              }
+              else {
+                for( int32 k=0; k<8; ++k ) {
+                  *dcol = image( xs[x+k], ys[x+k], p );
+                  dcol.next_col();
+                }
+              }
+            }
+          }
+#endif
+          for( ; x<bbox.width(); ++x ) {
+            double sx = xs[x], sy = ys[x];
+            if( sx >= xmin && sx < xmax && sy >= ymin && sy < ymax )
+              *dcol = interp( src, sx, sy, p );
+            else
+              *dcol = image( sx, sy, p );
+            dcol.next_col();
+          }
+        }
       }
     }
     /// \endcond
@@ -8,6 +8,9 @@
 #include <gtest/gtest.h>
 #include <test/Helpers.h>
 #include <vw/Image/BlockRasterize.h>
+#include <vw/Image/Filter.h>
+
+#include <set>
 
 using namespace vw;
 using namespace std;
@@ -34,3 +37,127 @@ TEST(BlockRasterize, Basic) {
   img2 = b4;
   EXPECT_RANGE_EQ(img1.begin(), img1.end(), img2.begin(), img2.end());
 }
+
+// Several threads rasterizing overlapping regions of the same cached view
+// will miss on the same blocks. Whichever thread loses the race for a block
+// defers it and comes back for it later, and everyone must still get the
+// right pixels.
+template <class ViewT>
+class RasterizeTask {
+  ViewT m_view;
+  BBox2i m_bbox;
+  boost::shared_ptr<ImageView<uint32> > m_result;
+public:
+  RasterizeTask(ViewT const& view, BBox2i const& bbox, boost::shared_ptr<ImageView<uint32> > result)
+    : m_view(view), m_bbox(bbox), m_result(result) {}
+  void operator()() { *m_result = crop(m_view, m_bbox); }
+};
+
+TEST(BlockRasterize, ConcurrentMisses) {
+  typedef ImageView<uint32> Image;
+  typedef BlockRasterizeView<Image> Block;
+
+  Image img(64,64);
+  for (int32 y = 0; y < img.rows(); ++y)
+    for (int32 x = 0; x < img.cols(); ++x)
+      img(x,y) = y*img.cols() + x;
+
+  vw::Cache cache(64*64*sizeof(uint32));
+  Block b = block_cache(img, Vector2i(8,8), 2, cache);
+
+  const int num_threads = 4;
+  std::vector<boost::shared_ptr<Image> > results;
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for (int i = 0; i < num_threads; ++i) {
+    results.push_back(boost::shared_ptr<Image>(new Image()));
+    threads.push_back(boost::shared_ptr<Thread>(new Thread(
+      RasterizeTask<Block>(b, BBox2i(4*i, 4*i, 40, 40), results.back()))));
+  }
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->join();
+
+  for (int i = 0; i < num_threads; ++i) {
+    Image expected = crop(img, BBox2i(4*i, 4*i, 40, 40));
+    EXPECT_RANGE_EQ(expected.begin(), expected.end(), results[i]->begin(), results[i]->end());
+  }
+
+  // Every block that was touched is generated exactly once
+  std::set<std::pair<int,int> > touched;
+  for (int i = 0; i < num_threads; ++i)
+    for (int32 y = 4*i; y < 4*i+40; ++y)
+      for (int32 x = 4*i; x < 4*i+40; ++x)
+        touched.insert(std::make_pair(x/8, y/8));
+  EXPECT_EQ(touched.size(), cache.misses());
+}
+
+TEST(BlockRasterize, Prefetch) {
+  typedef ImageView<uint32> Image;
+  typedef BlockRasterizeView<Image> Block;
+
+  Image img(64,8);
+  for (int32 x = 0; x < img.cols(); ++x)
+    for (int32 y = 0; y < img.rows(); ++y)
+      img(x,y) = x + y;
+
+  vw::Cache cache(64*8*sizeof(uint32));
+  Block b = block_cache(img, Vector2i(8,8), 1, cache, 3);
+
+  // Rasterizing the first block should read the next three ahead.
+  Image result = crop(b, BBox2i(0,0,8,8));
+  for (int i = 0; i < 100 && cache.misses() < 4; ++i)
+    Thread::sleep_ms(10);
+  EXPECT_EQ(4u, cache.misses());
+
+  cache.clear_stats();
+  result = crop(b, BBox2i(8,0,24,8));
+  Image expected = crop(img, BBox2i(8,0,24,8));
+  EXPECT_RANGE_EQ(expected.begin(), expected.end(), result.begin(), result.end());
+  EXPECT_EQ(3u, cache.hits());
+}
+
+TEST(BlockRasterize, PrefetchOutlivedByTasks) {
+  typedef ImageView<uint32> Image;
+  typedef BlockRasterizeView<Image> Block;
+
+  Image img(512,8);
+  for (int32 x = 0; x < img.cols(); ++x)
+    for (int32 y = 0; y < img.rows(); ++y)
+      img(x,y) = x + y;
+
+  // The view and its cache go away while the blocks read ahead of
+  // the first one are still queued or being generated.
+  for (int i = 0; i < 20; ++i) {
+    vw::Cache cache(512*8*sizeof(uint32));
+    Block b = block_cache(img, Vector2i(8,8), 1, cache, 32);
+    Image result = crop(b, BBox2i(0,0,8,8));
+    EXPECT_EQ(img(7,7), result(7,7));
+  }
+}
+
+// Fails like a disk read error on the one pixel with a given value.
+struct ThrowOnValue : public ReturnFixedType<uint32> {
+  uint32 m_value;
+  ThrowOnValue(uint32 value) : m_value(value) {}
+  uint32 operator()(uint32 v) const {
+    if (v == m_value)
+      vw_throw(IOErr() << "ThrowOnValue: bad pixel");
+    return v;
+  }
+};
+
+TEST(BlockRasterize, BlockErrors) {
+  typedef ImageView<uint32> Image;
+
+  Image img(64,64);
+  for (int32 y = 0; y < img.rows(); ++y)
+    for (int32 x = 0; x < img.cols(); ++x)
+      img(x,y) = y*img.cols() + x;
+
+  // One block out of 64 throws on a worker thread, and the caller
+  // must see that error with its type.
+  Image result;
+  EXPECT_THROW(result = block_rasterize(per_pixel_filter(img, ThrowOnValue(img(37,21))), Vector2i(8,8), 4), IOErr);
+
+  result = block_rasterize(per_pixel_filter(img, ThrowOnValue(uint32(-1))), Vector2i(8,8), 4);
+  EXPECT_RANGE_EQ(img.begin(), img.end(), result.begin(), result.end());
+}
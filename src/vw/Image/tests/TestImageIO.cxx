@@ -0,0 +1,157 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+
+#include <vw/Image/ImageIO.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/ImageMath.h>
+#include <vw/Image/PixelMath.h>
+#include <vw/Image/BlockRasterize.h>
+
+#include <test/Helpers.h>
+
+#include <set>
+
+using namespace vw;
+
+// An in-memory resource that records the order its blocks were
+// written in, and checks that they fit the block grid.
+class BlockWriteResource : public DstImageResource {
+  Vector2i m_block_size;
+  bool m_unordered;
+public:
+  ImageView<float> image;
+  std::vector<BBox2i> writes;
+
+  BlockWriteResource( int32 cols, int32 rows, Vector2i const& block_size, bool unordered )
+    : m_block_size(block_size), m_unordered(unordered), image(cols, rows) {}
+
+  virtual void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+    ASSERT_EQ( uint32(bbox.width()), buf.format.cols );
+    ASSERT_EQ( uint32(bbox.height()), buf.format.rows );
+    ASSERT_EQ( 0, bbox.min().x() % m_block_size.x() );
+    ASSERT_EQ( 0, bbox.min().y() % m_block_size.y() );
+    ImageView<float> block( bbox.width(), bbox.height() );
+    convert( block.buffer(), buf );
+    crop( image, bbox ) = block;
+    writes.push_back( bbox );
+  }
+  virtual bool has_block_write() const { return true; }
+  virtual bool has_unordered_block_write() const { return m_unordered; }
+  virtual Vector2i block_write_size() const { return m_block_size; }
+  virtual bool has_nodata_write() const { return false; }
+  virtual void flush() {}
+};
+
+class RecordStatistics : public BlockWriteStatisticsCallback {
+public:
+  int32 reports;
+  BlockWriteStatistics final;
+  RecordStatistics() : reports(0) {}
+  virtual void report_block( BlockWriteStatistics const& stats ) {
+    ++reports;
+    EXPECT_EQ( reports, stats.blocks_written );
+  }
+  virtual void report_finished( BlockWriteStatistics const& stats ) { final = stats; }
+};
+
+// A view that fails to rasterize one particular block, and counts
+// how many times it has been asked to.
+class FailingView : public ImageViewBase<FailingView> {
+  boost::shared_ptr<int32> m_failures;
+public:
+  FailingView() : m_failures( new int32(0) ) {}
+  int32 failures() const { return *m_failures; }
+  typedef float pixel_type;
+  typedef float result_type;
+  typedef ProceduralPixelAccessor<FailingView> pixel_accessor;
+  int32 cols() const { return 100; }
+  int32 rows() const { return 100; }
+  int32 planes() const { return 1; }
+  pixel_accessor origin() const { return pixel_accessor( *this ); }
+  result_type operator()( int32 i, int32 j, int32 /*p*/=0 ) const { return float(i + j); }
+  typedef FailingView prerasterize_type;
+  prerasterize_type prerasterize( BBox2i const& /*bbox*/ ) const { return *this; }
+  template <class DestT> void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    if( bbox.min() == Vector2i(50,50) ) {
+      ++*m_failures;
+      vw_throw( ArgumentErr() << "FailingView: bad block" );
+    }
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+};
+
+static ImageView<float> test_image() {
+  ImageView<float> image( 301, 203 );
+  for( int32 j = 0; j < image.rows(); ++j )
+    for( int32 i = 0; i < image.cols(); ++i )
+      image(i,j) = float( i * 1000 + j );
+  return image;
+}
+
+TEST( ImageIO, BlockWriteOrdered ) {
+  ImageView<float> image = test_image();
+  BlockWriteResource resource( image.cols(), image.rows(), Vector2i(32,16), false );
+
+  BlockWriteOptions options;
+  options.rasterize_threads = 4;
+  options.max_waiting_blocks = 2;
+  RecordStatistics stats;
+  options.statistics = &stats;
+  block_write_image( resource, block_cache( image * 2.0f, Vector2i(40,40), 4 ),
+                     ProgressCallback::dummy_instance(), options );
+
+  EXPECT_SEQ_EQ( image * 2.0f, resource.image );
+
+  int32 num_blocks = 10 * 13;
+  ASSERT_EQ( size_t(num_blocks), resource.writes.size() );
+  for( int32 i = 1; i < num_blocks; ++i ) {
+    BBox2i const& a = resource.writes[i-1], & b = resource.writes[i];
+    EXPECT_TRUE( a.min().y() < b.min().y() || ( a.min().y() == b.min().y() && a.min().x() < b.min().x() ) );
+  }
+
+  EXPECT_EQ( num_blocks, stats.reports );
+  EXPECT_EQ( num_blocks, stats.final.total_blocks );
+  EXPECT_EQ( num_blocks, stats.final.blocks_written );
+  // The buffer pool never needs more than rasterize_threads +
+  // max_waiting_blocks buffers.
+  EXPECT_GE( 6, stats.final.buffers_allocated );
+  EXPECT_GE( 6, stats.final.max_waiting_blocks );
+}
+
+TEST( ImageIO, BlockWriteUnordered ) {
+  ImageView<float> image = test_image();
+  BlockWriteResource resource( image.cols(), image.rows(), Vector2i(64,64), true );
+
+  BlockWriteOptions options;
+  options.rasterize_threads = 3;
+  options.max_waiting_blocks = 1;
+  RecordStatistics stats;
+  options.statistics = &stats;
+  block_write_image( resource, image + 1.0f, ProgressCallback::dummy_instance(), options );
+
+  EXPECT_SEQ_EQ( image + 1.0f, resource.image );
+
+  // Every block is written exactly once, in whatever order.
+  std::set<std::pair<int32,int32> > blocks;
+  for( size_t i = 0; i < resource.writes.size(); ++i )
+    blocks.insert( std::make_pair( resource.writes[i].min().x(), resource.writes[i].min().y() ) );
+  EXPECT_EQ( size_t(5 * 4), resource.writes.size() );
+  EXPECT_EQ( size_t(5 * 4), blocks.size() );
+  EXPECT_GE( 4, stats.final.buffers_allocated );
+}
+
+TEST( ImageIO, BlockWriteFailure ) {
+  BlockWriteResource resource( 100, 100, Vector2i(25,25), false );
+  FailingView view;
+  EXPECT_THROW( block_write_image( resource, view ), ArgumentErr );
+  EXPECT_GT( size_t(16), resource.writes.size() );
+  // The error is rethrown as it was caught, not by rasterizing the
+  // block again.
+  EXPECT_EQ( 1, view.failures() );
+}
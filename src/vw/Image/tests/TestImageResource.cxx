@@ -11,9 +11,13 @@
 #include <vw/Image/ImageResourceImpl.h>
 #include <vw/Image/PixelTypeInfo.h>
 #include <vw/Image/PixelTypes.h>
+#include <vw/Core/Stopwatch.h>
 
 #include <test/Helpers.h>
 
+#include <iostream>
+#include <vector>
+
 #if defined(VW_HAVE_PKG_OPENCV) && (VW_HAVE_PKG_OPENCV==1)
 # include <opencv/cxcore.h>
 #endif
@@ -63,6 +67,115 @@ TEST( ImageResource, PreMultiply ) {
   EXPECT_RANGE_EQ(buf3_data+0, buf3_data+4, buf1_data+0, buf1_data+4);
 }
 
+// Builds an ImageBuffer over a vector of pixels.
+template <class PixelT>
+static ImageBuffer pixel_buffer( std::vector<PixelT>& data, uint32 cols, uint32 rows, bool premultiplied = true ) {
+  ImageFormat fmt;
+  fmt.cols = cols;
+  fmt.rows = rows;
+  fmt.planes = 1;
+  fmt.pixel_format = PixelFormatID<PixelT>::value;
+  fmt.channel_type = ChannelTypeID<typename PixelChannelType<PixelT>::type>::value;
+  fmt.premultiplied = premultiplied;
+  return ImageBuffer( fmt, &data[0] );
+}
+
+// Rows are converted as spans, with a vectorized body and a scalar
+// tail, so use a width that exercises both.
+TEST( ImageResource, ConvertRows ) {
+  const uint32 cols = 37, rows = 3, n = cols*rows;
+
+  std::vector<uint16> u16(n);
+  std::vector<uint8> u8(n), u8_back(n);
+  std::vector<float> f32(n);
+  std::vector<uint16> u16_back(n);
+  for( uint32 i=0; i<n; ++i ) u16[i] = uint16( i*1771 );
+
+  convert( pixel_buffer(f32,cols,rows), pixel_buffer(u16,cols,rows), true );
+  for( uint32 i=0; i<n; ++i ) EXPECT_EQ( float(u16[i]) * (1.0f/65535), f32[i] );
+  convert( pixel_buffer(f32,cols,rows), pixel_buffer(u16,cols,rows), false );
+  for( uint32 i=0; i<n; ++i ) EXPECT_EQ( float(u16[i]), f32[i] );
+
+  convert( pixel_buffer(u8,cols,rows), pixel_buffer(u16,cols,rows), true );
+  for( uint32 i=0; i<n; ++i ) EXPECT_EQ( u16[i] / 257, u8[i] );
+  convert( pixel_buffer(u16_back,cols,rows), pixel_buffer(u8,cols,rows), true );
+  for( uint32 i=0; i<n; ++i ) EXPECT_EQ( u8[i] * 257, u16_back[i] );
+
+  for( uint32 i=0; i<n; ++i ) f32[i] = float(i)/50 - 0.5f;
+  convert( pixel_buffer(u8_back,cols,rows), pixel_buffer(f32,cols,rows), true );
+  for( uint32 i=0; i<n; ++i ) {
+    uint8 expected = f32[i] > 1 ? 255 : f32[i] < 0 ? 0 : uint8( f32[i] * 255 );
+    EXPECT_EQ( expected, u8_back[i] );
+  }
+}
+
+TEST( ImageResource, ConvertPixelFormats ) {
+  typedef PixelRGBA<uint8> Px;
+  const uint32 cols = 21;
+  std::vector<Px> rgba(cols);
+  for( uint32 i=0; i<cols; ++i ) rgba[i] = Px( uint8(i*3), uint8(i*5), uint8(i*7), uint8(255-i) );
+
+  // Dropping the alpha channel premultiplies the colors.
+  std::vector<PixelGrayA<uint8> > graya(cols);
+  for( uint32 i=0; i<cols; ++i ) graya[i] = PixelGrayA<uint8>( uint8(i*9), uint8(255-i*4) );
+  std::vector<PixelGray<float> > grayf(cols);
+  convert( pixel_buffer(grayf,cols,1), pixel_buffer(graya,cols,1,false), true );
+  for( uint32 i=0; i<cols; ++i )
+    EXPECT_EQ( float( round( graya[i].v() * (graya[i].a()/255.0) ) ) * (1.0f/255), grayf[i].v() );
+
+  // Averaging to gray keeps the alpha channel.
+  convert( pixel_buffer(graya,cols,1), pixel_buffer(rgba,cols,1), true );
+  for( uint32 i=0; i<cols; ++i ) {
+    EXPECT_EQ( (rgba[i].r() + rgba[i].g() + rgba[i].b()) / 3, graya[i].v() );
+    EXPECT_EQ( rgba[i].a(), graya[i].a() );
+  }
+
+  // Gray is triplicated, and an opaque alpha channel added.
+  std::vector<PixelGray<uint8> > gray(cols);
+  for( uint32 i=0; i<cols; ++i ) gray[i] = PixelGray<uint8>( uint8(i*11) );
+  std::vector<Px> back(cols);
+  convert( pixel_buffer(back,cols,1), pixel_buffer(gray,cols,1), true );
+  for( uint32 i=0; i<cols; ++i )
+    EXPECT_PIXEL_EQ( Px( gray[i].v(), gray[i].v(), gray[i].v(), 255 ), back[i] );
+
+  // Planes of a scalar image become the channels of a pixel.  This
+  // reads the planes with a pixel stride larger than one channel.
+  std::vector<uint8> planes(3*cols);
+  for( uint32 i=0; i<3*cols; ++i ) planes[i] = uint8(i);
+  ImageBuffer planar = pixel_buffer(planes,cols,1);
+  planar.format.planes = 3;
+  std::vector<PixelRGB<uint8> > interleaved(cols);
+  convert( pixel_buffer(interleaved,cols,1), planar );
+  for( uint32 i=0; i<cols; ++i )
+    EXPECT_PIXEL_EQ( PixelRGB<uint8>( uint8(i), uint8(cols+i), uint8(2*cols+i) ), interleaved[i] );
+}
+
+TEST( ImageResource, DISABLED_ConvertBenchmark ) {
+  const uint32 size = 4096;
+  std::vector<uint16> u16(size*size);
+  for( uint32 i=0; i<u16.size(); ++i ) u16[i] = uint16( i*31 );
+  std::vector<float> f32(size*size);
+
+  Stopwatch sw;
+  sw.start();
+  convert( pixel_buffer(f32,size,size), pixel_buffer(u16,size,size), true );
+  sw.stop();
+  std::cout << "Convert 4096x4096 uint16 to float: " << sw.elapsed_seconds() << "s" << std::endl;
+  for( uint32 i=0; i<u16.size(); i+=4099 )
+    EXPECT_EQ( float(u16[i]) * (1.0f/65535), f32[i] );
+
+  typedef PixelRGBA<uint8> Px;
+  std::vector<Px> rgba(size*size/4), premultiplied(size*size/4);
+  for( uint32 i=0; i<rgba.size(); ++i ) rgba[i] = Px( uint8(i), uint8(i*3), uint8(i*5), uint8(i*7) );
+  Stopwatch sw2;
+  sw2.start();
+  convert( pixel_buffer(premultiplied,size/2,size/2,true), pixel_buffer(rgba,size/2,size/2,false), true );
+  sw2.stop();
+  std::cout << "Premultiply 2048x2048 RGBA uint8: " << sw2.elapsed_seconds() << "s" << std::endl;
+  for( uint32 i=0; i<rgba.size(); i+=4099 )
+    EXPECT_EQ( uint8( round( rgba[i].g() * (rgba[i].a()/255.0) ) ), premultiplied[i].g() );
+}
+
 class SrcNoopResource : public SrcImageResource {
   private:
     const ImageFormat& m_fmt;
@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 #include <test/Helpers.h>
 
+#include <vw/Core/Stopwatch.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Transform.h>
 
@@ -148,3 +149,133 @@ TEST( Transform, Compose ) {
   }
 
 }
+
+// Rasterizes a transformed view one pixel at a time, the way
+// TransformView did before it learned to work a row at a time.
+template <class ViewT>
+static ImageView<typename ViewT::pixel_type> rasterize_per_pixel( ViewT const& view ) {
+  BBox2i bbox( 0, 0, view.cols(), view.rows() );
+  ImageView<typename ViewT::pixel_type> result( view.cols(), view.rows(), view.planes() );
+  vw::rasterize( view.prerasterize(bbox), result, bbox );
+  return result;
+}
+
+template <class PixelT>
+static ImageView<PixelT> transform_test_image() {
+  ImageView<PixelT> image( 61, 47 );
+  for( int32 j=0; j<image.rows(); ++j )
+    for( int32 i=0; i<image.cols(); ++i )
+      image(i,j) = PixelT( typename CompoundChannelType<PixelT>::type( (i*7 + j*13) % 200 ) );
+  return image;
+}
+
+template <class PixelT, class TransformT>
+static void check_row_transform( TransformT const& tx ) {
+  ImageView<PixelT> image = transform_test_image<PixelT>();
+  double tol = boost::is_floating_point<typename CompoundChannelType<PixelT>::type>::value ? 1e-4 : 1;
+
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( image, tx, ZeroEdgeExtension(), BilinearInterpolation() ) ),
+                   ImageView<PixelT>( transform( image, tx, ZeroEdgeExtension(), BilinearInterpolation() ) ), tol );
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( image, tx, ConstantEdgeExtension(), BicubicInterpolation() ) ),
+                   ImageView<PixelT>( transform( image, tx, ConstantEdgeExtension(), BicubicInterpolation() ) ), tol );
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( image, tx, PeriodicEdgeExtension(), NearestPixelInterpolation() ) ),
+                   ImageView<PixelT>( transform( image, tx, PeriodicEdgeExtension(), NearestPixelInterpolation() ) ), tol );
+
+  // A source that is in memory, but not in an ImageView.
+  BBox2i image_bbox( 0, 0, image.cols(), image.rows() );
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( crop( image, image_bbox ), tx, ZeroEdgeExtension(), BilinearInterpolation() ) ),
+                   ImageView<PixelT>( transform( crop( image, image_bbox ), tx, ZeroEdgeExtension(), BilinearInterpolation() ) ), tol );
+
+  // A block that maps partly outside of the source image.
+  BBox2i bbox( 40, 3, 21, 40 );
+  ImageView<PixelT> block = crop( transform( image, tx, ZeroEdgeExtension(), BicubicInterpolation() ), bbox );
+  EXPECT_SEQ_NEAR( crop( rasterize_per_pixel( transform( image, tx, ZeroEdgeExtension(), BicubicInterpolation() ) ), bbox ),
+                   block, tol );
+}
+
+template <class PixelT>
+static void check_row_transforms() {
+  Matrix3x3 h( 0.9, 0.1, 3.2,
+               -0.15, 1.05, -2.5,
+               0.001, -0.0005, 1 );
+  check_row_transform<PixelT>( TranslateTransform( 2.5, -3.25 ) );
+  check_row_transform<PixelT>( AffineTransform( Matrix2x2( 0.8, 0.3, -0.2, 1.1 ), Vector2( 4.5, -1.75 ) ) );
+  check_row_transform<PixelT>( RotateTransform( 0.3, Vector2( 30, 20 ) ) );
+  check_row_transform<PixelT>( HomographyTransform( h ) );
+
+
+  // Transforms with a tolerance are rasterized through an
+  // ApproximateTransform built over the block being rasterized.
+  HomographyTransform approx( h );
+  approx.set_tolerance( 0.1 );
+  ImageView<PixelT> image = transform_test_image<PixelT>();
+  ApproximateTransform<HomographyTransform> table( approx, BBox2i( 0, 0, image.cols(), image.rows() ) );
+  double tol = boost::is_floating_point<typename CompoundChannelType<PixelT>::type>::value ? 1e-4 : 1;
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( image, table, ZeroEdgeExtension(), BilinearInterpolation() ) ),
+                   ImageView<PixelT>( transform( image, approx, ZeroEdgeExtension(), BilinearInterpolation() ) ), tol );
+  EXPECT_SEQ_NEAR( rasterize_per_pixel( transform( image, table, ConstantEdgeExtension(), BicubicInterpolation() ) ),
+                   ImageView<PixelT>( transform( image, approx, ConstantEdgeExtension(), BicubicInterpolation() ) ), tol );
+}
+
+TEST( Transform, RowRasterize ) {
+  check_row_transforms<float>();
+  check_row_transforms<uint8>();
+  check_row_transforms<PixelRGB<float> >();
+}
+
+TEST( Transform, ApproximateReverseRow ) {
+  HomographyTransform h( Matrix3x3( 0.9, 0.1, 3.2, -0.15, 1.05, -2.5, 0.001, -0.0005, 1 ) );
+  ApproximateTransform<HomographyTransform> approx( h, BBox2i( 10, 5, 250, 190 ) );
+  std::vector<double> xs(250), ys(250);
+  for( int32 y=5; y<195; y+=17 ) {
+    approx.reverse_row( 10, y, 250, &xs[0], &ys[0] );
+    for( int32 x=0; x<250; ++x ) {
+      Vector2 expected = approx.reverse( Vector2(x+10,y) );
+      EXPECT_NEAR( expected[0], xs[x], 1e-9 );
+      EXPECT_NEAR( expected[1], ys[x], 1e-9 );
+    }
+  }
+}
+
+// A transform that overrides reverse(), but not the reverse_row() it
+// inherits.
+class WarpedAffineTransform : public AffineTransform {
+public:
+  WarpedAffineTransform( Matrix2x2 const& matrix, Vector2 const& offset ) : AffineTransform( matrix, offset ) {}
+  Vector2 reverse( Vector2 const& p ) const {
+    Vector2 q = AffineTransform::reverse( p );
+    return Vector2( 1.1 * q[0] + 0.05 * q[1], q[1] );
+  }
+};
+
+TEST( Transform, ReverseRowOverride ) {
+  WarpedAffineTransform tx( Matrix2x2( 0.8, 0.3, -0.2, 1.1 ), Vector2( 4.5, -1.75 ) );
+  std::vector<double> xs(50), ys(50);
+  detail::reverse_row( tx, 3, 7, 50, &xs[0], &ys[0] );
+  for( int32 x=0; x<50; ++x ) {
+    Vector2 expected = tx.reverse( Vector2(x+3,7) );
+    EXPECT_NEAR( expected[0], xs[x], 1e-9 );
+    EXPECT_NEAR( expected[1], ys[x], 1e-9 );
+  }
+  check_row_transform<float>( tx );
+}
+
+TEST( Transform, DISABLED_RowRasterizeBenchmark ) {
+  ImageView<float> image( 2048, 2048 );
+  for( int32 j=0; j<image.rows(); ++j )
+    for( int32 i=0; i<image.cols(); ++i )
+      image(i,j) = float( (i*7 + j*13) % 200 );
+  AffineTransform tx( Matrix2x2( 0.95, 0.2, -0.2, 0.95 ), Vector2( 100, -50 ) );
+
+  Stopwatch per_pixel, rows;
+  per_pixel.start();
+  ImageView<float> expected = rasterize_per_pixel( transform( image, tx, ZeroEdgeExtension(), BilinearInterpolation() ) );
+  per_pixel.stop();
+  rows.start();
+  ImageView<float> result = transform( image, tx, ZeroEdgeExtension(), BilinearInterpolation() );
+  rows.stop();
+
+  EXPECT_SEQ_NEAR( expected, result, 1e-3 );
+  std::cout << "2048x2048 affine bilinear warp: per pixel " << per_pixel.elapsed_seconds()
+            << "s, by rows " << rows.elapsed_seconds() << "s" << std::endl;
+}
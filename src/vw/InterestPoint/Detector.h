@@ -16,6 +16,8 @@
 #include <vw/Core/Settings.h>
 #include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageViewRef.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Algorithms.h>
 #include <vw/Image/Statistics.h>
 #include <vw/Image/Filter.h>
 
@@ -85,46 +87,77 @@ namespace ip {
     ViewT m_view;
     DetectorT& m_detector;
     BBox2i m_bbox;
+    int32 m_halo;
     InterestPointList& m_interest_point_list;
-    Mutex& m_mutex;
     int m_id, m_max_id;
 
   public:
-    InterestPointDetectionTask(ViewT const& view, DetectorT& detector, BBox2i bbox,
-                               InterestPointList& ip_list, Mutex &mutex, int id, int max_id ) :
-      m_view(view), m_detector(detector), m_bbox(bbox),
-      m_interest_point_list(ip_list), m_mutex(mutex), m_id(id), m_max_id(max_id) {}
+    InterestPointDetectionTask(ViewT const& view, DetectorT& detector, BBox2i bbox, int32 halo,
+                               InterestPointList& ip_list, int id, int max_id ) :
+      m_view(view), m_detector(detector), m_bbox(bbox), m_halo(halo),
+      m_interest_point_list(ip_list), m_id(id), m_max_id(max_id) {}
 
     void operator()() {
       vw_out(InfoMessage, "interest_point") << "Locating interest points in block " << m_id << "/" << m_max_id << "   [ " << m_bbox << " ]\n";
-      InterestPointList new_ip_list = m_detector(crop(pixel_cast<PixelGray<float> >(channel_cast_rescale<float>(m_view.impl())), m_bbox),0);
-      for (InterestPointList::iterator pt = new_ip_list.begin(); pt != new_ip_list.end(); ++pt) {
-        (*pt).x +=  m_bbox.min().x();
-        (*pt).ix += m_bbox.min().x();
-        (*pt).y +=  m_bbox.min().y();
-        (*pt).iy += m_bbox.min().y();
-      }
 
-      // Append these interest points to the master list owned by the
-      // detect_interest_points() function.
-      {
-        Mutex::Lock lock(m_mutex);
-        m_interest_point_list.splice(m_interest_point_list.end(), new_ip_list);
+      // Detect in the block grown by the halo, so that features near
+      // the block's edges see the same neighborhood they would in the
+      // full image.  The block is rasterized once, as float, so the
+      // detector's filters all run on a contiguous buffer.
+      BBox2i detect_bbox = m_bbox;
+      detect_bbox.expand(m_halo);
+      detect_bbox.crop(bounding_box(m_view.impl()));
+      ImageView<PixelGray<float> > block = crop(pixel_cast<PixelGray<float> >(channel_cast_rescale<float>(m_view.impl())), detect_bbox);
+      InterestPointList new_ip_list = m_detector(block,0);
+
+      InterestPointList::iterator pt = new_ip_list.begin();
+      while (pt != new_ip_list.end()) {
+        (*pt).x +=  detect_bbox.min().x();
+        (*pt).ix += detect_bbox.min().x();
+        (*pt).y +=  detect_bbox.min().y();
+        (*pt).iy += detect_bbox.min().y();
+
+        // Each pixel belongs to exactly one block, and a block keeps
+        // only the points whose pixel it owns.  Points found in the
+        // halo are left to the neighboring block that owns them.
+        // (Points localized just off the image belong to the block
+        // at that edge.)
+        Vector2i owner( std::min(std::max((*pt).ix, 0), m_view.impl().cols()-1),
+                        std::min(std::max((*pt).iy, 0), m_view.impl().rows()-1) );
+        if (m_halo > 0 && !m_bbox.contains(owner))
+          pt = new_ip_list.erase(pt);
+        else
+          ++pt;
       }
+
+      // This task is the only writer of its own result list, which
+      // detect_interest_points() concatenates once all tasks finish.
+      m_interest_point_list.swap(new_ip_list);
     }
     InterestPointList interest_point_list() { return m_interest_point_list; }
   };
 
   /// This free function implements a multithreaded interest point
-  /// detector.  Threads are spun off to process the image in
-  /// 2048x2048 pixel blocks.
+  /// detector.  Threads are spun off to process the image in blocks
+  /// of vw_settings().default_tile_size() pixels (at least 1024x1024).
+  ///
+  /// If halo is zero each block is processed on its own, so a few
+  /// interest points along the block seams may be lost or shifted.
+  /// Otherwise each block is processed together with a border of
+  /// halo pixels from its neighbors, and keeps only the points whose
+  /// integer location falls inside the block itself.  With a halo at
+  /// least as wide as the detector's support (and, for scaled
+  /// detectors, a tile size that is a multiple of the coarsest
+  /// octave's subsampling), the result matches running the detector
+  /// over the whole image, apart from the per-block max_points cull.
+  ///
+  /// The points are returned in block order, whatever the number of
+  /// threads.
   template <class ViewT, class DetectorT>
-  InterestPointList detect_interest_points (ViewT const& view, DetectorT& detector) {
+  InterestPointList detect_interest_points (ViewT const& view, DetectorT& detector, int32 halo = 0) {
     typedef InterestPointDetectionTask<ViewT, DetectorT> task_type;
 
     FifoWorkQueue queue(vw_settings().default_num_threads());
-    InterestPointList ip_list;
-    Mutex mutex;     // Used to lock access to ip_list by the child threads.
 
     vw_out(DebugMessage, "interest_point") << "Running MT interest point detector.  Input image: [ " << view.impl().cols() << " x " << view.impl().rows() << " ]\n";
 
@@ -133,13 +166,18 @@ namespace ip {
     if (tile_size < 1024) tile_size = 1024;
     std::vector<BBox2i> bboxes = image_blocks(view.impl(),
                                               tile_size, tile_size);
+    std::vector<InterestPointList> block_ip_lists(bboxes.size());
     for (unsigned i = 0; i < bboxes.size(); ++i) {
-      boost::shared_ptr<task_type> task (new task_type(view, detector, bboxes[i], ip_list, mutex, i+1, bboxes.size() ) );
+      boost::shared_ptr<task_type> task (new task_type(view, detector, bboxes[i], halo, block_ip_lists[i], i+1, bboxes.size() ) );
       queue.add_task(task);
     }
     vw_out(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
     queue.join_all();
 
+    InterestPointList ip_list;
+    for (unsigned i = 0; i < block_ip_lists.size(); ++i)
+      ip_list.splice(ip_list.end(), block_ip_lists[i]);
+
     vw_out(DebugMessage, "interest_point") << "MT interest point detection complete.  " << ip_list.size() << " interest point detected.\n";
     return ip_list;
   }
@@ -15,9 +15,16 @@
 #include <algorithm>
 
 #include <vw/Core/Log.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/InterestPoint/Descriptor.h>
+#include <vw/InterestPoint/MatcherSIMD.h>
 #include <vector>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/utility.hpp>
 
 #if VW_HAVE_PKG_FLANN
 #include <vw/Math/FLANNTree.h>
@@ -48,6 +55,55 @@ namespace ip {
     }
   };
 
+  /// Brute force L2 norm: the squared Euclidean distance, like
+  /// L2NormMetric.  Choosing it as the MetricT of an
+  /// InterestPointMatcher makes the matcher compare every pair of
+  /// descriptors with vectorized kernels instead of searching a tree.
+  /// The matches are exact, and for sets of up to a few tens of
+  /// thousands of points the search is faster than building a tree.
+  ///
+  /// Each descriptor element is multiplied by a scale before it is
+  /// converted to ChannelT.  With ChannelT = uint8 the scaled values
+  /// are rounded and clamped to [0,255], which quarters the memory
+  /// traffic; the default scale of 255 suits normalized descriptors,
+  /// whose elements lie in [0,1].  For other channel types the
+  /// default scale is 1.
+  template <class ChannelT = float>
+  struct BruteForceL2Metric {
+    typedef ChannelT channel_type;
+
+    float scale;
+
+    BruteForceL2Metric( float scale = default_scale() ) : scale(scale) {}
+
+    static float default_scale() { return 1; }
+
+    /// Converts a descriptor element to the channel type compared.
+    ChannelT channel( float value ) const { return ChannelT(value * scale); }
+
+    double operator() (InterestPoint const& ip1, InterestPoint const& ip2,
+                       float maxdist = std::numeric_limits<float>::max()) const {
+      double dist = 0.0;
+      for (size_t i = 0; i < ip1.descriptor.size(); i++) {
+        double diff = double(channel(ip1.descriptor[i])) - double(channel(ip2.descriptor[i]));
+        dist += diff*diff;
+        if (dist > maxdist) break;  // abort calculation if distance exceeds upper bound
+      }
+      return dist;
+    }
+  };
+
+  template <>
+  inline float BruteForceL2Metric<uint8>::default_scale() { return 255; }
+
+  template <>
+  inline uint8 BruteForceL2Metric<uint8>::channel( float value ) const {
+    value *= scale;
+    if (!(value > 0)) return 0;
+    if (value >= 255) return 255;
+    return uint8(value + 0.5f);
+  }
+
   /// KL distance (relative entropy) between interest point
   /// descriptors. Optional argument "maxdist" to provide early
   /// termination of computation if result will exceed maxdist.
@@ -161,108 +217,403 @@ namespace ip {
   //                         Interest Point Matcher
   // ---------------------------------------------------------------------------
 
-  /// Interest point matcher class
-  template < class MetricT, class ConstraintT >
-  class InterestPointMatcher {
-    ConstraintT m_constraint;
-    MetricT m_distance_metric;
-    double m_threshold;
-
-  public:
-
-    InterestPointMatcher(double threshold = 0.5, MetricT metric = MetricT(), ConstraintT constraint = ConstraintT())
-      : m_constraint(constraint), m_distance_metric(metric), m_threshold(threshold) { }
-
-    /// Given two lists of interest points, this routine returns the two lists
-    /// of matching interest points based on the Metric and Constraints
-    /// provided by the user.
-    template <class ListT, class MatchListT>
-    void operator()( ListT const& ip1, ListT const& ip2,
-                     MatchListT& matched_ip1, MatchListT& matched_ip2,
-                     bool bidirectional = false,
-                     const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
-      typedef typename ListT::const_iterator IterT;
-
-      Timer *total = new Timer("Total elapsed time", DebugMessage, "interest_point");
-
-      matched_ip1.clear(); matched_ip2.clear();
-      if (!ip1.size() || !ip2.size()) {
-        vw_out(InfoMessage,"interest_point") << "KD-Tree: no points to match, exiting\n";
-        progress_callback.report_finished();
-        return;
+  /// \cond INTERNAL
+  namespace detail {
+
+    /// Copies the descriptors of a list of interest points into the
+    /// rows of a contiguous float matrix, and collects pointers to the
+    /// points themselves in the same order.
+    template <class ListT>
+    void gather_descriptors( ListT const& ips, Matrix<float>& descriptors,
+                             std::vector<InterestPoint const*>& points ) {
+      descriptors.set_size( ips.size(), ips.begin()->size() );
+      points.clear();
+      points.reserve( ips.size() );
+      Matrix<float>::iterator it = descriptors.begin();
+      BOOST_FOREACH( InterestPoint const& ip, ips ) {
+        it = std::copy( ip.begin(), ip.end(), it );
+        points.push_back( &ip );
       }
-
-      size_t size = ip1.size();
-      float inc_amt = 1.0f/float(size);
+    }
 
 #if VW_HAVE_PKG_FLANN
-      Matrix<float> ip2_matrix( ip2.size(), ip2.begin()->size() );
-      Matrix<float>::iterator ip2_matrix_it = ip2_matrix.begin();
-      BOOST_FOREACH( InterestPoint const& ip, ip2 )
-        ip2_matrix_it = std::copy( ip.begin(), ip.end(), ip2_matrix_it );
-
-      math::FLANNTree<flann::L2<float> > kd( ip2_matrix );
-      vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
-
-      Vector<int> indices(2);
-      Vector<float> distances(2);
+    /// A nearest neighbor index over the rows of a descriptor matrix,
+    /// which must outlive it.  FLANN trees may be searched from
+    /// several threads at once, so every searcher shares this one.
+    class DescriptorIndex : private boost::noncopyable {
+      math::FLANNTree<flann::L2<float> > m_tree;
+    public:
+      template <class MetricT>
+      DescriptorIndex( Matrix<float> const& descriptors, MetricT const& /*metric*/ ) : m_tree( descriptors ) {
+        vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
+      }
+      math::FLANNTree<flann::L2<float> >& tree() { return m_tree; }
+    };
+
+    /// Searches a DescriptorIndex on behalf of one thread.
+    class DescriptorSearcher {
+      DescriptorIndex& m_index;
+    public:
+      DescriptorSearcher( DescriptorIndex& index ) : m_index(index) {}
+
+      /// Finds the k nearest indexed descriptors to each row of
+      /// queries.  Row i of indices and distances holds the indices
+      /// (-1 where there are fewer than k) and squared L2 distances
+      /// of the neighbors of query i, nearest first.
+      template <class MatrixT>
+      void knn( MatrixBase<MatrixT> const& queries, size_t k,
+                Matrix<int>& indices, Matrix<float>& distances ) {
+        m_index.tree().knn_search( queries, indices, distances, k );
+      }
+    };
 #else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
+    /// A KDTree record that remembers which descriptor it came from.
+    struct IndexedDescriptor {
+      typedef std::vector<float>::const_iterator const_iterator;
+      std::vector<float> descriptor;
+      int index;
+      const_iterator begin() const { return descriptor.begin(); }
+      const_iterator end() const { return descriptor.end(); }
+    };
+
+    /// A nearest neighbor index over the rows of a descriptor matrix.
+    /// Every searcher shares the one tree, and keeps the state of its
+    /// searches to itself.
+    class DescriptorIndex : private boost::noncopyable {
+    public:
+      typedef math::KDTree<std::vector<IndexedDescriptor> > tree_type;
+    private:
+      boost::scoped_ptr<tree_type> m_tree;
+    public:
+      template <class MetricT>
+      DescriptorIndex( Matrix<float> const& descriptors, MetricT const& /*metric*/ ) {
+        std::vector<IndexedDescriptor> records( descriptors.rows() );
+        for ( size_t i = 0; i < descriptors.rows(); ++i ) {
+          records[i].descriptor.assign( &descriptors(i,0), &descriptors(i,0) + descriptors.cols() );
+          records[i].index = int(i);
+        }
+        m_tree.reset( new tree_type( descriptors.cols(), records ) );
+        vw_out(InfoMessage,"interest_point") << "KD-Tree created. Searching...\n";
+      }
+      tree_type const& tree() const { return *m_tree; }
+    };
+
+    /// Searches a DescriptorIndex on behalf of one thread.
+    class DescriptorSearcher {
+      DescriptorIndex::tree_type const& m_tree;
+      DescriptorIndex::tree_type::search_queue_t m_queue;
+      std::vector<IndexedDescriptor> m_nearest;
+    public:
+      DescriptorSearcher( DescriptorIndex& index ) : m_tree( index.tree() ) {}
+
+      /// Finds the k nearest indexed descriptors to each row of
+      /// queries.  Row i of indices and distances holds the indices
+      /// (-1 where there are fewer than k) and squared L2 distances
+      /// of the neighbors of query i, nearest first.
+      template <class MatrixT>
+      void knn( MatrixBase<MatrixT> const& queries, size_t k,
+                Matrix<int>& indices, Matrix<float>& distances ) {
+        MatrixT const& q = queries.impl();
+        indices.set_size( q.rows(), k );
+        distances.set_size( q.rows(), k );
+        for ( size_t i = 0; i < q.rows(); ++i ) {
+          size_t found = m_tree.m_nearest_neighbors( select_row( q, i ), m_nearest, k, m_queue );
+          for ( size_t j = 0; j < k; ++j ) {
+            if ( j < found ) {
+              std::vector<float> const& d = m_nearest[j].descriptor;
+              float dist = 0;
+              for ( size_t c = 0; c < d.size(); ++c )
+                dist += (q(i,c) - d[c]) * (q(i,c) - d[c]);
+              indices(i,j) = m_nearest[j].index;
+              distances(i,j) = dist;
+            } else {
+              indices(i,j) = -1;
+              distances(i,j) = std::numeric_limits<float>::max();
+            }
+          }
+        }
+      }
+    };
 #endif
-      progress_callback.report_progress(0);
 
-      BOOST_FOREACH( InterestPoint ip, ip1 ) {
-        if (progress_callback.abort_requested())
-          vw_throw( Aborted() << "Aborted by ProgressCallback" );
-        progress_callback.report_incremental_progress(inc_amt);
+    /// Brute force nearest neighbor search over the rows of a
+    /// descriptor matrix, converted to ChannelT by the metric.
+    template <class ChannelT>
+    class BruteForceIndex : private boost::noncopyable {
+      BruteForceL2Metric<ChannelT> m_metric;
+      std::vector<ChannelT> m_data;
+      size_t m_rows, m_cols;
+    public:
+      BruteForceIndex( Matrix<float> const& descriptors, BruteForceL2Metric<ChannelT> const& metric )
+        : m_metric( metric ), m_data( descriptors.rows() * descriptors.cols() ),
+          m_rows( descriptors.rows() ), m_cols( descriptors.cols() ) {
+        float const* src = descriptors.data();
+        for ( size_t i = 0; i < m_data.size(); ++i )
+          m_data[i] = m_metric.channel( src[i] );
+      }
+      BruteForceL2Metric<ChannelT> const& metric() const { return m_metric; }
+      ChannelT const* row( size_t i ) const { return &m_data[i*m_cols]; }
+      size_t rows() const { return m_rows; }
+      size_t cols() const { return m_cols; }
+    };
+
+    /// Searches a BruteForceIndex on behalf of one thread.  The index
+    /// is walked in tiles small enough to stay in cache, and each tile
+    /// is compared against every query before moving on to the next.
+    template <class ChannelT>
+    class BruteForceSearcher {
+      BruteForceIndex<ChannelT> const& m_index;
+      std::vector<ChannelT> m_queries;
+      std::vector<double> m_best;
+    public:
+      BruteForceSearcher( BruteForceIndex<ChannelT>& index ) : m_index(index) {}
+
+      /// Finds the k nearest indexed descriptors to each row of
+      /// queries.  Row i of indices and distances holds the indices
+      /// (-1 where there are fewer than k) and squared L2 distances
+      /// of the neighbors of query i, nearest first.  Ties go to the
+      /// lower index.
+      template <class MatrixT>
+      void knn( MatrixBase<MatrixT> const& queries, size_t k,
+                Matrix<int>& indices, Matrix<float>& distances ) {
+        MatrixT const& q = queries.impl();
+        const size_t num_queries = q.rows(), cols = m_index.cols();
+        indices.set_size( num_queries, k );
+        distances.set_size( num_queries, k );
+        std::fill( indices.begin(), indices.end(), -1 );
+        m_best.assign( num_queries * k, std::numeric_limits<double>::max() );
+
+        m_queries.resize( num_queries * cols );
+        for ( size_t i = 0; i < num_queries; ++i )
+          for ( size_t c = 0; c < cols; ++c )
+            m_queries[i*cols+c] = m_index.metric().channel( q(i,c) );
+
+        // Aim for tiles of about 256KB.
+        const size_t tile_rows = std::max<size_t>( 1, (256*1024) / (cols*sizeof(ChannelT) + 1) );
+        for ( size_t tile = 0; tile < m_index.rows(); tile += tile_rows ) {
+          const size_t tile_end = std::min( m_index.rows(), tile + tile_rows );
+          for ( size_t i = 0; i < num_queries; ++i ) {
+            ChannelT const* query = &m_queries[i*cols];
+            double* best = &m_best[i*k];
+            int* best_index = &indices(i,0);
+            for ( size_t j = tile; j < tile_end; ++j ) {
+              double dist = squared_distance( query, m_index.row(j), cols );
+              if ( !(dist < best[k-1]) )
+                continue;
+              size_t pos = k-1;
+              for ( ; pos > 0 && dist < best[pos-1]; --pos ) {
+                best[pos] = best[pos-1];
+                best_index[pos] = best_index[pos-1];
+              }
+              best[pos] = dist;
+              best_index[pos] = int(j);
+            }
+          }
+        }
 
-        std::vector<InterestPoint> nearest_records(2);
-#if VW_HAVE_PKG_FLANN
-        kd.knn_search( ip.descriptor, indices, distances, 2 );
-        nearest_records[0] = ip2[indices[0]];
-        nearest_records[1] = ip2[indices[1]];
-#else
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
-          continue; // Ignore if there are no matches
-#endif
+        for ( size_t i = 0; i < num_queries; ++i )
+          for ( size_t j = 0; j < k; ++j )
+            distances(i,j) = indices(i,j) < 0 ? std::numeric_limits<float>::max() : float(m_best[i*k+j]);
+      }
+    };
+
+    /// Selects the nearest neighbor search a matcher with MetricT
+    /// uses.  use_search_distances is true if the squared L2
+    /// distances the search reports are the metric's own distances.
+    template <class MetricT>
+    struct MatcherSearch {
+      typedef DescriptorIndex index_type;
+      typedef DescriptorSearcher searcher_type;
+      static const bool use_search_distances = boost::is_same<MetricT, L2NormMetric>::value;
+    };
+
+    template <class ChannelT>
+    struct MatcherSearch<BruteForceL2Metric<ChannelT> > {
+      typedef BruteForceIndex<ChannelT> index_type;
+      typedef BruteForceSearcher<ChannelT> searcher_type;
+      static const bool use_search_distances = true;
+    };
+
+    /// Returns rows [begin,end) of a descriptor matrix, which are
+    /// contiguous, as a matrix of their own.
+    inline MatrixProxy<float> query_rows( Matrix<float> const& queries, size_t begin, size_t end ) {
+      return MatrixProxy<float>( const_cast<float*>( queries.data() + begin * queries.cols() ),
+                                 end - begin, queries.cols() );
+    }
 
-        bool constraint_satisfied = false;
-        if (bidirectional) {
-          if (m_constraint(nearest_records[0], ip) &&
-              m_constraint(ip, nearest_records[0]))
-            constraint_satisfied = true;
-        } else {
-          if (m_constraint(nearest_records[0], ip))
-            constraint_satisfied = true;
+    /// Hands out consecutive chunks of [0,size) to the matching
+    /// threads, reporting progress as it goes.
+    class MatchChunks : private boost::noncopyable {
+      Mutex m_mutex;
+      size_t m_next, m_size, m_chunk;
+      ProgressCallback const& m_progress;
+      bool m_aborted;
+    public:
+      MatchChunks( size_t size, size_t chunk, ProgressCallback const& progress )
+        : m_next(0), m_size(size), m_chunk(chunk), m_progress(progress), m_aborted(false) {}
+
+      /// Claims the next chunk, returning false when there are none
+      /// left or the progress callback has asked to abort.
+      bool next( size_t& begin, size_t& end ) {
+        Mutex::Lock lock(m_mutex);
+        if ( m_next >= m_size || m_aborted ) return false;
+        if ( m_progress.abort_requested() ) {
+          m_aborted = true;
+          return false;
         }
-        if (constraint_satisfied) {
-          double dist0 = m_distance_metric(nearest_records[0], ip);
-          double dist1 = m_distance_metric(nearest_records[1], ip);
+        begin = m_next;
+        end = std::min( m_size, m_next + m_chunk );
+        m_next = end;
+        m_progress.report_incremental_progress( float(end - begin) / float(m_size) );
+        return true;
+      }
+
+      bool aborted() const { return m_aborted; }
+    };
+
+    /// A matching thread: claims chunks until none remain and passes
+    /// each to work.process() along with the thread's own searcher.
+    template <class SearchT, class WorkT>
+    class MatchWorker : public Task, private boost::noncopyable {
+      WorkT& m_work;
+      typename SearchT::index_type& m_index;
+      MatchChunks& m_chunks;
+    public:
+      MatchWorker( WorkT& work, typename SearchT::index_type& index, MatchChunks& chunks )
+        : m_work(work), m_index(index), m_chunks(chunks) {}
+
+      void operator()() {
+        typename SearchT::searcher_type searcher( m_index );
+        Matrix<int> indices;
+        Matrix<float> distances;
+        size_t begin, end;
+        while ( m_chunks.next( begin, end ) )
+          m_work.process( searcher, begin, end, indices, distances );
+      }
+    };
+
+    /// Runs work.process() over [0,size) in chunks, on the default
+    /// number of threads.
+    template <class SearchT, class WorkT>
+    void match_in_chunks( WorkT& work, typename SearchT::index_type& index, size_t size,
+                          ProgressCallback const& progress ) {
+      static const size_t chunk_size = 256;
+      MatchChunks chunks( size, chunk_size, progress );
+      int num_threads = vw_settings().default_num_threads();
+      if ( num_threads < 1 ) num_threads = 1;
+      {
+        FifoWorkQueue queue( num_threads );
+        for ( int i = 0; i < num_threads; ++i )
+          queue.add_task( boost::shared_ptr<Task>( new MatchWorker<SearchT, WorkT>( work, index, chunks ) ) );
+        queue.join_all();
+      }
+      if ( chunks.aborted() )
+        vw_throw( Aborted() << "Aborted by ProgressCallback" );
+    }
 
-          if (dist0 < m_threshold * dist1) {
-            matched_ip1.push_back(ip);
-            matched_ip2.push_back(nearest_records[0]);
+    /// Matches each point of the first list to its nearest neighbor
+    /// in the second, subject to the constraint and the ratio test.
+    template <class MetricT, class ConstraintT>
+    struct RatioTestWork {
+      Matrix<float> const& queries;
+      std::vector<InterestPoint const*> const& points1;
+      std::vector<InterestPoint const*> const& points2;
+      MetricT const& metric;
+      ConstraintT const& constraint;
+      double threshold;
+      bool bidirectional;
+      std::vector<int>& match_index;
+
+      RatioTestWork( Matrix<float> const& queries,
+                     std::vector<InterestPoint const*> const& points1,
+                     std::vector<InterestPoint const*> const& points2,
+                     MetricT const& metric, ConstraintT const& constraint,
+                     double threshold, bool bidirectional, std::vector<int>& match_index )
+        : queries(queries), points1(points1), points2(points2), metric(metric), constraint(constraint),
+          threshold(threshold), bidirectional(bidirectional), match_index(match_index) {}
+
+      template <class SearcherT>
+      void process( SearcherT& searcher, size_t begin, size_t end,
+                    Matrix<int>& indices, Matrix<float>& distances ) {
+        searcher.knn( query_rows( queries, begin, end ), 2, indices, distances );
+        for ( size_t i = begin; i < end; ++i ) {
+          int j0 = indices(i-begin,0), j1 = indices(i-begin,1);
+          match_index[i] = -1;
+          if ( j0 < 0 || j1 < 0 )
+            continue; // Ignore if there are no matches
+
+          InterestPoint const& ip = *points1[i];
+          InterestPoint const& nearest0 = *points2[j0];
+          InterestPoint const& nearest1 = *points2[j1];
+          if ( !constraint( nearest0, ip ) || ( bidirectional && !constraint( ip, nearest0 ) ) )
+            continue;
+
+          // The search already measured squared L2 distances, so only
+          // other metrics need to be evaluated again.
+          double dist0, dist1;
+          if ( MatcherSearch<MetricT>::use_search_distances ) {
+            dist0 = distances(i-begin,0);
+            dist1 = distances(i-begin,1);
+          } else {
+            dist0 = metric( nearest0, ip );
+            dist1 = metric( nearest1, ip );
           }
+          if ( dist0 < threshold * dist1 )
+            match_index[i] = j0;
         }
       }
+    };
+
+    /// Finds the nearest neighbor in the first list of each of a set
+    /// of points from the second list, to cross-check matches.
+    struct CrossCheckWork {
+      Matrix<float> const& queries;
+      std::vector<int>& nearest;
+
+      CrossCheckWork( Matrix<float> const& queries, std::vector<int>& nearest )
+        : queries(queries), nearest(nearest) {}
+
+      template <class SearcherT>
+      void process( SearcherT& searcher, size_t begin, size_t end,
+                    Matrix<int>& indices, Matrix<float>& distances ) {
+        searcher.knn( query_rows( queries, begin, end ), 1, indices, distances );
+        for ( size_t i = begin; i < end; ++i )
+          nearest[i] = indices(i-begin,0);
+      }
+    };
 
-      progress_callback.report_finished();
-      delete total;
-    }
-  };
+  } // namespace detail
+  /// \endcond
 
-  // Specialization to capture more speed.
-  template <>
-  class InterestPointMatcher<L2NormMetric, NullConstraint> {
+  /// Interest point matcher class
+  ///
+  /// The descriptors of both lists are copied into contiguous float
+  /// matrices, and a nearest neighbor index (FLANN if available,
+  /// otherwise KDTree, or an exhaustive search for
+  /// BruteForceL2Metric) is built over the second list.  The points of
+  /// the first list are then matched in chunks on the default number
+  /// of threads.  Each point's two nearest neighbors are found, and
+  /// the nearest is accepted if it satisfies the constraint and its
+  /// distance is less than threshold times the second's.  All the
+  /// threads search the same index.
+  ///
+  /// In mutual mode a match is only kept if the point from the
+  /// first list is in turn the nearest neighbor of its match among
+  /// all the points of the first list.
+  template < class MetricT, class ConstraintT >
+  class InterestPointMatcher {
+    typedef detail::MatcherSearch<MetricT> search_type;
+
+    ConstraintT m_constraint;
+    MetricT m_distance_metric;
     double m_threshold;
-    L2NormMetric m_metric;
+    bool m_mutual;
 
   public:
 
-    InterestPointMatcher(double threshold = 0.5, L2NormMetric metric = L2NormMetric(), NullConstraint /*constraint*/ = NullConstraint())
-      : m_threshold(threshold), m_metric(metric) { }
+    InterestPointMatcher(double threshold = 0.5, MetricT metric = MetricT(), ConstraintT constraint = ConstraintT(),
+                         bool mutual = false)
+      : m_constraint(constraint), m_distance_metric(metric), m_threshold(threshold), m_mutual(mutual) { }
 
     /// Given two lists of interest points, this routine returns the two lists
     /// of matching interest points based on the Metric and Constraints
@@ -270,11 +621,10 @@ namespace ip {
     template <class ListT, class MatchListT>
     void operator()( ListT const& ip1, ListT const& ip2,
                      MatchListT& matched_ip1, MatchListT& matched_ip2,
-                     bool /*bidirectional*/ = false,
+                     bool bidirectional = false,
                      const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
-      typedef typename ListT::const_iterator IterT;
 
-      Timer *total = new Timer("Total elapsed time", DebugMessage, "interest_point");
+      Timer total("Total elapsed time", DebugMessage, "interest_point");
 
       matched_ip1.clear(); matched_ip2.clear();
       if (!ip1.size() || !ip2.size()) {
@@ -283,55 +633,58 @@ namespace ip {
         return;
       }
 
-      size_t size = ip1.size();
-      float inc_amt = 1.0f/float(size);
+      Matrix<float> descriptors1, descriptors2;
+      std::vector<InterestPoint const*> points1, points2;
+      detail::gather_descriptors( ip1, descriptors1, points1 );
+      detail::gather_descriptors( ip2, descriptors2, points2 );
 
-#if VW_HAVE_PKG_FLANN
-      Matrix<float> ip2_matrix( ip2.size(), ip2.begin()->size() );
-      Matrix<float>::iterator ip2_matrix_it = ip2_matrix.begin();
-      BOOST_FOREACH( InterestPoint const& ip, ip2 )
-        ip2_matrix_it = std::copy( ip.begin(), ip.end(), ip2_matrix_it );
-
-      math::FLANNTree<flann::L2<float> > kd( ip2_matrix );
-      vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
-
-      Vector<int> indices(2);
-      Vector<float> distances(2);
-#else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
-#endif
       progress_callback.report_progress(0);
 
-      BOOST_FOREACH( InterestPoint ip, ip1 ) {
-        if (progress_callback.abort_requested())
-          vw_throw( Aborted() << "Aborted by ProgressCallback" );
-        progress_callback.report_incremental_progress(inc_amt);
+      std::vector<int> match_index( points1.size(), -1 );
+      {
+        typename search_type::index_type index( descriptors2, m_distance_metric );
+        detail::RatioTestWork<MetricT, ConstraintT> work( descriptors1, points1, points2, m_distance_metric,
+                                                          m_constraint, m_threshold, bidirectional, match_index );
+        detail::match_in_chunks<search_type>( work, index, points1.size(), progress_callback );
+      }
 
+      if ( m_mutual )
+        cross_check( descriptors1, descriptors2, match_index );
 
-#if VW_HAVE_PKG_FLANN
-        kd.knn_search( ip.descriptor, indices, distances, 2 );
-        if ( distances[0] < m_threshold * distances[1] ) {
-          matched_ip1.push_back(ip);
-          matched_ip2.push_back(ip2[indices[0]]);
-        }
-#else
-        std::vector<InterestPoint> nearest_records(2);
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
-          continue; // Ignore if there are no matches
-        double dist0 = m_metric(nearest_records[0], ip);
-        double dist1 = m_metric(nearest_records[1], ip);
-
-        if (dist0 < m_threshold * dist1) {
-          matched_ip1.push_back(ip);
-          matched_ip2.push_back(nearest_records[0]);
+      progress_callback.report_finished();
+
+      for ( size_t i = 0; i < match_index.size(); ++i ) {
+        if ( match_index[i] != -1 ) {
+          matched_ip1.push_back( *points1[i] );
+          matched_ip2.push_back( *points2[match_index[i]] );
         }
-#endif
       }
+    }
 
-      progress_callback.report_finished();
-      delete total;
+  private:
+    // Drops the matches whose point in the second list does not have
+    // its match as its own nearest neighbor in the first list.
+    void cross_check( Matrix<float> const& descriptors1, Matrix<float> const& descriptors2,
+                      std::vector<int>& match_index ) const {
+      std::vector<int> matched;
+      for ( size_t i = 0; i < match_index.size(); ++i )
+        if ( match_index[i] != -1 )
+          matched.push_back( int(i) );
+      if ( matched.empty() )
+        return;
+
+      Matrix<float> queries( matched.size(), descriptors2.cols() );
+      for ( size_t m = 0; m < matched.size(); ++m )
+        select_row( queries, m ) = select_row( descriptors2, match_index[matched[m]] );
+
+      std::vector<int> nearest( matched.size() );
+      typename search_type::index_type index( descriptors1, m_distance_metric );
+      detail::CrossCheckWork work( queries, nearest );
+      detail::match_in_chunks<search_type>( work, index, matched.size(), ProgressCallback::dummy_instance() );
+
+      for ( size_t m = 0; m < matched.size(); ++m )
+        if ( nearest[m] != matched[m] )
+          match_index[matched[m]] = -1;
     }
   };
 
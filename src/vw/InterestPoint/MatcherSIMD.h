@@ -0,0 +1,138 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file MatcherSIMD.h
+///
+/// Vectorized squared L2 distance kernels used by the brute force
+/// descriptor search in \ref Matcher.h, for float and uint8
+/// descriptors.  The instruction set is chosen at compile time: AVX2
+/// if the compiler is targeting it, otherwise SSE2, otherwise plain
+/// loops.
+///
+#ifndef __VW_INTERESTPOINT_MATCHERSIMD_H__
+#define __VW_INTERESTPOINT_MATCHERSIMD_H__
+
+#include <cstddef>
+
+#include <vw/Core/FundamentalTypes.h>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define VW_MATCHER_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VW_MATCHER_SIMD 1
+#else
+# define VW_MATCHER_SIMD 0
+#endif
+
+namespace vw {
+namespace ip {
+
+  /// \cond INTERNAL
+  namespace detail {
+
+#if VW_MATCHER_SIMD == 2
+    inline float horizontal_sum( __m256 v ) {
+      __m128 s = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+      s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+      s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+      return _mm_cvtss_f32( s );
+    }
+    inline int32 horizontal_sum( __m256i v ) {
+      __m128i s = _mm_add_epi32( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE(1,0,3,2) ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE(2,3,0,1) ) );
+      return _mm_cvtsi128_si32( s );
+    }
+#elif VW_MATCHER_SIMD == 1
+    inline float horizontal_sum( __m128 s ) {
+      s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+      s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+      return _mm_cvtss_f32( s );
+    }
+    inline int32 horizontal_sum( __m128i s ) {
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE(1,0,3,2) ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE(2,3,0,1) ) );
+      return _mm_cvtsi128_si32( s );
+    }
+#endif
+
+    /// Returns the squared L2 distance between two float descriptors
+    /// of length n.
+    inline float squared_distance( float const* a, float const* b, size_t n ) {
+      size_t i = 0;
+      float sum = 0;
+#if VW_MATCHER_SIMD == 2
+      __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+      for ( ; i + 16 <= n; i += 16 ) {
+        __m256 d0 = _mm256_sub_ps( _mm256_loadu_ps( a+i ),   _mm256_loadu_ps( b+i ) );
+        __m256 d1 = _mm256_sub_ps( _mm256_loadu_ps( a+i+8 ), _mm256_loadu_ps( b+i+8 ) );
+        acc0 = _mm256_add_ps( acc0, _mm256_mul_ps( d0, d0 ) );
+        acc1 = _mm256_add_ps( acc1, _mm256_mul_ps( d1, d1 ) );
+      }
+      for ( ; i + 8 <= n; i += 8 ) {
+        __m256 d0 = _mm256_sub_ps( _mm256_loadu_ps( a+i ), _mm256_loadu_ps( b+i ) );
+        acc0 = _mm256_add_ps( acc0, _mm256_mul_ps( d0, d0 ) );
+      }
+      sum = horizontal_sum( _mm256_add_ps( acc0, acc1 ) );
+#elif VW_MATCHER_SIMD == 1
+      __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+      for ( ; i + 8 <= n; i += 8 ) {
+        __m128 d0 = _mm_sub_ps( _mm_loadu_ps( a+i ),   _mm_loadu_ps( b+i ) );
+        __m128 d1 = _mm_sub_ps( _mm_loadu_ps( a+i+4 ), _mm_loadu_ps( b+i+4 ) );
+        acc0 = _mm_add_ps( acc0, _mm_mul_ps( d0, d0 ) );
+        acc1 = _mm_add_ps( acc1, _mm_mul_ps( d1, d1 ) );
+      }
+      for ( ; i + 4 <= n; i += 4 ) {
+        __m128 d0 = _mm_sub_ps( _mm_loadu_ps( a+i ), _mm_loadu_ps( b+i ) );
+        acc0 = _mm_add_ps( acc0, _mm_mul_ps( d0, d0 ) );
+      }
+      sum = horizontal_sum( _mm_add_ps( acc0, acc1 ) );
+#endif
+      for ( ; i < n; ++i )
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+      return sum;
+    }
+
+    /// Returns the squared L2 distance between two uint8 descriptors
+    /// of length n.  The sum is exact for n up to 33025.
+    inline int32 squared_distance( uint8 const* a, uint8 const* b, size_t n ) {
+      size_t i = 0;
+      int32 sum = 0;
+#if VW_MATCHER_SIMD == 2
+      __m256i acc = _mm256_setzero_si256();
+      for ( ; i + 16 <= n; i += 16 ) {
+        __m256i d = _mm256_sub_epi16( _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i const*)(a+i) ) ),
+                                      _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i const*)(b+i) ) ) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( d, d ) );
+      }
+      sum = horizontal_sum( acc );
+#elif VW_MATCHER_SIMD == 1
+      // Widen to 16 bits, difference, then square and add pairs of
+      // lanes into 32 bit sums.
+      __m128i zero = _mm_setzero_si128(), acc = _mm_setzero_si128();
+      for ( ; i + 16 <= n; i += 16 ) {
+        __m128i va = _mm_loadu_si128( (__m128i const*)(a+i) );
+        __m128i vb = _mm_loadu_si128( (__m128i const*)(b+i) );
+        __m128i lo = _mm_sub_epi16( _mm_unpacklo_epi8( va, zero ), _mm_unpacklo_epi8( vb, zero ) );
+        __m128i hi = _mm_sub_epi16( _mm_unpackhi_epi8( va, zero ), _mm_unpackhi_epi8( vb, zero ) );
+        acc = _mm_add_epi32( acc, _mm_add_epi32( _mm_madd_epi16( lo, lo ), _mm_madd_epi16( hi, hi ) ) );
+      }
+      sum = horizontal_sum( acc );
+#endif
+      for ( ; i < n; ++i )
+        sum += (int32(a[i]) - int32(b[i])) * (int32(a[i]) - int32(b[i]));
+      return sum;
+    }
+
+  } // namespace detail
+  /// \endcond
+
+}} // namespace vw::ip
+
+#endif // __VW_INTERESTPOINT_MATCHERSIMD_H__
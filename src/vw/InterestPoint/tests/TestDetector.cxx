@@ -0,0 +1,83 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+#include <vw/Core/Settings.h>
+#include <vw/InterestPoint/Detector.h>
+
+#include <algorithm>
+
+using namespace vw;
+using namespace vw::ip;
+using namespace vw::test;
+
+namespace {
+  // A field of gaussian blobs, several of which straddle the seam
+  // between the first two 1024 pixel blocks at x = 1024.
+  ImageView<PixelGray<float> > blob_image() {
+    ImageView<PixelGray<float> > image(1400,300);
+    for ( int32 j = 0; j < image.rows(); ++j )
+      for ( int32 i = 0; i < image.cols(); ++i ) {
+        float value = 0;
+        for ( int32 by = 30; by < image.rows(); by += 60 )
+          for ( int32 bx = 37 + (by/60)%2 * 23; bx < image.cols(); bx += 47 ) {
+            float dx = i - bx, dy = j - by;
+            value += exp( -(dx*dx + dy*dy) / 50.0 );
+          }
+        image(i,j) = value / 2;
+      }
+    return image;
+  }
+
+  bool ip_less( InterestPoint const& a, InterestPoint const& b ) {
+    if ( a.x != b.x ) return a.x < b.x;
+    return a.y < b.y;
+  }
+
+  std::vector<InterestPoint> sorted( InterestPointList const& list ) {
+    std::vector<InterestPoint> result( list.begin(), list.end() );
+    std::sort( result.begin(), result.end(), ip_less );
+    return result;
+  }
+}
+
+TEST( Detector, TiledHaloMatchesWholeImage ) {
+  ImageView<PixelGray<float> > image = blob_image();
+  InterestPointDetector<HarrisInterestOperator> detector( HarrisInterestOperator(1e-6), 0 );
+
+  std::vector<InterestPoint> whole = sorted( detector( image ) );
+  ASSERT_GT( whole.size(), 100u );
+
+  int32 old_threads = vw_settings().default_num_threads();
+  int32 old_tile_size = vw_settings().default_tile_size();
+  vw_settings().set_default_tile_size( 1024 );
+  vw_settings().set_default_num_threads( 2 );
+
+  std::vector<InterestPoint> tiled = sorted( detect_interest_points( image, detector, 32 ) );
+  InterestPointList untiled_list = detect_interest_points( image, detector );
+
+  vw_settings().set_default_num_threads( old_threads );
+  vw_settings().set_default_tile_size( old_tile_size );
+
+  // With a halo, every point is found exactly once, exactly where it
+  // is found in the whole image.
+  ASSERT_EQ( whole.size(), tiled.size() );
+  for ( size_t i = 0; i < whole.size(); ++i ) {
+    EXPECT_EQ( whole[i].ix, tiled[i].ix );
+    EXPECT_EQ( whole[i].iy, tiled[i].iy );
+    EXPECT_NEAR( whole[i].x, tiled[i].x, 1e-4 );
+    EXPECT_NEAR( whole[i].y, tiled[i].y, 1e-4 );
+    EXPECT_NEAR( whole[i].orientation, tiled[i].orientation, 1e-4 );
+  }
+
+  // Without one, the blocks' edges change what is found near the seam.
+  std::vector<InterestPoint> untiled = sorted( untiled_list );
+  bool same = untiled.size() == whole.size();
+  for ( size_t i = 0; same && i < whole.size(); ++i )
+    same = whole[i].ix == untiled[i].ix && whole[i].iy == untiled[i].iy;
+  EXPECT_FALSE( same );
+}
@@ -10,9 +10,12 @@
 
 #include <vw/InterestPoint/Matcher.h>
 #include <vw/InterestPoint/InterestData.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Stopwatch.h>
 #include <test/Helpers.h>
 
 #include <algorithm>
+#include <iostream>
 
 using namespace vw;
 using namespace vw::ip;
@@ -104,3 +107,225 @@ TEST( Matcher, Matcher ) {
 }
 
 
+
+TEST( Matcher, MatcherConstraint ) {
+  InterestPoint ip1a(0,0,1.0,1.0,0.0);
+  ip1a.descriptor = Vector3(0,7.7,0);
+  std::vector<InterestPoint> ip1_list(1,ip1a), ip2_list;
+  for ( int i = 5; i < 10; ++i ) {
+    ip2_list.push_back( InterestPoint(20,0,1.0,1.0,0.0) );
+    ip2_list.back().descriptor = Vector3(0,i,0);
+  }
+  std::vector<InterestPoint> matched_ip1, matched_ip2;
+
+  InterestPointMatcher<L2NormMetric,PositionConstraint> near_matcher;
+  near_matcher(ip1_list, ip2_list, matched_ip1, matched_ip2);
+  EXPECT_EQ( 0u, matched_ip1.size() );
+
+  InterestPointMatcher<L2NormMetric,PositionConstraint> far_matcher(0.5, L2NormMetric(), PositionConstraint(-30,30,-30,30));
+  far_matcher(ip1_list, ip2_list, matched_ip1, matched_ip2);
+  ASSERT_EQ( 1u, matched_ip1.size() );
+  EXPECT_VECTOR_FLOAT_EQ( matched_ip2[0].descriptor, Vector3(0,8,0) );
+}
+
+TEST( Matcher, MatcherMutual ) {
+  // Both points of ip1 have 8 as their nearest neighbor, but 8 is
+  // nearest to the second.
+  std::vector<InterestPoint> ip1_list(2), ip2_list;
+  ip1_list[0].descriptor = Vector3(0,7.7,0);
+  ip1_list[1].descriptor = Vector3(0,7.9,0);
+  for ( int i = 5; i < 10; ++i ) {
+    ip2_list.push_back( InterestPoint() );
+    ip2_list.back().descriptor = Vector3(0,i,0);
+  }
+  std::vector<InterestPoint> matched_ip1, matched_ip2;
+
+  InterestPointMatcher<L2NormMetric,NullConstraint> matcher;
+  matcher(ip1_list, ip2_list, matched_ip1, matched_ip2);
+  EXPECT_EQ( 2u, matched_ip1.size() );
+
+  InterestPointMatcher<L2NormMetric,NullConstraint> mutual(0.5, L2NormMetric(), NullConstraint(), true);
+  mutual(ip1_list, ip2_list, matched_ip1, matched_ip2);
+  ASSERT_EQ( 1u, matched_ip1.size() );
+  EXPECT_NEAR( matched_ip1[0].descriptor[1], 7.9, 1e-5 );
+  EXPECT_VECTOR_FLOAT_EQ( matched_ip2[0].descriptor, Vector3(0,8,0) );
+}
+
+// Random descriptors in [0,scale), and noisy, shuffled copies of
+// them.  With a scale other than 1 the descriptors are quantized to
+// whole numbers, like uint8 descriptors when the scale is 255, and
+// the noisy copies stay within [0,scale].
+static void noisy_descriptors( size_t num_points, size_t length,
+                               std::vector<InterestPoint>& ip1_list, std::vector<InterestPoint>& ip2_list,
+                               float scale = 1.0f ) {
+  ip1_list.resize( num_points );
+  ip2_list.resize( num_points );
+  srand(42);
+  for ( size_t i = 0; i < num_points; ++i ) {
+    ip1_list[i].x = float(i);
+    ip1_list[i].descriptor.set_size( length );
+    for ( size_t j = 0; j < length; ++j ) {
+      ip1_list[i].descriptor[j] = scale * float(rand()) / RAND_MAX;
+      if ( scale != 1.0f )
+        ip1_list[i].descriptor[j] = floorf( ip1_list[i].descriptor[j] );
+    }
+  }
+  for ( size_t i = 0; i < num_points; ++i ) {
+    ip2_list[i] = ip1_list[(i * 7919) % num_points];
+    for ( size_t j = 0; j < length; ++j ) {
+      float noise = float(rand()) / RAND_MAX - 0.5f;
+      if ( scale == 1.0f )
+        ip2_list[i].descriptor[j] += 0.01f * noise;
+      else
+        ip2_list[i].descriptor[j] = std::min( scale, std::max( 0.0f, ip2_list[i].descriptor[j] + floorf( 0.2f * scale * noise ) ) );
+    }
+  }
+}
+
+// The matches do not depend on the number of threads searching the
+// shared tree.
+TEST( Matcher, MatcherThreads ) {
+  const size_t num_points = 1000;
+  std::vector<InterestPoint> ip1_list, ip2_list;
+  noisy_descriptors( num_points, 16, ip1_list, ip2_list );
+
+  int32 old_threads = vw_settings().default_num_threads();
+  std::vector<InterestPoint> single_ip1, single_ip2;
+  const int threads[] = { 1, 2, 4 };
+  for ( int t = 0; t < 3; ++t ) {
+    vw_settings().set_default_num_threads( threads[t] );
+    std::vector<InterestPoint> matched_ip1, matched_ip2;
+    InterestPointMatcher<L2NormMetric,NullConstraint> matcher(0.8, L2NormMetric(), NullConstraint(), true);
+    matcher(ip1_list, ip2_list, matched_ip1, matched_ip2);
+
+    ASSERT_EQ( matched_ip1.size(), matched_ip2.size() );
+    EXPECT_GT( matched_ip1.size(), num_points * 9 / 10 );
+    for ( size_t i = 0; i < matched_ip1.size(); ++i )
+      EXPECT_EQ( matched_ip1[i].x, matched_ip2[i].x );
+    if ( t == 0 ) {
+      single_ip1 = matched_ip1;
+      single_ip2 = matched_ip2;
+    } else {
+      ASSERT_EQ( single_ip1.size(), matched_ip1.size() );
+      for ( size_t i = 0; i < matched_ip1.size(); ++i ) {
+        EXPECT_EQ( single_ip1[i].x, matched_ip1[i].x );
+        EXPECT_EQ( single_ip2[i].x, matched_ip2[i].x );
+      }
+    }
+  }
+  vw_settings().set_default_num_threads( old_threads );
+}
+
+// Times matching a few thousand points with increasing numbers of
+// threads.
+TEST( Matcher, DISABLED_MatcherThreadsBenchmark ) {
+  const size_t num_points = 4000;
+  std::vector<InterestPoint> ip1_list, ip2_list;
+  noisy_descriptors( num_points, 16, ip1_list, ip2_list );
+
+  int32 old_threads = vw_settings().default_num_threads();
+  const int threads[] = { 1, 2, 4, 8 };
+  for ( int t = 0; t < 4; ++t ) {
+    vw_settings().set_default_num_threads( threads[t] );
+    std::vector<InterestPoint> matched_ip1, matched_ip2;
+    InterestPointMatcher<L2NormMetric,NullConstraint> matcher(0.8, L2NormMetric(), NullConstraint(), true);
+    Stopwatch sw;
+    sw.start();
+    matcher(ip1_list, ip2_list, matched_ip1, matched_ip2);
+    sw.stop();
+    std::cout << "Matched " << num_points << " points with " << threads[t] << " threads in "
+              << sw.elapsed_seconds() << "s" << std::endl;
+    EXPECT_GT( matched_ip1.size(), num_points * 9 / 10 );
+  }
+  vw_settings().set_default_num_threads( old_threads );
+}
+
+TEST( Matcher, BruteForceMatchesExhaustiveSearch ) {
+  std::vector<InterestPoint> ip1_list, ip2_list;
+  noisy_descriptors( 1500, 37, ip1_list, ip2_list, 255 );
+
+  std::vector<InterestPoint> simple_ip1, simple_ip2;
+  InterestPointMatcherSimple<L2NormMetric,NullConstraint> simple(0.8);
+  simple(ip1_list, ip2_list, simple_ip1, simple_ip2);
+  ASSERT_GT( simple_ip1.size(), 100u );
+
+  // Quantized descriptors are compared exactly in either channel type.
+  std::vector<InterestPoint> float_ip1, float_ip2, byte_ip1, byte_ip2;
+  InterestPointMatcher<BruteForceL2Metric<float>,NullConstraint> float_matcher(0.8);
+  float_matcher(ip1_list, ip2_list, float_ip1, float_ip2);
+  InterestPointMatcher<BruteForceL2Metric<uint8>,NullConstraint> byte_matcher(0.8, BruteForceL2Metric<uint8>(1));
+  byte_matcher(ip1_list, ip2_list, byte_ip1, byte_ip2);
+
+  ASSERT_EQ( simple_ip1.size(), float_ip1.size() );
+  ASSERT_EQ( simple_ip1.size(), byte_ip1.size() );
+  for ( size_t i = 0; i < simple_ip1.size(); ++i ) {
+    EXPECT_EQ( simple_ip1[i].x, float_ip1[i].x );
+    EXPECT_EQ( simple_ip2[i].x, float_ip2[i].x );
+    EXPECT_EQ( simple_ip1[i].x, byte_ip1[i].x );
+    EXPECT_EQ( simple_ip2[i].x, byte_ip2[i].x );
+  }
+}
+
+// Unit length descriptors, whose elements lie in [0,1], are scaled
+// onto [0,255] before they are quantized.
+TEST( Matcher, BruteForceNormalizedDescriptors ) {
+  const size_t num_points = 1000;
+  std::vector<InterestPoint> ip1_list, ip2_list;
+  noisy_descriptors( num_points, 64, ip1_list, ip2_list );
+  for ( size_t i = 0; i < num_points; ++i ) {
+    ip1_list[i].descriptor = normalize( ip1_list[i].descriptor );
+    ip2_list[i].descriptor = normalize( ip2_list[i].descriptor );
+  }
+
+  EXPECT_EQ( 255, BruteForceL2Metric<uint8>().channel( 1.0f ) );
+  EXPECT_EQ( 128, BruteForceL2Metric<uint8>().channel( 0.5f ) );
+  EXPECT_EQ( 0, BruteForceL2Metric<uint8>().channel( -0.1f ) );
+
+  std::vector<InterestPoint> float_ip1, float_ip2, byte_ip1, byte_ip2;
+  InterestPointMatcher<BruteForceL2Metric<float>,NullConstraint> float_matcher(0.8);
+  float_matcher(ip1_list, ip2_list, float_ip1, float_ip2);
+  InterestPointMatcher<BruteForceL2Metric<uint8>,NullConstraint> byte_matcher(0.8);
+  byte_matcher(ip1_list, ip2_list, byte_ip1, byte_ip2);
+
+  EXPECT_GT( float_ip1.size(), num_points * 9 / 10 );
+  EXPECT_GT( byte_ip1.size(), num_points * 9 / 10 );
+  for ( size_t i = 0; i < byte_ip1.size(); ++i )
+    EXPECT_EQ( byte_ip1[i].x, byte_ip2[i].x );
+}
+
+// Compares the brute force matcher with the tree matcher (FLANN if
+// available, otherwise KDTree) across set sizes.
+TEST( Matcher, DISABLED_BruteForceBenchmark ) {
+  const size_t sizes[] = { 500, 1500, 4000 };
+  for ( int s = 0; s < 3; ++s ) {
+    std::vector<InterestPoint> ip1_list, ip2_list;
+    noisy_descriptors( sizes[s], 32, ip1_list, ip2_list, 255 );
+
+    std::vector<InterestPoint> tree_ip1, tree_ip2, float_ip1, float_ip2, byte_ip1, byte_ip2;
+    Stopwatch tree_sw, float_sw, byte_sw;
+    tree_sw.start();
+    DefaultMatcher tree(0.8);
+    tree(ip1_list, ip2_list, tree_ip1, tree_ip2);
+    tree_sw.stop();
+    float_sw.start();
+    InterestPointMatcher<BruteForceL2Metric<float>,NullConstraint> float_matcher(0.8);
+    float_matcher(ip1_list, ip2_list, float_ip1, float_ip2);
+    float_sw.stop();
+    byte_sw.start();
+    InterestPointMatcher<BruteForceL2Metric<uint8>,NullConstraint> byte_matcher(0.8, BruteForceL2Metric<uint8>(1));
+    byte_matcher(ip1_list, ip2_list, byte_ip1, byte_ip2);
+    byte_sw.stop();
+
+    std::cout << sizes[s] << " points: "
+#if VW_HAVE_PKG_FLANN
+              << "FLANN "
+#else
+              << "KDTree "
+#endif
+              << tree_sw.elapsed_seconds() << "s (" << tree_ip1.size() << " matches), brute force float "
+              << float_sw.elapsed_seconds() << "s (" << float_ip1.size() << "), uint8 "
+              << byte_sw.elapsed_seconds() << "s (" << byte_ip1.size() << ")" << std::endl;
+    EXPECT_EQ( float_ip1.size(), byte_ip1.size() );
+    EXPECT_GE( float_ip1.size(), tree_ip1.size() * 9 / 10 );
+  }
+}
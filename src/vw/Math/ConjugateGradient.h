@@ -229,6 +229,56 @@ namespace math{
     return pos;
   }
 
+
+  /// Solves the linear system A*x = b, with A symmetric positive
+  /// definite, by the preconditioned conjugate gradient method.
+  /// Unlike the methods above, A is never evaluated as a cost
+  /// function; it only has to be applied to vectors, so it never has
+  /// to be formed.  You supply two functors:
+  /// * apply( p, result ) sets result = A*p.
+  /// * precondition( r, result ) sets result to an approximation of
+  ///   inverse(A)*r, e.g. by inverting the diagonal (blocks) of A.
+  ///   Both must be symmetric positive definite.
+  /// x holds the initial guess, and the solution on return.  The
+  /// iteration stops once the norm of the residual is below
+  /// tolerance times the norm of b, or after max_iterations steps.
+  /// Returns the number of steps taken.
+  template <class ApplyT, class PreconditionT, class VectorT>
+  int preconditioned_conjugate_gradient( ApplyT const& apply,
+                                         PreconditionT const& precondition,
+                                         VectorT const& b, VectorT& x,
+                                         double tolerance, int max_iterations ) {
+    VectorT r, z, p, ap;
+    apply( x, ap );
+    r = b - ap;
+    const double stop_norm = tolerance * norm_2(b);
+    if ( norm_2(r) <= stop_norm )
+      return 0;
+    precondition( r, z );
+    p = z;
+    double rz = dot_prod( r, z );
+    int i = 0;
+    while ( i < max_iterations ) {
+      apply( p, ap );
+      double p_ap = dot_prod( p, ap );
+      if ( !(p_ap > 0) )
+        break;  // A is not positive definite along p
+      double alpha = rz / p_ap;
+      x += alpha * p;
+      r -= alpha * ap;
+      ++i;
+      if ( norm_2(r) <= stop_norm )
+        break;
+      precondition( r, z );
+      double rz_next = dot_prod( r, z );
+      p = z + (rz_next / rz) * p;
+      rz = rz_next;
+    }
+    vw_out(DebugMessage, "math") << "PCG: " << i << " steps, residual "
+                                 << norm_2(r) << std::endl;
+    return i;
+  }
+
 } } // namespace vw::math
 
 #endif // #ifndef __VW_MATH_CONJUGATEGRADIENT_H__
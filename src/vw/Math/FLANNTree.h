@@ -66,6 +66,28 @@ namespace math {
       m_index.knnSearch( query_mat, indice_mat, dists_mat, knn, params );
     }
 
+    // Batched query access.  Row i of indices and dists holds the
+    // knn nearest features to row i of query, nearest first.
+    template <class MatrixT>
+    void knn_search( MatrixBase<MatrixT> const& query,
+                     Matrix<int>& indices,
+                     Matrix<distance_type>& dists,
+                     size_t knn,
+                     flann::SearchParams const& params = flann::SearchParams(128) ) {
+      typedef typename MatrixT::value_type element_type;
+
+      if ( indices.rows() != query.impl().rows() || indices.cols() != knn )
+        indices.set_size( query.impl().rows(), knn );
+      if ( dists.rows() != query.impl().rows() || dists.cols() != knn )
+        dists.set_size( query.impl().rows(), knn );
+
+      flann::Matrix<element_type> query_mat( const_cast<element_type*>(query.impl().data()),
+                                             query.impl().rows(), query.impl().cols() );
+      flann::Matrix<int> indice_mat( indices.data(), indices.rows(), indices.cols() );
+      flann::Matrix<distance_type> dists_mat( dists.data(), dists.rows(), dists.cols() );
+      m_index.knnSearch( query_mat, indice_mat, dists_mat, knn, params );
+    }
+
     size_t size1() const { return m_index.size(); }
     size_t size2() const { return m_index.veclen(); }
   };
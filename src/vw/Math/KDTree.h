@@ -605,6 +605,11 @@ namespace math {
 
   public:
 
+    /// The state of one nearest neighbor search.  A search given its
+    /// own queue does not modify the tree, so several threads may
+    /// search the same tree at once, each with a queue of its own.
+    typedef std::priority_queue< std::pair<Vertex, key_t>, std::vector<std::pair<Vertex, key_t> >, VertexDistanceComparator > search_queue_t;
+
     //////////////////   --- KD Public Methods ---  /////////////////////////
 
     //  Insert one record into an existing k-d tree. Does not guarantee
@@ -648,17 +653,42 @@ namespace math {
                                  unsigned m = 1,
                                  RecordConstraintT recordConstraint = NullRecordConstraintKD(),
                                  DistanceMetricT distanceMetric = SafeEuclideanDistanceMetric())
+    {
+      return m_nearest_neighbors(query, nearest_records, m, m_priority_queue,
+                                 recordConstraint, distanceMetric);
+    }
+
+    /// As above, but keeping the state of the search in queue, so
+    /// that the tree itself is left untouched.
+    template <typename ContainerT>
+    unsigned m_nearest_neighbors(ContainerT const& query,
+                                 std::vector<record_t>& nearest_records,
+                                 unsigned m,
+                                 search_queue_t& queue) const
+    {
+      return m_nearest_neighbors(query, nearest_records, m, queue,
+                                 NullRecordConstraintKD(),
+                                 SafeEuclideanDistanceMetric());
+    }
+
+    template <typename ContainerT, typename RecordConstraintT, typename DistanceMetricT>
+    unsigned m_nearest_neighbors(ContainerT const& query,
+                                 std::vector<record_t>& nearest_records,
+                                 unsigned m,
+                                 search_queue_t& queue,
+                                 RecordConstraintT recordConstraint,
+                                 DistanceMetricT distanceMetric) const
     {
       assert( m_k == (unsigned) std::distance(query.begin(), query.end()) );
       nearest_records.clear();
 
       //Initialize the priority queue with m sentinel NIL pairs
       std::pair<Vertex, key_t> nil_pair(m_NIL, m_POSITIVE_INFINITY);
-      while (!m_priority_queue.empty()){
-        m_priority_queue.pop();
+      while (!queue.empty()){
+        queue.pop();
       }
       for(unsigned i = 0; i < m; ++i){
-        m_priority_queue.push(nil_pair);
+        queue.push(nil_pair);
       }
 
       //convert input into a range_t object, which is more convenient for
@@ -666,22 +696,22 @@ namespace math {
       range_t _query(m_k);
       std::copy(query.begin(), query.end(), _query.begin());
 
-      nearest_neighbors(m_root, _query, m, recordConstraint, distanceMetric);
+      nearest_neighbors(m_root, _query, m, queue, recordConstraint, distanceMetric);
 
-      //Now parse m_priority_queue into nearest_records
+      //Now parse queue into nearest_records
       unsigned num_records_found = 0;
       std::pair<Vertex, key_t> temp_pair;
 
-      while (!m_priority_queue.empty()){
+      while (!queue.empty()){
 
-        temp_pair = m_priority_queue.top();
+        temp_pair = queue.top();
         if (temp_pair.first == m_NIL){
-          m_priority_queue.pop();
+          queue.pop();
         }else{
           //add record of neighbor node
           ++num_records_found;
           nearest_records.push_back(m_record_map[temp_pair.first]);
-          m_priority_queue.pop();
+          queue.pop();
         }
       }
       // The priority queue is ordered in decreasing distance from the query,
@@ -903,7 +933,8 @@ namespace math {
     /// Nearest Neighbors
     //
     // Finds the m nearest records to the query, and stores them in
-    // m_priority_queue.
+    // queue.  The bounds of the child being considered are worked out
+    // in a copy, so that the tree is only read.
     //
     // The return value 0 indicates 'return' from recursion, whereas a
     // return value of 1 indicates the search is complete
@@ -916,22 +947,23 @@ namespace math {
     // the child's hirange satisfies the constraint.
     template<typename RecordConstraint, typename DistanceMetric>
     int nearest_neighbors(Vertex const& N, range_t const& query, unsigned m,
+                          search_queue_t& queue,
                           RecordConstraint const& recordConstraint,
-                          DistanceMetric const& distanceMetric ) {
+                          DistanceMetric const& distanceMetric ) const {
       if (N == m_NIL)
         return 0;
 
-      range_t& N_lorange = get(m_LORANGE_map, N);
-      range_t& N_hirange = get(m_HIRANGE_map, N);
+      range_t const& N_lorange = get(m_LORANGE_map, N);
+      range_t const& N_hirange = get(m_HIRANGE_map, N);
 
       //If no part of N's domain satisfies the constraint, don't search
       if(!recordConstraint.domains_overlap(N_lorange,  N_hirange)){
         return 0;
       }
-      record_t& N_record = get(m_record_map, N);
+      record_t const& N_record = get(m_record_map, N);
       unsigned disc = get(m_discriminator_map, N);
-      Vertex& loson = get(m_LOSON_map, N);
-      Vertex& hison = get(m_HISON_map, N);
+      Vertex loson = get(m_LOSON_map, N);
+      Vertex hison = get(m_HISON_map, N);
 
       //Calculate distance from query to N's record.
       //double distance_to_N = kd_euclidean_distance(query.begin(), query.end(), N_record.begin());
@@ -940,8 +972,8 @@ namespace math {
       //Update the list of m best.
       Vertex dummy = m_NIL;
       double distance_to_mth_best = m_POSITIVE_INFINITY;
-      if (!m_priority_queue.empty()){
-        boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
+      if (!queue.empty()){
+        boost::tie(dummy, distance_to_mth_best) = queue.top();
       } else {
         std::cout<<"Priority Queue is empty!?\n";
       }
@@ -949,12 +981,12 @@ namespace math {
       if ((distance_to_N < distance_to_mth_best) && recordConstraint(N_record) ){
         //if (distance_to_N < distance_to_mth_best){
         std::pair<Vertex, double> temp_pair(N, distance_to_N);
-        m_priority_queue.push(temp_pair);
+        queue.push(temp_pair);
 
-        while(m_priority_queue.size() > m){
-          m_priority_queue.pop();
+        while(queue.size() > m){
+          queue.pop();
         }
-        boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
+        boost::tie(dummy, distance_to_mth_best) = queue.top();
       }
 
       // Now it is necesary to search the subtree on the same side of
@@ -970,39 +1002,41 @@ namespace math {
       if (query_key < partition_key)
         {
           //query is on low side of partition at vertex N
-          done = nearest_neighbors(loson, query, m, recordConstraint, distanceMetric);
+          done = nearest_neighbors(loson, query, m, queue, recordConstraint, distanceMetric);
           if (done == 1)
             return 1;
           //m nearest may have changed from searching loson
-          if (!m_priority_queue.empty())
-            boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-          N_lorange[disc] = partition_key;
-          if (bounds_overlap_ball(query, N_lorange, N_hirange, distance_to_mth_best))
+          if (!queue.empty())
+            boost::tie(dummy, distance_to_mth_best) = queue.top();
+          range_t hison_lorange(N_lorange);
+          hison_lorange[disc] = partition_key;
+          if (bounds_overlap_ball(query, hison_lorange, N_hirange, distance_to_mth_best))
             {
               //std::cout<<"Hison's Bounds Overlap Ball, check hi side too.\n";
-              done = nearest_neighbors(hison, query, m, recordConstraint, distanceMetric);
+              done = nearest_neighbors(hison, query, m, queue, recordConstraint, distanceMetric);
               if(done == 1)
                 return 1;
             }
         }else{
         //query is on the high side of the partition
-        done = nearest_neighbors(hison, query, m, recordConstraint, distanceMetric);
+        done = nearest_neighbors(hison, query, m, queue, recordConstraint, distanceMetric);
         if (done == 1)
           return 1;
         //m nearest may have changed from searching hison
-        if (!m_priority_queue.empty())
-          boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-        N_hirange[disc] = partition_key;
-        if (bounds_overlap_ball(query, N_lorange, N_hirange, distance_to_mth_best))
+        if (!queue.empty())
+          boost::tie(dummy, distance_to_mth_best) = queue.top();
+        range_t loson_hirange(N_hirange);
+        loson_hirange[disc] = partition_key;
+        if (bounds_overlap_ball(query, N_lorange, loson_hirange, distance_to_mth_best))
           {
             //std::cout<<"LOson's's Bounds Overlap Ball, check lo side too.\n";
-            done = nearest_neighbors(loson, query, m, recordConstraint, distanceMetric);
+            done = nearest_neighbors(loson, query, m, queue, recordConstraint, distanceMetric);
             if (done == 1)
               return 1;
           }
       }
       //After checking children, the ball containing the m best may be entirely in N's range:
-      boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
+      boost::tie(dummy, distance_to_mth_best) = queue.top();
       if(ball_within_bounds(query, N_lorange, N_hirange, distance_to_mth_best) ){
         return 1;
       }
@@ -1065,7 +1099,7 @@ namespace math {
     // bounded region is less than the radius of the ball.
     //
     // TODO: all uses of ScalarTypeLimits<double>::highest() should be replaced with a C implementation of infinity!
-    bool ball_within_bounds(range_t const& query, range_t const& lorange, range_t const& hirange, double radius){
+    bool ball_within_bounds(range_t const& query, range_t const& lorange, range_t const& hirange, double radius) const {
 
       //If any coordinate distance is less less than radius, ball
       //escapes bounds, so return false if a bound is +/- infinity,
@@ -1077,9 +1111,11 @@ namespace math {
         // DELETE?
         //         if ((fabs(*lorange_iter) == m_POSITIVE_INFINITY) || (fabs(*hirange_iter) == m_POSITIVE_INFINITY))
         //           return false;
-        if (fabs( *iter - *lorange_iter ) <= radius)
+        // The query may lie outside a region that was only searched
+        // because the ball overlapped it, so the distances are signed.
+        if (double(*iter) - double(*lorange_iter) <= radius)
           return false;
-        if (fabs( *iter - *hirange_iter ) <= radius)
+        if (double(*hirange_iter) - double(*iter) <= radius)
           return false;
       }
       return true;
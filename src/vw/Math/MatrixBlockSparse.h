@@ -0,0 +1,490 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file MatrixBlockSparse.h
+///
+/// A symmetric sparse matrix made of small dense blocks, and a
+/// supernodal Cholesky factorization of it.  This is made for the
+/// reduced camera system in bundle adjustment, where the blocks are
+/// the size of a camera's parameter vector and a block is nonzero
+/// when its two cameras see a common point.
+///
+
+#ifndef __VW_MATH_MATRIX_BLOCK_SPARSE_H__
+#define __VW_MATH_MATRIX_BLOCK_SPARSE_H__
+
+// Standard
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Vision Workbench
+#include <vw/Core/Exception.h>
+#include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
+
+namespace vw {
+namespace math {
+
+  //------------------------------------------------------------------
+  //                 Block Sparse Matrix
+  //
+  // A symmetric matrix of BlockN x BlockN blocks.  Only the blocks on
+  // and below the diagonal are stored, row by row, in block
+  // compressed sparse row order.  The sparsity pattern is fixed when
+  // the matrix is built; after that the values of the stored blocks
+  // can be changed in place, which is all that a bundle adjustment
+  // iteration needs.
+  // -----------------------------------------------------------------
+  template <class ElemT, size_t BlockN>
+  class MatrixBlockSparse {
+    size_t m_block_rows;
+    std::vector<size_t> m_row_start; // First stored block of each row
+    std::vector<size_t> m_col;       // Block column of each stored block
+    std::vector<ElemT> m_values;     // Stored blocks, each row major
+
+  public:
+    typedef ElemT value_type;
+    static const size_t block_size = BlockN;
+    static const size_t block_elements = BlockN*BlockN;
+
+    MatrixBlockSparse() : m_block_rows(0), m_row_start(1,0) {}
+
+    /// Builds the pattern of a matrix with block_rows rows of blocks
+    /// from a list of (row, column) pairs of blocks that may be
+    /// nonzero.  Pairs above the diagonal stand for their transpose,
+    /// duplicates are ignored, and the diagonal blocks are always
+    /// stored.  The values start out as zero.
+    MatrixBlockSparse( size_t block_rows,
+                       std::vector<std::pair<size_t,size_t> > blocks ) :
+      m_block_rows(block_rows), m_row_start(block_rows+1,0) {
+      for ( size_t k = 0; k < blocks.size(); ++k ) {
+        VW_ASSERT( blocks[k].first < block_rows && blocks[k].second < block_rows,
+                   ArgumentErr() << "MatrixBlockSparse: block index out of range." );
+        if ( blocks[k].first < blocks[k].second )
+          std::swap( blocks[k].first, blocks[k].second );
+      }
+      for ( size_t r = 0; r < block_rows; ++r )
+        blocks.push_back( std::make_pair(r,r) );
+      std::sort( blocks.begin(), blocks.end() );
+      blocks.erase( std::unique( blocks.begin(), blocks.end() ), blocks.end() );
+
+      m_col.resize( blocks.size() );
+      for ( size_t k = 0; k < blocks.size(); ++k ) {
+        m_row_start[blocks[k].first+1]++;
+        m_col[k] = blocks[k].second;
+      }
+      for ( size_t r = 0; r < block_rows; ++r )
+        m_row_start[r+1] += m_row_start[r];
+      m_values.resize( blocks.size()*block_elements, ElemT(0) );
+    }
+
+    size_t rows() const { return m_block_rows*BlockN; }
+    size_t cols() const { return m_block_rows*BlockN; }
+    size_t block_rows() const { return m_block_rows; }
+    size_t num_blocks() const { return m_col.size(); }
+
+    /// The stored blocks of block row r are [row_begin(r), row_end(r)),
+    /// in increasing order of block column.
+    size_t row_begin( size_t r ) const { return m_row_start[r]; }
+    size_t row_end( size_t r ) const { return m_row_start[r+1]; }
+    size_t block_col( size_t k ) const { return m_col[k]; }
+
+    /// Returns the index of the stored block (row,col), which must be
+    /// on or below the diagonal, or num_blocks() if it is not stored.
+    size_t find_block( size_t row, size_t col ) const {
+      std::vector<size_t>::const_iterator begin = m_col.begin() + m_row_start[row];
+      std::vector<size_t>::const_iterator end = m_col.begin() + m_row_start[row+1];
+      std::vector<size_t>::const_iterator it = std::lower_bound( begin, end, col );
+      if ( it == end || *it != col )
+        return num_blocks();
+      return it - m_col.begin();
+    }
+
+    /// The elements of stored block k, row major.
+    ElemT* block( size_t k ) { return &m_values[k*block_elements]; }
+    const ElemT* block( size_t k ) const { return &m_values[k*block_elements]; }
+
+    /// All of the stored values, block after block.
+    ElemT* data() { return m_values.empty() ? 0 : &m_values[0]; }
+    const ElemT* data() const { return m_values.empty() ? 0 : &m_values[0]; }
+    size_t num_values() const { return m_values.size(); }
+
+    void set_zero() { std::fill( m_values.begin(), m_values.end(), ElemT(0) ); }
+
+    /// Element access; elements above the diagonal come from the
+    /// transposed block.
+    ElemT operator()( size_t i, size_t j ) const {
+      if ( i < j ) std::swap( i, j );
+      size_t k = find_block( i/BlockN, j/BlockN );
+      if ( k == num_blocks() )
+        return ElemT(0);
+      size_t a = i%BlockN, b = j%BlockN;
+      if ( i/BlockN == j/BlockN && a < b )
+        std::swap( a, b );
+      return block(k)[a*BlockN+b];
+    }
+  };
+
+  /// Matrix vector product.
+  template <class ElemT, size_t BlockN, class VectorT>
+  Vector<ElemT> operator*( MatrixBlockSparse<ElemT,BlockN> const& A,
+                           VectorBase<VectorT> const& x ) {
+    VW_ASSERT( x.impl().size() == A.cols(),
+               ArgumentErr() << "MatrixBlockSparse: matrix and vector sizes do not agree." );
+    Vector<ElemT> result( A.rows() );
+    for ( size_t r = 0; r < A.block_rows(); ++r ) {
+      for ( size_t k = A.row_begin(r); k < A.row_end(r); ++k ) {
+        const size_t c = A.block_col(k);
+        const ElemT* blk = A.block(k);
+        for ( size_t a = 0; a < BlockN; ++a )
+          for ( size_t b = 0; b < BlockN; ++b ) {
+            result[r*BlockN+a] += blk[a*BlockN+b] * x.impl()[c*BlockN+b];
+            if ( c != r )
+              result[c*BlockN+b] += blk[a*BlockN+b] * x.impl()[r*BlockN+a];
+          }
+      }
+    }
+    return result;
+  }
+
+  //------------------------------------------------------------------
+  //                 Supernodal Block Cholesky
+  //
+  // Computes L*L^T = P*A*P^T for a MatrixBlockSparse A, where P is a
+  // fill reducing (minimum degree) ordering of the blocks.  Columns
+  // of L with the same sparsity pattern are grouped into supernodes,
+  // each of which is stored as one dense, column major panel, so the
+  // factorization is carried out by dense kernels over whole panels
+  // rather than element by element.
+  //
+  // analyze() only looks at the pattern of A, so it can be done once
+  // and followed by factor() and solve() for every matrix with the
+  // same pattern.
+  // -----------------------------------------------------------------
+  template <class ElemT, size_t BlockN>
+  class BlockSparseCholesky {
+    size_t m_n;                          // Block columns
+    std::vector<size_t> m_perm;          // Block column of A of each column of L
+    std::vector<size_t> m_inverse_perm;  // Column of L of each block column of A
+    std::vector<size_t> m_super_start;   // First column of each supernode
+    std::vector<size_t> m_super_of;      // Supernode of each column
+    std::vector<size_t> m_rows_start;    // First of each supernode's rows in m_rows
+    std::vector<size_t> m_rows;          // Block rows of each supernode, increasing
+    std::vector<size_t> m_panel_start;   // Each supernode's panel in m_values
+    std::vector<ElemT> m_values;
+    std::vector<size_t> m_a_offset;      // Where each block of A goes in m_values,
+    std::vector<size_t> m_a_ld;          // the leading dimension of its panel,
+    std::vector<char> m_a_transposed;    // and whether it goes in transposed.
+    bool m_factored;
+
+    size_t panel_rows( size_t s ) const { return (m_rows_start[s+1]-m_rows_start[s])*BlockN; }
+    size_t panel_cols( size_t s ) const { return (m_super_start[s+1]-m_super_start[s])*BlockN; }
+
+    // Sets m_perm and m_inverse_perm to a minimum degree ordering of
+    // the graph of blocks of A.  Neighbors that are left adjacent to
+    // exactly the same vertices as the eliminated one are eliminated
+    // along with it, which keeps dense graphs from costing O(n^3).
+    void minimum_degree_ordering( MatrixBlockSparse<ElemT,BlockN> const& A ) {
+      const size_t n = A.block_rows();
+      std::vector<std::vector<size_t> > adjacent(n);
+      for ( size_t r = 0; r < n; ++r )
+        for ( size_t k = A.row_begin(r); k < A.row_end(r); ++k )
+          if ( A.block_col(k) != r ) {
+            adjacent[r].push_back( A.block_col(k) );
+            adjacent[A.block_col(k)].push_back( r );
+          }
+      std::set<std::pair<size_t,size_t> > queue;
+      for ( size_t v = 0; v < n; ++v ) {
+        std::sort( adjacent[v].begin(), adjacent[v].end() );
+        queue.insert( std::make_pair( adjacent[v].size(), v ) );
+      }
+
+      m_perm.clear();
+      std::vector<size_t> merged, mass;
+      while ( !queue.empty() ) {
+        const size_t v = queue.begin()->second;
+        queue.erase( queue.begin() );
+        m_perm.push_back( v );
+        std::vector<size_t> neighbors;
+        neighbors.swap( adjacent[v] );
+
+        // The neighbors of v become a clique.
+        mass.clear();
+        for ( size_t i = 0; i < neighbors.size(); ++i ) {
+          const size_t u = neighbors[i];
+          queue.erase( std::make_pair( adjacent[u].size(), u ) );
+          merged.clear();
+          std::set_union( adjacent[u].begin(), adjacent[u].end(),
+                          neighbors.begin(), neighbors.end(), std::back_inserter(merged) );
+          merged.erase( std::remove( merged.begin(), merged.end(), v ), merged.end() );
+          merged.erase( std::remove( merged.begin(), merged.end(), u ), merged.end() );
+          adjacent[u].swap( merged );
+          if ( adjacent[u].size() + 1 == neighbors.size() )
+            mass.push_back( u );
+        }
+
+        // Mass elimination of the neighbors indistinguishable from v
+        for ( size_t i = 0; i < mass.size(); ++i ) {
+          m_perm.push_back( mass[i] );
+          adjacent[mass[i]].clear();
+        }
+        for ( size_t i = 0; i < neighbors.size(); ++i ) {
+          const size_t u = neighbors[i];
+          if ( !mass.empty() && adjacent[u].empty() &&
+               std::binary_search( mass.begin(), mass.end(), u ) )
+            continue;
+          if ( !mass.empty() ) {
+            merged.clear();
+            std::set_difference( adjacent[u].begin(), adjacent[u].end(),
+                                 mass.begin(), mass.end(), std::back_inserter(merged) );
+            adjacent[u].swap( merged );
+          }
+          queue.insert( std::make_pair( adjacent[u].size(), u ) );
+        }
+      }
+
+      m_inverse_perm.resize(n);
+      for ( size_t j = 0; j < n; ++j )
+        m_inverse_perm[m_perm[j]] = j;
+    }
+
+  public:
+    BlockSparseCholesky() : m_n(0), m_factored(false) {}
+    BlockSparseCholesky( MatrixBlockSparse<ElemT,BlockN> const& A ) : m_n(0), m_factored(false) {
+      analyze(A);
+    }
+
+    size_t num_supernodes() const { return m_panel_start.empty() ? 0 : m_panel_start.size()-1; }
+    /// Number of values stored for L, including the zeros above the
+    /// diagonal of each supernode.
+    size_t nonzeros() const { return m_values.size(); }
+
+    /// Finds the ordering, the structure of L and its supernodes.
+    void analyze( MatrixBlockSparse<ElemT,BlockN> const& A ) {
+      const size_t n = A.block_rows();
+      m_n = n;
+      m_factored = false;
+
+      // Fill reducing ordering of the graph of blocks
+      minimum_degree_ordering( A );
+
+      // The structure of each column of L below the diagonal is that
+      // of A, merged with those of its children in the elimination
+      // tree.
+      std::vector<std::vector<size_t> > structure(n), children(n);
+      std::vector<size_t> parent(n,n);
+      for ( size_t r = 0; r < n; ++r )
+        for ( size_t k = A.row_begin(r); k < A.row_end(r); ++k ) {
+          size_t pr = m_inverse_perm[r], pc = m_inverse_perm[A.block_col(k)];
+          if ( pr != pc )
+            structure[std::min(pr,pc)].push_back( std::max(pr,pc) );
+        }
+      for ( size_t j = 0; j < n; ++j ) {
+        std::vector<size_t>& s = structure[j];
+        for ( size_t c = 0; c < children[j].size(); ++c ) {
+          std::vector<size_t> const& child = structure[children[j][c]];
+          for ( size_t i = 0; i < child.size(); ++i )
+            if ( child[i] > j )
+              s.push_back( child[i] );
+        }
+        std::sort( s.begin(), s.end() );
+        s.erase( std::unique( s.begin(), s.end() ), s.end() );
+        if ( !s.empty() ) {
+          parent[j] = s[0];
+          children[s[0]].push_back(j);
+        }
+      }
+
+      // A column joins the supernode of the one before it when it is
+      // that column's parent and the rest of their patterns agree.
+      m_super_start.clear();
+      m_super_of.resize(n);
+      for ( size_t j = 0; j < n; ++j ) {
+        if ( j == 0 || parent[j-1] != j ||
+             structure[j-1].size() != structure[j].size() + 1 )
+          m_super_start.push_back(j);
+        m_super_of[j] = m_super_start.size()-1;
+      }
+      m_super_start.push_back(n);
+
+      const size_t num_super = m_super_start.size()-1;
+      m_rows.clear();
+      m_rows_start.assign( 1, 0 );
+      m_panel_start.assign( 1, 0 );
+      for ( size_t s = 0; s < num_super; ++s ) {
+        for ( size_t j = m_super_start[s]; j < m_super_start[s+1]; ++j )
+          m_rows.push_back(j);
+        std::vector<size_t> const& below = structure[m_super_start[s+1]-1];
+        m_rows.insert( m_rows.end(), below.begin(), below.end() );
+        m_rows_start.push_back( m_rows.size() );
+        m_panel_start.push_back( m_panel_start.back() + panel_rows(s)*panel_cols(s) );
+      }
+      m_values.assign( m_panel_start.back(), ElemT(0) );
+
+      // Where each block of A is loaded into the panels
+      m_a_offset.resize( A.num_blocks() );
+      m_a_ld.resize( A.num_blocks() );
+      m_a_transposed.resize( A.num_blocks() );
+      for ( size_t r = 0; r < n; ++r )
+        for ( size_t k = A.row_begin(r); k < A.row_end(r); ++k ) {
+          size_t pr = m_inverse_perm[r], pc = m_inverse_perm[A.block_col(k)];
+          m_a_transposed[k] = pr < pc;
+          if ( pr < pc )
+            std::swap( pr, pc );
+          size_t s = m_super_of[pc];
+          size_t row = std::lower_bound( m_rows.begin() + m_rows_start[s],
+                                         m_rows.begin() + m_rows_start[s+1], pr ) -
+            ( m_rows.begin() + m_rows_start[s] );
+          m_a_ld[k] = panel_rows(s);
+          m_a_offset[k] = m_panel_start[s] + (pc - m_super_start[s])*BlockN*m_a_ld[k] + row*BlockN;
+        }
+    }
+
+    /// Computes the numeric factorization of A, which must have the
+    /// pattern given to analyze().  Returns false if A is not
+    /// positive definite.
+    bool factor( MatrixBlockSparse<ElemT,BlockN> const& A ) {
+      VW_ASSERT( A.block_rows() == m_n && A.num_blocks() == m_a_offset.size(),
+                 ArgumentErr() << "BlockSparseCholesky: the matrix does not match the analyzed pattern." );
+      m_factored = false;
+
+      std::fill( m_values.begin(), m_values.end(), ElemT(0) );
+      for ( size_t k = 0; k < A.num_blocks(); ++k ) {
+        const ElemT* a = A.block(k);
+        ElemT* l = &m_values[m_a_offset[k]];
+        const size_t ld = m_a_ld[k];
+        for ( size_t i = 0; i < BlockN; ++i )
+          for ( size_t j = 0; j < BlockN; ++j )
+            l[j*ld+i] = m_a_transposed[k] ? a[j*BlockN+i] : a[i*BlockN+j];
+      }
+
+      std::vector<ElemT> update;
+      std::vector<size_t> relative;
+      for ( size_t s = 0; s + 1 < m_super_start.size(); ++s ) {
+        const size_t m = panel_rows(s), w = panel_cols(s);
+        ElemT* panel = &m_values[m_panel_start[s]];
+
+        // Dense Cholesky of the whole panel: the diagonal block and,
+        // below it, the rows that will update later supernodes.
+        for ( size_t j = 0; j < w; ++j ) {
+          ElemT* col = panel + j*m;
+          for ( size_t k = 0; k < j; ++k ) {
+            const ElemT* src = panel + k*m;
+            const ElemT v = src[j];
+            if ( v != 0 )
+              for ( size_t i = j; i < m; ++i )
+                col[i] -= src[i]*v;
+          }
+          if ( !(col[j] > 0) )
+            return false;
+          const ElemT d = std::sqrt( col[j] );
+          col[j] = d;
+          for ( size_t i = j+1; i < m; ++i )
+            col[i] /= d;
+        }
+
+        // Subtract L21*L21^T from the supernodes that the rows below
+        // the diagonal block belong to, one column at a time.
+        const size_t* rows = &m_rows[m_rows_start[s]];
+        const size_t num_rows = m_rows_start[s+1]-m_rows_start[s];
+        const size_t first = m_super_start[s+1]-m_super_start[s];
+        update.resize(m);
+        relative.resize(num_rows);
+        for ( size_t q = first; q < num_rows; ) {
+          const size_t t = m_super_of[rows[q]];
+          const size_t* trows = &m_rows[m_rows_start[t]];
+          for ( size_t p = q, pos = 0; p < num_rows; ++p ) {
+            while ( trows[pos] != rows[p] )
+              ++pos;
+            relative[p] = pos;
+          }
+          const size_t tld = panel_rows(t);
+          ElemT* target = &m_values[m_panel_start[t]];
+
+          for ( ; q < num_rows && m_super_of[rows[q]] == t; ++q )
+            for ( size_t b = 0; b < BlockN; ++b ) {
+              const size_t c = q*BlockN + b;
+              std::fill( update.begin() + q*BlockN, update.end(), ElemT(0) );
+              for ( size_t k = 0; k < w; ++k ) {
+                const ElemT* src = panel + k*m;
+                const ElemT v = src[c];
+                if ( v != 0 )
+                  for ( size_t i = q*BlockN; i < m; ++i )
+                    update[i] += src[i]*v;
+              }
+              ElemT* tcol = target + ((rows[q] - m_super_start[t])*BlockN + b)*tld;
+              for ( size_t p = q; p < num_rows; ++p )
+                for ( size_t a = 0; a < BlockN; ++a )
+                  tcol[relative[p]*BlockN + a] -= update[p*BlockN + a];
+            }
+        }
+      }
+      m_factored = true;
+      return true;
+    }
+
+    /// Solves A*x = b with the factorization.
+    template <class VectorT>
+    Vector<ElemT> solve( VectorBase<VectorT> const& b ) const {
+      VW_ASSERT( m_factored, LogicErr() << "BlockSparseCholesky: solve() called before factor()." );
+      VW_ASSERT( b.impl().size() == m_n*BlockN,
+                 ArgumentErr() << "BlockSparseCholesky: matrix and vector sizes do not agree." );
+      Vector<ElemT> y( m_n*BlockN );
+      for ( size_t j = 0; j < m_n; ++j )
+        for ( size_t a = 0; a < BlockN; ++a )
+          y[j*BlockN+a] = b.impl()[m_perm[j]*BlockN+a];
+
+      const size_t num_super = num_supernodes();
+      // Solve L*z = y
+      for ( size_t s = 0; s < num_super; ++s ) {
+        const size_t m = panel_rows(s), w = panel_cols(s);
+        const ElemT* panel = &m_values[m_panel_start[s]];
+        const size_t* rows = &m_rows[m_rows_start[s]];
+        ElemT* ys = &y[m_super_start[s]*BlockN];
+        for ( size_t j = 0; j < w; ++j ) {
+          const ElemT* col = panel + j*m;
+          const ElemT v = ys[j] /= col[j];
+          for ( size_t i = j+1; i < w; ++i )
+            ys[i] -= col[i]*v;
+          for ( size_t p = w/BlockN; p < m/BlockN; ++p )
+            for ( size_t a = 0; a < BlockN; ++a )
+              y[rows[p]*BlockN+a] -= col[p*BlockN+a]*v;
+        }
+      }
+      // Solve L^T*x = z
+      for ( size_t s = num_super; s-- > 0; ) {
+        const size_t m = panel_rows(s), w = panel_cols(s);
+        const ElemT* panel = &m_values[m_panel_start[s]];
+        const size_t* rows = &m_rows[m_rows_start[s]];
+        ElemT* ys = &y[m_super_start[s]*BlockN];
+        for ( size_t j = w; j-- > 0; ) {
+          const ElemT* col = panel + j*m;
+          ElemT sum = ys[j];
+          for ( size_t i = j+1; i < w; ++i )
+            sum -= col[i]*ys[i];
+          for ( size_t p = w/BlockN; p < m/BlockN; ++p )
+            for ( size_t a = 0; a < BlockN; ++a )
+              sum -= col[p*BlockN+a]*y[rows[p]*BlockN+a];
+          ys[j] = sum / col[j];
+        }
+      }
+
+      Vector<ElemT> x( m_n*BlockN );
+      for ( size_t j = 0; j < m_n; ++j )
+        for ( size_t a = 0; a < BlockN; ++a )
+          x[m_perm[j]*BlockN+a] = y[j*BlockN+a];
+      return x;
+    }
+  };
+
+}} // namespace vw::math
+
+#endif // __VW_MATH_MATRIX_BLOCK_SPARSE_H__
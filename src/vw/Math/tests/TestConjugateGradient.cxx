@@ -51,3 +51,42 @@ TEST( ConjugateGradient, ConjugateGradient ) {
   EXPECT_NEAR(result[0], 0.1962, 1e-3);
   EXPECT_NEAR(result[1], 0.4846, 1e-3);
 }
+
+// Applies the matrix tridiag(-1, 4, -1), with 10 on the diagonal of
+// the first row.
+struct TridiagonalOperator {
+  void operator()( Vector<double> const& x, Vector<double>& result ) const {
+    result.set_size( x.size() );
+    for ( size_t i = 0; i < x.size(); ++i ) {
+      result[i] = (i == 0 ? 10 : 4) * x[i];
+      if ( i > 0 ) result[i] -= x[i-1];
+      if ( i + 1 < x.size() ) result[i] -= x[i+1];
+    }
+  }
+};
+
+struct DiagonalPreconditioner {
+  void operator()( Vector<double> const& r, Vector<double>& result ) const {
+    result = r / 4;
+    result[0] = r[0] / 10;
+  }
+};
+
+TEST( ConjugateGradient, PreconditionedLinearSolve ) {
+  Vector<double> b(20), x(20);
+  for ( size_t i = 0; i < b.size(); ++i )
+    b[i] = double(i % 3) - 1;
+
+  int steps = preconditioned_conjugate_gradient( TridiagonalOperator(), DiagonalPreconditioner(),
+                                                 b, x, 1e-12, 100 );
+  EXPECT_LE( steps, 20 );
+
+  Vector<double> ax;
+  TridiagonalOperator()( x, ax );
+  for ( size_t i = 0; i < b.size(); ++i )
+    EXPECT_NEAR( b[i], ax[i], 1e-10 );
+
+  // Starting from the solution takes no steps.
+  EXPECT_EQ( 0, preconditioned_conjugate_gradient( TridiagonalOperator(), DiagonalPreconditioner(),
+                                                   b, x, 1e-6, 100 ) );
+}
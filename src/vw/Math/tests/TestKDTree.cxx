@@ -5,6 +5,7 @@
 // __END_LICENSE__
 
 
+#include <algorithm>
 #include <vector>
 #include <gtest/gtest.h>
 #include <vw/Math/KDTree.h>
@@ -987,3 +988,39 @@ TEST(KDTree, constrained_search) {
   EXPECT_EQ( nearest_records[3][0], 8);
   EXPECT_EQ( nearest_records[3][1], 18);
 }
+
+// A search with its own queue leaves the tree alone, and finds the
+// same neighbors as an exhaustive search.
+TEST(KDTree, shared_tree_search) {
+  typedef vector<vector<double> > file_t;
+  file_t file(500, vector<double>(4));
+  for (size_t i = 0; i < file.size(); ++i)
+    for (size_t j = 0; j < 4; ++j)
+      file[i][j] = double((i * 7919 + j * 104729) % 1009) / 10.0;
+  KDTree<file_t> const kd(4, file);
+
+  KDTree<file_t>::search_queue_t queue;
+  vector<vector<double> > nearest;
+  for (int q = 0; q < 50; ++q) {
+    vector<double> query(4);
+    for (size_t j = 0; j < 4; ++j)
+      query[j] = double((q * 193 + j * 389) % 1009) / 10.0 + 0.05;
+
+    vector<double> dists;
+    for (size_t i = 0; i < file.size(); ++i) {
+      double d = 0;
+      for (size_t j = 0; j < 4; ++j)
+        d += (file[i][j] - query[j]) * (file[i][j] - query[j]);
+      dists.push_back(d);
+    }
+    std::sort(dists.begin(), dists.end());
+
+    ASSERT_EQ(3u, kd.m_nearest_neighbors(query, nearest, 3, queue));
+    for (size_t k = 0; k < 3; ++k) {
+      double d = 0;
+      for (size_t j = 0; j < 4; ++j)
+        d += (nearest[k][j] - query[j]) * (nearest[k][j] - query[j]);
+      EXPECT_NEAR(dists[k], d, 1e-9);
+    }
+  }
+}
@@ -0,0 +1,141 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Math/MatrixBlockSparse.h>
+#include <test/Helpers.h>
+
+#include <boost/random.hpp>
+
+using namespace vw;
+using namespace vw::math;
+
+// A random symmetric positive definite matrix with a band of blocks
+// and a few blocks far from the diagonal, or with every block.
+template <size_t BlockN>
+void fill_test_matrix( MatrixBlockSparse<double,BlockN>& A, Matrix<double>& dense,
+                       size_t block_rows, bool complete, boost::mt19937& gen ) {
+  boost::uniform_real<double> dist(-1,1);
+  std::vector<std::pair<size_t,size_t> > blocks;
+  for ( size_t r = 1; r < block_rows; ++r ) {
+    blocks.push_back( std::make_pair( r, r-1 ) );
+    if ( r % 5 == 0 )
+      blocks.push_back( std::make_pair( r/5, r ) );
+    if ( complete )
+      for ( size_t c = 0; c < r; ++c )
+        blocks.push_back( std::make_pair( r, c ) );
+  }
+  A = MatrixBlockSparse<double,BlockN>( block_rows, blocks );
+
+  dense.set_size( A.rows(), A.cols() );
+  dense.set_zero();
+  for ( size_t r = 0; r < A.block_rows(); ++r )
+    for ( size_t k = A.row_begin(r); k < A.row_end(r); ++k ) {
+      size_t c = A.block_col(k);
+      for ( size_t a = 0; a < BlockN; ++a )
+        for ( size_t b = 0; b < BlockN; ++b ) {
+          double value = dist(gen);
+          if ( r == c ) {
+            if ( b > a ) continue;
+            if ( a == b ) value += 4.0*BlockN*block_rows;
+            A.block(k)[b*BlockN+a] = value;
+            dense(c*BlockN+b, r*BlockN+a) = value;
+          }
+          A.block(k)[a*BlockN+b] = value;
+          dense(r*BlockN+a, c*BlockN+b) = value;
+          dense(c*BlockN+b, r*BlockN+a) = value;
+        }
+    }
+}
+
+TEST( MatrixBlockSparse, Pattern ) {
+  std::vector<std::pair<size_t,size_t> > blocks;
+  blocks.push_back( std::make_pair( 0, 2 ) );
+  blocks.push_back( std::make_pair( 2, 0 ) );
+  blocks.push_back( std::make_pair( 3, 1 ) );
+  MatrixBlockSparse<double,2> A( 4, blocks );
+
+  EXPECT_EQ( 8u, A.rows() );
+  EXPECT_EQ( 6u, A.num_blocks() );
+  EXPECT_EQ( 2u, A.row_end(2) - A.row_begin(2) );
+  EXPECT_EQ( A.num_blocks(), A.find_block( 3, 0 ) );
+  ASSERT_NE( A.num_blocks(), A.find_block( 2, 0 ) );
+
+  double* blk = A.block( A.find_block( 2, 0 ) );
+  blk[0] = 1; blk[1] = 2; blk[2] = 3; blk[3] = 4;
+  EXPECT_EQ( 2, A(4,1) );
+  EXPECT_EQ( 2, A(1,4) );
+  EXPECT_EQ( 3, A(5,0) );
+  EXPECT_EQ( 0, A(6,0) );
+}
+
+TEST( MatrixBlockSparse, Multiply ) {
+  boost::mt19937 gen(42);
+  MatrixBlockSparse<double,3> A;
+  Matrix<double> dense;
+  fill_test_matrix( A, dense, 20, false, gen );
+
+  for ( size_t i = 0; i < A.rows(); ++i )
+    for ( size_t j = 0; j < A.cols(); ++j )
+      ASSERT_EQ( dense(i,j), A(i,j) );
+
+  Vector<double> x( A.cols() );
+  for ( size_t i = 0; i < x.size(); ++i )
+    x[i] = double(i%7) - 3;
+  EXPECT_VECTOR_NEAR( dense*x, A*x, 1e-12 );
+}
+
+TEST( BlockSparseCholesky, Solve ) {
+  boost::mt19937 gen(7);
+  MatrixBlockSparse<double,6> A;
+  Matrix<double> dense;
+  fill_test_matrix( A, dense, 60, false, gen );
+
+  BlockSparseCholesky<double,6> chol( A );
+  EXPECT_LT( chol.num_supernodes(), A.block_rows() );
+  ASSERT_TRUE( chol.factor( A ) );
+
+  Vector<double> b( A.rows() );
+  for ( size_t i = 0; i < b.size(); ++i )
+    b[i] = double(i%11) - 5;
+  Vector<double> x = chol.solve( b );
+  EXPECT_VECTOR_NEAR( dense*x, b, 1e-9 );
+
+  // The same pattern can be factored again with new values.
+  for ( size_t i = 0; i < A.num_values(); ++i )
+    A.data()[i] *= 2;
+  ASSERT_TRUE( chol.factor( A ) );
+  EXPECT_VECTOR_NEAR( chol.solve( b ), x/2, 1e-9 );
+}
+
+TEST( BlockSparseCholesky, SolveDense ) {
+  boost::mt19937 gen(3);
+  MatrixBlockSparse<double,6> A;
+  Matrix<double> dense;
+  fill_test_matrix( A, dense, 12, true, gen );
+
+  BlockSparseCholesky<double,6> chol( A );
+  EXPECT_EQ( 1u, chol.num_supernodes() );
+  ASSERT_TRUE( chol.factor( A ) );
+
+  Vector<double> b( A.rows() );
+  for ( size_t i = 0; i < b.size(); ++i )
+    b[i] = double(i%5) - 2;
+  EXPECT_VECTOR_NEAR( dense*chol.solve( b ), b, 1e-9 );
+}
+
+TEST( BlockSparseCholesky, NotPositiveDefinite ) {
+  std::vector<std::pair<size_t,size_t> > blocks;
+  blocks.push_back( std::make_pair( 1, 0 ) );
+  MatrixBlockSparse<double,1> A( 2, blocks );
+  A.block(0)[0] = 1;
+  A.block(1)[0] = 2;
+  A.block(2)[0] = 1;
+
+  BlockSparseCholesky<double,1> chol( A );
+  EXPECT_FALSE( chol.factor( A ) );
+}
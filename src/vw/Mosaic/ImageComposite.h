@@ -15,8 +15,11 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <map>
+#include <algorithm>
 
 #include <vw/Core/Cache.h>
+#include <vw/Core/Thread.h>
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
@@ -27,6 +30,7 @@
 #include <vw/Image/Filter.h>
 #include <vw/Image/SparseImageCheck.h>
 #include <vw/FileIO/DiskImageResource.h>
+#include <vw/FileIO/DiskImageView.h>
 
 namespace vw {
 namespace mosaic {
@@ -120,6 +124,133 @@ namespace mosaic {
   };
 
 
+  // *******************************************************************
+  // BBoxRTree
+  // *******************************************************************
+
+  /// A packed R-tree over a fixed set of bounding boxes, built by
+  /// sort-tile-recursive packing.  Finds the boxes that intersect a
+  /// query box in time proportional to the number found plus the
+  /// depth of the tree.
+  class BBoxRTree {
+    static const size_t node_size = 16;
+
+    struct Node {
+      BBox2i bbox;
+      uint32 first, count;  // Children in the level below, or items
+    };
+
+    std::vector<BBox2i> m_boxes;
+    std::vector<uint32> m_items;               // Box indices in leaf order
+    std::vector<std::vector<Node> > m_levels;  // Leaves first
+
+    struct CompareX {
+      std::vector<BBox2i> const& boxes;
+      CompareX( std::vector<BBox2i> const& boxes ) : boxes(boxes) {}
+      bool operator()( uint32 a, uint32 b ) const {
+        return boxes[a].min().x() + boxes[a].max().x() < boxes[b].min().x() + boxes[b].max().x();
+      }
+    };
+
+    struct CompareY {
+      std::vector<BBox2i> const& boxes;
+      CompareY( std::vector<BBox2i> const& boxes ) : boxes(boxes) {}
+      bool operator()( uint32 a, uint32 b ) const {
+        return boxes[a].min().y() + boxes[a].max().y() < boxes[b].min().y() + boxes[b].max().y();
+      }
+    };
+
+    // Groups runs of node_size consecutive entries into nodes.
+    template <class BBoxFuncT>
+    static std::vector<Node> pack( size_t count, BBoxFuncT const& bbox_of ) {
+      std::vector<Node> nodes;
+      for ( size_t first = 0; first < count; first += node_size ) {
+        Node node;
+        node.first = first;
+        node.count = std::min( node_size, count - first );
+        node.bbox = bbox_of( first );
+        for ( size_t i = first+1; i < first + node.count; ++i )
+          node.bbox.grow( bbox_of( i ) );
+        nodes.push_back( node );
+      }
+      return nodes;
+    }
+
+    struct ItemBBox {
+      BBoxRTree const& tree;
+      ItemBBox( BBoxRTree const& tree ) : tree(tree) {}
+      BBox2i operator()( size_t i ) const { return tree.m_boxes[tree.m_items[i]]; }
+    };
+
+    struct NodeBBox {
+      std::vector<Node> const& nodes;
+      NodeBBox( std::vector<Node> const& nodes ) : nodes(nodes) {}
+      BBox2i operator()( size_t i ) const { return nodes[i].bbox; }
+    };
+
+  public:
+    BBoxRTree() {}
+
+    explicit BBoxRTree( std::vector<BBox2i> const& boxes ) : m_boxes(boxes) {
+      if ( boxes.empty() ) return;
+
+      // Sort into vertical slices by x, then each slice by y.
+      m_items.resize( boxes.size() );
+      for ( size_t i = 0; i < boxes.size(); ++i ) m_items[i] = i;
+      std::sort( m_items.begin(), m_items.end(), CompareX( m_boxes ) );
+      size_t leaves = (boxes.size() + node_size - 1) / node_size;
+      size_t slices = size_t( ceil( sqrt( double(leaves) ) ) );
+      size_t slice_size = slices * node_size;
+      for ( size_t first = 0; first < boxes.size(); first += slice_size )
+        std::sort( m_items.begin() + first,
+                   m_items.begin() + std::min( first + slice_size, boxes.size() ),
+                   CompareY( m_boxes ) );
+
+      m_levels.push_back( pack( m_items.size(), ItemBBox( *this ) ) );
+      while ( m_levels.back().size() > 1 ) {
+        std::vector<Node> const& below = m_levels.back();
+        m_levels.push_back( pack( below.size(), NodeBBox( below ) ) );
+      }
+    }
+
+    size_t size() const { return m_boxes.size(); }
+
+    /// The indices of the boxes that intersect bbox, in increasing
+    /// order.
+    void intersecting( BBox2i const& bbox, std::vector<uint32>& result ) const {
+      result.clear();
+      if ( m_levels.empty() ) return;
+      std::vector<std::pair<size_t,uint32> > stack;  // (level, node)
+      stack.push_back( std::make_pair( m_levels.size()-1, uint32(0) ) );
+      while ( !stack.empty() ) {
+        size_t level = stack.back().first;
+        Node const& node = m_levels[level][stack.back().second];
+        stack.pop_back();
+        if ( !node.bbox.intersects( bbox ) ) continue;
+        for ( uint32 i = node.first; i < node.first + node.count; ++i ) {
+          if ( level > 0 )
+            stack.push_back( std::make_pair( level-1, i ) );
+          else if ( m_boxes[m_items[i]].intersects( bbox ) )
+            result.push_back( m_items[i] );
+        }
+      }
+      std::sort( result.begin(), result.end() );
+    }
+  };
+
+  /// Raises each pixel of a rows x cols block of dest to the
+  /// corresponding pixel of src.  Each row is a contiguous run, so the
+  /// inner loop vectorizes.
+  template <class ChannelT>
+  void max_channel_block( ChannelT* dest, ssize_t dest_rstride,
+                          const ChannelT* src, ssize_t src_rstride,
+                          int32 cols, int32 rows ) {
+    for ( int32 j = 0; j < rows; ++j, dest += dest_rstride, src += src_rstride )
+      for ( int32 i = 0; i < cols; ++i )
+        dest[i] = ( src[i] > dest[i] ) ? src[i] : dest[i];
+  }
+
+
   // *******************************************************************
   // ImageComposite
   // *******************************************************************
@@ -195,27 +326,101 @@ namespace mosaic {
 
     friend class PyramidGenerator;
 
+    // The pyramid of one source over just the part of it, bbox, that
+    // a patch needs.  It holds everything it needs by value, so it
+    // can outlive the composite it came from.  Only bbox is read from
+    // the mask file.
+    class LocalPyramidGenerator {
+      ImageViewRef<pixel_type> m_source;
+      std::string m_mask_filename;
+      BBox2i m_source_bbox, m_bbox;
+      int32 m_cols, m_rows, m_levels;
+      bool m_fill_holes;
+    public:
+      typedef Pyramid value_type;
+      LocalPyramidGenerator( ImageComposite const& composite, size_t index, BBox2i const& bbox )
+        : m_source(composite.sourcerefs[index]), m_mask_filename(mask_filename(index)),
+          m_source_bbox(composite.bboxes[index]), m_bbox(bbox),
+          m_cols(composite.view_bbox.width()), m_rows(composite.view_bbox.height()),
+          m_levels(composite.levels), m_fill_holes(composite.m_fill_holes) {}
+      size_t size() const {
+        return size_t( double(m_bbox.width() * m_bbox.height() * sizeof(pixel_type)) * 1.66 );
+      }
+      boost::shared_ptr<value_type> generate() const {
+        boost::shared_ptr<Pyramid> ptr( new Pyramid );
+        ImageView<pixel_type> source = crop( m_source, m_bbox - m_source_bbox.min() );
+        if( m_fill_holes ) source /= select_alpha_channel(source);
+        ImageView<channel_type> mask_image = crop( DiskImageView<channel_type>( m_mask_filename ),
+                                                   m_bbox - m_source_bbox.min() );
+        build_pyramid( *ptr, PositionedImage<pixel_type>( m_cols, m_rows, source, m_bbox ),
+                       PositionedImage<channel_type>( m_cols, m_rows, mask_image, m_bbox ), m_levels );
+        return ptr;
+      }
+    };
+
+    // The local pyramids of recent patches, keyed by source and patch.
+    // Shared between copies of the composite.
+    struct LocalPyramidKey {
+      uint32 source;
+      int32 x, y, cols, rows;
+      bool operator<( LocalPyramidKey const& other ) const {
+        if( source != other.source ) return source < other.source;
+        if( x != other.x ) return x < other.x;
+        if( y != other.y ) return y < other.y;
+        if( cols != other.cols ) return cols < other.cols;
+        return rows < other.rows;
+      }
+    };
+    struct LocalPyramidCache {
+      Mutex mutex;
+      std::map<LocalPyramidKey, Cache::Handle<LocalPyramidGenerator> > handles;
+    };
+
+    // The most local pyramid handles to keep; their pixels are
+    // bounded by the cache either way.
+    static const size_t max_local_pyramids = 4096;
+
+    static std::string mask_filename( size_t index ) {
+      std::ostringstream filename;
+      filename << "mask." << index << ".png";
+      return filename.str();
+    }
+
+    static void build_pyramid( Pyramid& pyramid, PositionedImage<pixel_type> image_high,
+                               PositionedImage<channel_type> mask, int levels );
+
     std::vector<BBox2i > bboxes;
     BBox2i view_bbox, data_bbox;
     int mindim, levels;
     bool m_draft_mode;
     bool m_fill_holes;
     bool m_reuse_masks;
+    bool m_local_pyramids;
     Cache& m_cache;
     std::vector<ImageViewRef<pixel_type> > sourcerefs;
     std::vector<Cache::Handle<SourceGenerator> > sources;
     std::vector<Cache::Handle<AlphaGenerator> > alphas;
     std::vector<Cache::Handle<PyramidGenerator> > pyramids;
+    BBoxRTree m_index;
+    boost::shared_ptr<LocalPyramidCache> m_local_cache;
 
     void generate_masks( ProgressCallback const& progress_callback ) const;
 
+    // The sources whose bboxes intersect bbox, in order.
+    void intersecting_sources( BBox2i const& bbox, std::vector<uint32>& result ) const;
+
+    Cache::Handle<LocalPyramidGenerator> local_pyramid( uint32 index, BBox2i const& patch_bbox,
+                                                        BBox2i const& source_bbox ) const;
+
     ImageView<pixel_type> blend_patch( BBox2i const& patch_bbox ) const;
     ImageView<pixel_type> draft_patch( BBox2i const& patch_bbox ) const;
 
   public:
     typedef pixel_type result_type;
 
-    ImageComposite() : m_draft_mode(false), m_fill_holes(false), m_reuse_masks(false), m_cache(vw_system_cache()) {}
+    ImageComposite() : m_draft_mode(false), m_fill_holes(false), m_reuse_masks(false),
+                       m_local_pyramids(false), m_cache(vw_system_cache()),
+                       m_local_cache( new LocalPyramidCache ) {}
 
     void insert( ImageViewRef<pixel_type> const& image, int x, int y );
 
@@ -233,6 +438,13 @@ namespace mosaic {
 
     void set_reuse_masks( bool reuse_masks ) { m_reuse_masks = reuse_masks; }
 
+    /// Build each source's pyramid only over the part of it that a
+    /// patch needs, rather than over the whole source, and cache it
+    /// for that patch.  Memory then depends on the patch size rather
+    /// than the source sizes, at the cost of recomputing the overlap
+    /// between neighboring patches.
+    void set_local_pyramids( bool local_pyramids ) { m_local_pyramids = local_pyramids; }
+
     int32 cols() const {
       return view_bbox.width();
     }
@@ -275,13 +487,14 @@ namespace mosaic {
     }
 
     bool sparse_check( BBox2i const& bbox ) const {
-      for (unsigned int i = 0; i < bboxes.size(); ++i) {
+      std::vector<uint32> image_list;
+      intersecting_sources( bbox, image_list );
+      for (unsigned int k = 0; k < image_list.size(); ++k) {
+        uint32 i = image_list[k];
         BBox2i src_bbox = bboxes[i];
         src_bbox.crop(bbox);
-        if( ! src_bbox.empty() ) {
-          if( vw::sparse_check( sourcerefs[i], src_bbox-bboxes[i].min() ) ) {
-            return true;
-          }
+        if( vw::sparse_check( sourcerefs[i], src_bbox-bboxes[i].min() ) ) {
+          return true;
         }
       }
       return false;
@@ -315,9 +528,12 @@ void vw::mosaic::ImageComposite<PixelT>::generate_masks( vw::ProgressCallback co
   std::vector<Cache::Handle<GrassfireGenerator> > grassfires;
   for( unsigned i=0; i<sources.size(); ++i )
     grassfires.push_back( m_cache.insert( GrassfireGenerator( sourcerefs[i] ) ) );
+  std::vector<uint32> overlapping;
   for( unsigned p1=0; p1<sources.size(); ++p1 ) {
     ImageView<float> mask = copy( *(grassfires[p1]) );
-    for( unsigned p2=0; p2<sources.size(); ++p2 ) {
+    intersecting_sources( bboxes[p1], overlapping );
+    for( unsigned k=0; k<overlapping.size(); ++k ) {
+      unsigned p2 = overlapping[k];
       if( p1 == p2 ) continue;
       int ox = bboxes[p2].min().x() - bboxes[p1].min().x();
       int oy = bboxes[p2].min().y() - bboxes[p1].min().y();
@@ -339,13 +555,10 @@ void vw::mosaic::ImageComposite<PixelT>::generate_masks( vw::ProgressCallback co
           }
         }
       }
-      progress_callback.report_fractional_progress( double(p1*(sources.size()+1)+p2+1), double((sources.size()+1)*sources.size()) );
     }
     mask = threshold( mask );
-    std::ostringstream filename;
-    filename << "mask." << p1 << ".png";
-    write_image( filename.str(), mask );
-    progress_callback.report_fractional_progress( double((p1+1)*(sources.size()+1)), double((sources.size()+1)*sources.size()) );
+    write_image( mask_filename( p1 ), mask );
+    progress_callback.report_fractional_progress( double(p1+1), double(sources.size()) );
   }
   // report_finished() called by prepare(), so don't call it here
 }
@@ -363,18 +576,27 @@ boost::shared_ptr<typename vw::mosaic::ImageComposite<PixelT>::Pyramid> vw::mosa
   if( m_composite.m_fill_holes ) source /= select_alpha_channel(source);
 
   PositionedImage<pixel_type> image_high( m_composite.view_bbox.width(), m_composite.view_bbox.height(), source, m_composite.bboxes[m_index] );
-  PositionedImage<pixel_type> image_low = image_high.reduce();
   ImageView<channel_type> mask_image;
-
-  std::ostringstream mask_filename;
-  mask_filename << "mask." << m_index << ".png";
-  read_image( mask_image, mask_filename.str() );
+  read_image( mask_image, mask_filename( m_index ) );
   PositionedImage<channel_type> mask( m_composite.view_bbox.width(), m_composite.view_bbox.height(), mask_image, m_composite.bboxes[m_index] );
 
-  for( int l=0; l<m_composite.levels; ++l ) {
+  build_pyramid( *ptr, image_high, mask, m_composite.levels );
+  return ptr;
+}
+
+
+// Builds the Laplacian pyramid of image_high, weighted by the
+// pyramid of its mask.
+template <class PixelT>
+void vw::mosaic::ImageComposite<PixelT>::build_pyramid( Pyramid& pyramid,
+                                                        PositionedImage<pixel_type> image_high,
+                                                        PositionedImage<channel_type> mask,
+                                                        int levels ) {
+  PositionedImage<pixel_type> image_low = image_high.reduce();
+  for( int l=0; l<levels; ++l ) {
     PositionedImage<pixel_type> diff = image_high;
     if( l > 0 ) mask = mask.reduce();
-    if( l < m_composite.levels-1 ) {
+    if( l < levels-1 ) {
       PositionedImage<pixel_type> next_image_low = image_low.reduce();
       image_low.unpremultiply();
       diff.subtract_expanded( image_low );
@@ -382,10 +604,9 @@ boost::shared_ptr<typename vw::mosaic::ImageComposite<PixelT>::Pyramid> vw::mosa
       image_low = next_image_low;
     }
     diff *= mask;
-    ptr->images.push_back( diff );
-    ptr->masks.push_back( mask );
+    pyramid.images.push_back( diff );
+    pyramid.masks.push_back( mask );
   }
-  return ptr;
 }
 
 
@@ -418,6 +639,8 @@ void vw::mosaic::ImageComposite<PixelT>::prepare( vw::ProgressCallback const& pr
   for( unsigned i=0; i<sources.size(); ++i )
     bboxes[i] -= view_bbox.min();
   data_bbox -= view_bbox.min();
+  m_index = BBoxRTree( bboxes );
+  m_local_cache->handles.clear();
 
   levels = (int) floorf( logf( float(mindim)/2.0f ) / logf(2.0f) ) - 1;
   if( levels < 1 ) levels = 1;
@@ -435,6 +658,36 @@ void vw::mosaic::ImageComposite<PixelT>::prepare( BBox2i const& total_bbox,
   prepare( progress_callback );
 }
 
+template <class PixelT>
+void vw::mosaic::ImageComposite<PixelT>::intersecting_sources( BBox2i const& bbox, std::vector<uint32>& result ) const {
+  // The index is built by prepare(); before that, check every source.
+  if( m_index.size() == bboxes.size() ) {
+    m_index.intersecting( bbox, result );
+    return;
+  }
+  result.clear();
+  for( uint32 p=0; p<bboxes.size(); ++p )
+    if( bbox.intersects( bboxes[p] ) ) result.push_back( p );
+}
+
+template <class PixelT>
+vw::Cache::Handle<typename vw::mosaic::ImageComposite<PixelT>::LocalPyramidGenerator>
+vw::mosaic::ImageComposite<PixelT>::local_pyramid( uint32 index, BBox2i const& patch_bbox,
+                                                   BBox2i const& source_bbox ) const {
+  LocalPyramidKey key = { index, patch_bbox.min().x(), patch_bbox.min().y(),
+                          patch_bbox.width(), patch_bbox.height() };
+  Mutex::Lock lock( m_local_cache->mutex );
+  typename std::map<LocalPyramidKey, Cache::Handle<LocalPyramidGenerator> >::iterator it =
+    m_local_cache->handles.find( key );
+  if( it != m_local_cache->handles.end() ) return it->second;
+  if( m_local_cache->handles.size() >= max_local_pyramids )
+    m_local_cache->handles.clear();
+  Cache::Handle<LocalPyramidGenerator> handle =
+    m_cache.insert( LocalPyramidGenerator( *this, index, source_bbox ) );
+  m_local_cache->handles[key] = handle;
+  return handle;
+}
+
 // Suppose a destination image patch at a given level of the pyramid
 // has a bounding box that begins at offset x and has width w.  It
 // is affected by a range of pixels at the next level of the pyramid
@@ -482,10 +735,12 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
 
   // Make a list of the images whose bounding boxes permit them to
   // impact the patch, prioritizing ones that are already in memory.
+  std::vector<uint32> intersecting;
+  intersecting_sources( padded_bbox, intersecting );
   std::list<unsigned> image_list;
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! padded_bbox.intersects( bboxes[p] ) ) continue;
-    if( ! pyramids[p].valid() ) image_list.push_back( p );
+  for( unsigned k=0; k<intersecting.size(); ++k ) {
+    unsigned p = intersecting[k];
+    if( m_local_pyramids || ! pyramids[p].valid() ) image_list.push_back( p );
     else image_list.push_front( p );
   }
 
@@ -493,7 +748,13 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
   std::list<unsigned>::iterator ili=image_list.begin(), ilend=image_list.end();
   for( ; ili!=ilend; ++ili ) {
     unsigned p = *ili;
-    boost::shared_ptr<Pyramid> pyr = pyramids[p];
+    boost::shared_ptr<Pyramid> pyr;
+    if( m_local_pyramids ) {
+      BBox2i source_bbox = padded_bbox;
+      source_bbox.crop( bboxes[p] );
+      pyr = local_pyramid( p, patch_bbox, source_bbox );
+    }
+    else pyr = pyramids[p];
     for( int l=0; l<levels; ++l ) {
       pyr->images[l].addto( sum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
       pyr->masks[l].addto( msum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
@@ -519,24 +780,30 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
   }
   else {
 
-    // Trim to the maximal source alpha, reloading images if needed
+    // Trim to the maximal source alpha, reloading images if needed.
+    // Local pyramids only read the overlap of each source.
     ImageView<channel_type> alpha( patch_bbox.width(), patch_bbox.height() );
-    for( unsigned p=0; p<sources.size(); ++p ) {
-      if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
-
-      ImageView<channel_type> source_alpha = *alphas[p];
-
+    intersecting_sources( patch_bbox, intersecting );
+    for( unsigned k=0; k<intersecting.size(); ++k ) {
+      unsigned p = intersecting[k];
       BBox2i overlap = patch_bbox;
       overlap.crop( bboxes[p] );
-      for( int j=0; j<overlap.height(); ++j ) {
-        for( int i=0; i<overlap.width(); ++i ) {
-          if( source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() ) >
-              alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) ) {
-            alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) =
-              source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() );
-          }
-        }
+
+      ImageView<channel_type> source_alpha;
+      Vector2i source_origin;
+      if( m_local_pyramids ) {
+        source_alpha = select_alpha_channel( crop( sourcerefs[p], overlap - bboxes[p].min() ) );
+        source_origin = overlap.min();
+      }
+      else {
+        source_alpha = *alphas[p];
+        source_origin = bboxes[p].min();
       }
+
+      Vector2i src = overlap.min() - source_origin, dst = overlap.min() - patch_bbox.min();
+      max_channel_block( &alpha( dst.x(), dst.y() ), alpha.cols(),
+                         &source_alpha( src.x(), src.y() ), source_alpha.cols(),
+                         overlap.width(), overlap.height() );
     }
 
     composite *= alpha / select_alpha_channel( composite );
@@ -556,8 +823,10 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::draft_patch( BBox2i co
   ImageView<pixel_type> composite(patch_bbox.width(),patch_bbox.height());
 
   // Add each image to the composite.
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
+  std::vector<uint32> image_list;
+  intersecting_sources( patch_bbox, image_list );
+  for( unsigned k=0; k<image_list.size(); ++k ) {
+    unsigned p = image_list[k];
     BBox2i bbox = patch_bbox;
     bbox.crop( bboxes[p] );
     PositionedImage<pixel_type> image( view_bbox.width(), view_bbox.height(), crop(sourcerefs[p],bbox-bboxes[p].min()), bbox );
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <vw/Mosaic/ImageComposite.h>
+#include <test/Helpers.h>
 
 using namespace std;
 using namespace vw;
@@ -32,3 +33,70 @@ TEST(TestImageComposite, Basic) {
       EXPECT_EQ(2, c(col, row)) << "at (" << col << "," << row << ")";
   }
 }
+
+TEST(TestImageComposite, RTree) {
+  std::vector<BBox2i> boxes;
+  for (int32 i = 0; i < 500; ++i)
+    boxes.push_back(BBox2i((i * 37) % 1000, (i * 91) % 700, 5 + i % 60, 5 + (i * 7) % 45));
+  BBoxRTree tree(boxes);
+  EXPECT_EQ(boxes.size(), tree.size());
+
+  std::vector<uint32> found;
+  for (int32 q = 0; q < 50; ++q) {
+    BBox2i query((q * 53) % 1000, (q * 29) % 700, 10 + q * 3, 10 + q * 2);
+    std::vector<uint32> expected;
+    for (uint32 i = 0; i < boxes.size(); ++i)
+      if (query.intersects(boxes[i])) expected.push_back(i);
+    tree.intersecting(query, found);
+    EXPECT_EQ(expected, found) << "for " << query;
+  }
+
+  BBoxRTree empty;
+  empty.intersecting(BBox2i(0, 0, 10, 10), found);
+  EXPECT_TRUE(found.empty());
+}
+
+ImageView<PixelRGBA<float32> > make_source(int32 cols, int32 rows, float32 seed) {
+  ImageView<PixelRGBA<float32> > img(cols, rows);
+  for (int32 row = 0; row < rows; ++row)
+    for (int32 col = 0; col < cols; ++col) {
+      float32 v = 0.5 + 0.4 * sin(seed + 0.21 * col) * cos(seed * 2 + 0.13 * row);
+      img(col, row) = PixelRGBA<float32>(v, v * v, 1 - v, 1);
+    }
+  return img;
+}
+
+TEST(TestImageComposite, LocalPyramids) {
+  typedef PixelRGBA<float32> PixelT;
+  test::UnlinkName mask0("mask.0.png", "."), mask1("mask.1.png", "."), mask2("mask.2.png", ".");
+
+  ImageComposite<PixelT> full, local;
+  local.set_local_pyramids(true);
+  local.set_reuse_masks(true);
+  ImageComposite<PixelT>* composites[2] = { &full, &local };
+  for (int32 c = 0; c < 2; ++c) {
+    composites[c]->insert(make_source(64, 48, 0), 0, 0);
+    composites[c]->insert(make_source(56, 60, 1), 40, 10);
+    composites[c]->insert(make_source(70, 40, 2), 15, 35);
+  }
+  full.prepare();   // Writes the masks
+  local.prepare();
+  ASSERT_EQ(full.cols(), local.cols());
+  ASSERT_EQ(full.rows(), local.rows());
+
+  for (int32 y = 0; y < full.rows(); y += 16)
+    for (int32 x = 0; x < full.cols(); x += 16) {
+      BBox2i patch(x, y, std::min(16, full.cols() - x), std::min(16, full.rows() - y));
+      ImageView<PixelT> expected = full.generate_patch(patch);
+      ImageView<PixelT> actual = local.generate_patch(patch);
+      // Twice, to use the cached pyramids
+      ImageView<PixelT> cached = local.generate_patch(patch);
+      for (int32 row = 0; row < patch.height(); ++row)
+        for (int32 col = 0; col < patch.width(); ++col)
+          for (int32 ch = 0; ch < 4; ++ch) {
+            ASSERT_NEAR(expected(col, row)[ch], actual(col, row)[ch], 1e-4)
+              << "at (" << x + col << "," << y + row << ") channel " << ch;
+            ASSERT_EQ(actual(col, row)[ch], cached(col, row)[ch]);
+          }
+    }
+}
@@ -14,10 +14,12 @@
 #include <vw/Core/Log.h>
 #include <vw/Core/Debugging.h>
 
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <boost/shared_array.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #define WHEREAMI (vw::vw_out(VerboseDebugMessage, "platefile.blob") << VW_CURRENT_FUNCTION << ": ")
 
@@ -45,6 +47,50 @@ BlobRecord Blob::read_blob_record(uint16 &blob_record_size) const {
   return blob_record;
 }
 
+BlobRecord Blob::read_blob_record(uint64 base_offset, uint16 &blob_record_size,
+                                  boost::shared_ptr<mapping_type>& mapping) const {
+
+  WHEREAMI << "[Filename: " << m_blob_filename
+           << " Offset: " << base_offset << "]\n";
+
+  // Read the blob record size, and then the blob record, straight out
+  // of the mapping.
+  mapping = this->mapping(base_offset + sizeof(blob_record_size));
+  std::memcpy(&blob_record_size, mapping->data() + base_offset, sizeof(blob_record_size));
+  WHEREAMI << "[blob_record_size: " << blob_record_size << "]\n";
+
+  mapping = this->mapping(base_offset + sizeof(blob_record_size) + blob_record_size);
+  BlobRecord blob_record;
+  bool worked = blob_record.ParseFromArray(mapping->data() + base_offset + sizeof(blob_record_size),
+                                           blob_record_size);
+  if (!worked)
+    vw_throw(BlobIoErr() << "read_blob_record() failed in " << m_blob_filename
+                         << " at offset " << base_offset);
+  return blob_record;
+}
+
+boost::shared_ptr<Blob::mapping_type> Blob::mapping(uint64 end) const {
+  Mutex::Lock lock(m_mapping_mutex);
+  if (end <= m_mapping->size())
+    return m_mapping;
+
+  // Someone has appended to the blob since we mapped it.  Map it
+  // again; tiles that were read from the old mapping keep it alive
+  // for as long as they need it.
+  WHEREAMI << "remapping " << m_blob_filename << " to reach offset " << end << "\n";
+  boost::shared_ptr<mapping_type> grown;
+  try {
+    grown.reset(new mapping_type(m_blob_filename));
+  } catch (const std::exception& e) {
+    vw_throw(BlobIoErr() << "Could not map blob file \"" << m_blob_filename << "\": " << e.what());
+  }
+  if (end > grown->size())
+    vw_throw(BlobIoErr() << "Offset " << end << " is past the end of blob file \""
+                         << m_blob_filename << "\" (" << grown->size() << " bytes).");
+  m_mapping = grown;
+  return m_mapping;
+}
+
 bool Blob::iterator::equal (iterator const& iter) const {
   return m_blob->m_blob_filename == iter.m_blob->m_blob_filename
       && m_current_base_offset == iter.m_current_base_offset;
@@ -68,6 +114,24 @@ TileHeader Blob::read_header(uint64 base_offset64) {
   vw_out(VerboseDebugMessage, "platefile::blob")
     << "Entering read_header() -- " <<" base_offset: " <<  base_offset64 << "\n";
 
+  // Read-only blobs parse the header straight out of the mapping.
+  if (!m_fstream) {
+    uint16 blob_record_size;
+    boost::shared_ptr<mapping_type> mapping;
+    BlobRecord blob_record = this->read_blob_record(base_offset64, blob_record_size, mapping);
+
+    uint64 offset = base_offset64 + sizeof(blob_record_size) + blob_record_size + blob_record.header_offset();
+    uint64 size = blob_record.header_size();
+    mapping = this->mapping(offset + size);
+
+    TileHeader header;
+    bool worked = header.ParseFromArray(mapping->data() + offset, boost::numeric_cast<int>(size));
+    if (!worked)
+      vw_throw(IOErr() << "Blob::read() -- an error occurred while deserializing the header "
+               << "from the blob file.");
+    return header;
+  }
+
   std::streamoff base_offset = boost::numeric_cast<std::streamoff>(base_offset64);
 
   // Seek to the requested offset and read the header and data offset
@@ -123,10 +187,19 @@ TileData Blob::read_data(vw::uint64 base_offset) {
   std::string dontcare;
   read_sendfile(base_offset, dontcare, offset, size);
 
-  TileData data(new std::vector<uint8>(size));
+  // Read-only blobs hand out a view into the mapping.
+  if (!m_fstream) {
+    boost::shared_ptr<mapping_type> mapping = this->mapping(offset + size);
+    const uint8* data = reinterpret_cast<const uint8*>(mapping->data()) + offset;
+    return TileData(new TileBuffer(mapping, data, boost::numeric_cast<size_t>(size)));
+  }
 
-  m_fstream->seekg(offset, std::ios_base::beg);
-  m_fstream->read(reinterpret_cast<char*>(&data->operator[](0)), size);
+  boost::shared_ptr<std::vector<uint8> > data(new std::vector<uint8>(boost::numeric_cast<size_t>(size)));
+
+  if (size > 0) {
+    m_fstream->seekg(offset, std::ios_base::beg);
+    m_fstream->read(reinterpret_cast<char*>(&data->operator[](0)), size);
+  }
 
   // Throw an exception if the read operation failed (after clearing the error bit)
   if (m_fstream->fail()) {
@@ -134,7 +207,7 @@ TileData Blob::read_data(vw::uint64 base_offset) {
     vw_throw(IOErr() << VW_CURRENT_FUNCTION << ": failed to read from blob.");
   }
 
-  return data;
+  return TileData(new TileBuffer(data, data->empty() ? 0 : &data->operator[](0), data->size()));
 }
 
 boost::shared_array<uint8> Blob::read_data(uint64 base_offset, uint64& data_size) {
@@ -147,6 +220,12 @@ boost::shared_array<uint8> Blob::read_data(uint64 base_offset, uint64& data_size
   // Allocate an array of the appropriate size to read the data.
   boost::shared_array<uint8> data(new uint8[data_size]);
 
+  if (!m_fstream) {
+    boost::shared_ptr<mapping_type> mapping = this->mapping(offset + data_size);
+    std::memcpy(data.get(), mapping->data() + offset, boost::numeric_cast<size_t>(data_size));
+    return data;
+  }
+
   m_fstream->seekg(offset, std::ios_base::beg);
   m_fstream->read(reinterpret_cast<char*>(data.get()), data_size);
 
@@ -165,12 +244,16 @@ uint64 Blob::next_base_offset(uint64 current_base_offset) {
 
   WHEREAMI << "[current_base_offset: " <<  current_base_offset << "]\n";
 
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(current_base_offset, std::ios_base::beg);
-
   // Read the blob record
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record;
+  if (m_fstream) {
+    m_fstream->seekg(current_base_offset, std::ios_base::beg);
+    blob_record = this->read_blob_record(blob_record_size);
+  } else {
+    boost::shared_ptr<mapping_type> mapping;
+    blob_record = this->read_blob_record(current_base_offset, blob_record_size, mapping);
+  }
 
   uint64 blob_offset_metadata = sizeof(blob_record_size) + blob_record_size;
   uint64 next_offset = current_base_offset + blob_offset_metadata + blob_record.data_offset() + blob_record.data_size();
@@ -185,12 +268,16 @@ uint64 Blob::data_size(uint64 base_offset) const {
 
   WHEREAMI << "[base_offset: " <<  base_offset << "]\n";
 
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(base_offset, std::ios_base::beg);
-
   // Read the blob record
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record;
+  if (m_fstream) {
+    m_fstream->seekg(base_offset, std::ios_base::beg);
+    blob_record = this->read_blob_record(blob_record_size);
+  } else {
+    boost::shared_ptr<mapping_type> mapping;
+    blob_record = this->read_blob_record(base_offset, blob_record_size, mapping);
+  }
 
   WHEREAMI << "[result size: " <<  blob_record.data_size() << "]\n";
 
@@ -204,10 +291,11 @@ Blob::Blob(std::string filename, bool readonly)
 {
 
   if (readonly) {
-    m_fstream.reset(new std::fstream(m_blob_filename.c_str(),
-                                     std::ios::in | std::ios::binary));
-    if (!m_fstream->is_open())
-        vw_throw(BlobIoErr() << "Could not open blob file \"" << m_blob_filename << "\".");
+    try {
+      m_mapping.reset(new mapping_type(m_blob_filename));
+    } catch (const std::exception& e) {
+      vw_throw(BlobIoErr() << "Could not open blob file \"" << m_blob_filename << "\": " << e.what());
+    }
 
     WHEREAMI << filename << " (READONLY)\n";
   } else {
@@ -235,7 +323,7 @@ Blob::Blob(std::string filename, bool readonly)
     WHEREAMI << filename << " (READ/WRITE)\n";
   }
 
-  if (!m_fstream->is_open())
+  if (m_fstream && !m_fstream->is_open())
     vw_throw(BlobIoErr() << "Could not open blob file \"" << m_blob_filename << "\".");
 
   // Set the cached copy of the end_of_file_ptr.
@@ -244,17 +332,22 @@ Blob::Blob(std::string filename, bool readonly)
 
 /// Destructor: make sure that we have written the end of file ptr.
 Blob::~Blob() {
-  this->write_end_of_file_ptr(m_end_of_file_ptr);
+  if (m_fstream)
+    this->write_end_of_file_ptr(m_end_of_file_ptr);
   WHEREAMI << m_blob_filename << "\n";
 }
 
 void Blob::read_sendfile(uint64 base_offset, std::string& filename, uint64& offset, uint64& size) {
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(base_offset, std::ios_base::beg);
-
-  // Read the blob record
+  // Read the blob record, from the mapping if we have one.
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record;
+  if (m_fstream) {
+    m_fstream->seekg(base_offset, std::ios_base::beg);
+    blob_record = this->read_blob_record(blob_record_size);
+  } else {
+    boost::shared_ptr<mapping_type> mapping;
+    blob_record = this->read_blob_record(base_offset, blob_record_size, mapping);
+  }
 
   // The overall blob metadata includes the uint16 of the
   // blob_record_size in addition to the size of the blob_record
@@ -289,8 +382,12 @@ uint64 Blob::read_end_of_file_ptr() const {
 
   // The end of file ptr is stored at the beginning of the blob
   // file.
-  m_fstream->seekg(0, std::ios_base::beg);
-  m_fstream->read(reinterpret_cast<char*>(data), 3*sizeof(uint64));
+  if (m_fstream) {
+    m_fstream->seekg(0, std::ios_base::beg);
+    m_fstream->read(reinterpret_cast<char*>(data), 3*sizeof(uint64));
+  } else {
+    std::memcpy(data, this->mapping(sizeof(data))->data(), sizeof(data));
+  }
 
   // Make sure the read ptr is valid by comparing the three
   // entries.
@@ -311,6 +408,8 @@ uint64 Blob::read_end_of_file_ptr() const {
   else {
     vw_out(ErrorMessage) << "\nWARNING: end of file ptr in blobfile " << m_blob_filename
                          << " is inconsistent.  This file may be corrupt.  Proceed with caution.\n";
+    if (!m_fstream)
+      return this->mapping(0)->size();
     m_fstream->seekg(0, std::ios_base::end);
     return m_fstream->tellg();
   }
@@ -318,6 +417,9 @@ uint64 Blob::read_end_of_file_ptr() const {
 
 uint64 Blob::write(TileHeader const& header, const uint8* data, uint64 data_size) {
 
+  if (!m_fstream)
+    vw_throw(BlobIoErr() << "Cannot write to read-only blob file \"" << m_blob_filename << "\".");
+
   // Store the current offset of the end of the file.  We'll
   // return that at the end of this function.
   std::streamoff base_offset = boost::numeric_cast<std::streamoff>(m_end_of_file_ptr);
@@ -365,6 +467,61 @@ uint64 Blob::write(TileHeader const& header, const uint8* data, uint64 data_size
   return base_offset;
 }
 
+std::vector<uint64> Blob::write(std::vector<TileHeader> const& headers,
+                               std::vector<const uint8*> const& data,
+                               std::vector<uint64> const& data_sizes) {
+
+  if (!m_fstream)
+    vw_throw(BlobIoErr() << "Cannot write to read-only blob file \"" << m_blob_filename << "\".");
+  VW_ASSERT(headers.size() == data.size() && headers.size() == data_sizes.size(),
+            ArgumentErr() << "Blob::write(): batch has " << headers.size() << " headers, "
+            << data.size() << " data pointers, and " << data_sizes.size() << " sizes.");
+
+  std::vector<uint64> base_offsets(headers.size());
+  if (headers.empty())
+    return base_offsets;
+
+  // Lay out every record back to back in memory, exactly as the
+  // single tile write() would have written them one after another,
+  // so that the whole batch goes to disk in one write.
+  uint64 offset = m_end_of_file_ptr;
+  std::string buffer;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    BlobRecord blob_record;
+    blob_record.set_header_offset(0);
+    blob_record.set_header_size(headers[i].ByteSize());
+    blob_record.set_data_offset(headers[i].ByteSize());
+    blob_record.set_data_size(data_sizes[i]);
+
+    uint16 blob_record_size = boost::numeric_cast<uint16>(blob_record.ByteSize());
+    buffer.append(reinterpret_cast<char*>(&blob_record_size), sizeof(blob_record_size));
+    blob_record.AppendToString(&buffer);
+    headers[i].AppendToString(&buffer);
+    buffer.append(reinterpret_cast<const char*>(data[i]), boost::numeric_cast<size_t>(data_sizes[i]));
+
+    base_offsets[i] = offset;
+    offset = m_end_of_file_ptr + buffer.size();
+  }
+
+  m_fstream->seekp(boost::numeric_cast<std::streamoff>(m_end_of_file_ptr), std::ios_base::beg);
+  m_fstream->write(buffer.data(), buffer.size());
+
+  vw_out(VerboseDebugMessage, "platefile::blob") << "Blob::write() -- writing "
+                                                     << headers.size() << " tiles ("
+                                                     << buffer.size() << " bytes) to "
+                                                     << m_blob_filename << "\n";
+
+  // One batch counts as one write as far as the end_of_file_ptr is
+  // concerned, so a batch costs a single pointer update at most.
+  m_end_of_file_ptr = offset;
+  ++m_write_count;
+  if (m_write_count % 10 == 0) {
+    this->write_end_of_file_ptr(m_end_of_file_ptr);
+  }
+
+  return base_offsets;
+}
+
 /// Read data out of the blob and save it as its own file on disk.
 void Blob::read_to_file(std::string dest_file, uint64 offset) {
   TileData data = this->read_data(offset);
@@ -375,7 +532,7 @@ void Blob::read_to_file(std::string dest_file, uint64 offset) {
   if (!ostr.is_open())
     vw_throw(IOErr() << VW_CURRENT_FUNCTION << ": could not open dst file for writing");
 
-  ostr.write(reinterpret_cast<char*>(&data->operator[](0)), data->size());
+  ostr.write(reinterpret_cast<const char*>(data->data()), data->size());
   ostr.close();
 }
 
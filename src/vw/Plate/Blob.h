@@ -32,20 +32,56 @@
 ///
 ///   [ DATA ]              [ uint8 - N raw bytes of data ]
 ///
+/// A blob opened read-only is memory mapped rather than read through a
+/// stream.  Headers are parsed straight out of the mapping, and tile
+/// data is returned as a view into it, so serving a tile from a
+/// read-only blob costs no seeks, reads, or copies.
 ///
 
 #include <vw/Plate/IndexData.pb.h>
 #include <vw/Core/Exception.h>
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Thread.h>
 #include <boost/shared_array.hpp>
 #include <fstream>
 #include <string>
+#include <vector>
+
+namespace boost {
+namespace iostreams {
+  class mapped_file_source;
+}}
 
 namespace vw {
 namespace platefile {
 
-  typedef boost::shared_ptr<std::vector<vw::uint8> > TileData;
+  /// The raw bytes of a tile.  A TileBuffer keeps whatever holds its
+  /// bytes alive: for tiles read from a read-only blob that is the
+  /// blob's memory mapping, so the bytes remain valid even after the
+  /// Blob itself has been destroyed.
+  class TileBuffer {
+    boost::shared_ptr<const void> m_owner;
+    const uint8* m_data;
+    size_t m_size;
+
+  public:
+    typedef uint8 value_type;
+    typedef const uint8* const_iterator;
+    typedef const_iterator iterator;
+
+    TileBuffer( boost::shared_ptr<const void> owner, const uint8* data, size_t size )
+      : m_owner(owner), m_data(data), m_size(size) {}
+
+    const uint8* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+    const uint8& operator[]( size_t i ) const { return m_data[i]; }
+  };
+
+  typedef boost::shared_ptr<const TileBuffer> TileData;
 
   // -------------------------------------------------------------------
   //                                 BLOB
@@ -53,14 +89,29 @@ namespace platefile {
 
   class Blob : boost::noncopyable {
 
+    typedef boost::iostreams::mapped_file_source mapping_type;
+
     std::string m_blob_filename;
     boost::shared_ptr<std::fstream> m_fstream;
+    mutable boost::shared_ptr<mapping_type> m_mapping;
+    mutable Mutex m_mapping_mutex;
     uint64 m_end_of_file_ptr;
     uint64 m_write_count;
 
     /// Returns the metadata (i.e. BlobRecord) for a blob entry.
     BlobRecord read_blob_record(uint16 &blob_record_size) const;
 
+    /// Returns the metadata (i.e. BlobRecord) for the blob entry at
+    /// base_offset in a read-only blob, along with the mapping that
+    /// it was read from.
+    BlobRecord read_blob_record(uint64 base_offset, uint16 &blob_record_size,
+                                boost::shared_ptr<mapping_type>& mapping) const;
+
+    /// Returns a mapping of a read-only blob that covers the bytes
+    /// before end, remapping the file if it has grown since it was
+    /// last mapped.
+    boost::shared_ptr<mapping_type> mapping(uint64 end) const;
+
     // End-of-file point manipulation.
     void write_end_of_file_ptr(uint64 ptr);
     uint64 read_end_of_file_ptr() const;
@@ -87,7 +138,7 @@ namespace platefile {
 
     // -----------------------------------------------------------------------
 
-    /// Constructor
+    /// Constructor.  A read-only blob is memory mapped.
     Blob(std::string filename, bool readonly = false);
 
     /// The destructor flushes any unwritten journal entries and
@@ -117,6 +168,7 @@ namespace platefile {
     TileHeader read_header(vw::uint64 base_offset64);
 
     /// Returns the binary data for an entry starting at base_offset.
+    /// For a read-only blob this is a view into the blob's mapping.
     boost::shared_array<uint8> read_data(vw::uint64 base_offset, vw::uint64& data_size) VW_DEPRECATED;
     TileData read_data(vw::uint64 base_offset);
 
@@ -135,6 +187,14 @@ namespace platefile {
     /// written to the blob file.
     vw::uint64 write(TileHeader const& header, const uint8* data, uint64 data_size);
 
+    /// Write several tiles to the blob file with a single append.  The
+    /// i'th tile has header headers[i] and data_sizes[i] bytes of data
+    /// starting at data[i].  The end of file pointer is updated once
+    /// for the whole batch.  Returns the base_offset of each tile.
+    std::vector<vw::uint64> write(std::vector<TileHeader> const& headers,
+                                  std::vector<const uint8*> const& data,
+                                  std::vector<uint64> const& data_sizes);
+
     /// Write the data file to disk, and the concatenate it into the data blob.
     void write_from_file(std::string source_file, TileHeader const& header, uint64& base_offset) VW_DEPRECATED;
 
@@ -30,3 +30,20 @@ boost::shared_ptr<Index> Index::construct_open(const Url& url) {
     return boost::shared_ptr<Index>(new RemoteIndex(url));
 }
 
+void Index::multi_read_request(std::vector<TileHeader> const& headers,
+                               std::vector<IndexRecord>& records,
+                               bool exact_transaction_match) {
+  records.resize(headers.size());
+  for (size_t i = 0; i < headers.size(); ++i)
+    records[i] = this->read_request(headers[i].col(), headers[i].row(), headers[i].level(),
+                                    headers[i].transaction_id(), exact_transaction_match);
+}
+
+void Index::multi_write_update(std::vector<TileHeader> const& headers,
+                               std::vector<IndexRecord> const& records) {
+  VW_ASSERT(headers.size() == records.size(),
+            ArgumentErr() << "multi_write_update(): " << headers.size() << " headers but "
+            << records.size() << " records.");
+  for (size_t i = 0; i < headers.size(); ++i)
+    this->write_update(headers[i], records[i]);
+}
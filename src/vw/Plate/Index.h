@@ -14,6 +14,7 @@
 #include <vw/Math/BBox.h>
 #include <boost/shared_ptr.hpp>
 #include <list>
+#include <vector>
 
 #define VW_PLATE_INDEX_VERSION 3
 
@@ -74,6 +75,15 @@ namespace platefile {
     /// most recent tile, regardless of its transaction id.
     virtual IndexRecord read_request(int col, int row, int depth, TransactionOrNeg transaction_id, bool exact_transaction_match = false) = 0;
 
+    /// Reading, batched: Look up the tiles that several headers name
+    /// by col, row, level and transaction_id.  records[i] is set to
+    /// the record for headers[i].  Throws a TileNotFoundErr if any of
+    /// them cannot be found.  The default implementation calls
+    /// read_request() for each header.
+    virtual void multi_read_request(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord>& records,
+                                    bool exact_transaction_match = false);
+
     /// Writing, pt. 1: Locks a blob and returns the blob id that can
     /// be used to write a tile.
     virtual int write_request(uint64 &size) = 0;
@@ -82,6 +92,12 @@ namespace platefile {
     /// unlock the blob id.
     virtual void write_update(TileHeader const& header, IndexRecord const& record) = 0;
 
+    /// Writing, pt. 2, batched: Update the index for several tiles at
+    /// once.  headers[i] is paired with records[i].  The default
+    /// implementation calls write_update() for each pair.
+    virtual void multi_write_update(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord> const& records);
+
     /// Writing, pt. 3: Signal the completion of the write operation.
     virtual void write_complete(int blob_id, uint64 blob_offset) = 0;
 
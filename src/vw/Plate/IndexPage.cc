@@ -11,6 +11,9 @@
 #include <vw/Math/BBox.h>
 #include <vw/Core/Debugging.h>
 
+#include <vw/Plate/google/sparsetable>
+
+#include <algorithm>
 #include <boost/shared_array.hpp>
 #include <boost/foreach.hpp>
 
@@ -22,13 +25,53 @@ using namespace vw::platefile;
 //                            INDEX PAGE
 // ----------------------------------------------------------------------
 
+namespace {
+
+  // "VWIP" on little endian machines.  Pages in the legacy format
+  // start with their page width, which is never anywhere near this.
+  const uint32 PACKED_PAGE_MAGIC = 0x50495756;
+  const uint32 PACKED_PAGE_VERSION = 1;
+
+  // Orders records by tile and then by decreasing transaction id.
+  struct RecordOrder {
+    int page_width;
+    RecordOrder(int page_width) : page_width(page_width) {}
+    template <class RecordT>
+    bool operator()(RecordT const& a, RecordT const& b) const {
+      uint32 tile_a = a.row*page_width + a.col, tile_b = b.row*page_width + b.col;
+      if (tile_a != tile_b) return tile_a < tile_b;
+      return a.transaction_id > b.transaction_id;
+    }
+  };
+
+  template <class T>
+  void write_vector(std::ostream& ostr, std::vector<T> const& v) {
+    uint32 size = boost::numeric_cast<uint32>(v.size());
+    ostr.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    if (size)
+      ostr.write(reinterpret_cast<const char*>(&v[0]), size*sizeof(T));
+  }
+
+  template <class T>
+  void read_vector(std::istream& istr, std::vector<T>& v) {
+    uint32 size;
+    istr.read(reinterpret_cast<char*>(&size), sizeof(size));
+    VW_ASSERT(istr.good(), IOErr() << "while reading an array size.");
+    v.resize(size);
+    if (size)
+      istr.read(reinterpret_cast<char*>(&v[0]), size*sizeof(T));
+    VW_ASSERT(!istr.fail(), IOErr() << "while reading an array of " << size << " entries.");
+  }
+
+}
+
 IndexPage::IndexPage(int level, int base_col, int base_row,
                      int page_width, int page_height) :
   m_level(level), m_base_col(base_col), m_base_row(base_row),
-  m_page_width(page_width), m_page_height(page_height) {
+  m_page_width(page_width), m_page_height(page_height), m_tile_starts(1, 0) {
 
-  // Set the size of the sparse table.
-  m_sparse_table.resize(page_width*page_height);
+  VW_ASSERT(page_width > 0 && page_height > 0 && page_width <= 65536 && page_height <= 65536,
+            ArgumentErr() << "IndexPage: unsupported page size " << page_width << "x" << page_height);
 
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
@@ -37,47 +80,169 @@ IndexPage::~IndexPage() {
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
 
+void IndexPage::compact() const {
+  if (m_pending.empty())
+    return;
+
+  RecordOrder order(m_page_width);
+
+  // Sort the new records.  The sort is stable, so of several writes
+  // to the same tile and transaction the last one made comes last.
+  std::stable_sort(m_pending.begin(), m_pending.end(), order);
+
+  // Merge them into the sorted records.  A new record replaces an
+  // existing one with the same tile and transaction id.
+  std::vector<Record> merged;
+  merged.reserve(m_records.size() + m_pending.size());
+  std::vector<Record>::const_iterator old_it = m_records.begin(), new_it = m_pending.begin();
+  while (new_it != m_pending.end()) {
+    // Skip to the last of a run of equal new records.
+    while (new_it+1 != m_pending.end() && !order(*new_it, *(new_it+1)))
+      ++new_it;
+    while (old_it != m_records.end() && order(*old_it, *new_it))
+      merged.push_back(*old_it++);
+    if (old_it != m_records.end() && !order(*new_it, *old_it))
+      ++old_it;
+    merged.push_back(*new_it++);
+  }
+  merged.insert(merged.end(), old_it, std::vector<Record>::const_iterator(m_records.end()));
+  m_records.swap(merged);
+  m_pending.clear();
+
+  // Rebuild the tile offset table.
+  m_tile_ids.clear();
+  m_tile_starts.clear();
+  for (size_t i = 0; i < m_records.size(); ++i) {
+    uint32 tile = m_records[i].row*m_page_width + m_records[i].col;
+    if (m_tile_ids.empty() || m_tile_ids.back() != tile) {
+      m_tile_ids.push_back(tile);
+      m_tile_starts.push_back(boost::numeric_cast<uint32>(i));
+    }
+  }
+  m_tile_starts.push_back(boost::numeric_cast<uint32>(m_records.size()));
+}
+
+std::pair<size_t, size_t> IndexPage::tile_range(int32 page_col, int32 page_row) const {
+  uint32 tile = page_row*m_page_width + page_col;
+  std::vector<uint32>::const_iterator it = std::lower_bound(m_tile_ids.begin(), m_tile_ids.end(), tile);
+  if (it == m_tile_ids.end() || *it != tile)
+    return std::make_pair(size_t(0), size_t(0));
+  size_t i = it - m_tile_ids.begin();
+  return std::make_pair(size_t(m_tile_starts[i]), size_t(m_tile_starts[i+1]));
+}
+
+IndexRecord IndexPage::index_record(Record const& r) const {
+  IndexRecord rec;
+  rec.set_blob_id(r.blob_id);
+  rec.set_blob_offset(r.blob_offset);
+  rec.set_filetype(m_filetypes[r.filetype]);
+  return rec;
+}
+
+TileHeader IndexPage::tile_header(Record const& r) const {
+  TileHeader hdr;
+  hdr.set_col( m_base_col + r.col );
+  hdr.set_row( m_base_row + r.row );
+  hdr.set_level(m_level);
+  hdr.set_transaction_id(r.transaction_id);
+  return hdr;
+}
+
 void IndexPage::serialize(std::ostream& ostr) {
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 
-  // Part 1: Write out the page size
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+
+  // Part 1: Write the format tag and the page size
+  ostr.write(reinterpret_cast<const char*>(&PACKED_PAGE_MAGIC), sizeof(PACKED_PAGE_MAGIC));
+  ostr.write(reinterpret_cast<const char*>(&PACKED_PAGE_VERSION), sizeof(PACKED_PAGE_VERSION));
   ostr.write(reinterpret_cast<char*>(&m_page_width), sizeof(m_page_width));
   ostr.write(reinterpret_cast<char*>(&m_page_height), sizeof(m_page_height));
 
-  // Part 2: Write the sparsetable metadata
-  m_sparse_table.write_metadata(&ostr);
+  // Part 2: Write the filetype table
+  uint32 num_filetypes = boost::numeric_cast<uint32>(m_filetypes.size());
+  ostr.write(reinterpret_cast<char*>(&num_filetypes), sizeof(num_filetypes));
+  BOOST_FOREACH(std::string const& type, m_filetypes) {
+    uint16 length = boost::numeric_cast<uint16>(type.size());
+    ostr.write(reinterpret_cast<char*>(&length), sizeof(length));
+    ostr.write(type.data(), length);
+  }
 
-  // Part 3: Write sparse entries
-  for (nonempty_iterator it = m_sparse_table.nonempty_begin(); it != m_sparse_table.nonempty_end(); ++it) {
+  // Part 3: Write the tile offset table and the records
+  write_vector(ostr, m_tile_ids);
+  write_vector(ostr, m_tile_starts);
+  write_vector(ostr, m_records);
+}
 
-    // Iterate over transaction_id list.
-    uint32 transaction_list_size = boost::numeric_cast<uint32>(it->size());
-    ostr.write(reinterpret_cast<char*>(&transaction_list_size), sizeof(transaction_list_size));
+void IndexPage::deserialize(std::istream& istr) {
 
-    multi_value_type::iterator transaction_iter = (*it).begin();
-    while (transaction_iter != (*it).end()) {
+  WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 
-      // Save the transaction id
-      uint32 t_id = (*transaction_iter).first;
-      ostr.write(reinterpret_cast<char*>(&t_id), sizeof(t_id));
+  VW_ASSERT(istr.good(), IOErr() << "while beginning to deserialize.");
 
-      // Save the size of each protobuf, and then serialize it to disk.
-      uint16 protobuf_size = boost::numeric_cast<uint16>(transaction_iter->second.ByteSize());
-      boost::shared_array<uint8> protobuf_bytes( new uint8[protobuf_size] );
-      (*transaction_iter).second.SerializeToArray(protobuf_bytes.get(), protobuf_size);
-      ostr.write(reinterpret_cast<char*>(&protobuf_size), sizeof(protobuf_size));
-      ostr.write(reinterpret_cast<char*>(protobuf_bytes.get()), protobuf_size);
+  Mutex::Lock lock(m_mutex);
+  m_records.clear();
+  m_pending.clear();
+  m_tile_ids.clear();
+  m_tile_starts.assign(1, 0);
+  m_filetypes.clear();
+
+  uint32 magic;
+  istr.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  VW_ASSERT(istr.good(), IOErr() << "while reading page format.");
+  if (magic != PACKED_PAGE_MAGIC) {
+    istr.seekg(-std::streamoff(sizeof(magic)), std::ios_base::cur);
+    this->deserialize_legacy(istr);
+    return;
+  }
 
-      ++transaction_iter;
-    }
+  // Part 1: Read the format version and the page size
+  uint32 version;
+  istr.read(reinterpret_cast<char*>(&version), sizeof(version));
+  istr.read(reinterpret_cast<char*>(&m_page_width), sizeof(m_page_width));
+  istr.read(reinterpret_cast<char*>(&m_page_height), sizeof(m_page_height));
+  VW_ASSERT(istr.good(), IOErr() << "while reading page size.");
+  VW_ASSERT(version == PACKED_PAGE_VERSION, IOErr() << "unknown index page version " << version << ".");
+
+  // Part 2: Read the filetype table
+  uint32 num_filetypes;
+  istr.read(reinterpret_cast<char*>(&num_filetypes), sizeof(num_filetypes));
+  VW_ASSERT(istr.good(), IOErr() << "while reading filetype table size.");
+  m_filetypes.resize(num_filetypes);
+  BOOST_FOREACH(std::string& type, m_filetypes) {
+    uint16 length;
+    istr.read(reinterpret_cast<char*>(&length), sizeof(length));
+    VW_ASSERT(istr.good(), IOErr() << "while reading a filetype.");
+    std::vector<char> bytes(length);
+    if (length)
+      istr.read(&bytes[0], length);
+    VW_ASSERT(istr.good(), IOErr() << "while reading a filetype.");
+    type.assign(bytes.begin(), bytes.end());
   }
-}
 
-void IndexPage::deserialize(std::istream& istr) {
+  // Part 3: Read the tile offset table and the records
+  read_vector(istr, m_tile_ids);
+  read_vector(istr, m_tile_starts);
+  read_vector(istr, m_records);
+
+  // Make sure the tables agree with each other, since a bad offset
+  // would otherwise send searches off the end of the records.
+  VW_ASSERT(m_tile_starts.size() == m_tile_ids.size() + 1 &&
+            m_tile_starts.front() == 0 && m_tile_starts.back() == m_records.size(),
+            IOErr() << "index page tile table does not match its records.");
+  for (size_t i = 0; i < m_tile_ids.size(); ++i)
+    VW_ASSERT(m_tile_starts[i] < m_tile_starts[i+1] && (i == 0 || m_tile_ids[i-1] < m_tile_ids[i]),
+              IOErr() << "index page tile table is not sorted.");
+  BOOST_FOREACH(Record const& r, m_records)
+    VW_ASSERT(r.col < m_page_width && r.row < m_page_height && r.filetype < m_filetypes.size(),
+              IOErr() << "index page record is out of range.");
 
-  WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
+  if (istr.peek() != EOF)
+    vw_out(WarningMessage, "platefile.index") << "Unparsed data remaining in index page.\n";
+}
 
-  VW_ASSERT(istr.good(), IOErr() << "while beginning to deserialize.");
+void IndexPage::deserialize_legacy(std::istream& istr) {
 
   // Part 1: Read the page size
   istr.read(reinterpret_cast<char*>(&m_page_width), sizeof(m_page_width));
@@ -85,28 +250,30 @@ void IndexPage::deserialize(std::istream& istr) {
 
   VW_ASSERT(istr.good(), IOErr() << "while reading page size.");
 
-  // Part 2: Read the sparsetable metadata
-  if (!m_sparse_table.read_metadata(&istr))
+  // Part 2: Read the sparsetable metadata.  Only its bitmap of which
+  // tiles are present is of interest; the entries themselves follow
+  // in order of position.
+  google::sparsetable<uint8> present;
+  if (!present.read_metadata(&istr))
     vw_throw(IOErr() << "while reading sparse table metadata.");
 
   VW_ASSERT(istr.good(), IOErr() << "after reading sparse table metadata.");
 
-  // make sure we initialize everything before we continue
-  BOOST_FOREACH(multi_value_type& x, std::make_pair(m_sparse_table.nonempty_begin(), m_sparse_table.nonempty_end()))
-    new (&x) multi_value_type();
-
-  size_t count = 0, total = m_sparse_table.num_nonempty();
-
   // Part 3: Read sparse entries
-  BOOST_FOREACH(multi_value_type& x, std::make_pair(m_sparse_table.nonempty_begin(), m_sparse_table.nonempty_end())) {
-    if (count++ % 4000 == 0)
-      WHEREAMI << "reading tile slot " << count << " of " << total << std::endl;
+  for (size_t elmnt = 0; elmnt < present.size(); ++elmnt) {
+    if (!present.test(elmnt))
+      continue;
+
     // Iterate over transaction_id list.
     uint32 transaction_list_size;
     istr.read(reinterpret_cast<char*>(&transaction_list_size), sizeof(transaction_list_size));
 
     VW_ASSERT(istr.good(), IOErr() << "while reading transaction list size.");
 
+    TileHeader header;
+    header.set_col(boost::numeric_cast<int32>(elmnt % m_page_width));
+    header.set_row(boost::numeric_cast<int32>(elmnt / m_page_width));
+
     for (uint32 tid = 0; tid < transaction_list_size; ++tid) {
 
       // Read the transaction id
@@ -128,10 +295,13 @@ void IndexPage::deserialize(std::istream& istr) {
       if (!rec.ParseFromArray(protobuf_bytes.get(), protobuf_size))
         vw_throw(IOErr() << "while parsing a message.");
 
-      x.push_back(value_type(t_id, rec));
+      header.set_transaction_id(t_id);
+      this->append(header, rec);
     }
   }
 
+  this->compact();
+
   if (istr.peek() != EOF)
     vw_out(WarningMessage, "platefile.index") << "Unparsed data remaining in index page.\n";
 }
@@ -143,44 +313,27 @@ void IndexPage::set(TileHeader const& header, IndexRecord const& record) {
   VW_ASSERT( header.col() >= 0 && header.row() >= 0,
              TileNotFoundErr() << "IndexPage::set() failed.  Column and row indices must be positive.");
 
-  int32 page_col = header.col() % m_page_width;
-  int32 page_row = header.row() % m_page_height;
-
-  value_type p(header.transaction_id(), record);
-  int elmnt = page_row*m_page_width + page_col;
-  if (m_sparse_table.test(elmnt)) {
-
-    // Add to existing entry.
-    multi_value_type *entries = m_sparse_table[elmnt].operator&();
-
-    // We need to keep this list sorted in decreasing order of
-    // transaction ID, do a simple insertion sort here.
-    multi_value_type::iterator it = entries->begin();
-    while (it != entries->end() && (*it).first >= header.transaction_id() ) {
-
-      // Handle the case where we replace an entry
-      if ( (*it).first == header.transaction_id() ) {
-        (*it).second = record;
-        return;
-      }
-
-      // Otherwise, we search forward in the list.
-      ++it;
-    }
-
-    // If we reach this point, we are either at the end of the list,
-    // or we have found the correct position.  Either way, we call
-    // insert().
-    entries->insert(it, p);
-
-  } else {
-
-    // Create a new entry
-    multi_value_type l;
-    l.push_front(p);
-    m_sparse_table[elmnt] = l;
+  Mutex::Lock lock(m_mutex);
+  this->append(header, record);
+}
 
-  }
+void IndexPage::append(TileHeader const& header, IndexRecord const& record) {
+  Record r;
+  r.blob_offset = record.blob_offset();
+  r.transaction_id = header.transaction_id();
+  r.blob_id = record.blob_id();
+  r.col = boost::numeric_cast<uint16>(header.col() % m_page_width);
+  r.row = boost::numeric_cast<uint16>(header.row() % m_page_height);
+  r.status = 0;
+
+  // Look the filetype up in (or add it to) the page's filetype table.
+  std::vector<std::string>::const_iterator type =
+    std::find(m_filetypes.begin(), m_filetypes.end(), record.filetype());
+  r.filetype = boost::numeric_cast<uint16>(type - m_filetypes.begin());
+  if (type == m_filetypes.end())
+    m_filetypes.push_back(record.filetype());
+
+  m_pending.push_back(r);
 }
 
 /// Return the IndexRecord for a the given transaction_id at
@@ -205,37 +358,32 @@ IndexRecord IndexPage::get(int col, int row, TransactionOrNeg transaction_id_neg
   int32 page_col = col % m_page_width;
   int32 page_row = row % m_page_height;
 
-  // Interate over entries.
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+  std::pair<size_t, size_t> range = this->tile_range(page_col, page_row);
 
-  if ( entries.begin() == entries.end() )
+  if ( range.first == range.second )
     vw_throw(TileNotFoundErr() << "No Tiles exist at this location.");
 
   // A transaction ID of -1 indicates that we should return the most
-  // recent tile (which is the first entry in the list, since it is
-  // sorted from most recent to least recent), regardless of its
-  // transaction id.
+  // recent tile (which is the first entry, since they are sorted from
+  // most recent to least recent), regardless of its transaction id.
   if (transaction_id_neg.newest())
-    return (*it).second;
+    return this->index_record(m_records[range.first]);
 
   Transaction transaction_id = transaction_id_neg.promote();
 
-  // Otherwise, we search through the entries in the list, looking for
-  // the requested t_id.  Note: this search is O(n), so it can be slow
-  // if there are a lot of entries and the entry you are looking for
-  // is near the end.  However, most pages will contain very few
-  // entries, and for those with many entries (i.e. tiles near the
-  // root of the mosaic), you will rarely search for old tiles.
-  while (it != entries.end()) {
+  // Otherwise, we search through the entries, looking for the
+  // requested t_id.
+  for (size_t i = range.first; i < range.second; ++i) {
+    Record const& r = m_records[i];
     if (exact_match) {
-      if ((*it).first == transaction_id)
-        return (*it).second;
+      if (r.transaction_id == transaction_id)
+        return this->index_record(r);
     } else {
-      if ((*it).first <= transaction_id)
-        return (*it).second;
+      if (r.transaction_id <= transaction_id)
+        return this->index_record(r);
     }
-    ++it;
   }
 
   // If we reach this point, then there are no entries before
@@ -245,24 +393,30 @@ IndexRecord IndexPage::get(int col, int row, TransactionOrNeg transaction_id_neg
   return IndexRecord(); // never reached
 }
 
+IndexPage::multi_value_type
+IndexPage::multi_get(int col, int row,
+                     TransactionOrNeg begin_transaction_id, TransactionOrNeg end_transaction_id) const {
 
-void IndexPage::append_if_in_region( std::list<TileHeader> &results,
-                                     multi_value_type const& candidates,
-                                     int col, int row, BBox2i const& region,
-                                     uint32 min_num_matches) const {
+  VW_ASSERT( col >= 0 && row >= 0,
+             TileNotFoundErr() << "IndexPage::multi_get() failed.  Column and row indices must be positive.");
 
-  // Check to see if the tile is in the specified region.
-  Vector2i loc( m_base_col + col, m_base_row + row);
-  if ( region.contains( loc ) && candidates.size() >= min_num_matches ) {
-    TileHeader hdr;
-    hdr.set_col( m_base_col + col );
-    hdr.set_row( m_base_row + row );
-    hdr.set_level(m_level);
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+  std::pair<size_t, size_t> range = this->tile_range(col % m_page_width, row % m_page_height);
 
-    // Return the transaction ID of the first result in the list.
-    hdr.set_transaction_id(candidates.begin()->first);
-    results.push_back(hdr);
+  multi_value_type results;
+  for (size_t i = range.first; i < range.second; ++i) {
+    Record const& r = m_records[i];
+    if (r.transaction_id >= begin_transaction_id && r.transaction_id <= end_transaction_id)
+      results.push_back(value_type(r.transaction_id, this->index_record(r)));
   }
+  return results;
+}
+
+int IndexPage::sparse_size() const {
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+  return boost::numeric_cast<int>(m_tile_ids.size());
 }
 
 /// Returns a list of valid tiles in this IndexPage.  Returns a list
@@ -283,54 +437,55 @@ IndexPage::search_by_region(BBox2i const& region,
             ArgumentErr() << VW_CURRENT_FUNCTION << ": received a null set range ["
                           << start_transaction_id << "," << end_transaction_id << "]");
 
-  for (int row = 0; row < m_page_height; ++row) {
-    for (int col = 0; col < m_page_width; ++col) {
-      if (m_sparse_table.test(row*m_page_width + col)) {
-
-        // Iterate over entries.
-        multi_value_type const& entries = m_sparse_table[row*m_page_width + col];
-        multi_value_type candidates;
-
-        if (start_transaction_id.newest() && end_transaction_id.newest()) {
-          // If the user has specified a transaction range of [-1, -1],
-          // then we only return the last valid tile.
-          if (entries.size() > 0)
-            candidates.push_back( *(entries.begin()) );
-        } else {
-          // Search through the entries in the list, looking entries
-          // that match the requested transaction_id range.  Note: this
-          // search is O(n), so it can be slow if there are a lot of
-          // entries and the entry you are looking for is near the end.
-          // However, most pages will contain very few entries, and for
-          // those with many entries (i.e. tiles near the root of the
-          // mosaic), you will most likely be searching for recently
-          // added tiles, which are sorted to the beginning.
-
-          // Transactions are stored in descending order. Find the first one that is <= end_transaction_id
-          multi_value_type::const_iterator begin =
-            std::find_if(entries.begin(), entries.end(),
-                         boost::bind(std::greater_equal<TransactionOrNeg>(), end_transaction_id, boost::bind(&value_type::first,_1)));
-
-          // now iterate from that one until we go outside the transaction range.
-          BOOST_FOREACH(const value_type& v, boost::make_iterator_range(begin, entries.end())) {
-            if (v.first >= start_transaction_id)
-              candidates.push_back(v);
-            else {
-              // For snapshotting, we need to fetch one additional entry
-              // outside of the specified range.  This next tile represents the
-              // "top" tile in the mosaic for entries that may not have been
-              // part of the last snapshot.
-              if (fetch_one_additional_entry)
-                candidates.push_back(v);
-              break;
-            }
-          }
-        }
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+
+  bool newest_only = start_transaction_id.newest() && end_transaction_id.newest();
+
+  for (size_t t = 0; t < m_tile_ids.size(); ++t) {
+    Record const* begin = &m_records[m_tile_starts[t]];
+    Record const* end   = begin + (m_tile_starts[t+1] - m_tile_starts[t]);
+
+    // Do the region check.
+    if (!region.contains( Vector2i(m_base_col + begin->col, m_base_row + begin->row) ))
+      continue;
 
-        // Do the region check.
-        append_if_in_region( results, candidates, col, row, region, min_num_matches );
+    // Count the entries that match the requested transaction_id
+    // range, and remember the first (most recent) of them.  If the
+    // user has specified a transaction range of [-1, -1], then only
+    // the last valid tile counts.
+    Record const* first = 0;
+    uint32 num_matches = 0;
+    if (newest_only) {
+      first = begin;
+      num_matches = 1;
+    } else {
+      // Transactions are stored in descending order. Skip to the
+      // first one that is <= end_transaction_id, then count from
+      // there until we go outside the transaction range.
+      Record const* r = begin;
+      while (r != end && r->transaction_id > end_transaction_id)
+        ++r;
+      for ( ; r != end; ++r) {
+        if (!first) first = r;
+        if (r->transaction_id >= start_transaction_id)
+          ++num_matches;
+        else {
+          // For snapshotting, we need to fetch one additional entry
+          // outside of the specified range.  This next tile represents the
+          // "top" tile in the mosaic for entries that may not have been
+          // part of the last snapshot.
+          if (fetch_one_additional_entry)
+            ++num_matches;
+          else if (num_matches == 0)
+            first = 0;
+          break;
+        }
       }
     }
+
+    if (first && num_matches >= min_num_matches)
+      results.push_back(this->tile_header(*first));
   }
 
   return results;
@@ -350,39 +505,28 @@ IndexPage::search_by_location(int col, int row,
             TileNotFoundErr() << "IndexPage::read_headers() failed.  Invalid index ["
             << page_col << " " << page_row << "]");
 
-  // Check first to make sure that there are actually tiles at this location.
-  if (!m_sparse_table.test(page_row*m_page_width + page_col))
-    return std::list<TileHeader>();
+  Mutex::Lock lock(m_mutex);
+  this->compact();
+  std::pair<size_t, size_t> range = this->tile_range(page_col, page_row);
 
-  // If there are, then we apply the transaction_id filters to select the requested ones.
+  // Apply the transaction_id filters to select the requested entries.
   std::list<TileHeader> results;
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
-  while (it != entries.end() && it->first >= start_transaction_id) {
-    if (it->first >= start_transaction_id && it->first <= end_transaction_id) {
-      TileHeader hdr;
-      hdr.set_col( m_base_col + page_col );
-      hdr.set_row( m_base_row + page_row );
-      hdr.set_level(m_level);
-      hdr.set_transaction_id(it->first);
-      hdr.set_filetype(it->second.filetype());
+  size_t i = range.first;
+  for ( ; i < range.second && m_records[i].transaction_id >= start_transaction_id; ++i) {
+    Record const& r = m_records[i];
+    if (r.transaction_id <= end_transaction_id) {
+      TileHeader hdr = this->tile_header(r);
+      hdr.set_filetype(m_filetypes[r.filetype]);
       results.push_back(hdr);
     }
-    ++it;
   }
 
   // For snapshotting, we need to fetch one additional entry
   // outside of the specified range.  This next tile
   // represents the "top" tile in the mosaic for entries that
   // may not have been part of the last snapshot.
-  if (fetch_one_additional_entry && it != entries.end()) {
-    TileHeader hdr;
-    hdr.set_col( m_base_col + page_col );
-    hdr.set_row( m_base_row + page_row );
-    hdr.set_level(m_level);
-    hdr.set_transaction_id(it->first);
-    results.push_back(hdr);
-  }
+  if (fetch_one_additional_entry && i < range.second)
+    results.push_back(this->tile_header(m_records[i]));
 
   return results;
 }
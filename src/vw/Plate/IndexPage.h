@@ -10,12 +10,14 @@
 
 #include <vw/Plate/FundamentalTypes.h>
 #include <vw/Plate/IndexData.pb.h>
-#include <vw/Plate/google/sparsetable>
+#include <vw/Core/Thread.h>
 #include <vw/Math/BBox.h>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
 #include <string>
 #include <list>
+#include <vector>
 
 namespace vw {
 namespace platefile {
@@ -24,22 +26,71 @@ namespace platefile {
   //                            INDEX PAGE
   // ----------------------------------------------------------------------
 
-  class IndexPage {
+  /// An IndexPage holds the index entries for a page_width x
+  /// page_height block of tiles at one level of the pyramid.
+  ///
+  /// Entries are kept packed: one flat array of fixed size records
+  /// sorted by tile (in row major order) and then by decreasing
+  /// transaction id, plus a per-tile offset table that gives the range
+  /// of records belonging to each tile that has any.  Filetypes, of
+  /// which a page only ever sees a handful, are stored once in a
+  /// per-page table and referred to by index.  Looking up a tile is a
+  /// binary search in the offset table, and region and location
+  /// searches are linear scans of contiguous memory.
+  ///
+  /// New entries are appended to a small unsorted buffer and merged
+  /// into the sorted array the next time the page is read, so writing
+  /// a run of tiles costs one merge rather than one insertion each.
+  ///
+  /// Pages are written to disk (or a network byte stream) by copying
+  /// the two arrays out directly.  Pages written in the older format,
+  /// a sparsetable of per-tile lists of serialized IndexRecords, can
+  /// still be read.
+  class IndexPage : private boost::noncopyable {
 
   public:
     typedef std::pair<uint32, IndexRecord> value_type;
     typedef std::list<value_type> multi_value_type;
-    typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
 
   protected:
+    /// One packed index entry.  col and row are relative to the page.
+    struct Record {
+      uint64 blob_offset;
+      uint32 transaction_id;
+      int32 blob_id;
+      uint16 col, row;
+      uint16 filetype;    // index into m_filetypes
+      uint16 status;      // reserved for per-record state; always 0 for now
+    };
+
     int m_level, m_base_col, m_base_row;
     int m_page_width, m_page_height;
-    google::sparsetable<multi_value_type> m_sparse_table;
 
-    void append_if_in_region( std::list<TileHeader> &results,
-                              multi_value_type const& candidates,
-                              int col, int row, BBox2i const& region, uint32 min_num_matches) const;
+    // The sorted records, and for each tile with records (in
+    // increasing order of tile id, row*page_width+col) the index of
+    // its first record.  m_tile_starts has one extra entry at the end.
+    mutable std::vector<Record> m_records;
+    mutable std::vector<uint32> m_tile_ids;
+    mutable std::vector<uint32> m_tile_starts;
+    mutable std::vector<Record> m_pending;
+    std::vector<std::string> m_filetypes;
+    mutable Mutex m_mutex;
+
+    // Add a record to m_pending.  Call with m_mutex held.
+    void append(TileHeader const& header, IndexRecord const& record);
+
+    // Merge m_pending into m_records.  Call with m_mutex held.
+    void compact() const;
+
+    // Returns the [begin, end) range of m_records for a tile, which is
+    // empty if the tile has no records.  Call with m_mutex held after
+    // compact().
+    std::pair<size_t, size_t> tile_range(int32 page_col, int32 page_row) const;
 
+    IndexRecord index_record(Record const& r) const;
+    TileHeader tile_header(Record const& r) const;
+
+    void deserialize_legacy(std::istream& istr);
 
   public:
 
@@ -56,11 +107,6 @@ namespace platefile {
     void serialize(std::ostream& ostr);
     void deserialize(std::istream& istr);
 
-    // ----------------------- ITERATORS  ----------------------
-
-    nonempty_iterator begin() { return m_sparse_table.nonempty_begin(); }
-    nonempty_iterator end() { return m_sparse_table.nonempty_end(); }
-
     // ----------------------- ACCESSORS  ----------------------
 
     /// Set the value of an entry in the IndexPage.
@@ -95,7 +141,7 @@ namespace platefile {
 
     /// Return the number of valid entries in this page.  (Remember
     /// that this is a sparse store of IndexRecords.)
-    int sparse_size() { return boost::numeric_cast<int>(m_sparse_table.num_nonempty()); }
+    int sparse_size() const;
 
     /// Returns a list of valid tiles in this IndexPage.
     ///
@@ -243,11 +243,19 @@ METHOD_IMPL_NOREPLY(WriteUpdate, IndexWriteUpdate) {
 
 METHOD_IMPL_NOREPLY(MultiWriteUpdate, IndexMultiWriteUpdate) {
   METHOD_BOILERPLATE(read_lock_t);
-  // MultiWrite updates are packetized.  We iterate over them here.
-  for (int i = 0; i < request->write_updates().size(); ++i) {
-    IndexWriteUpdate update = request->write_updates().Get(i);
-    IndexServiceRecord rec = find_id_throw(update.platefile_id());
-    rec.index->write_update(update.header(), update.record());
+  // MultiWrite updates are packetized.  Consecutive updates to the
+  // same platefile are handed to its index as one batch.
+  int size = request->write_updates().size();
+  for (int i = 0; i < size; ) {
+    int32 platefile_id = request->write_updates().Get(i).platefile_id();
+    std::vector<TileHeader> headers;
+    std::vector<IndexRecord> records;
+    for ( ; i < size && request->write_updates().Get(i).platefile_id() == platefile_id; ++i) {
+      headers.push_back(request->write_updates().Get(i).header());
+      records.push_back(request->write_updates().Get(i).record());
+    }
+    IndexServiceRecord rec = find_id_throw(platefile_id);
+    rec.index->multi_write_update(headers, records);
   }
 }
 
@@ -352,8 +352,9 @@ Transaction LocalIndex::transaction_request(std::string transaction_description,
  // work to the mosaic by issuing a transaction_complete method.
  void LocalIndex::transaction_complete(Transaction transaction_id, bool update_read_cursor) {
 
-   // First we save (sync) the index pages to disk
-   //this->sync();
+   // First we save (sync) the index pages to disk.  Only pages that
+   // have been modified since the last sync are written.
+   this->sync();
 
    if ( update_read_cursor ) {
      Transaction max_trans_id = std::max(m_header.transaction_read_cursor(), transaction_id+0);
@@ -438,6 +439,18 @@ void LocalIndex::write_update(TileHeader const& header, IndexRecord const& recor
   }
 }
 
+void LocalIndex::multi_write_update(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord> const& records) {
+  size_t starting_size = m_levels.size();
+
+  PagedIndex::multi_write_update(headers, records);
+
+  if (m_levels.size() != starting_size) {
+    m_header.set_num_levels(boost::numeric_cast<int32>(m_levels.size()));
+    this->save_index_file();
+  }
+}
+
 /// Writing, pt. 3: Signal the completion
 void LocalIndex::write_complete(int blob_id, uint64 blob_offset) {
   m_blob_manager->release_lock(blob_id, blob_offset);
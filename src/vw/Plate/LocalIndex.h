@@ -134,6 +134,11 @@ namespace platefile {
     // unlock the blob id.
     virtual void write_update(TileHeader const& header, IndexRecord const& record);
 
+    // Writing, pt. 2, batched: Update the index for several tiles at
+    // once.  The index file is saved at most once per batch.
+    virtual void multi_write_update(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord> const& records);
+
     /// Writing, pt. 3: Signal the completion
     virtual void write_complete(int blob_id, uint64 blob_offset);
 
@@ -163,6 +168,7 @@ namespace platefile {
 
     // Once a chunk of work is complete, clients can "commit" their
     // work to the mosaic by issuding a transaction_complete method.
+    // Any index pages modified since the last sync are saved to disk.
     virtual void transaction_complete(Transaction transaction_id, bool update_read_cursor);
 
     // If a transaction fails, we may need to clean up the mosaic.
@@ -10,6 +10,7 @@
 #include <vw/Core/Debugging.h>
 
 #include <boost/foreach.hpp>
+#include <algorithm>
 
 using namespace vw;
 using namespace vw::platefile;
@@ -138,6 +139,90 @@ void IndexLevel::set(TileHeader const& header, IndexRecord const& rec) {
   page->set(header, rec);
 }
 
+namespace {
+  // Orders entries of a multi_get() or multi_set() by the page that
+  // they fall on.
+  struct PageOrder {
+    std::vector<TileHeader> const& headers;
+    int page_width, page_height;
+    PageOrder(std::vector<TileHeader> const& headers, int page_width, int page_height)
+      : headers(headers), page_width(page_width), page_height(page_height) {}
+    bool operator()(size_t a, size_t b) const {
+      int32 row_a = headers[a].row() / page_height, row_b = headers[b].row() / page_height;
+      if (row_a != row_b) return row_a < row_b;
+      return headers[a].col() / page_width < headers[b].col() / page_width;
+    }
+  };
+}
+
+/// Fetch the values of several index nodes at this level.
+void IndexLevel::multi_get(std::vector<TileHeader> const& headers,
+                           std::vector<IndexRecord>& records,
+                           std::vector<size_t> const& indices,
+                           bool exact_match) const {
+
+  BOOST_FOREACH( size_t i, indices ) {
+    TileHeader const& header = headers[i];
+    VW_ASSERT( header.level() == m_level &&
+               header.col() >= 0 && header.row() >= 0 &&
+               header.col() < pow(2,m_level) && header.row() < pow(2,m_level),
+               TileNotFoundErr() << "IndexLevel::multi_get() failed.  Invalid index [ "
+               << header.col() << " " << header.row() << " @ level " << header.level() << "]" );
+  }
+
+  std::vector<size_t> order(indices);
+  std::sort(order.begin(), order.end(), PageOrder(headers, m_page_width, m_page_height));
+
+  boost::shared_ptr<IndexPage> page;
+  int32 page_col = -1, page_row = -1;
+  BOOST_FOREACH( size_t i, order ) {
+    int32 level_col = headers[i].col() / m_page_width;
+    int32 level_row = headers[i].row() / m_page_height;
+    if (!page || level_col != page_col || level_row != page_row) {
+      WHEREAMI << "(" << level_col << " " << level_row << " @ " << m_level << ")\n";
+      page = fetch_page(level_col, level_row);
+      page_col = level_col;
+      page_row = level_row;
+    }
+    records[i] = page->get(headers[i].col(), headers[i].row(),
+                           headers[i].transaction_id(), exact_match);
+  }
+}
+
+/// Set the values of several index nodes at this level.
+void IndexLevel::multi_set(std::vector<TileHeader> const& headers,
+                           std::vector<IndexRecord> const& records,
+                           std::vector<size_t> const& indices) {
+
+  BOOST_FOREACH( size_t i, indices ) {
+    TileHeader const& header = headers[i];
+    VW_ASSERT( header.level() == m_level &&
+               header.col() >= 0 && header.row() >= 0 &&
+               header.col() < pow(2,m_level) && header.row() < pow(2,m_level),
+               TileNotFoundErr() << "IndexLevel::multi_set() failed.  Invalid index [ "
+               << header.col() << " " << header.row() << " @ level " << header.level() << "]" );
+  }
+
+  // Group the entries by page.  The sort is stable so that repeated
+  // writes to the same tile land in the order they were made.
+  std::vector<size_t> order(indices);
+  std::stable_sort(order.begin(), order.end(), PageOrder(headers, m_page_width, m_page_height));
+
+  boost::shared_ptr<IndexPage> page;
+  int32 page_col = -1, page_row = -1;
+  BOOST_FOREACH( size_t i, order ) {
+    int32 level_col = headers[i].col() / m_page_width;
+    int32 level_row = headers[i].row() / m_page_height;
+    if (!page || level_col != page_col || level_row != page_row) {
+      WHEREAMI << "(" << level_col << " " << level_row << " @ " << m_level << ")\n";
+      page = fetch_page(level_col, level_row);
+      page_col = level_col;
+      page_row = level_row;
+    }
+    page->set(headers[i], records[i]);
+  }
+}
+
 /// Returns a list of valid tiles at this level.
 std::list<TileHeader>
 IndexLevel::search_by_region(BBox2i const& region,
@@ -238,6 +323,29 @@ IndexRecord PagedIndex::read_request(int col, int row, int level,
   return rec;
 }
 
+void PagedIndex::multi_read_request(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord>& records,
+                                    bool exact_transaction_match) {
+  // Bucket the lookups by level.
+  std::vector<std::vector<size_t> > by_level(m_levels.size());
+  for (size_t i = 0; i < headers.size(); ++i) {
+    int32 level = headers[i].level();
+    if (level < 0 || level >= int32(m_levels.size()))
+      vw_throw(TileNotFoundErr() << "Requested tile at level " << level
+               << " was greater than the max level (" << m_levels.size() << ").");
+    by_level[level].push_back(i);
+  }
+
+  records.resize(headers.size());
+  for (size_t level = 0; level < by_level.size(); ++level)
+    if (!by_level[level].empty())
+      m_levels[level]->multi_get(headers, records, by_level[level], exact_transaction_match);
+
+  for (size_t i = 0; i < records.size(); ++i)
+    if (records[i].filetype() == "default_to_index")
+      records[i].set_filetype(this->tile_filetype());
+}
+
 void PagedIndex::write_update(TileHeader const& header, IndexRecord const& record) {
   // First, we check to make sure we have a sufficient number of
   // levels to save the requested data.  If not, we grow the levels
@@ -252,6 +360,45 @@ void PagedIndex::write_update(TileHeader const& header, IndexRecord const& recor
   m_levels[header.level()]->set(header, record);
 }
 
+void PagedIndex::multi_write_update(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord> const& records) {
+  VW_ASSERT(headers.size() == records.size(),
+            ArgumentErr() << "multi_write_update(): " << headers.size() << " headers but "
+            << records.size() << " records.");
+
+  // Check every tile before touching the index, so that a bad batch
+  // leaves it unchanged.
+  for (size_t i = 0; i < headers.size(); ++i) {
+    TileHeader const& header = headers[i];
+    int32 level = header.level();
+    VW_ASSERT(level >= 0 && level < 32 &&
+              header.col() >= 0 && header.row() >= 0 &&
+              header.col() < (1 << level) && header.row() < (1 << level),
+              TileNotFoundErr() << "multi_write_update(): invalid index [ "
+              << header.col() << " " << header.row() << " @ level " << level << "]");
+  }
+
+  // Bucket the updates by level, growing the levels vector once to
+  // cover the deepest of them.
+  std::vector<std::vector<size_t> > by_level(m_levels.size());
+  for (size_t i = 0; i < headers.size(); ++i) {
+    int32 level = headers[i].level();
+    if (level >= int32(by_level.size()))
+      by_level.resize(level+1);
+    by_level[level].push_back(i);
+  }
+
+  for (int level = boost::numeric_cast<int>(m_levels.size()); level < int(by_level.size()); ++level) {
+    boost::shared_ptr<IndexLevel> new_level(
+        new IndexLevel(m_page_gen_factory, level, m_page_width, m_page_height, m_default_cache_size) );
+    m_levels.push_back(new_level);
+  }
+
+  for (size_t level = 0; level < by_level.size(); ++level)
+    if (!by_level[level].empty())
+      m_levels[level]->multi_set(headers, records, by_level[level]);
+}
+
 
 
 // ----------------------- PROPERTIES  ----------------------
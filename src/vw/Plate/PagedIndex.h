@@ -54,9 +54,25 @@ namespace platefile {
     /// Fetch the value of an index node at this level.
     IndexRecord get(int32 col, int32 row, TransactionOrNeg transaction_id, bool exact_match = false) const;
 
+    /// Fetch the values of several index nodes at this level.  Entry
+    /// i of indices looks up headers[indices[i]] into
+    /// records[indices[i]].  Each page touched is fetched once.
+    void multi_get(std::vector<TileHeader> const& headers,
+                   std::vector<IndexRecord>& records,
+                   std::vector<size_t> const& indices,
+                   bool exact_match = false) const;
+
     /// Set the value of an index node at this level.
     void set(TileHeader const& hdr, IndexRecord const& rec);
 
+    /// Set the values of several index nodes at this level.  Entry i
+    /// of indices picks the pair headers[indices[i]] and
+    /// records[indices[i]].  Each page touched is fetched once, and
+    /// entries on the same page are applied in the order given.
+    void multi_set(std::vector<TileHeader> const& headers,
+                   std::vector<IndexRecord> const& records,
+                   std::vector<size_t> const& indices);
+
     /// Returns a list of valid tiles at this level.
     std::list<TileHeader> search_by_region(BBox2i const& region,
                                            TransactionOrNeg start_transaction_id,
@@ -128,6 +144,12 @@ namespace platefile {
     virtual IndexRecord read_request(int col, int row, int level,
                                      TransactionOrNeg transaction_id, bool exact_transaction_match = false);
 
+    // Reading, batched: Look up several tiles, visiting each level
+    // and each page they touch only once.
+    virtual void multi_read_request(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord>& records,
+                                    bool exact_transaction_match = false);
+
     // Writing, pt. 1: Locks a blob and returns the blob id that can
     // be used to write a tile.
     virtual int write_request(uint64 &size) = 0;
@@ -136,6 +158,11 @@ namespace platefile {
     // unlock the blob id.
     virtual void write_update(TileHeader const& header, IndexRecord const& record);
 
+    // Writing, pt. 2, batched: Update the index for several tiles,
+    // visiting each level and each page they touch only once.
+    virtual void multi_write_update(std::vector<TileHeader> const& headers,
+                                    std::vector<IndexRecord> const& records);
+
     /// Writing, pt. 3: Signal the completion
     virtual void write_complete(int blob_id, uint64 blob_offset) = 0;
 
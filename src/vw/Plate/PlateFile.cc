@@ -39,20 +39,30 @@ PlateFile::PlateFile(const Url& url, std::string type, std::string description,
 
 std::pair<TileHeader, TileData>
 PlateFile::read(int col, int row, int level, TransactionOrNeg transaction_id, bool exact_transaction_match) const {
-  IndexRecord record = m_index->read_request(col, row, level, transaction_id, exact_transaction_match);
+  return this->read(m_index->read_request(col, row, level, transaction_id, exact_transaction_match));
+}
+
+boost::shared_ptr<Blob> PlateFile::read_blob(int blob_id) const {
+  if (m_write_blob && blob_id == m_write_blob_id)
+    return m_write_blob;
 
-  boost::shared_ptr<Blob> read_blob;
-  if (m_write_blob && record.blob_id() == m_write_blob_id) {
-    read_blob = m_write_blob;
-  } else {
+  Mutex::Lock lock(m_read_blobs_mutex);
+  boost::shared_ptr<Blob>& blob = m_read_blobs[blob_id];
+  if (!blob) {
     std::ostringstream blob_filename;
-    blob_filename << this->name() << "/plate_" << record.blob_id() << ".blob";
-    read_blob.reset(new Blob(blob_filename.str(), true));
+    blob_filename << this->name() << "/plate_" << blob_id << ".blob";
+    blob.reset(new Blob(blob_filename.str(), true));
   }
+  return blob;
+}
+
+std::pair<TileHeader, TileData>
+PlateFile::read(IndexRecord const& record) const {
+  boost::shared_ptr<Blob> blob = this->read_blob(record.blob_id());
 
   std::pair<TileHeader, TileData> tile;
-  tile.first  = read_blob->read_header(record.blob_offset());
-  tile.second = read_blob->read_data(record.blob_offset());
+  tile.first  = blob->read_header(record.blob_offset());
+  tile.second = blob->read_data(record.blob_offset());
   return tile;
 }
 
@@ -67,22 +77,15 @@ PlateFile::read_to_file(std::string const& base_name, int col, int row, int leve
   IndexRecord record = m_index->read_request(col, row, level, transaction_id, exact_transaction_match);
 
   // 2. Open the blob file and read the header
-  boost::shared_ptr<Blob> read_blob;
-  if (m_write_blob && record.blob_id() == m_write_blob_id) {
-    read_blob = m_write_blob;
-  } else {
-    std::ostringstream blob_filename;
-    blob_filename << this->name() << "/plate_" << record.blob_id() << ".blob";
-    read_blob.reset(new Blob(blob_filename.str(), true));
-  }
+  boost::shared_ptr<Blob> blob = this->read_blob(record.blob_id());
 
   // 3. Choose a temporary filename and call BlobIO
   // read_as_file(filename, offset, size) [ offset, size from
   // IndexRecord ]
   std::string filename = base_name + "." + record.filetype();
-  read_blob->read_to_file(filename, record.blob_offset());
+  blob->read_to_file(filename, record.blob_offset());
 
-  TileHeader hdr = read_blob->read_header(record.blob_offset());
+  TileHeader hdr = blob->read_header(record.blob_offset());
 
   // 4. Return the name of the file
   return std::make_pair(filename, hdr);
@@ -152,6 +155,12 @@ vw::platefile::IndexRecord vw::platefile::PlateFile::read_record(int col, int ro
   return m_index->read_request(col, row, level, transaction_id, exact_transaction_match);
 }
 
+void vw::platefile::PlateFile::read_records(std::vector<TileHeader> const& headers,
+                                            std::vector<IndexRecord>& records,
+                                            bool exact_transaction_match) {
+  m_index->multi_read_request(headers, records, exact_transaction_match);
+}
+
 void PlateFile::write_update(const uint8* data, uint64 data_size, int col, int row,
     int level, Transaction transaction_id, const std::string& type_) {
 
@@ -182,3 +191,36 @@ void PlateFile::write_update(const uint8* data, uint64 data_size, int col, int r
 
   m_index->write_update(write_header, write_record);
 }
+
+void PlateFile::write_update(TileWriteBatch const& batch) {
+
+  if (batch.empty())
+    return;
+  if (!m_write_blob)
+    vw_throw(BlobIoErr() << "write_update(): No blob file open. Are you sure you ran write_request()?");
+
+  std::vector<TileHeader> headers(batch.headers());
+  std::vector<const uint8*> data(batch.size());
+  std::vector<uint64> data_sizes(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (headers[i].filetype().empty())
+      headers[i].set_filetype(this->default_file_type());
+    if (headers[i].filetype() == "auto")
+      vw_throw(NoImplErr() << "write_update() does not support filetype 'auto'");
+    data[i] = batch.data(i);
+    data_sizes[i] = batch.data_size(i);
+  }
+
+  // 1. Write all of the data into the blob at once
+  std::vector<uint64> blob_offsets = m_write_blob->write(headers, data, data_sizes);
+
+  // 2. Update the index
+  std::vector<IndexRecord> records(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    records[i].set_blob_id(m_write_blob_id);
+    records[i].set_blob_offset(blob_offsets[i]);
+    records[i].set_filetype(headers[i].filetype());
+  }
+
+  m_index->multi_write_update(headers, records);
+}
@@ -105,16 +105,93 @@
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Algorithms.h>
 
+#include <map>
 #include <sstream>
+#include <vector>
 
 namespace vw {
 namespace platefile {
 
+  /// A batch of encoded tiles that PlateFile::write_update(batch)
+  /// writes with a single append to the blob and a single pass over
+  /// the index.  The batch keeps its own copy of each tile's data.
+  /// It reports itself full() once it holds max_tiles tiles or
+  /// max_bytes bytes of tile data, at which point the caller should
+  /// write it and clear() it.
+  class TileWriteBatch {
+    std::vector<TileHeader> m_headers;
+    std::vector<uint8> m_data;
+    std::vector<uint64> m_offsets;
+    size_t m_max_tiles;
+    uint64 m_max_bytes;
+
+  public:
+    TileWriteBatch(size_t max_tiles = 256, uint64 max_bytes = 32*1024*1024)
+      : m_offsets(1, 0), m_max_tiles(max_tiles), m_max_bytes(max_bytes) {}
+
+    /// Add a tile to the batch.  An empty type means "platefile
+    /// default".
+    void add(const uint8* data, uint64 data_size,
+             int col, int row, int level, Transaction transaction_id,
+             const std::string& type = "") {
+      TileHeader header;
+      header.set_col(col);
+      header.set_row(row);
+      header.set_level(level);
+      header.set_transaction_id(transaction_id);
+      header.set_filetype(type);
+      m_headers.push_back(header);
+      m_data.insert(m_data.end(), data, data + data_size);
+      m_offsets.push_back(m_data.size());
+    }
+
+    size_t size() const { return m_headers.size(); }
+    bool empty() const { return m_headers.empty(); }
+    bool full() const { return size() >= m_max_tiles || m_data.size() >= m_max_bytes; }
+
+    void clear() {
+      m_headers.clear();
+      m_data.clear();
+      m_offsets.resize(1);
+    }
+
+    std::vector<TileHeader> const& headers() const { return m_headers; }
+    const uint8* data(size_t i) const { return m_data.empty() ? 0 : &m_data[0] + m_offsets[i]; }
+    uint64 data_size(size_t i) const { return m_offsets[i+1] - m_offsets[i]; }
+  };
+
   class PlateFile {
     boost::shared_ptr<Index> m_index;
     boost::shared_ptr<Blob> m_write_blob;
     int m_write_blob_id;
 
+    /// Read-only blobs opened so far, by blob id.  They stay open so
+    /// that every tile read from a blob shares one memory mapping.
+    typedef std::map<int, boost::shared_ptr<Blob> > ReadBlobMap;
+    mutable ReadBlobMap m_read_blobs;
+    mutable Mutex m_read_blobs_mutex;
+
+    /// The blob to read a tile with the given blob id from: the write
+    /// blob if it is the one being written, otherwise a shared
+    /// read-only blob.
+    boost::shared_ptr<Blob> read_blob(int blob_id) const;
+
+    /// The file type to encode a tile as.
+    template <class ViewT>
+    std::string file_type_for(ImageViewBase<ViewT> const& view) const {
+      std::string type = this->default_file_type();
+      if (type == "auto") {
+        // This specialization saves us TONS of space by storing opaque tiles
+        // as jpgs.  However it does come at a small cost of having to conduct
+        // this extra check to see if the tile is opaque or not.
+        if ( is_opaque(view.impl()) )
+          type = "jpg";
+        else
+          type = "png";
+      }
+      return type;
+    }
+
   public:
     PlateFile(const Url& url);
 
@@ -157,6 +234,10 @@ namespace platefile {
     std::pair<TileHeader, TileData>
     read(int col, int row, int level, TransactionOrNeg transaction_id, bool exact_transaction_match = false) const;
 
+    /// Read the tile that an index record points to, without going
+    /// back to the index.  The record can come from read_record().
+    std::pair<TileHeader, TileData> read(IndexRecord const& record) const;
+
     /// Read an image from the specified tile location in the plate file.
     ///
     /// By default, this call to read will return a tile with the MOST
@@ -174,7 +255,7 @@ namespace platefile {
                     TransactionOrNeg transaction_id, bool exact_transaction_match = false) const {
 
       std::pair<TileHeader, TileData> ret = this->read(col, row, level, transaction_id, exact_transaction_match);
-      boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(ret.first.filetype(), &ret.second->operator[](0), ret.second->size()));
+      boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(ret.first.filetype(), ret.second->data(), ret.second->size()));
       read_image(view, *r);
       return ret.first;
     }
@@ -188,28 +269,35 @@ namespace platefile {
     template <class ViewT>
     void write_update(ImageViewBase<ViewT> const& view,
                       int col, int row, int level, Transaction transaction_id) {
-
-      std::string type = this->default_file_type();
-      if (type == "auto") {
-        // This specialization saves us TONS of space by storing opaque tiles
-        // as jpgs.  However it does come at a small cost of having to conduct
-        // this extra check to see if the tile is opaque or not.
-        if ( is_opaque(view.impl()) )
-          type = "jpg";
-        else
-          type = "png";
-      }
+      std::string type = this->file_type_for(view);
       boost::scoped_ptr<DstMemoryImageResource> r(DstMemoryImageResource::create(type, view.format()));
       write_image(*r, view);
       this->write_update(r->data(), r->size(), col, row, level, transaction_id, type);
     }
 
+    /// Writing, pt. 2, batched: Encode an image for the specified tile
+    /// location and add it to a batch.  Nothing is written until the
+    /// batch is passed to write_update().
+    template <class ViewT>
+    void encode_tile(TileWriteBatch& batch, ImageViewBase<ViewT> const& view,
+                     int col, int row, int level, Transaction transaction_id) const {
+      std::string type = this->file_type_for(view);
+      boost::scoped_ptr<DstMemoryImageResource> r(DstMemoryImageResource::create(type, view.format()));
+      write_image(*r, view);
+      batch.add(r->data(), r->size(), col, row, level, transaction_id, type);
+    }
+
     /// Writing, pt. 2, alternate: Write raw data (as a tile) to a specified
     /// tile location. Use the filetype to identify the data later; empty type
     /// means "platefile default".
     void write_update(const uint8* data, uint64 data_size,
                       int col, int row, int level, Transaction transaction_id, const std::string& type = "");
 
+    /// Writing, pt. 2, batched: Write every tile in a batch with a
+    /// single append to the blob and update the index for all of them
+    /// in one pass.  The batch is left unchanged.
+    void write_update(TileWriteBatch const& batch);
+
     /// Writing, pt. 3: Signal the completion of the write operation.
     void write_complete();
 
@@ -227,6 +315,13 @@ namespace platefile {
     IndexRecord read_record(int col, int row, int level,
                             TransactionOrNeg transaction_id, bool exact_transaction_match = false);
 
+    /// Read the records of several tiles at once, each named by the
+    /// col, row, level and transaction_id of a header.  records[i] is
+    /// the record for headers[i].  Throws TileNotFoundErr if any of
+    /// them is missing.
+    void read_records(std::vector<TileHeader> const& headers, std::vector<IndexRecord>& records,
+                      bool exact_transaction_match = false);
+
     // --------------------- TRANSACTIONS ------------------------
 
     // Clients are expected to make a transaction request whenever
@@ -94,6 +94,11 @@ void PlateManager<PixelT>::mipmap(int starting_level, BBox2i const& bbox,
     sum_denom *= 4.0f;
   }
 
+  // Mipmap tiles are written in batches.  A level only reads tiles
+  // from the level below it, so each level's batch is flushed before
+  // moving on to the next level.
+  TileWriteBatch batch;
+
   float current_num_tiles = 0;
   sum_denom = 4.0;
   float prev_num_tiles = 0;
@@ -161,7 +166,11 @@ void PlateManager<PixelT>::mipmap(int starting_level, BBox2i const& bbox,
 
             if (img && !is_transparent(img)) {
               vw_out(VerboseDebugMessage, "platefile") << "Writing " << col << " " << row << " @ " << level << "\n";
-              this->m_platefile->write_update(img, col, row, level, output_transaction_id);
+              this->m_platefile->encode_tile(batch, img, col, row, level, output_transaction_id);
+              if (batch.full()) {
+                this->m_platefile->write_update(batch);
+                batch.clear();
+              }
             }
 
             sub_sub_progress.report_incremental_progress(inc_amt);
@@ -170,6 +179,8 @@ void PlateManager<PixelT>::mipmap(int starting_level, BBox2i const& bbox,
       }
       sub_sub_progress.report_finished();
     }
+    this->m_platefile->write_update(batch);
+    batch.clear();
     sub_progress.report_finished();
 
     // Adjust the size of the bbox for this level
@@ -125,8 +125,10 @@ namespace platefile {
       // the two operations below.
       m_platefile->write_request();
 
-      // Add each tile
+      // Add each tile.  Encoded tiles are collected into batches so
+      // that each batch costs one blob append and one index update.
       progress.report_progress(0);
+      TileWriteBatch batch;
       BOOST_FOREACH( TileInfo const& tile, tiles ) {
         typedef WritePlateFileTask<ImageViewRef<typename ViewT::pixel_type> > Job;
 
@@ -134,9 +136,15 @@ namespace platefile {
           new Job(m_platefile, transaction_id,
                   tile, pyramid_level,
                   stereo_view, tweak_settings_for_terrain,
-                  false, boost::numeric_cast<int>(tiles_size), progress));
+                  false, boost::numeric_cast<int>(tiles_size), progress, &batch));
         (*task)();
+
+        if (batch.full()) {
+          m_platefile->write_update(batch);
+          batch.clear();
+        }
       }
+      m_platefile->write_update(batch);
       progress.report_finished();
 
       // Sync the index
@@ -175,6 +183,18 @@ namespace platefile {
     bool m_tweak_settings_for_terrain;
     bool m_verbose;
     SubProgressCallback m_progress;
+    TileWriteBatch* m_batch;
+
+    // Writes the tile, or adds it to m_batch if there is one.
+    template <class TileT>
+    void write_tile(ImageViewBase<TileT> const& tile) {
+      if (m_batch)
+        m_platefile->encode_tile(*m_batch, tile, m_tile_info.i, m_tile_info.j,
+                                 m_level, m_transaction_id);
+      else
+        m_platefile->write_update(tile, m_tile_info.i, m_tile_info.j,
+                                  m_level, m_transaction_id);
+    }
 
   public:
     WritePlateFileTask(boost::shared_ptr<PlateFile> platefile,
@@ -183,10 +203,12 @@ namespace platefile {
                        int level, ImageViewBase<ViewT> const& view,
                        bool tweak_settings_for_terrain,
                        bool verbose, int total_num_blocks,
-                       const ProgressCallback &progress_callback = ProgressCallback::dummy_instance()) : m_platefile(platefile), m_transaction_id(transaction_id),
+                       const ProgressCallback &progress_callback = ProgressCallback::dummy_instance(),
+                       TileWriteBatch* batch = 0) : m_platefile(platefile), m_transaction_id(transaction_id),
       m_tile_info(tile_info), m_level(level), m_view(view.impl()),
       m_tweak_settings_for_terrain(tweak_settings_for_terrain),
-      m_verbose(verbose), m_progress(progress_callback,0.0,1.0/float(total_num_blocks)) {}
+      m_verbose(verbose), m_progress(progress_callback,0.0,1.0/float(total_num_blocks)),
+      m_batch(batch) {}
 
     virtual ~WritePlateFileTask() {}
     virtual void operator() () {
@@ -222,19 +244,13 @@ namespace platefile {
         switch(m_platefile->channel_type()) {
         case VW_CHANNEL_UINT8:
         case VW_CHANNEL_UINT16:
-          m_platefile->write_update(pixel_cast<PixelGrayA<uint8> >(tile),
-                                    m_tile_info.i, m_tile_info.j,
-                                    m_level, m_transaction_id);
+          this->write_tile(pixel_cast<PixelGrayA<uint8> >(tile));
           break;
         case VW_CHANNEL_INT16:
-          m_platefile->write_update(pixel_cast<PixelGrayA<int16> >(tile),
-                                    m_tile_info.i, m_tile_info.j,
-                                    m_level, m_transaction_id);
+          this->write_tile(pixel_cast<PixelGrayA<int16> >(tile));
           break;
         case VW_CHANNEL_FLOAT32:
-          m_platefile->write_update(pixel_cast<PixelGrayA<float32> >(tile),
-                                    m_tile_info.i, m_tile_info.j,
-                                    m_level, m_transaction_id);
+          this->write_tile(pixel_cast<PixelGrayA<float32> >(tile));
           break;
         default:
           vw_throw(NoImplErr() << "Unsupported GrayA channel type in PlateManager.");
@@ -243,9 +259,7 @@ namespace platefile {
       case VW_PIXEL_RGBA:
         switch(m_platefile->channel_type()) {
         case VW_CHANNEL_UINT8:
-          m_platefile->write_update(pixel_cast<PixelRGBA<uint8> >(tile),
-                                    m_tile_info.i, m_tile_info.j,
-                                    m_level, m_transaction_id);
+          this->write_tile(pixel_cast<PixelRGBA<uint8> >(tile));
           break;
         default:
           vw_throw(NoImplErr() << "Unsupported RGBA channel type in PlateManager.");
@@ -11,17 +11,22 @@
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Plate/PlateFile.h>
+#include <vw/Plate/TileCache.h>
 #include <vw/Image/Transform.h>
+#include <vw/Image/UtilityViews.h>
 #include <boost/foreach.hpp>
 
 namespace vw {
 namespace platefile {
 
   /// An image view for accessing tiles from a plate file.  Tiles are
-  /// cached by this view to increase read speeds.
+  /// cached by this view to increase read speeds.  The cache is shared
+  /// by copies of the view, so the overlapping regions that block
+  /// rasterization asks for only decode each tile once.
   template <class PixelT>
   class PlateView : public ImageViewBase<PlateView<PixelT> > {
     boost::shared_ptr<PlateFile> m_platefile;
+    boost::shared_ptr<TileCache<PixelT> > m_tile_cache;
     int m_current_level;
 
   public:
@@ -31,11 +36,13 @@ namespace platefile {
 
     PlateView(const Url& url)
       : m_platefile( new PlateFile(url) ),
+        m_tile_cache( new TileCache<PixelT>(m_platefile) ),
         m_current_level(m_platefile->num_levels()-1)
     { }
 
     PlateView(boost::shared_ptr<PlateFile> plate)
       : m_platefile( plate ),
+        m_tile_cache( new TileCache<PixelT>(m_platefile) ),
         m_current_level(m_platefile->num_levels()-1)
     { }
 
@@ -58,6 +65,8 @@ namespace platefile {
 
     int num_levels() const { return m_platefile->num_levels(); }
 
+    TileCache<PixelT>& tile_cache() const { return *m_tile_cache; }
+
     std::list<TileHeader>
     search_for_tiles( BBox2i image_bbox ) const {
       const float tile_size = m_platefile->default_tile_size();
@@ -81,6 +90,8 @@ namespace platefile {
     inline prerasterize_type prerasterize(BBox2i bbox) const {
       const int32 tile_size = m_platefile->default_tile_size();
 
+      // The one index query for this region also names the exact
+      // transaction of each tile, which is all the cache needs.
       std::list<TileHeader> tileheaders =
         search_for_tiles( bbox );
 
@@ -93,10 +104,13 @@ namespace platefile {
       ImageView<pixel_type> level_image(bbox.width(),bbox.height());
 
       // Access the tiles needed for this level and copy them into place
-      BOOST_FOREACH( TileHeader const& theader, tileheaders ) {
-        ImageView<PixelT> tile;
-        m_platefile->read( tile, theader.col(), theader.row(), theader.level(),
-                           theader.transaction_id(), true );
+      std::vector<TileHeader> headers( tileheaders.begin(), tileheaders.end() );
+      std::vector<boost::shared_ptr<ImageView<PixelT> > > tiles;
+      m_tile_cache->read( headers, tiles );
+
+      for ( size_t i = 0; i < headers.size(); ++i ) {
+        TileHeader const& theader = headers[i];
+        ImageView<PixelT> const& tile = *tiles[i];
 
         BBox2i src_bbox_cropped( tile_size*theader.col(), tile_size*theader.row(),
                                     tile_size, tile_size );
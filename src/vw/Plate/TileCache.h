@@ -0,0 +1,183 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file TileCache.h
+///
+/// A cache of decoded plate file tiles, keyed by col, row, level and
+/// transaction id.  Tiles never change once written, so a tile with
+/// the same key is always the same image, and entries never go
+/// stale.  The decoded images live in a vw::Cache, by default the
+/// system cache, which bounds their total size and evicts the least
+/// recently used.
+///
+#ifndef __VW_PLATE_TILE_CACHE_H__
+#define __VW_PLATE_TILE_CACHE_H__
+
+#include <vw/Plate/PlateFile.h>
+#include <vw/Core/Cache.h>
+#include <vw/Core/System.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <vector>
+
+namespace vw {
+namespace platefile {
+
+  template <class PixelT>
+  class TileCache : private boost::noncopyable {
+
+    struct Key {
+      int32 col, row, level, transaction_id;
+      Key( TileHeader const& hdr )
+        : col(hdr.col()), row(hdr.row()), level(hdr.level()), transaction_id(hdr.transaction_id()) {}
+      bool operator<( Key const& k ) const {
+        if ( level != k.level ) return level < k.level;
+        if ( row != k.row ) return row < k.row;
+        if ( col != k.col ) return col < k.col;
+        return transaction_id < k.transaction_id;
+      }
+    };
+
+    // Decodes the tile an index record points to.  The record is
+    // looked up once, when the tile first misses, so regenerating an
+    // evicted tile only touches the blob.
+    class TileGenerator {
+      boost::shared_ptr<PlateFile> m_platefile;
+      IndexRecord m_record;
+    public:
+      typedef ImageView<PixelT> value_type;
+      TileGenerator( boost::shared_ptr<PlateFile> platefile, IndexRecord const& record )
+        : m_platefile(platefile), m_record(record) {}
+      size_t size() const {
+        return size_t(m_platefile->default_tile_size()) * m_platefile->default_tile_size() * sizeof(PixelT);
+      }
+      boost::shared_ptr<value_type> generate() const {
+        std::pair<TileHeader, TileData> tile = m_platefile->read( m_record );
+        boost::scoped_ptr<SrcImageResource> r( SrcMemoryImageResource::open( tile.first.filetype(),
+                                                                             tile.second->data(),
+                                                                             tile.second->size() ) );
+        boost::shared_ptr<value_type> image( new value_type );
+        read_image( *image, *r );
+        return image;
+      }
+    };
+
+    typedef Cache::Handle<TileGenerator> handle_type;
+
+    // A tile that fails to decode throws here, and run_tasks()
+    // rethrows the error to read()'s caller, so it is decoded once.
+    class DecodeTask : public Task {
+      handle_type m_handle;
+    public:
+      DecodeTask( handle_type const& handle ) : m_handle(handle) {}
+      virtual void operator()() { m_handle.operator->(); }
+    };
+
+    boost::shared_ptr<PlateFile> m_platefile;
+    Cache& m_cache;
+    std::map<Key, handle_type> m_handles;
+    size_t m_max_handles;
+    uint64 m_hits, m_misses;
+    mutable Mutex m_mutex;
+
+    // Sets handles[i] to the handle for headers[i].  The tiles that
+    // have never been seen are looked up in the index together.
+    void lookup( std::vector<TileHeader> const& headers, std::vector<handle_type>& handles ) {
+      handles.resize( headers.size() );
+      std::vector<size_t> unknown;
+      {
+        Mutex::Lock lock( m_mutex );
+        for ( size_t i = 0; i < headers.size(); ++i ) {
+          typename std::map<Key, handle_type>::const_iterator h = m_handles.find( Key( headers[i] ) );
+          if ( h != m_handles.end() )
+            handles[i] = h->second;
+          else
+            unknown.push_back( i );
+        }
+      }
+      if ( unknown.empty() )
+        return;
+
+      std::vector<TileHeader> unknown_headers( unknown.size() );
+      for ( size_t k = 0; k < unknown.size(); ++k )
+        unknown_headers[k] = headers[unknown[k]];
+      std::vector<IndexRecord> records;
+      m_platefile->read_records( unknown_headers, records, true );
+
+      std::vector<handle_type> inserted( unknown.size() );
+      for ( size_t k = 0; k < unknown.size(); ++k )
+        inserted[k] = m_cache.insert( TileGenerator( m_platefile, records[k] ) );
+
+      Mutex::Lock lock( m_mutex );
+      if ( m_handles.size() + unknown.size() > m_max_handles ) {
+        // Forget the tiles that have been evicted, or everything if
+        // that is not enough.
+        for ( typename std::map<Key, handle_type>::iterator i = m_handles.begin(); i != m_handles.end(); )
+          if ( i->second.valid() ) ++i;
+          else m_handles.erase( i++ );
+        if ( m_handles.size() + unknown.size() > m_max_handles )
+          m_handles.clear();
+      }
+      // Another thread may have added the same tile meanwhile.
+      for ( size_t k = 0; k < unknown.size(); ++k )
+        handles[unknown[k]] = m_handles.insert( std::make_pair( Key( unknown_headers[k] ), inserted[k] ) ).first->second;
+    }
+
+  public:
+    /// Keeps the decoded tiles in cache, and remembers at most
+    /// max_tiles tile locations.
+    TileCache( boost::shared_ptr<PlateFile> platefile,
+               Cache& cache = vw_system_cache(), size_t max_tiles = 16384 )
+      : m_platefile(platefile), m_cache(cache), m_max_handles(max_tiles),
+        m_hits(0), m_misses(0) {}
+
+    /// Returns the tile hdr names exactly, reading and decoding it if
+    /// it is not cached.  Throws TileNotFoundErr if there is no such
+    /// tile.
+    boost::shared_ptr<ImageView<PixelT> > read( TileHeader const& hdr ) {
+      std::vector<boost::shared_ptr<ImageView<PixelT> > > tiles;
+      read( std::vector<TileHeader>( 1, hdr ), tiles );
+      return tiles[0];
+    }
+
+    /// Returns the tiles in headers, in order.  The missing ones are
+    /// looked up in the index in one batch, then read and decoded in
+    /// parallel.  Throws TileNotFoundErr if any of them is not in the
+    /// plate file, or the first error met decoding them.
+    void read( std::vector<TileHeader> const& headers,
+               std::vector<boost::shared_ptr<ImageView<PixelT> > >& tiles ) {
+      std::vector<handle_type> handles;
+      lookup( headers, handles );
+
+      std::vector<boost::shared_ptr<Task> > tasks;
+      for ( size_t i = 0; i < handles.size(); ++i )
+        if ( !handles[i].valid() )
+          tasks.push_back( boost::shared_ptr<Task>( new DecodeTask( handles[i] ) ) );
+      {
+        Mutex::Lock lock( m_mutex );
+        m_misses += tasks.size();
+        m_hits += handles.size() - tasks.size();
+      }
+      run_tasks( tasks );
+
+      tiles.resize( headers.size() );
+      for ( size_t i = 0; i < headers.size(); ++i )
+        tiles[i] = handles[i];
+    }
+
+    /// The number of tiles read that were already decoded, and that
+    /// had to be decoded.
+    uint64 hits() const { Mutex::Lock lock( m_mutex ); return m_hits; }
+    uint64 misses() const { Mutex::Lock lock( m_mutex ); return m_misses; }
+  };
+
+}} // namespace vw::platefile
+
+#endif // __VW_PLATE_TILE_CACHE_H__
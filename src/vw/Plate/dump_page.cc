@@ -56,11 +56,9 @@ void run(const Options& opt) {
   std::cout << "Loaded page at col=" << opt.col << " row=" << opt.row << " level=" << opt.level << std::endl
             << "Page contains " << page->sparse_size() << " entries." << std::endl;
 
-    //typedef std::pair<uint32, IndexRecord> value_type;
-    //typedef std::list<value_type> multi_value_type;
-    //typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
-
-  BOOST_FOREACH(const IndexPage::multi_value_type& slot, std::make_pair(page->begin(), page->end())) {
+  BBox2i level_bbox(0, 0, 1 << opt.level, 1 << opt.level);
+  BOOST_FOREACH(const TileHeader& tile, page->search_by_region(level_bbox, 0, -1, 0, false)) {
+    IndexPage::multi_value_type slot = page->multi_get(tile.col(), tile.row(), 0, -1);
     std::cout << "Loaded page slot with " << slot.size() << " entries" << std::endl;
     BOOST_FOREACH(const IndexPage::value_type& elt, slot) {
       std::cout << "TID=" << elt.first << " BLOB=" << elt.second.blob_id() << " OFFSET=" << elt.second.blob_offset() << std::endl;
@@ -84,7 +84,7 @@ void do_tiles(boost::shared_ptr<PlateFile> platefile, Options& opt) {
   datum.set_well_known_datum( opt.output_datum );
   output_georef.set_datum( datum );
 
-  PlateView<PixelT> plate_view(opt.plate_file_name);
+  PlateView<PixelT> plate_view(platefile);
   if ( opt.level != -1 )
     plate_view.set_level( opt.level );
   ImageViewRef<PixelT> plate_view_ref = plate_view;
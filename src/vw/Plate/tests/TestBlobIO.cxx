@@ -8,8 +8,10 @@
 #include <gtest/gtest.h>
 #include <test/Helpers.h>
 
+#include <vw/Core/Stopwatch.h>
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/BlobManager.h>
+#include <vw/Plate/Exception.h>
 #include <vw/Plate/Rpc.pb.h>
 
 #include <boost/filesystem/operations.hpp>
@@ -201,3 +203,140 @@ TEST_F(BlobIOTest, Iterator) {
   ++iter;
   EXPECT_EQ( blob.end(), iter );
 }
+
+TEST_F(BlobIOTest, ReadOnly) {
+  std::vector<uint64> offsets;
+  {
+    Blob blob(blob_path);
+    for (int i = 0; i < 3; ++i) {
+      hdr.set_col(i);
+      offsets.push_back(blob.write(hdr, test_data, data_size));
+    }
+  }
+
+  TileData data;
+  {
+    Blob blob(blob_path, true);
+    Blob writable(blob_path);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+      TileHeader hdr2 = blob.read_header(offsets[i]);
+      EXPECT_EQ(hdr.filetype(), hdr2.filetype());
+      EXPECT_EQ(int32(i), hdr2.col());
+
+      TileData verify_data = blob.read_data(offsets[i]);
+      EXPECT_RANGE_EQ(test_data+0, test_data+data_size, verify_data->begin(), verify_data->end());
+      EXPECT_EQ(data_size, blob.data_size(offsets[i]));
+
+      // The sendfile(2) parameters must agree with the streamed blob's.
+      std::string filename1, filename2;
+      uint64 offset1, offset2, size1, size2;
+      blob.read_sendfile(offsets[i], filename1, offset1, size1);
+      writable.read_sendfile(offsets[i], filename2, offset2, size2);
+      EXPECT_EQ(filename2, filename1);
+      EXPECT_EQ(offset2, offset1);
+      EXPECT_EQ(size2, size1);
+    }
+
+    int count = 0;
+    for (Blob::iterator iter = blob.begin(); iter != blob.end(); ++iter)
+      EXPECT_EQ(count++, (*iter).col());
+    EXPECT_EQ(3, count);
+
+    EXPECT_THROW(blob.write(hdr, test_data, data_size), BlobIoErr);
+
+    // Tiles appended after the blob was mapped can still be read.
+    hdr.set_col(3);
+    uint64 offset = writable.write(hdr, test_data, data_size);
+    writable.read_data(offset); // Flushes the write out to the file
+    EXPECT_EQ(3, blob.read_header(offset).col());
+    data = blob.read_data(offset);
+  }
+
+  // Tile data outlives the blob it was read from.
+  EXPECT_RANGE_EQ(test_data+0, test_data+data_size, data->begin(), data->end());
+}
+
+TEST_F(BlobIOTest, BatchWrite) {
+  UnlinkName single_path("BlobIOSingle");
+
+  std::vector<TileHeader> headers;
+  std::vector<const uint8*> data;
+  std::vector<uint64> sizes;
+  for (int i = 0; i < 25; ++i) {
+    hdr.set_col(i);
+    headers.push_back(hdr);
+    data.push_back(test_data + i % data_size);
+    sizes.push_back(data_size - i % data_size);
+  }
+
+  // A batch lands on disk exactly as the same tiles written one at a time.
+  std::vector<uint64> single_offsets, batch_offsets;
+  {
+    Blob single(single_path);
+    for (size_t i = 0; i < headers.size(); ++i)
+      single_offsets.push_back(single.write(headers[i], data[i], sizes[i]));
+
+    Blob batch(blob_path);
+    batch_offsets = batch.write(headers, data, sizes);
+    EXPECT_EQ(single.size(), batch.size());
+
+    // Mismatched batches are rejected; empty ones write nothing.
+    std::vector<uint64> short_sizes(sizes.begin(), sizes.end() - 1);
+    EXPECT_THROW(batch.write(headers, data, short_sizes), ArgumentErr);
+    EXPECT_TRUE(batch.write(std::vector<TileHeader>(), std::vector<const uint8*>(),
+                            std::vector<uint64>()).empty());
+    EXPECT_EQ(single.size(), batch.size());
+  }
+  EXPECT_RANGE_EQ(single_offsets.begin(), single_offsets.end(), batch_offsets.begin(), batch_offsets.end());
+  EXPECT_EQ(fs::file_size(single_path), fs::file_size(blob_path));
+
+  Blob blob(blob_path, true);
+  for (size_t i = 0; i < headers.size(); ++i) {
+    EXPECT_EQ(headers[i].col(), blob.read_header(batch_offsets[i]).col());
+    TileData verify_data = blob.read_data(batch_offsets[i]);
+    EXPECT_RANGE_EQ(data[i], data[i] + sizes[i], verify_data->begin(), verify_data->end());
+  }
+}
+
+TEST_F(BlobIOTest, DISABLED_ReadBenchmark) {
+  const int num_tiles = 2000;
+  std::vector<uint8> tile(16384);
+  for (size_t i = 0; i < tile.size(); ++i)
+    tile[i] = uint8(i * 7);
+
+  std::vector<uint64> offsets;
+  {
+    Blob blob(blob_path);
+    for (int i = 0; i < num_tiles; ++i) {
+      hdr.set_col(i);
+      offsets.push_back(blob.write(hdr, &tile[0], tile.size()));
+    }
+  }
+
+  Stopwatch streamed, mapped;
+  uint64 total_streamed = 0, total_mapped = 0;
+  {
+    Blob blob(blob_path);
+    streamed.start();
+    for (int i = 0; i < num_tiles; ++i) {
+      TileHeader header = blob.read_header(offsets[i]);
+      TileData data = blob.read_data(offsets[i]);
+      total_streamed += header.col() + data->size() + (*data)[i % data->size()];
+    }
+    streamed.stop();
+  }
+  {
+    Blob blob(blob_path, true);
+    mapped.start();
+    for (int i = 0; i < num_tiles; ++i) {
+      TileHeader header = blob.read_header(offsets[i]);
+      TileData data = blob.read_data(offsets[i]);
+      total_mapped += header.col() + data->size() + (*data)[i % data->size()];
+    }
+    mapped.stop();
+  }
+
+  EXPECT_EQ(total_streamed, total_mapped);
+  std::cout << "Read " << num_tiles << " 16KB tiles: streamed " << streamed.elapsed_seconds()
+            << "s, mapped " << mapped.elapsed_seconds() << "s" << std::endl;
+}
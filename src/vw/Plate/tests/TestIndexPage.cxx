@@ -7,8 +7,13 @@
 
 #include <gtest/gtest.h>
 #include <test/Helpers.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Plate/LocalIndex.h>
 #include <vw/Plate/Exception.h>
+#include <vw/Plate/google/sparsetable>
+
+#include <fstream>
+#include <boost/foreach.hpp>
 
 using namespace std;
 using namespace vw;
@@ -157,3 +162,177 @@ TEST_F(IndexPageTest, Serialization) {
   EXPECT_EQ( rec[2].blob_id(),     out_rec.blob_id() );
   EXPECT_EQ( rec[2].blob_offset(), out_rec.blob_offset() );
 }
+
+TEST_F(IndexPageTest, ReplaceAndMerge) {
+  TileHeader hdr;
+  hdr.set_col(7);
+  hdr.set_row(9);
+  IndexRecord rec;
+  rec.set_filetype("png");
+
+  // Interleave writes and reads, writing some transactions twice.
+  for (int t = 10; t > 0; --t) {
+    hdr.set_transaction_id(t);
+    rec.set_blob_id(t);
+    rec.set_blob_offset(100*t);
+    page->set(hdr, rec);
+    if (t % 3 == 0) {
+      EXPECT_EQ(t, page->get(7, 9, t, true).blob_id());
+    }
+  }
+  for (int t = 2; t <= 10; t += 2) {
+    hdr.set_transaction_id(t);
+    rec.set_blob_id(1000+t);
+    page->set(hdr, rec);
+    rec.set_blob_id(2000+t);
+    page->set(hdr, rec);
+  }
+
+  EXPECT_EQ(1, page->sparse_size());
+  IndexPage::multi_value_type all = page->multi_get(7, 9, 0, -1);
+  ASSERT_EQ(10u, all.size());
+  uint32 expected_tid = 10;
+  BOOST_FOREACH(const IndexPage::value_type& v, all) {
+    EXPECT_EQ(expected_tid, v.first);
+    EXPECT_EQ(int32(expected_tid % 2 ? expected_tid : 2000+expected_tid), v.second.blob_id());
+    EXPECT_EQ("png", v.second.filetype());
+    --expected_tid;
+  }
+
+  EXPECT_EQ(2006, page->get(7, 9, 6).blob_id());
+  EXPECT_EQ(5,    page->get(7, 9, 5, true).blob_id());
+  EXPECT_THROW(page->get(7, 9, 0), TileNotFoundErr);
+  EXPECT_THROW(page->get(7, 9, 11, true), TileNotFoundErr);
+}
+
+TEST_F(IndexPageTest, Search) {
+  TileHeader hdr;
+  IndexRecord rec;
+
+  // Tile (1,1) has transactions 5 and 3, tile (4,2) has 6, 4, and 2.
+  int tiles[5][3] = { {1,1,5}, {1,1,3}, {4,2,6}, {4,2,4}, {4,2,2} };
+  for (int i = 0; i < 5; ++i) {
+    hdr.set_col(tiles[i][0]);
+    hdr.set_row(tiles[i][1]);
+    hdr.set_transaction_id(tiles[i][2]);
+    rec.set_filetype(i == 2 ? "jpg" : "png");
+    page->set(hdr, rec);
+  }
+
+  std::list<TileHeader> r = page->search_by_region(BBox2i(0,0,1024,1024), -1, -1, 1, false);
+  ASSERT_EQ(2u, r.size());
+  EXPECT_EQ(1, r.front().col());
+  EXPECT_EQ(5u, r.front().transaction_id());
+  EXPECT_EQ(4, r.back().col());
+  EXPECT_EQ(6u, r.back().transaction_id());
+
+  // The region excludes tile (4,2).
+  r = page->search_by_region(BBox2i(0,0,4,4), -1, -1, 1, false);
+  ASSERT_EQ(1u, r.size());
+  EXPECT_EQ(1, r.front().row());
+
+  // [3,4] picks 3 from (1,1) and 4 from (4,2).
+  r = page->search_by_region(BBox2i(0,0,1024,1024), 3, 4, 1, false);
+  ASSERT_EQ(2u, r.size());
+  EXPECT_EQ(3u, r.front().transaction_id());
+  EXPECT_EQ(4u, r.back().transaction_id());
+
+  // [4,5] matches one entry at each tile, [4,6] two at (4,2).
+  EXPECT_EQ(0u, page->search_by_region(BBox2i(0,0,1024,1024), 4, 5, 2, false).size());
+  EXPECT_EQ(1u, page->search_by_region(BBox2i(0,0,1024,1024), 4, 6, 2, false).size());
+  EXPECT_EQ(2u, page->search_by_region(BBox2i(0,0,1024,1024), 4, 5, 2, true).size());
+
+  // Nothing at (1,1) in [4,4] unless we fetch the next older entry.
+  r = page->search_by_region(BBox2i(0,0,1024,1024), 4, 4, 1, false);
+  ASSERT_EQ(1u, r.size());
+  EXPECT_EQ(4, r.front().col());
+  r = page->search_by_region(BBox2i(0,0,1024,1024), 4, 4, 1, true);
+  ASSERT_EQ(2u, r.size());
+  EXPECT_EQ(3u, r.front().transaction_id());
+
+  r = page->search_by_location(4, 2, 3, 6, false);
+  ASSERT_EQ(2u, r.size());
+  EXPECT_EQ(6u, r.front().transaction_id());
+  EXPECT_EQ("jpg", r.front().filetype());
+  EXPECT_EQ(4u, r.back().transaction_id());
+  EXPECT_EQ("png", r.back().filetype());
+  r = page->search_by_location(4, 2, 3, 6, true);
+  ASSERT_EQ(3u, r.size());
+  EXPECT_EQ(2u, r.back().transaction_id());
+  EXPECT_EQ(0u, page->search_by_location(5, 2, 0, 6, true).size());
+}
+
+TEST_F(IndexPageTest, ReadsLegacyFormat) {
+  // Write a page in the sparsetable format that pages used to be
+  // stored in: three entries at (3,5) and one at (1023,5).
+  {
+    std::ofstream ostr(page_path.c_str(), std::ios::binary);
+    int32 width = 1024, height = 1024;
+    ostr.write(reinterpret_cast<char*>(&width), sizeof(width));
+    ostr.write(reinterpret_cast<char*>(&height), sizeof(height));
+    google::sparsetable<uint8> table(width*height);
+    table.set(5*width + 3, 0);
+    table.set(5*width + 1023, 0);
+    table.write_metadata(&ostr);
+
+    uint32 counts[2] = { 3, 1 };
+    uint32 tid = 30;
+    for (int slot = 0; slot < 2; ++slot) {
+      ostr.write(reinterpret_cast<char*>(&counts[slot]), sizeof(counts[slot]));
+      for (uint32 i = 0; i < counts[slot]; ++i, --tid) {
+        IndexRecord rec;
+        rec.set_blob_id(tid);
+        rec.set_blob_offset(1000*tid);
+        std::string bytes = rec.SerializeAsString();
+        uint16 size = uint16(bytes.size());
+        ostr.write(reinterpret_cast<char*>(&tid), sizeof(tid));
+        ostr.write(reinterpret_cast<char*>(&size), sizeof(size));
+        ostr.write(bytes.data(), size);
+      }
+    }
+  }
+
+  boost::shared_ptr<LocalIndexPage> legacy(new LocalIndexPage(page_path,0,0,0,1024,1024));
+  EXPECT_EQ(2, legacy->sparse_size());
+  EXPECT_EQ(30, legacy->get(3, 5, -1).blob_id());
+  EXPECT_EQ(29, legacy->get(3, 5, 29, true).blob_id());
+  EXPECT_EQ(28000u, legacy->get(3, 5, 28).blob_offset());
+  EXPECT_EQ("default_to_index", legacy->get(3, 5, 28).filetype());
+  EXPECT_EQ(27, legacy->get(1023, 5, -1).blob_id());
+  EXPECT_EQ(3u, legacy->multi_get(3, 5, 0, -1).size());
+}
+
+TEST_F(IndexPageTest, DISABLED_SearchBenchmark) {
+  // A page that has seen 100k transactions spread over its tiles,
+  // with the most activity near the top left.
+  page.reset(new LocalIndexPage(page_path,0,0,0,256,256));
+  TileHeader hdr;
+  IndexRecord rec;
+  rec.set_filetype("png");
+  const int num_transactions = 100000;
+  Stopwatch write;
+  write.start();
+  for (int t = 1; t <= num_transactions; ++t) {
+    hdr.set_col(int32((int64(t) * 7919) % (1 + t % 256)));
+    hdr.set_row(int32((int64(t) * 104729) % (1 + (t / 256) % 256)));
+    hdr.set_transaction_id(t);
+    rec.set_blob_id(t % 16);
+    rec.set_blob_offset(t * 4096);
+    page->set(hdr, rec);
+  }
+  write.stop();
+
+  Stopwatch search;
+  size_t found = 0;
+  search.start();
+  for (int i = 0; i < 20; ++i) {
+    found += page->search_by_region(BBox2i(0,0,256,256), -1, -1, 1, false).size();
+    found += page->search_by_region(BBox2i(0,0,128,128), num_transactions/2, num_transactions, 1, true).size();
+  }
+  search.stop();
+
+  EXPECT_LT(0u, found);
+  std::cout << "Wrote " << num_transactions << " transactions to a page with " << page->sparse_size()
+            << " tiles in " << write.elapsed_seconds() << "s, 40 region searches took "
+            << search.elapsed_seconds() << "s" << std::endl;
+}
@@ -357,3 +357,86 @@ TEST_F(LocalIndexTiles, ValidTiles) {
   tiles = index->search_by_region(1, BBox2i(0,0,2,2), tid.minimum(), tid.maximum(), 1, false);
   EXPECT_EQ(4, tiles.size());
 }
+
+TEST_F(LocalIndexTiles, MultiWriteUpdate) {
+
+  // Write the tiles as one batch, with a repeated tile at the end.
+  std::vector<TileHeader> headers(hdrs.get(), hdrs.get()+6);
+  std::vector<const uint8*> data(headers.size(), test_data);
+  std::vector<uint64> sizes(headers.size(), test_size);
+
+  uint64 old_offset;
+  int blob_id = index->write_request(old_offset);
+  std::vector<uint64> offsets = blob->write(headers, data, sizes);
+
+  std::vector<IndexRecord> records(headers.size());
+  for (size_t i = 0; i < headers.size(); ++i) {
+    records[i].set_blob_id(blob_id);
+    records[i].set_blob_offset(offsets[i]);
+    records[i].set_filetype(headers[i].filetype());
+  }
+  index->multi_write_update(headers, records);
+  index->write_complete(blob_id, blob->size());
+
+  EXPECT_EQ(2, index->num_levels());
+
+  // The later of two writes to the same tile wins.
+  IndexRecord out = index->read_request(1, 1, 1, -1);
+  EXPECT_EQ(offsets[5], out.blob_offset());
+
+  // A batch with a bad tile in it is rejected, and none of it is
+  // applied, even at the levels before the bad tile.
+  headers[3].set_col(10);
+  records[0].set_blob_offset(offsets[0] + 1);
+  EXPECT_THROW(index->multi_write_update(headers, records), TileNotFoundErr);
+  EXPECT_EQ(offsets[0], index->read_request(0, 0, 0, -1).blob_offset());
+  headers[3].set_col(0);
+  headers[3].set_level(-1);
+  EXPECT_THROW(index->multi_write_update(headers, records), TileNotFoundErr);
+  EXPECT_EQ(offsets[0], index->read_request(0, 0, 0, -1).blob_offset());
+  EXPECT_EQ(2, index->num_levels());
+  records.pop_back();
+  EXPECT_THROW(index->multi_write_update(headers, records), ArgumentErr);
+
+  // Completing a transaction saves the pages, so the batch is visible
+  // to a freshly opened index.
+  index->transaction_complete(hdrs[0].transaction_id(), true);
+  LocalIndex index2(plate_path);
+  EXPECT_EQ(2, index2.num_levels());
+  for (size_t i = 0; i < 5; ++i) {
+    out = index2.read_request(hdrs[i].col(), hdrs[i].row(), hdrs[i].level(), -1);
+    EXPECT_EQ(i == 4 ? offsets[5] : offsets[i], out.blob_offset());
+    check_tile_hdr(hdrs[i], blob->read_header(out.blob_offset()));
+  }
+}
+
+TEST_F(LocalIndexTiles, MultiReadRequest) {
+  std::vector<uint64> offsets(5);
+  for (size_t i = 0; i < 5; ++i) {
+    IndexRecord rec;
+    rec.set_filetype(hdrs[i].filetype());
+    index_write(hdrs[i], rec);
+    offsets[i] = rec.blob_offset();
+  }
+
+  // Out of order, and across levels and pages.
+  std::vector<TileHeader> headers;
+  headers.push_back(hdrs[4]);
+  headers.push_back(hdrs[0]);
+  headers.push_back(hdrs[2]);
+  headers.push_back(hdrs[1]);
+  std::vector<IndexRecord> records;
+  index->multi_read_request(headers, records, true);
+  ASSERT_EQ(4u, records.size());
+  EXPECT_EQ(offsets[4], records[0].blob_offset());
+  EXPECT_EQ(offsets[0], records[1].blob_offset());
+  EXPECT_EQ(offsets[2], records[2].blob_offset());
+  EXPECT_EQ(offsets[1], records[3].blob_offset());
+
+  // One missing tile fails the batch.
+  headers[2].set_transaction_id(hdrs[2].transaction_id() + 1);
+  EXPECT_THROW(index->multi_read_request(headers, records, true), TileNotFoundErr);
+  headers[2] = hdrs[2];
+  headers[2].set_level(5);
+  EXPECT_THROW(index->multi_read_request(headers, records, true), TileNotFoundErr);
+}
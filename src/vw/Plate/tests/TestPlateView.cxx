@@ -0,0 +1,99 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+#include <vw/Plate/PlateView.h>
+#include <vw/Image/PixelTypes.h>
+
+using namespace std;
+using namespace vw;
+using namespace vw::platefile;
+using namespace vw::test;
+
+class PlateViewTest : public ::testing::Test {
+protected:
+  typedef PixelGrayA<uint8> PixelT;
+
+  // A tile whose pixels encode where they are, and which transaction
+  // wrote them.
+  ImageView<PixelT> make_tile( int col, int row, int transaction_id ) {
+    ImageView<PixelT> tile( 16, 16 );
+    for ( int32 j = 0; j < tile.rows(); ++j )
+      for ( int32 i = 0; i < tile.cols(); ++i )
+        tile(i,j) = PixelT( (col*16+i + 3*(row*16+j) + 50*transaction_id) % 256, 255 );
+    return tile;
+  }
+
+  virtual void SetUp() {
+    platename = UnlinkName("test.plate");
+    platefile.reset( new PlateFile( Url(platename), "", "", 16, "png",
+                                    VW_PIXEL_GRAYA, VW_CHANNEL_UINT8 ) );
+
+    // Level 2 is 4x4 tiles.  Leave out (3,3), and write (1,1) twice.
+    platefile->write_request();
+    for ( int row = 0; row < 4; ++row )
+      for ( int col = 0; col < 4; ++col )
+        if ( col != 3 || row != 3 )
+          platefile->write_update( make_tile( col, row, 1 ), col, row, 2, 1 );
+    platefile->write_update( make_tile( 1, 1, 2 ), 1, 1, 2, 2 );
+    platefile->write_complete();
+  }
+
+  UnlinkName platename;
+  boost::shared_ptr<PlateFile> platefile;
+};
+
+TEST_F( PlateViewTest, Rasterize ) {
+  PlateView<PixelT> view( platefile );
+  view.set_level( 2 );
+  ASSERT_EQ( 64, view.cols() );
+
+  BBox2i bbox( 5, 7, 50, 52 );
+  ImageView<PixelT> result = crop( view, bbox );
+  ASSERT_EQ( bbox.width(), result.cols() );
+  for ( int32 j = 0; j < result.rows(); ++j )
+    for ( int32 i = 0; i < result.cols(); ++i ) {
+      int32 x = bbox.min().x() + i, y = bbox.min().y() + j;
+      int col = x / 16, row = y / 16;
+      PixelT expected;
+      if ( col != 3 || row != 3 )
+        expected = make_tile( col, row, col == 1 && row == 1 ? 2 : 1 )(x%16, y%16);
+      ASSERT_EQ( expected, result(i,j) ) << "at " << x << "," << y;
+    }
+
+  // The same region again is decoded from the cache.
+  EXPECT_EQ( 15u, view.tile_cache().misses() );
+  uint64 hits = view.tile_cache().hits();
+  ImageView<PixelT> again = crop( view, bbox );
+  EXPECT_EQ( 15u, view.tile_cache().misses() );
+  EXPECT_EQ( hits + 15, view.tile_cache().hits() );
+  EXPECT_TRUE( std::equal( result.begin(), result.end(), again.begin() ) );
+}
+
+TEST_F( PlateViewTest, TileCache ) {
+  TileCache<PixelT> cache( platefile );
+
+  // Both versions of a tile are cached separately.
+  TileHeader hdr;
+  hdr.set_col( 1 );
+  hdr.set_row( 1 );
+  hdr.set_level( 2 );
+  hdr.set_transaction_id( 1 );
+  ImageView<PixelT> expected = make_tile( 1, 1, 1 );
+  ImageView<PixelT> tile = *cache.read( hdr );
+  EXPECT_EQ( expected(3,4), tile(3,4) );
+  hdr.set_transaction_id( 2 );
+  expected = make_tile( 1, 1, 2 );
+  tile = *cache.read( hdr );
+  EXPECT_EQ( expected(3,4), tile(3,4) );
+  EXPECT_EQ( 2u, cache.misses() );
+
+  hdr.set_col( 3 );
+  hdr.set_row( 3 );
+  EXPECT_THROW( cache.read( hdr ), TileNotFoundErr );
+}
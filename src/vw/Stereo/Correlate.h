@@ -20,7 +20,8 @@ namespace stereo {
 
   enum CorrelatorType { ABS_DIFF_CORRELATOR = 0,
                         SQR_DIFF_CORRELATOR = 1,
-                        NORM_XCORR_CORRELATOR = 2 };
+                        NORM_XCORR_CORRELATOR = 2,
+                        SGM_CORRELATOR = 3 };       // See SemiGlobalCorrelator.h
 
   /// Given a type, these traits classes help to determine a suitable
   /// working type for accumulation operations in the correlator
@@ -11,6 +11,7 @@
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Stereo/Correlate.h>
 #include <vw/Stereo/PyramidCorrelator.h>
+#include <vw/Stereo/SemiGlobalCorrelator.h>
 #include <vw/Stereo/DisparityMap.h>
 
 #include <ostream>
@@ -178,7 +179,38 @@ namespace stereo {
              sum_of_pixel_values(cropped_right_mask) != 0 ) {
           // We have all of the settings adjusted.  Now we just have to
           // run the correlator.
-          if ( m_do_pyramid_correlator ) {
+          if ( m_correlator_type == SGM_CORRELATOR ) {
+            SemiGlobalCorrelator correlator(BBox2i(0,0,m_search_range.width(),
+                                                   m_search_range.height()),
+                                            m_kernel_size[0], m_cross_corr_threshold,
+                                            m_corr_score_threshold);
+
+            // Narrow the search at each pixel to the neighborhood of
+            // the disparity found by a pyramid correlation of the
+            // images at half resolution.
+            if ( m_do_pyramid_correlator ) {
+              PyramidCorrelator seeder(BBox2(0,0,m_search_range.width()/2.0,
+                                             m_search_range.height()/2.0),
+                                       Vector2i(m_kernel_size[0], m_kernel_size[1]),
+                                       m_cross_corr_threshold, m_corr_score_threshold,
+                                       m_cost_blur, ABS_DIFF_CORRELATOR, m_num_pyramid_levels-1);
+              ImageView<ImagePixelT> half_left = subsample(gaussian_filter(cropped_left_image,1.2),2);
+              ImageView<ImagePixelT> half_right = subsample(gaussian_filter(cropped_right_image,1.2),2);
+              ImageView<MaskPixelT> half_left_mask = subsample(cropped_left_mask,2);
+              ImageView<MaskPixelT> half_right_mask = subsample(cropped_right_mask,2);
+              ImageView<pixel_type> seed =
+                disparity_upsample(seeder( half_left, half_right, half_left_mask, half_right_mask,
+                                           m_preproc_func ));
+              correlator.set_seed(crop(edge_extend(seed, ZeroEdgeExtension()), 0, 0,
+                                       cropped_left_image.cols(), cropped_left_image.rows()), 2);
+            }
+
+            disparity_map = disparity_mask(correlator( cropped_left_image,
+                                                       cropped_right_image,
+                                                       m_preproc_func ),
+                                           cropped_left_mask,
+                                           cropped_right_mask );
+          } else if ( m_do_pyramid_correlator ) {
             PyramidCorrelator correlator(BBox2(0,0,m_search_range.width(),
                                                m_search_range.height()),
                                          Vector2i(m_kernel_size[0], m_kernel_size[1]),
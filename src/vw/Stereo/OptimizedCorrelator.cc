@@ -6,6 +6,21 @@
 
 
 #include <vw/Stereo/OptimizedCorrelator.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define VW_STEREO_COST_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VW_STEREO_COST_SIMD 1
+#else
+# define VW_STEREO_COST_SIMD 0
+#endif
 
 using namespace vw;
 using namespace stereo;
@@ -22,6 +37,383 @@ struct DisparityScore {
   }
 };
 
+// Converts the best scores into a disparity map.  Pixels whose cost
+// never changed with disparity are invalid.
+static ImageView<PixelMask<Vector2f> > best_disparities(ImageView<DisparityScore<float> > const& scores) {
+  ImageView<PixelMask<Vector2f> > result(scores.cols(), scores.rows());
+  for (int32 x = 0; x < scores.cols(); x++) {
+    for (int32 y = 0; y < scores.rows(); y++) {
+      if (scores(x, y).best == ScalarTypeLimits<float>::highest() ||
+          scores(x, y).best == scores(x, y).worst) {
+        invalidate(result(x,y));
+      } else {
+        result(x, y)[0] = scores(x,y).hdisp;
+        result(x, y)[1] = scores(x,y).vdisp;
+        validate( result(x,y) );
+      }
+    }
+  }
+  return result;
+}
+
+// ---------------------------------------------------------------------------
+//                       SLIDING WINDOW ENGINE
+// ---------------------------------------------------------------------------
+//
+// Scores a whole row of the search window at once.  Every pixel keeps
+// one running box filter sum per horizontal disparity, stored
+// contiguously, so the sum updates, the per-pixel costs, and the search
+// for the best disparity are all vectorized across disparities.  The
+// sums are updated in the same order as StereoCostFunction::box_filter()
+// updates its single sum, so the costs match the ones calculate()
+// returns.  The image is split into column tiles that are scored in
+// parallel, each with its own scratch buffers.
+
+namespace {
+
+  // A vector of costs for consecutive disparities.
+  struct CostLanes {
+#if VW_STEREO_COST_SIMD == 2
+    typedef __m256 type;
+    static const int32 size = 8;
+    static type load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, type a) { _mm256_storeu_ps(p, a); }
+    static type set1(float a) { return _mm256_set1_ps(a); }
+    static type add(type a, type b) { return _mm256_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+    static type abs(type a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static type bit_or(type a, type b) { return _mm256_or_ps(a, b); }
+    static type less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static type greater(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static type select(type mask, type a, type b) { return _mm256_blendv_ps(b, a, mask); }
+#elif VW_STEREO_COST_SIMD == 1
+    typedef __m128 type;
+    static const int32 size = 4;
+    static type load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, type a) { _mm_storeu_ps(p, a); }
+    static type set1(float a) { return _mm_set1_ps(a); }
+    static type add(type a, type b) { return _mm_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+    static type abs(type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static type bit_or(type a, type b) { return _mm_or_ps(a, b); }
+    static type less(type a, type b) { return _mm_cmplt_ps(a, b); }
+    static type greater(type a, type b) { return _mm_cmpgt_ps(a, b); }
+    static type select(type mask, type a, type b) {
+      return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+#else
+    typedef float type;
+    static const int32 size = 1;
+    static type load(const float* p) { return *p; }
+    static void store(float* p, type a) { *p = a; }
+    static type set1(float a) { return a; }
+    static type add(type a, type b) { return a + b; }
+    static type sub(type a, type b) { return a - b; }
+    static type mul(type a, type b) { return a * b; }
+    static type abs(type a) { return fabsf(a); }
+    static type bit_or(type a, type /*b*/) { return a; }
+    static type less(type a, type b) { return a < b; }
+    static type greater(type a, type b) { return a > b; }
+    static type select(type mask, type a, type b) { return mask ? a : b; }
+#endif
+  };
+  typedef CostLanes::type CostVec;
+
+  // Copies n pixels of row y of image, starting at column x, into dst.
+  // Pixels outside the image are zero, as with ZeroEdgeExtension.
+  void copy_row(ImageView<float> const& image, int32 x, int32 y, int32 n, float* dst) {
+    std::fill(dst, dst + n, 0.0f);
+    if (y < 0 || y >= image.rows())
+      return;
+    int32 begin = std::max(-x, 0);
+    int32 end = std::min(image.cols() - x, n);
+    if (begin < end)
+      std::copy(&image(x + begin, y), &image(x + begin, y) + (end - begin), dst + begin);
+  }
+
+  // Per-pixel cost policies.  pixel() is the cost of matching left
+  // pixel l with right pixel r; the box filter averages it over the
+  // kernel and cost() turns that mean into the final cost of output
+  // pixel o of the current row at disparities [d, d+CostLanes::size).
+  struct AbsDifferencePixel {
+    float m_kernel_size_i2;
+    AbsDifferencePixel(float kernel_size_i2) : m_kernel_size_i2(kernel_size_i2) {}
+
+    static CostVec pixel(CostVec l, CostVec r) { return CostLanes::abs(CostLanes::sub(l, r)); }
+    void reserve(int32 /*n*/, int32 /*lanes*/) {}
+    void begin_row(int32 /*x*/, int32 /*y*/, int32 /*dx*/, int32 /*dy*/) {}
+    CostVec cost(CostVec sum, int32 /*o*/, int32 /*d*/) const {
+      return CostLanes::mul(sum, CostLanes::set1(m_kernel_size_i2));
+    }
+  };
+
+  struct SqDifferencePixel : AbsDifferencePixel {
+    SqDifferencePixel(float kernel_size_i2) : AbsDifferencePixel(kernel_size_i2) {}
+
+    static CostVec pixel(CostVec l, CostVec r) {
+      CostVec diff = CostLanes::sub(l, r);
+      return CostLanes::mul(diff, diff);
+    }
+  };
+
+  struct NormXCorrPixel {
+    float m_kernel_size_i2;
+    ImageView<float> m_left_mean, m_left_precision, m_right_mean, m_right_precision;
+    std::vector<float> m_lmean, m_lprec, m_rmean, m_rprec;
+
+    NormXCorrPixel(float kernel_size_i2,
+                   ImageView<float> const& left_mean, ImageView<float> const& left_precision,
+                   ImageView<float> const& right_mean, ImageView<float> const& right_precision) :
+      m_kernel_size_i2(kernel_size_i2), m_left_mean(left_mean), m_left_precision(left_precision),
+      m_right_mean(right_mean), m_right_precision(right_precision) {}
+
+    static CostVec pixel(CostVec l, CostVec r) { return CostLanes::mul(l, r); }
+
+    // Rows are n output pixels wide and see lanes disparities.
+    void reserve(int32 n, int32 lanes) {
+      m_lmean.resize(n);
+      m_lprec.resize(n);
+      m_rmean.resize(n + lanes);
+      m_rprec.resize(n + lanes);
+    }
+
+    // Caches the statistics of the output row starting at (x,y) and
+    // of the right pixels it is matched with, starting at (x+dx,y+dy).
+    void begin_row(int32 x, int32 y, int32 dx, int32 dy) {
+      copy_row(m_left_mean, x, y, int32(m_lmean.size()), &m_lmean[0]);
+      copy_row(m_left_precision, x, y, int32(m_lprec.size()), &m_lprec[0]);
+      copy_row(m_right_mean, x + dx, y + dy, int32(m_rmean.size()), &m_rmean[0]);
+      copy_row(m_right_precision, x + dx, y + dy, int32(m_rprec.size()), &m_rprec[0]);
+    }
+
+    // The same expression, in the same order, as NormXCorrCost::calculate().
+    CostVec cost(CostVec sum, int32 o, int32 d) const {
+      CostVec mean = CostLanes::mul(sum, CostLanes::set1(m_kernel_size_i2));
+      CostVec diff = CostLanes::sub(mean, CostLanes::mul(CostLanes::set1(m_lmean[o]),
+                                                         CostLanes::load(&m_rmean[o+d])));
+      CostVec ncc = CostLanes::mul(CostLanes::mul(CostLanes::mul(diff, diff),
+                                                  CostLanes::set1(m_lprec[o])),
+                                   CostLanes::load(&m_rprec[o+d]));
+      return CostLanes::sub(CostLanes::set1(1.0f), CostLanes::abs(ncc));
+    }
+  };
+
+  // Progress shared by the tiles of one correlation.
+  class SlidingWindowProgress {
+    Mutex m_mutex;
+    ProgressCallback const& m_progress;
+    int32 m_done, m_total;
+  public:
+    SlidingWindowProgress(ProgressCallback const& progress, int32 total) :
+      m_progress(progress), m_done(0), m_total(total) {}
+
+    void advance(int32 n) {
+      Mutex::Lock lock(m_mutex);
+      m_done += n;
+      m_progress.report_fractional_progress(m_done, m_total);
+    }
+
+    bool abort_requested() const { return m_progress.abort_requested(); }
+  };
+
+  // Scores output columns [begin,end) of bbox (in bbox coordinates)
+  // for every disparity in the search window.
+  template <class PixelCostT>
+  class SlidingWindowTile : public Task {
+    ImageView<float> const& m_left;
+    ImageView<float> const& m_right;
+    BBox2i m_bbox, m_search_window;
+    int32 m_kernel_size, m_begin, m_end;
+    PixelCostT m_cost;
+    ImageView<DisparityScore<float> >& m_scores;
+    SlidingWindowProgress& m_progress;
+
+    int32 m_lanes, m_in_cols;
+    std::vector<float> m_col_sum, m_row_sum;
+    std::vector<float> m_left_front, m_left_back, m_right_front, m_right_back;
+
+    // Copies the left row y and the right row y+dy it is matched with.
+    void load_rows(int32 y, int32 dy, std::vector<float>& left, std::vector<float>& right) {
+      int32 x = m_bbox.min().x() + m_begin - m_kernel_size/2;
+      copy_row(m_left, x, y, m_in_cols, &left[0]);
+      copy_row(m_right, x + m_search_window.min().x(), y + dy, m_in_cols + m_lanes, &right[0]);
+    }
+
+    // Adds the costs of the rows in m_left_front and m_right_front to
+    // the column sums, and subtracts those in the back buffers.
+    void update_col_sums(bool subtract) {
+      for (int32 a = 0; a < m_in_cols; a++) {
+        float* sum = &m_col_sum[a*m_lanes];
+        CostVec front_l = CostLanes::set1(m_left_front[a]);
+        CostVec back_l = CostLanes::set1(m_left_back[a]);
+        const float* front_r = &m_right_front[a];
+        const float* back_r = &m_right_back[a];
+        for (int32 d = 0; d < m_lanes; d += CostLanes::size) {
+          CostVec cost = PixelCostT::pixel(front_l, CostLanes::load(front_r + d));
+          if (subtract)
+            cost = CostLanes::sub(cost, PixelCostT::pixel(back_l, CostLanes::load(back_r + d)));
+          CostLanes::store(sum + d, CostLanes::add(CostLanes::load(sum + d), cost));
+        }
+      }
+    }
+
+    // Picks the best disparity of each output pixel of row y.
+    void score_row(int32 y, int32 dy, int32 num_disp) {
+      const int32 x = m_bbox.min().x() + m_begin;
+      m_cost.begin_row(x, y, m_search_window.min().x(), dy);
+
+      std::fill(m_row_sum.begin(), m_row_sum.end(), 0.0f);
+      float* row_sum = &m_row_sum[0];
+      for (int32 a = 0; a < m_kernel_size; a++)
+        for (int32 d = 0; d < m_lanes; d += CostLanes::size)
+          CostLanes::store(row_sum + d, CostLanes::add(CostLanes::load(row_sum + d),
+                                                       CostLanes::load(&m_col_sum[a*m_lanes + d])));
+
+      // Lanes past the last disparity are NaN so they never win.
+      float tail[CostLanes::size], index[CostLanes::size];
+      for (int32 l = 0; l < CostLanes::size; l++) {
+        uint32 bits = (m_lanes - CostLanes::size + l < num_disp) ? 0 : 0xffffffff;
+        memcpy(&tail[l], &bits, sizeof(float));
+        index[l] = float(l);
+      }
+      const CostVec tail_mask = CostLanes::load(tail);
+      const CostVec first_index = CostLanes::load(index);
+      const CostVec step = CostLanes::set1(float(CostLanes::size));
+
+      DisparityScore<float>* score = &m_scores(x, y);
+      const int32 num_out = m_end - m_begin;
+      for (int32 o = 0; o < num_out; o++) {
+        CostVec best = CostLanes::set1(ScalarTypeLimits<float>::highest());
+        CostVec worst = CostLanes::set1(ScalarTypeLimits<float>::lowest());
+        CostVec best_index = CostLanes::set1(0.0f), idx = first_index;
+        for (int32 d = 0; d < m_lanes; d += CostLanes::size) {
+          CostVec cost = m_cost.cost(CostLanes::load(row_sum + d), o, d);
+          if (d + CostLanes::size == m_lanes)
+            cost = CostLanes::bit_or(cost, tail_mask);
+          CostVec better = CostLanes::less(cost, best);
+          best = CostLanes::select(better, cost, best);
+          best_index = CostLanes::select(better, idx, best_index);
+          worst = CostLanes::select(CostLanes::greater(cost, worst), cost, worst);
+          idx = CostLanes::add(idx, step);
+        }
+
+        // Ties go to the first disparity, as in the scalar loop.
+        float lane_best[CostLanes::size], lane_index[CostLanes::size], lane_worst[CostLanes::size];
+        CostLanes::store(lane_best, best);
+        CostLanes::store(lane_index, best_index);
+        CostLanes::store(lane_worst, worst);
+        float b = lane_best[0], bi = lane_index[0], w = lane_worst[0];
+        for (int32 l = 1; l < CostLanes::size; l++) {
+          if (lane_best[l] < b || (lane_best[l] == b && lane_index[l] < bi)) {
+            b = lane_best[l];
+            bi = lane_index[l];
+          }
+          if (lane_worst[l] > w)
+            w = lane_worst[l];
+        }
+        if (b < score[o].best) {
+          score[o].best = b;
+          score[o].hdisp = m_search_window.min().x() + int32(bi);
+          score[o].vdisp = dy;
+        }
+        if (w > score[o].worst)
+          score[o].worst = w;
+
+        if (o + 1 < num_out) {
+          const float* front = &m_col_sum[(o + m_kernel_size)*m_lanes];
+          const float* back = &m_col_sum[o*m_lanes];
+          for (int32 d = 0; d < m_lanes; d += CostLanes::size)
+            CostLanes::store(row_sum + d, CostLanes::add(CostLanes::load(row_sum + d),
+                                                         CostLanes::sub(CostLanes::load(front + d),
+                                                                        CostLanes::load(back + d))));
+        }
+      }
+    }
+
+  public:
+    SlidingWindowTile(ImageView<float> const& left, ImageView<float> const& right,
+                      BBox2i const& bbox, BBox2i const& search_window, int32 kernel_size,
+                      int32 begin, int32 end, PixelCostT const& cost,
+                      ImageView<DisparityScore<float> >& scores, SlidingWindowProgress& progress) :
+      m_left(left), m_right(right), m_bbox(bbox), m_search_window(search_window),
+      m_kernel_size(kernel_size), m_begin(begin), m_end(end), m_cost(cost),
+      m_scores(scores), m_progress(progress) {}
+
+    void operator()() {
+      const int32 num_disp = m_search_window.width() + 1;
+      const int32 num_rows = m_bbox.height() - m_kernel_size;
+      m_lanes = CostLanes::size*((num_disp + CostLanes::size - 1)/CostLanes::size);
+      m_in_cols = m_end - m_begin + m_kernel_size - 1;
+      m_col_sum.resize(m_in_cols*m_lanes);
+      m_row_sum.resize(m_lanes);
+      m_left_front.resize(m_in_cols);
+      m_left_back.resize(m_in_cols);
+      m_right_front.resize(m_in_cols + m_lanes);
+      m_right_back.resize(m_in_cols + m_lanes);
+      m_cost.reserve(m_end - m_begin, m_lanes);
+
+      const int32 y0 = m_bbox.min().y();
+      const int32 half_kernel = m_kernel_size/2;
+      for (int32 dy = m_search_window.min().y(); dy <= m_search_window.max().y(); dy++) {
+        if (m_progress.abort_requested())
+          return;
+
+        // Seed the column sums with the first kernel_size rows.
+        std::fill(m_col_sum.begin(), m_col_sum.end(), 0.0f);
+        for (int32 b = 0; b < m_kernel_size; b++) {
+          load_rows(y0 + b, dy, m_left_front, m_right_front);
+          update_col_sums(false);
+        }
+
+        for (int32 j = 0; j < num_rows; j++) {
+          score_row(y0 + half_kernel + j, dy, num_disp);
+          if (j + 1 < num_rows) {
+            load_rows(y0 + j + m_kernel_size, dy, m_left_front, m_right_front);
+            load_rows(y0 + j, dy, m_left_back, m_right_back);
+            update_col_sums(true);
+          }
+        }
+        m_progress.advance(num_disp);
+      }
+    }
+  };
+
+  // Width, in output pixels, of the tiles scored by each task.
+  const int32 sliding_window_tile_size = 64;
+
+  template <class PixelCostT>
+  void run_sliding_window(PixelCostT const& cost,
+                          ImageView<float> const& left, ImageView<float> const& right,
+                          BBox2i const& bbox, int32 kernel_size, BBox2i const& search_window,
+                          ImageView<PixelMask<Vector2f> >& result,
+                          ProgressCallback const& progress) {
+    ImageView<DisparityScore<float> > scores(left.cols(), left.rows());
+
+    // The same output columns that box_filter() writes.
+    const int32 begin = kernel_size/2;
+    const int32 end = begin + bbox.width() - kernel_size;
+    int32 num_tiles = 0;
+    if (end > begin && bbox.height() > kernel_size)
+      num_tiles = (end - begin + sliding_window_tile_size - 1)/sliding_window_tile_size;
+
+    SlidingWindowProgress tile_progress(progress, num_tiles*(search_window.width() + 1)*(search_window.height() + 1));
+    std::vector<boost::shared_ptr<Task> > tiles;
+    for (int32 i = begin; i < end; i += sliding_window_tile_size)
+      tiles.push_back(boost::shared_ptr<Task>(new SlidingWindowTile<PixelCostT>(left, right, bbox, search_window,
+                                                                                kernel_size, i, std::min(i + sliding_window_tile_size, end),
+                                                                                cost, scores, tile_progress)));
+    // On a CorrelatorView worker the tiles run one after another, as
+    // the other workers are already busy with the other image tiles.
+    run_tasks(tiles);
+    progress.abort_if_requested();
+
+    result = best_disparities(scores);
+    progress.report_finished();
+  }
+}
+
 struct AbsDifferenceFunctor : BinaryReturnTemplateType<DifferenceType> {
   template <class Arg1T, class Arg2T>
   typename result<AbsDifferenceFunctor(Arg1T, Arg2T)>::type
@@ -63,6 +455,15 @@ ImageView<float> AbsDifferenceCost::calculate(int32 dx, int32 dy) {
   return this->box_filter(abs_difference(left_window, right_window));
 }
 
+bool AbsDifferenceCost::sliding_window_correlate(BBox2i const& search_window,
+                                                ImageView<PixelMask<Vector2f> >& result,
+                                                ProgressCallback const& progress) {
+  run_sliding_window(AbsDifferencePixel(m_kernel_size_i2),
+                     m_left, m_right, this->bbox(), m_kernel_size,
+                     search_window, result, progress);
+  return true;
+}
+
 
 ImageView<float> SqDifferenceCost::calculate(int32 dx, int32 dy) {
   typedef ZeroEdgeExtension EdgeT;
@@ -74,6 +475,15 @@ ImageView<float> SqDifferenceCost::calculate(int32 dx, int32 dy) {
   return this->box_filter(sq_difference(left_window, right_window));
 }
 
+bool SqDifferenceCost::sliding_window_correlate(BBox2i const& search_window,
+                                               ImageView<PixelMask<Vector2f> >& result,
+                                               ProgressCallback const& progress) {
+  run_sliding_window(SqDifferencePixel(m_kernel_size_i2),
+                     m_left, m_right, this->bbox(), m_kernel_size,
+                     search_window, result, progress);
+  return true;
+}
+
 
 ImageView<float> NormXCorrCost::calculate(int32 dx, int32 dy) {
   typedef ZeroEdgeExtension EdgeT;
@@ -95,6 +505,16 @@ ImageView<float> NormXCorrCost::calculate(int32 dx, int32 dy) {
   return 1-abs(square(this->box_filter(left_window * right_window) - left_mean_window * right_mean_window) * left_precision_window * right_precision_window );
 }
 
+bool NormXCorrCost::sliding_window_correlate(BBox2i const& search_window,
+                                            ImageView<PixelMask<Vector2f> >& result,
+                                            ProgressCallback const& progress) {
+  run_sliding_window(NormXCorrPixel(m_kernel_size_i2, m_left_mean, m_left_precision,
+                                    m_right_mean, m_right_precision),
+                     m_left, m_right, this->bbox(), m_kernel_size,
+                     search_window, result, progress);
+  return true;
+}
+
 
 // ---------------------------------------------------------------------------
 //                           CORRELATE()
@@ -103,6 +523,10 @@ ImageView<PixelMask<Vector2f> > vw::stereo::correlate(boost::shared_ptr<StereoCo
                                                       BBox2i const& search_window,
                                                       ProgressCallback const& progress) {
 
+  ImageView<PixelMask<Vector2f> > result;
+  if (cost_function->sliding_window_correlate(search_window, result, progress))
+    return result;
+
   int32 width = cost_function->cols();
   int32 height = cost_function->rows();
 
@@ -150,20 +574,7 @@ ImageView<PixelMask<Vector2f> > vw::stereo::correlate(boost::shared_ptr<StereoCo
   }
 
   // convert from the local result buffer to the return format
-  ImageView<PixelMask<Vector2f> > result(width, height);
-
-  for (int32 x = 0; x < width; x++) {
-    for (int32 y = 0; y < height; y++) {
-      if (result_buf(x, y).best == ScalarTypeLimits<float>::highest() ||
-          result_buf(x, y).best == result_buf(x, y).worst) {
-        invalidate(result(x,y));
-      } else {
-        result(x, y)[0] = result_buf(x,y).hdisp;
-        result(x, y)[1] = result_buf(x,y).vdisp;
-        validate( result(x,y) );
-      }
-    }
-  }
+  result = best_disparities(result_buf);
   progress.report_finished();
   return result;
 }
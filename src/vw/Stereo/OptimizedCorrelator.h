@@ -51,6 +51,16 @@ namespace stereo {
     int32 kernel_size() const { return m_kernel_size; }
 
     virtual ImageView<float> calculate(int32 dx, int32 dy) = 0;
+
+    // Finds the best disparity in search_window for every pixel of
+    // bbox() in one pass and returns true.  Cost functions that are a
+    // box filter of a per-pixel cost override this with the sliding
+    // window engine in OptimizedCorrelator.cc; the default returns
+    // false and correlate() calls calculate() once per disparity.
+    virtual bool sliding_window_correlate(BBox2i const& /*search_window*/,
+                                          ImageView<PixelMask<Vector2f> >& /*result*/,
+                                          ProgressCallback const& /*progress*/) { return false; }
+
     virtual int32 cols() const = 0;
     virtual int32 rows() const = 0;
     virtual int32 sample_size() const = 0; // What is the side length of
@@ -138,6 +148,9 @@ namespace stereo {
     }
 
     virtual ImageView<float> calculate(int32 dx, int32 dy);
+    virtual bool sliding_window_correlate(BBox2i const& search_window,
+                                          ImageView<PixelMask<Vector2f> >& result,
+                                          ProgressCallback const& progress);
 
     virtual int32 cols() const { return m_left.cols(); }
     virtual int32 rows() const { return m_left.rows(); }
@@ -162,6 +175,9 @@ namespace stereo {
     }
 
     virtual ImageView<float> calculate(int32 dx, int32 dy);
+    virtual bool sliding_window_correlate(BBox2i const& search_window,
+                                          ImageView<PixelMask<Vector2f> >& result,
+                                          ProgressCallback const& progress);
 
     virtual int32 cols() const { return m_left.cols(); }
     virtual int32 rows() const { return m_left.rows(); }
@@ -194,6 +210,9 @@ namespace stereo {
     }
 
     virtual ImageView<float> calculate(int32 dx, int32 dy);
+    virtual bool sliding_window_correlate(BBox2i const& search_window,
+                                          ImageView<PixelMask<Vector2f> >& result,
+                                          ProgressCallback const& progress);
 
     virtual int32 cols() const { return m_left.cols(); }
     virtual int32 rows() const { return m_left.rows(); }
@@ -0,0 +1,419 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Stereo/SemiGlobalCorrelator.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define VW_STEREO_SGM_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VW_STEREO_SGM_SIMD 1
+#else
+# define VW_STEREO_SGM_SIMD 0
+#endif
+
+using namespace vw;
+using namespace stereo;
+
+namespace {
+
+  // The cost of a disparity that a pixel may not take.  Path costs
+  // of allowed disparities stay far below it, and it leaves room in
+  // an int16 for the penalties to be added without overflowing.
+  const int16 forbidden_cost = 0x3fff;
+
+  // Tiles are split until their cost volume fits in the memory
+  // budget, but not below this size.
+  const int32 min_tile_size = 8;
+  const int32 max_tile_size = 256;
+  const int32 max_tile_margin = 32;
+
+  // A vector of path costs for consecutive disparities.
+  struct PathLanes {
+#if VW_STEREO_SGM_SIMD == 2
+    typedef __m256i type;
+    static const int32 size = 16;
+    static type load(const int16* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static type load(const uint16* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static void store(int16* p, type a) { _mm256_storeu_si256((__m256i*)p, a); }
+    static void store(uint16* p, type a) { _mm256_storeu_si256((__m256i*)p, a); }
+    static type set1(int16 a) { return _mm256_set1_epi16(a); }
+    static type adds(type a, type b) { return _mm256_adds_epi16(a, b); }
+    static type subs(type a, type b) { return _mm256_subs_epi16(a, b); }
+    static type adds_unsigned(type a, type b) { return _mm256_adds_epu16(a, b); }
+    static type min(type a, type b) { return _mm256_min_epi16(a, b); }
+#elif VW_STEREO_SGM_SIMD == 1
+    typedef __m128i type;
+    static const int32 size = 8;
+    static type load(const int16* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static type load(const uint16* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void store(int16* p, type a) { _mm_storeu_si128((__m128i*)p, a); }
+    static void store(uint16* p, type a) { _mm_storeu_si128((__m128i*)p, a); }
+    static type set1(int16 a) { return _mm_set1_epi16(a); }
+    static type adds(type a, type b) { return _mm_adds_epi16(a, b); }
+    static type subs(type a, type b) { return _mm_subs_epi16(a, b); }
+    static type adds_unsigned(type a, type b) { return _mm_adds_epu16(a, b); }
+    static type min(type a, type b) { return _mm_min_epi16(a, b); }
+#else
+    typedef int32 type;
+    static const int32 size = 1;
+    static type load(const int16* p) { return *p; }
+    static type load(const uint16* p) { return *p; }
+    static void store(int16* p, type a) { *p = int16(a); }
+    static void store(uint16* p, type a) { *p = uint16(a); }
+    static type set1(int16 a) { return a; }
+    static type clamp(type a, type lo, type hi) { return std::max(lo, std::min(a, hi)); }
+    static type adds(type a, type b) { return clamp(a + b, -32768, 32767); }
+    static type subs(type a, type b) { return clamp(a - b, -32768, 32767); }
+    static type adds_unsigned(type a, type b) { return std::min(uint16(a) + uint16(b), 65535); }
+    static type min(type a, type b) { return std::min(a, b); }
+#endif
+
+    static int16 min_lane(type a) {
+      int16 lanes[size];
+      store(lanes, a);
+      return *std::min_element(lanes, lanes + size);
+    }
+  };
+  typedef PathLanes::type PathVec;
+
+  int32 round_up(int32 n, int32 multiple) { return multiple*((n + multiple - 1)/multiple); }
+
+  // The census transform: one bit per pixel in the size by size
+  // window, other than the center, set if it is darker than the
+  // center.  Pixels outside the image are zero.
+  ImageView<uint64> census_transform(ImageView<float> const& image, int32 size) {
+    ImageView<uint64> census(image.cols(), image.rows());
+    const int32 half = size/2;
+    for (int32 y = 0; y < image.rows(); y++) {
+      for (int32 x = 0; x < image.cols(); x++) {
+        float center = image(x, y);
+        uint64 bits = 0;
+        for (int32 v = -half; v <= half; v++) {
+          for (int32 u = -half; u <= half; u++) {
+            if (u == 0 && v == 0)
+              continue;
+            int32 i = x + u, j = y + v;
+            float value = (i >= 0 && i < image.cols() && j >= 0 && j < image.rows()) ? image(i, j) : 0;
+            bits = (bits << 1) | (value < center ? 1 : 0);
+          }
+        }
+        census(x, y) = bits;
+      }
+    }
+    return census;
+  }
+
+  inline int16 census_distance(uint64 a, uint64 b) {
+#if defined(__GNUC__)
+    return int16(__builtin_popcountll(a ^ b));
+#else
+    int16 count = 0;
+    for (uint64 bits = a ^ b; bits; bits &= bits - 1)
+      count++;
+    return count;
+#endif
+  }
+
+  // An inclusive range of disparities.
+  struct LabelRange {
+    int32 x0, x1, y0, y1;
+    void grow(LabelRange const& r) {
+      x0 = std::min(x0, r.x0); x1 = std::max(x1, r.x1);
+      y0 = std::min(y0, r.y0); y1 = std::max(y1, r.y1);
+    }
+  };
+
+  struct SemiGlobalParams {
+    ImageView<uint64> left, right;
+    int16 census_bits;
+    LabelRange window;
+    float rejection_threshold;
+    ImageView<PixelMask<Vector2f> > seed;
+    int32 seed_radius;
+    int16 penalty1, penalty2;
+    size_t tile_memory;
+
+    // The disparities pixel (x,y) may take: the search window, or the
+    // part of it within seed_radius of a valid seed.
+    LabelRange labels(int32 x, int32 y) const {
+      if (seed.cols() == 0 || !is_valid(seed(x, y)))
+        return window;
+      Vector2f s = seed(x, y).child();
+      LabelRange r;
+      r.x0 = std::max(window.x0, int32(floor(s.x())) - seed_radius);
+      r.x1 = std::min(window.x1, int32(ceil(s.x())) + seed_radius);
+      r.y0 = std::max(window.y0, int32(floor(s.y())) - seed_radius);
+      r.y1 = std::min(window.y1, int32(ceil(s.y())) + seed_radius);
+      if (r.x0 > r.x1 || r.y0 > r.y1)
+        return window;
+      return r;
+    }
+  };
+
+  // One step along a path: the path costs at a pixel, given the path
+  // costs at the previous pixel on the path.  row_stride is the
+  // distance between disparities that differ by one vertically, or
+  // zero if there is only one row of them.  Returns the smallest
+  // path cost and adds the path costs to sum.
+  inline int16 path_step(const int16* prev, int16 prev_min, const int16* cost,
+                         int16* path, uint16* sum, int32 num_labels, int32 row_stride,
+                         PathVec penalty1, int32 penalty2) {
+    const PathVec base = PathLanes::set1(prev_min);
+    const PathVec jump = PathLanes::set1(int16(std::min(prev_min + penalty2, 0x7fff)));
+    PathVec lowest = PathLanes::set1(0x7fff);
+    for (int32 k = 0; k < num_labels; k += PathLanes::size) {
+      PathVec step = PathLanes::min(PathLanes::load(prev + k - 1), PathLanes::load(prev + k + 1));
+      if (row_stride)
+        step = PathLanes::min(step, PathLanes::min(PathLanes::load(prev + k - row_stride),
+                                                   PathLanes::load(prev + k + row_stride)));
+      PathVec best = PathLanes::min(PathLanes::min(PathLanes::load(prev + k),
+                                                   PathLanes::adds(step, penalty1)), jump);
+      PathVec value = PathLanes::subs(PathLanes::adds(PathLanes::load(cost + k), best), base);
+      PathLanes::store(path + k, value);
+      PathLanes::store(sum + k, PathLanes::adds_unsigned(PathLanes::load(sum + k), value));
+      lowest = PathLanes::min(lowest, value);
+    }
+    return PathLanes::min_lane(lowest);
+  }
+
+  // Matches the pixels of one tile, each worker with its own cost
+  // volume and path buffers.
+  class SemiGlobalTile : public Task {
+    SemiGlobalParams const& m_params;
+    BBox2i m_tile;
+    ImageView<PixelMask<Vector2f> >& m_result;
+
+    std::vector<int16> m_cost, m_paths, m_path_min, m_start;
+    std::vector<uint16> m_sum;
+
+    void match(BBox2i const& tile);
+
+  public:
+    SemiGlobalTile(SemiGlobalParams const& params, BBox2i const& tile,
+                   ImageView<PixelMask<Vector2f> >& result) :
+      m_params(params), m_tile(tile), m_result(result) {}
+
+    void operator()() { match(m_tile); }
+  };
+
+  void SemiGlobalTile::match(BBox2i const& tile) {
+    // The paths start in a margin around the tile.
+    const int32 margin = std::min(max_tile_margin, std::max(4, std::max(tile.width(), tile.height())/2));
+    BBox2i area = tile;
+    area.expand(margin);
+    area.crop(BBox2i(0, 0, m_params.left.cols(), m_params.left.rows()));
+    const int32 cols = area.width(), rows = area.height();
+
+    LabelRange labels = m_params.labels(area.min().x(), area.min().y());
+    for (int32 y = area.min().y(); y < area.max().y(); y++)
+      for (int32 x = area.min().x(); x < area.max().x(); x++)
+        labels.grow(m_params.labels(x, y));
+
+    // Disparities are stored a row at a time with a forbidden one
+    // between rows, so that the neighbors of every disparity are at
+    // fixed offsets.
+    const int32 label_cols = labels.x1 - labels.x0 + 1, label_rows = labels.y1 - labels.y0 + 1;
+    const int32 label_stride = label_cols + 1;
+    const int32 num_labels = round_up(label_rows*label_stride + 1, PathLanes::size);
+    const size_t num_pixels = size_t(cols)*rows;
+
+    if (num_pixels*num_labels*(sizeof(int16) + sizeof(uint16)) > m_params.tile_memory &&
+        (tile.width() > min_tile_size || tile.height() > min_tile_size)) {
+      const int32 w = tile.width() > min_tile_size ? (tile.width() + 1)/2 : tile.width();
+      const int32 h = tile.height() > min_tile_size ? (tile.height() + 1)/2 : tile.height();
+      for (int32 y = tile.min().y(); y < tile.max().y(); y += h)
+        for (int32 x = tile.min().x(); x < tile.max().x(); x += w)
+          match(BBox2i(x, y, std::min(w, tile.max().x() - x), std::min(h, tile.max().y() - y)));
+      return;
+    }
+
+    // Matching costs
+    m_cost.assign(num_pixels*num_labels, forbidden_cost);
+    for (int32 j = 0; j < rows; j++) {
+      const int32 y = area.min().y() + j;
+      for (int32 i = 0; i < cols; i++) {
+        const int32 x = area.min().x() + i;
+        const uint64 census = m_params.left(x, y);
+        const LabelRange r = m_params.labels(x, y);
+        int16* cost = &m_cost[(size_t(j)*cols + i)*num_labels];
+        for (int32 dy = r.y0; dy <= r.y1; dy++) {
+          int16* row = cost + (dy - labels.y0)*label_stride + 1 - labels.x0;
+          for (int32 dx = r.x0; dx <= r.x1; dx++) {
+            const int32 rx = x + dx, ry = y + dy;
+            row[dx] = (rx >= 0 && rx < m_params.right.cols() && ry >= 0 && ry < m_params.right.rows())
+              ? census_distance(census, m_params.right(rx, ry)) : m_params.census_bits;
+          }
+        }
+      }
+    }
+
+    // Aggregate along 8 paths.  Each path keeps its costs for two rows
+    // of pixels, with forbidden guards so that neighboring
+    // disparities can be read past the ends.
+    static const int32 directions[8][2] = { {1,0}, {-1,0}, {0,1}, {0,-1},
+                                            {1,1}, {-1,1}, {1,-1}, {-1,-1} };
+    const int32 row_stride = label_rows > 1 ? label_stride : 0;
+    const int32 guard = round_up(std::max(row_stride, 1), PathLanes::size);
+    const int32 slot = num_labels + 2*guard;
+    const PathVec penalty1 = PathLanes::set1(m_params.penalty1);
+    m_sum.assign(num_pixels*num_labels, 0);
+    m_paths.assign(2*size_t(cols)*slot, forbidden_cost);
+    m_path_min.assign(2*cols, 0);
+    m_start.assign(slot, 0);
+
+    for (int32 d = 0; d < 8; d++) {
+      const int32 rx = directions[d][0], ry = directions[d][1];
+      for (int32 n = 0; n < rows; n++) {
+        const int32 j = ry >= 0 ? n : rows - 1 - n;
+        int16* current = &m_paths[size_t(n%2)*cols*slot];
+        int16* previous = &m_paths[size_t((n+1)%2)*cols*slot];
+        int16* current_min = &m_path_min[(n%2)*cols];
+        int16* previous_min = &m_path_min[((n+1)%2)*cols];
+        for (int32 m = 0; m < cols; m++) {
+          const int32 i = rx >= 0 ? m : cols - 1 - m;
+          const int32 pi = i - rx, pj = j - ry;
+          const int16* prev = &m_start[guard];
+          int16 prev_min = 0;
+          if (pi >= 0 && pi < cols && pj >= 0 && pj < rows) {
+            if (ry == 0) {
+              prev = current + pi*slot + guard;
+              prev_min = current_min[pi];
+            } else {
+              prev = previous + pi*slot + guard;
+              prev_min = previous_min[pi];
+            }
+          }
+          const size_t p = size_t(j)*cols + i;
+          current_min[i] = path_step(prev, prev_min, &m_cost[p*num_labels], current + i*slot + guard,
+                                     &m_sum[p*num_labels], num_labels, row_stride,
+                                     penalty1, m_params.penalty2);
+        }
+      }
+    }
+
+    // Pick the disparity with the lowest total cost.  Ties go to the
+    // first one, as in the other correlators.  It must be clearly
+    // better than every disparity that is not its neighbor.
+    for (int32 y = tile.min().y(); y < tile.max().y(); y++) {
+      for (int32 x = tile.min().x(); x < tile.max().x(); x++) {
+        const uint16* sum = &m_sum[(size_t(y - area.min().y())*cols + (x - area.min().x()))*num_labels];
+        uint16 best = forbidden_cost;
+        int32 best_dx = 0, best_dy = 0;
+        for (int32 dy = 0; dy < label_rows; dy++) {
+          const uint16* row = sum + dy*label_stride + 1;
+          for (int32 dx = 0; dx < label_cols; dx++) {
+            if (row[dx] < best) {
+              best = row[dx];
+              best_dx = dx;
+              best_dy = dy;
+            }
+          }
+        }
+
+        bool unique = best < forbidden_cost;
+        if (unique && m_params.rejection_threshold > 1.0) {
+          const float limit = best*m_params.rejection_threshold;
+          for (int32 dy = 0; dy < label_rows && unique; dy++) {
+            const uint16* row = sum + dy*label_stride + 1;
+            for (int32 dx = 0; dx < label_cols; dx++) {
+              if ((std::abs(dx - best_dx) > 1 || std::abs(dy - best_dy) > 1) && row[dx] < limit) {
+                unique = false;
+                break;
+              }
+            }
+          }
+        }
+
+        PixelMask<Vector2f>& result = m_result(x, y);
+        if (unique) {
+          result[0] = labels.x0 + best_dx;
+          result[1] = labels.y0 + best_dy;
+          validate(result);
+        } else {
+          invalidate(result);
+        }
+      }
+    }
+  }
+}
+
+ImageView<PixelMask<Vector2f> >
+vw::stereo::semi_global_match( ImageView<float> const& left, ImageView<float> const& right,
+                               BBox2i const& search_window, int32 kernel_size,
+                               float corrscore_rejection_threshold,
+                               int32 penalty1, int32 penalty2,
+                               ImageView<PixelMask<Vector2f> > const& seed, int32 seed_radius,
+                               size_t tile_memory ) {
+  VW_ASSERT( left.cols() == right.cols() && left.rows() == right.rows(),
+             ArgumentErr() << "semi_global_match: the image dimensions do not agree." );
+  VW_ASSERT( seed.cols() == 0 || ( seed.cols() == left.cols() && seed.rows() == left.rows() ),
+             ArgumentErr() << "semi_global_match: the seed and image dimensions do not agree." );
+  VW_ASSERT( penalty1 >= 0 && penalty2 >= penalty1 && penalty2 < 1024,
+             ArgumentErr() << "semi_global_match: the penalties must satisfy 0 <= penalty1 <= penalty2 < 1024." );
+
+  // Census windows up to 7x7 fit in 64 bits.
+  int32 census_size = std::max(3, std::min(kernel_size, 7));
+  if (census_size % 2 == 0)
+    census_size--;
+
+  SemiGlobalParams params;
+  params.left = census_transform(left, census_size);
+  params.right = census_transform(right, census_size);
+  params.census_bits = int16(census_size*census_size - 1);
+  params.window.x0 = search_window.min().x();
+  params.window.x1 = search_window.max().x();
+  params.window.y0 = search_window.min().y();
+  params.window.y1 = search_window.max().y();
+  params.rejection_threshold = corrscore_rejection_threshold;
+  params.seed = seed;
+  params.seed_radius = seed_radius;
+  params.penalty1 = int16(penalty1);
+  params.penalty2 = int16(penalty2);
+  params.tile_memory = tile_memory;
+
+  ImageView<PixelMask<Vector2f> > result(left.cols(), left.rows());
+  std::vector<boost::shared_ptr<Task> > tiles;
+  for (int32 y = 0; y < left.rows(); y += max_tile_size)
+    for (int32 x = 0; x < left.cols(); x += max_tile_size)
+      tiles.push_back(boost::shared_ptr<Task>(new SemiGlobalTile(params, BBox2i(x, y, std::min(max_tile_size, left.cols() - x),
+                                                                                        std::min(max_tile_size, left.rows() - y)),
+                                                                 result)));
+  // On a CorrelatorView worker the tiles run one after another, as
+  // the other workers are already busy with the other image tiles.
+  run_tasks(tiles);
+  return result;
+}
+
+ImageView<PixelMask<Vector2f> > SemiGlobalCorrelator::reverse_seed() const {
+  ImageView<PixelMask<Vector2f> > result;
+  if (m_seed.cols() == 0)
+    return result;
+
+  // Each seed points from a left pixel to a right pixel, where the
+  // reverse search should look back the same distance.
+  result.set_size(m_seed.cols(), m_seed.rows());
+  for (int32 y = 0; y < m_seed.rows(); y++) {
+    for (int32 x = 0; x < m_seed.cols(); x++) {
+      if (!is_valid(m_seed(x, y)))
+        continue;
+      Vector2f disparity = m_seed(x, y).child();
+      int32 rx = x + int32(floor(disparity.x() + 0.5));
+      int32 ry = y + int32(floor(disparity.y() + 0.5));
+      if (rx >= 0 && rx < result.cols() && ry >= 0 && ry < result.rows())
+        result(rx, ry) = PixelMask<Vector2f>(-disparity);
+    }
+  }
+  return result;
+}
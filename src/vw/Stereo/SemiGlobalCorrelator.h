@@ -0,0 +1,129 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file SemiGlobalCorrelator.h
+///
+/// Semi-global matching (Hirschmuller, 2008).  Each pixel is matched
+/// by the census transform of its neighborhood, and the matching
+/// costs are aggregated along 8 straight paths through the image,
+/// with a small penalty for disparity changes of one pixel and a
+/// larger one for bigger jumps.  The image is processed in
+/// overlapping tiles that are small enough that the cost volume of a
+/// tile fits in a fixed memory budget, so the cost volume of the
+/// whole image is never held in memory.
+///
+/// The search at each pixel can be narrowed to a few pixels around a
+/// seed disparity, e.g. from a PyramidCorrelator run at a lower
+/// resolution, which is what CorrelatorView does for
+/// SGM_CORRELATOR.
+///
+#ifndef __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
+#define __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/PixelMask.h>
+#include <vw/Math/BBox.h>
+#include <vw/Stereo/Correlate.h>
+
+namespace vw {
+namespace stereo {
+
+  /// Finds the disparity in search_window (inclusive, as with
+  /// OptimizedCorrelator) of every pixel in left by semi-global
+  /// matching with right.  The census window is kernel_size wide, up
+  /// to 7 pixels.  Pixels are invalid unless the cost of every
+  /// disparity more than one pixel away from the best one is at least
+  /// corrscore_rejection_threshold times the best cost (1.0 is off).
+  /// penalty1 and penalty2 are the costs, in census bits, of
+  /// disparity changes of one pixel and of more than one pixel along
+  /// a path.  If seed is not empty it must be the size of left, and
+  /// pixels with a valid seed only search within seed_radius of it.
+  /// Each tile's cost volume is kept under tile_memory bytes when
+  /// possible.
+  ImageView<PixelMask<Vector2f> >
+  semi_global_match( ImageView<float> const& left, ImageView<float> const& right,
+                     BBox2i const& search_window, int32 kernel_size,
+                     float corrscore_rejection_threshold,
+                     int32 penalty1, int32 penalty2,
+                     ImageView<PixelMask<Vector2f> > const& seed, int32 seed_radius,
+                     size_t tile_memory );
+
+  /// A semi-global matching correlator with the same interface as
+  /// OptimizedCorrelator.  The left to right and right to left
+  /// disparity maps are cross checked.
+  class SemiGlobalCorrelator {
+    BBox2i m_search_window;
+    int32 m_kern_size;
+    float m_cross_correlation_threshold;
+    float m_corrscore_rejection_threshold;
+    int32 m_penalty1, m_penalty2;
+    ImageView<PixelMask<Vector2f> > m_seed;
+    int32 m_seed_radius;
+    size_t m_tile_memory;
+
+  public:
+    SemiGlobalCorrelator( BBox2i const& search_window,
+                          int32 kernel_size,
+                          float cross_correlation_threshold,
+                          float corrscore_rejection_threshold = 1.0,
+                          int32 penalty1 = 8,
+                          int32 penalty2 = 32 ) :
+      m_search_window(search_window), m_kern_size(kernel_size),
+      m_cross_correlation_threshold(cross_correlation_threshold),
+      m_corrscore_rejection_threshold(corrscore_rejection_threshold),
+      m_penalty1(penalty1), m_penalty2(penalty2),
+      m_seed_radius(0), m_tile_memory(32*1024*1024) {}
+
+    /// Only search within radius of the disparity in seed at pixels
+    /// where it is valid.  The seed must be the size of the images.
+    void set_seed( ImageView<PixelMask<Vector2f> > const& seed, int32 radius ) {
+      m_seed = seed;
+      m_seed_radius = radius;
+    }
+
+    /// Bound the memory used by the cost volume of each tile.
+    void set_tile_memory( size_t bytes ) { m_tile_memory = bytes; }
+
+    template <class ViewT, class PreProcFilterT>
+    ImageView<PixelMask<Vector2f> > operator()( ImageViewBase<ViewT> const& image0,
+                                                ImageViewBase<ViewT> const& image1,
+                                                PreProcFilterT const& preproc_filter ) {
+      if ( image0.impl().cols() != image1.impl().cols() ||
+           image0.impl().rows() != image1.impl().rows() )
+        vw_throw( ArgumentErr() << "Primary and secondary image dimensions do not agree!" );
+      if ( m_seed.cols() != 0 &&
+           ( m_seed.cols() != image0.impl().cols() || m_seed.rows() != image0.impl().rows() ) )
+        vw_throw( ArgumentErr() << "SemiGlobalCorrelator: the seed and image dimensions do not agree!" );
+
+      ImageView<float> left_image = pixel_cast<float>( preproc_filter(image0) );
+      ImageView<float> right_image = pixel_cast<float>( preproc_filter(image1) );
+
+      BBox2i r2l_window( -m_search_window.max().x(), -m_search_window.max().y(),
+                         m_search_window.width(), m_search_window.height() );
+
+      ImageView<PixelMask<Vector2f> > result_l2r =
+        semi_global_match( left_image, right_image, m_search_window, m_kern_size,
+                           m_corrscore_rejection_threshold, m_penalty1, m_penalty2,
+                           m_seed, m_seed_radius, m_tile_memory );
+      ImageView<PixelMask<Vector2f> > result_r2l =
+        semi_global_match( right_image, left_image, r2l_window, m_kern_size,
+                           m_corrscore_rejection_threshold, m_penalty1, m_penalty2,
+                           reverse_seed(), m_seed_radius, m_tile_memory );
+
+      cross_corr_consistency_check( result_l2r, result_r2l, m_cross_correlation_threshold, false );
+      return result_l2r;
+    }
+
+  private:
+    // The seed for the right to left search.
+    ImageView<PixelMask<Vector2f> > reverse_seed() const;
+  };
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
@@ -10,6 +10,8 @@
 
 #include <vw/Image/UtilityViews.h>
 #include <vw/Stereo/CorrelatorView.h>
+#include <vw/Stereo/OptimizedCorrelator.h>
+#include <vw/Stereo/SemiGlobalCorrelator.h>
 #include <vw/Image/Transform.h>
 
 #include <boost/random/linear_congruential.hpp>
@@ -143,3 +145,142 @@ TEST_F( BasicCorrelationTest, BlurPreprocess ) {
                stereo::NORM_XCORR_CORRELATOR );
   check_error( disparity_map, 0.79 );
 }
+
+TEST_F( BasicCorrelationTest, SemiGlobalMatching ) {
+  // Semi-global matching finds a disparity for every pixel, even
+  // where the match is off the image, so it relies on a strict left
+  // to right check to reject those.
+  CorrelatorView<uint8,PixelMask<uint8>,NullStereoPreprocessingFilter>
+    corr( image1, image2, mask, mask, NullStereoPreprocessingFilter(), false );
+  corr.set_search_range( BBox2i(0,0,6,6) );
+  corr.set_kernel_size( Vector2i(7,7) );
+  corr.set_correlator_options( 1, stereo::SGM_CORRELATOR );
+  corr.set_cross_corr_threshold( 1 );
+  ImageView<PixelMask<Vector2f> > disparity_map = corr;
+  check_error( disparity_map, 0.95 );
+
+  CorrelatorView<uint8,PixelMask<uint8>,SlogStereoPreprocessingFilter>
+    slog_corr( image1, image2, mask, mask, SlogStereoPreprocessingFilter(), false );
+  slog_corr.set_search_range( BBox2i(0,0,6,6) );
+  slog_corr.set_kernel_size( Vector2i(7,7) );
+  slog_corr.set_correlator_options( 1, stereo::SGM_CORRELATOR );
+  slog_corr.set_cross_corr_threshold( 1 );
+  disparity_map = slog_corr;
+  check_error( disparity_map, 0.95 );
+}
+
+// Hides the sliding window engine of a cost function, so that
+// correlate() scores it one disparity at a time with calculate().
+class CalculateOnlyCost : public StereoCostFunction {
+  boost::shared_ptr<StereoCostFunction> m_cost;
+public:
+  CalculateOnlyCost( boost::shared_ptr<StereoCostFunction> cost,
+                     BBox2i const& search_window ) :
+    StereoCostFunction( cost->cols(), cost->rows(), search_window, cost->kernel_size() ),
+    m_cost( cost ) {}
+
+  virtual ImageView<float> calculate( int32 dx, int32 dy ) { return m_cost->calculate( dx, dy ); }
+  virtual int32 cols() const { return m_cost->cols(); }
+  virtual int32 rows() const { return m_cost->rows(); }
+  virtual int32 sample_size() const { return m_cost->sample_size(); }
+};
+
+TEST( OptimizedCorrelator, SlidingWindowMatchesCalculate ) {
+  boost::rand48 gen(10);
+  ImageView<float> left = 255*uniform_noise_view( gen, 150, 40 );
+  ImageView<float> right = transform( left, TranslateTransform(-5,2),
+                                      ZeroEdgeExtension(), BilinearInterpolation() );
+
+  // Normalized cross correlation needs windows that include zero.
+  BBox2i windows[] = { BBox2i(-8,0,8,3), BBox2i(0,-3,4,3), BBox2i(-9,1,5,2) };
+  for ( int w = 0; w < 3; ++w ) {
+    for ( int type = 0; type < 3; ++type ) {
+      if ( type == NORM_XCORR_CORRELATOR && w == 2 )
+        continue;
+      boost::shared_ptr<StereoCostFunction> cost;
+      if ( type == ABS_DIFF_CORRELATOR )
+        cost.reset( new AbsDifferenceCost( left, right, windows[w], 7 ) );
+      else if ( type == SQR_DIFF_CORRELATOR )
+        cost.reset( new SqDifferenceCost( left, right, windows[w], 7 ) );
+      else
+        cost.reset( new NormXCorrCost( left, right, windows[w], 7 ) );
+      boost::shared_ptr<StereoCostFunction> reference( new CalculateOnlyCost( cost, windows[w] ) );
+
+      ImageView<PixelMask<Vector2f> > fast = stereo::correlate( cost, windows[w] );
+      ImageView<PixelMask<Vector2f> > slow = stereo::correlate( reference, windows[w] );
+      ASSERT_EQ( slow.cols(), fast.cols() );
+      ASSERT_EQ( slow.rows(), fast.rows() );
+      int count_valid = 0;
+      for ( int j = 0; j < slow.rows(); ++j )
+        for ( int i = 0; i < slow.cols(); ++i ) {
+          ASSERT_EQ( is_valid( slow(i,j) ), is_valid( fast(i,j) ) ) << i << " " << j << " " << type;
+          if ( is_valid( slow(i,j) ) ) {
+            count_valid++;
+            EXPECT_EQ( slow(i,j).child(), fast(i,j).child() ) << i << " " << j << " " << type;
+          }
+        }
+      EXPECT_GT( count_valid, 0 );
+    }
+  }
+}
+
+TEST( SemiGlobalCorrelator, SeedsAndTiles ) {
+  boost::rand48 gen(10);
+  ImageView<float> left = 255*uniform_noise_view( gen, 120, 80 );
+  ImageView<float> right = transform( left, TranslateTransform(4,1),
+                                      ZeroEdgeExtension(), NearestPixelInterpolation() );
+  BBox2i search( -6, -3, 12, 6 );
+
+  // A seed near the right answer, with some holes in it.
+  ImageView<PixelMask<Vector2f> > seed( left.cols(), left.rows() );
+  for ( int j = 0; j < seed.rows(); ++j )
+    for ( int i = 0; i < seed.cols(); ++i )
+      if ( (i + j) % 7 != 0 )
+        seed(i,j) = PixelMask<Vector2f>( Vector2f(3.5,1.5) );
+
+  ImageView<PixelMask<Vector2f> > empty;
+  size_t budgets[] = { 64*1024*1024, 64*1024 };
+  for ( int s = 0; s < 2; ++s ) {
+    for ( int b = 0; b < 2; ++b ) {
+      ImageView<PixelMask<Vector2f> > disparity =
+        semi_global_match( left, right, search, 7, 1.0, 8, 32, s ? seed : empty, 2, budgets[b] );
+      int count_correct = 0, count_total = 0;
+      for ( int j = 8; j < disparity.rows() - 8; ++j )
+        for ( int i = 8; i < disparity.cols() - 8; ++i ) {
+          count_total++;
+          if ( is_valid( disparity(i,j) ) && disparity(i,j).child() == Vector2f(4,1) )
+            count_correct++;
+        }
+      EXPECT_GT( float(count_correct)/float(count_total), 0.98 ) << s << " " << b;
+    }
+  }
+}
+
+TEST( SemiGlobalCorrelator, PyramidSeededView ) {
+  // A CorrelatorView seeds semi-global matching with a pyramid
+  // correlation at half resolution, and runs it on several tiles at
+  // once.
+  boost::rand48 gen(10);
+  ImageView<uint8> left = 255*uniform_noise_view( gen, 160, 160 );
+  ImageView<uint8> right = transform( left, TranslateTransform(3,3),
+                                      ZeroEdgeExtension(), NearestPixelInterpolation() );
+  ImageView<PixelMask<uint8> > mask( left.cols(), left.rows() );
+  fill( mask, PixelMask<uint8>(255) );
+
+  CorrelatorView<uint8,PixelMask<uint8>,NullStereoPreprocessingFilter>
+    corr( left, right, mask, mask, NullStereoPreprocessingFilter(), true );
+  corr.set_search_range( BBox2i(0,0,8,8) );
+  corr.set_kernel_size( Vector2i(7,7) );
+  corr.set_correlator_options( 1, stereo::SGM_CORRELATOR );
+  corr.set_cross_corr_threshold( 1 );
+  ImageView<PixelMask<Vector2f> > disparity = block_rasterize( corr, Vector2i(64,64), 4 );
+
+  int count_correct = 0, count_total = 0;
+  for ( int j = 8; j < disparity.rows() - 8; ++j )
+    for ( int i = 8; i < disparity.cols() - 8; ++i ) {
+      count_total++;
+      if ( is_valid( disparity(i,j) ) && disparity(i,j).child() == Vector2f(3,3) )
+        count_correct++;
+    }
+  EXPECT_GT( float(count_correct)/float(count_total), 0.95 );
+}
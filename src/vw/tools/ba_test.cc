@@ -149,7 +149,8 @@ enum BundleAdjustmentT {
     ROBUST_REF,
     ROBUST_SPARSE,
     SPARSE_HUBER,
-    SPARSE_CAUCHY
+    SPARSE_CAUCHY,
+    BLOCK_SPARSE
 };
 
 struct ProgramOptions {
@@ -196,6 +197,8 @@ std::ostream& operator<<(std::ostream& ostr, const ProgramOptions& o) {
       ostr << "Robust Reference"; break;
     case ROBUST_SPARSE:
       ostr << "Robust Sparse"; break;
+    case BLOCK_SPARSE:
+      ostr << "Block Sparse"; break;
     default:
       ostr << "unrecognized type";
   }
@@ -229,6 +232,7 @@ BundleAdjustmentT string_to_ba_type(std::string &s) {
   else if (s == "sparse_cauchy") t = SPARSE_CAUCHY;
   else if (s == "robust_ref") t = ROBUST_REF;
   else if (s == "robust_sparse") t = ROBUST_SPARSE;
+  else if (s == "block_sparse") t = BLOCK_SPARSE;
   return t;
 }
 /* }}} */
@@ -249,6 +253,8 @@ std::string ba_type_to_string(BundleAdjustmentT t) {
       s = "robust_ref"; break;
     case ROBUST_SPARSE:
       s = "robust_sparse"; break;
+    case BLOCK_SPARSE:
+      s = "block_sparse"; break;
   }
   return s;
 }
@@ -282,7 +288,7 @@ ProgramOptions parse_options(int argc, char* argv[]) {
   ba_options.add_options()
     ("bundle-adjustment-type,b",
         po::value<std::string>(&ba_type)->default_value("ref"),
-        "Select bundle adjustment type (options are: \"ref\", \"sparse\", \"sparse_huber\", \"sparse_cauchy\", \"robust_ref\", \"robust_sparse\" )")
+        "Select bundle adjustment type (options are: \"ref\", \"sparse\", \"sparse_huber\", \"sparse_cauchy\", \"robust_ref\", \"robust_sparse\", \"block_sparse\" )")
     ("cnet,c",
         po::value<fs::path>(&opts.cnet_file),
         "Load a control network from a file")
@@ -486,6 +492,11 @@ boost::shared_ptr<ControlNetwork> load_control_network(fs::path const &file) {
     vw_out(VerboseDebugMessage) << "\tReading VisionWorkbench binary control network file"
       << endl;
     cnet->read_binary( file.string() );
+  } else if ( fs::extension(file) == ".ccnet" ) {
+    // A VW compact control network
+    vw_out(VerboseDebugMessage) << "\tReading VisionWorkbench compact control network file"
+      << endl;
+    CompactControlNetwork( file.string() ).expand( *cnet );
   } else {
     vw_throw( IOErr() << "Unknown control network file extension, \""
       << fs::extension(file) << "\"." );
@@ -550,6 +561,7 @@ class BundleAdjustmentModel : public ba::ModelBase<BundleAdjustmentModel, 6, 3>
 
   CameraVector m_cameras;
   boost::shared_ptr<ControlNetwork> m_network;
+  boost::shared_ptr<CompactControlNetwork> m_compact_network;
 
   // TODO: Should BA model track ground truth points as well? Need to track
   // which points get removed by the outlier-removal process so that the final
@@ -617,6 +629,33 @@ public:
       b[i]         = point_vector_t((*m_network)[i].position());
     }
   }
+
+  // Reads the measures from a compact network, which is only expanded
+  // if something asks for control_network().
+  BundleAdjustmentModel(CameraVector const& cameras,
+                        boost::shared_ptr<CompactControlNetwork> network,
+                        double const camera_position_sigma,
+                        double const camera_pose_sigma,
+                        double const gcp_sigma) :
+    m_cameras(cameras),
+    m_compact_network(network),
+    a(cameras.size()),
+    b(network->num_points()),
+    a_target(cameras.size()),
+    b_target(network->num_points()),
+    m_num_pixel_observations(network->num_measures()),
+    m_camera_position_sigma(camera_position_sigma),
+    m_camera_pose_sigma(camera_pose_sigma),
+    m_gcp_sigma(gcp_sigma)
+  {
+    VW_ASSERT(network->num_cameras() <= cameras.size(), ArgumentErr()
+        << "Invalid control network: has more cameras than the camera vector");
+
+    for (unsigned i = 0; i < network->num_points(); ++i) {
+      b_target[i] = network->point_position(i);
+      b[i]        = network->point_position(i);
+    }
+  }
 /* }}} */
 
 /* {{{ camera, point and pixel accessors */
@@ -638,11 +677,21 @@ public:
 /* {{{ control network accessors */
   // Give access to the control network
   boost::shared_ptr<ControlNetwork> control_network(void) {
+    if (!m_network && m_compact_network) {
+      m_network.reset(new ControlNetwork("Control network"));
+      m_compact_network->expand(*m_network);
+    }
     return m_network;
   }
 
   void control_network(boost::shared_ptr<ControlNetwork> cnet) {
     m_network = cnet;
+    m_compact_network.reset();
+  }
+
+  // The compact network the model was made from, if any
+  boost::shared_ptr<CompactControlNetwork> compact_network(void) {
+    return m_compact_network;
   }
 /* }}} */
 
@@ -718,6 +767,16 @@ public:
   // Errors on the image plane
   void image_errors( std::vector<double>& pix_errors ) {
     pix_errors.clear();
+    if (m_compact_network) {
+      CompactControlNetwork const& cnet = *m_compact_network;
+      for (unsigned i = 0; i < cnet.num_points(); ++i)
+        for (size_t m = cnet.point_begin(i); m < cnet.point_end(i); ++m) {
+          int camera_idx = cnet.camera(m);
+          Vector2 pixel_error = cnet.position(m) - (*this)(i, camera_idx, a[camera_idx],b[i]);
+          pix_errors.push_back(norm_2(pixel_error));
+        }
+      return;
+    }
     for (unsigned i = 0; i < m_network->size(); ++i)
       for(unsigned m = 0; m < (*m_network)[i].size(); ++m) {
         int camera_idx = (*m_network)[i][m].image_id();
@@ -759,7 +818,9 @@ public:
   void gcp_errors( std::vector<double>& gcp_errors ) {
     gcp_errors.clear();
     for (unsigned i=0; i < this->num_points(); ++i) {
-      if ((*m_network)[i].type() == ControlPoint::GroundControlPoint)
+      ControlPoint::ControlPointType type = m_compact_network ?
+        m_compact_network->point_type(i) : (*m_network)[i].type();
+      if (type == ControlPoint::GroundControlPoint)
         gcp_errors.push_back(norm_2(b_target[i] - b[i]));
     }
   }
@@ -912,12 +973,41 @@ void run_bundle_adjustment(AdjusterT &adjuster,
 }
 /* }}} */
 
+/* {{{ AdjusterMaker */
+// Makes the adjuster for a model.  The block sparse adjuster reads the
+// measures straight from the model's compact network, when it has one,
+// and runs on all of the default threads, since the model only reads
+// its parameters and cameras.
+template <class AdjusterT>
+struct AdjusterMaker {
+  template <class CostT>
+  static AdjusterT* make(BundleAdjustmentModel &ba_model, CostT const &cost_func) {
+    return new AdjusterT(ba_model, cost_func);
+  }
+};
+
+template <class CostT>
+struct AdjusterMaker<AdjustBlockSparse<BundleAdjustmentModel, CostT> > {
+  typedef AdjustBlockSparse<BundleAdjustmentModel, CostT> AdjusterT;
+  static AdjusterT* make(BundleAdjustmentModel &ba_model, CostT const &cost_func) {
+    AdjusterT *adjuster;
+    if (ba_model.compact_network())
+      adjuster = new AdjusterT(ba_model, *ba_model.compact_network(), cost_func);
+    else
+      adjuster = new AdjusterT(ba_model, cost_func);
+    adjuster->set_threads(vw_settings().default_num_threads());
+    return adjuster;
+  }
+};
+/* }}} AdjusterMaker */
+
 /* {{{ adjust_bundles */
 template <class AdjusterT, class CostT>
 void adjust_bundles(BundleAdjustmentModel &ba_model, CostT const &cost_func,
         ProgramOptions const &config, std::string ba_type_str)
 {
-  AdjusterT bundle_adjuster(ba_model, cost_func);
+  boost::scoped_ptr<AdjusterT> adjuster(AdjusterMaker<AdjusterT>::make(ba_model, cost_func));
+  AdjusterT &bundle_adjuster = *adjuster;
   vw_out(DebugMessage) << "Running bundle adjustment" << endl;
 
   fs::path results_dir = config.results_dir;
@@ -1003,12 +1093,21 @@ int main(int argc, char* argv[]) {
   fs::path wp_file_final    = results_dir / "wp_final.txt";
 
   fs::path cnet_file        = config.data_dir / config.cnet_file;
-  boost::shared_ptr<ControlNetwork> cnet = load_control_network(cnet_file);
-
   CameraVector camera_models = load_camera_models(config.camera_files, config.data_dir);
 
-  BundleAdjustmentModel ba_model(camera_models, cnet,
-      config.camera_position_sigma, config.camera_pose_sigma, config.gcp_sigma);
+  // A compact network is kept as it is, rather than expanded.
+  boost::scoped_ptr<BundleAdjustmentModel> model;
+  if (fs::extension(cnet_file) == ".ccnet") {
+    vw_out(DebugMessage) << "Loading compact control network from file: " << cnet_file << endl;
+    boost::shared_ptr<CompactControlNetwork> cnet(new CompactControlNetwork(cnet_file.string()));
+    model.reset(new BundleAdjustmentModel(camera_models, cnet,
+        config.camera_position_sigma, config.camera_pose_sigma, config.gcp_sigma));
+  } else {
+    boost::shared_ptr<ControlNetwork> cnet = load_control_network(cnet_file);
+    model.reset(new BundleAdjustmentModel(camera_models, cnet,
+        config.camera_position_sigma, config.camera_pose_sigma, config.gcp_sigma));
+  }
+  BundleAdjustmentModel &ba_model = *model;
 
   // Write initial camera parameters and world points
   ba_model.write_camera_params(cam_file_initial);
@@ -1040,6 +1139,10 @@ int main(int argc, char* argv[]) {
       adjust_bundles<AdjustRobustSparse<BundleAdjustmentModel, L2Error>, L2Error >
         (ba_model, L2Error(), config, "Robust Sparse");
       break;
+    case BLOCK_SPARSE:
+      adjust_bundles<AdjustBlockSparse<BundleAdjustmentModel, L2Error>, L2Error >
+        (ba_model, L2Error(), config, "Block Sparse");
+      break;
   }
 
   // Do covariance calculation:
@@ -23,12 +23,40 @@ namespace fs = boost::filesystem;
 #include <vw/FileIO.h>
 #include <vw/InterestPoint/InterestData.h>
 #include <vw/Stereo/OptimizedCorrelator.h>
+#include <vw/Stereo/SemiGlobalCorrelator.h>
 #include <vw/Stereo/ReferenceCorrelator.h>
 #include <vw/Stereo/PyramidCorrelator.h>
 
 using namespace vw;
 using namespace vw::stereo;
 
+// Semi-global matching, optionally narrowed at each pixel to the
+// neighborhood of the disparity found by a pyramid correlation of the
+// images at half resolution, as CorrelatorView does.
+template <class PreProcFilterT>
+ImageView<PixelMask<Vector2f> >
+sgm_correlate( ImageViewRef<PixelGray<float> > const& left, ImageViewRef<PixelGray<float> > const& right,
+               ImageViewRef<uint8> const& left_mask, ImageViewRef<uint8> const& right_mask,
+               BBox2i const& search_range, Vector2i const& kernel_size, int lrthresh,
+               float corrscore_thresh, int cost_blur, bool use_pyramid,
+               PreProcFilterT const& filter ) {
+  SemiGlobalCorrelator correlator( search_range, kernel_size.x(), lrthresh, corrscore_thresh );
+  if ( use_pyramid ) {
+    PyramidCorrelator seeder( BBox2( Vector2(search_range.min())/2.0, Vector2(search_range.max())/2.0 ),
+                              kernel_size, lrthresh, corrscore_thresh, cost_blur,
+                              ABS_DIFF_CORRELATOR, 3 );
+    ImageView<PixelGray<float> > half_left = subsample(gaussian_filter(left,1.2),2);
+    ImageView<PixelGray<float> > half_right = subsample(gaussian_filter(right,1.2),2);
+    ImageView<uint8> half_left_mask = subsample(left_mask,2);
+    ImageView<uint8> half_right_mask = subsample(right_mask,2);
+    ImageView<PixelMask<Vector2f> > seed =
+      disparity_upsample(seeder( half_left, half_right, half_left_mask, half_right_mask, filter ));
+    correlator.set_seed(crop(edge_extend(seed, ZeroEdgeExtension()), 0, 0,
+                             left.cols(), left.rows()), 2);
+  }
+  return correlator( left, right, filter );
+}
+
 int main( int argc, char *argv[] ) {
   try {
 
@@ -60,7 +88,7 @@ int main( int argc, char *argv[] ) {
       ("lrthresh", po::value(&lrthresh)->default_value(2), "Left/right correspondence threshold")
       ("csthresh", po::value(&corrscore_thresh)->default_value(1.0), "Correlation score rejection threshold (1.0 is Off <--> 2.0 is Aggressive outlier rejection")
       ("cost-blur", po::value(&cost_blur)->default_value(1), "Kernel size for bluring the cost image")
-      ("correlator-type", po::value(&correlator_type)->default_value(0), "0 - Abs difference; 1 - Sq Difference; 2 - NormXCorr")
+      ("correlator-type", po::value(&correlator_type)->default_value(0), "0 - Abs difference; 1 - Sq Difference; 2 - NormXCorr; 3 - Semi-global matching")
       ("hsubpix", "Enable horizontal sub-pixel correlation")
       ("vsubpix", "Enable vertical sub-pixel correlation")
       ("affine-subpix", "Enable affine adaptive sub-pixel correlation (slower, but more accurate)")
@@ -128,6 +156,8 @@ int main( int argc, char *argv[] ) {
       corr_type = SQR_DIFF_CORRELATOR;
     else if (correlator_type == 2)
       corr_type = NORM_XCORR_CORRELATOR;
+    else if (correlator_type == 3)
+      corr_type = SGM_CORRELATOR;
 
     ImageView<PixelMask<Vector2f> > disparity_map;
     if (vm.count("reference")) {
@@ -142,6 +172,24 @@ int main( int argc, char *argv[] ) {
         disparity_map = correlator( left, right, stereo::LogStereoPreprocessingFilter(log));
       else
         disparity_map = correlator( left, right, stereo::SlogStereoPreprocessingFilter(slog));
+    } else if (corr_type == SGM_CORRELATOR) {
+      // With --pyramid, the search is seeded from a pyramid
+      // correlation rather than run by the PyramidCorrelator, which
+      // has no semi-global mode.
+      BBox2i search_range( Vector2i(h_corr_min, v_corr_min), Vector2i(h_corr_max, v_corr_max) );
+      {
+        vw::Timer corr_timer("Correlation Time");
+        if (log > 0)
+          disparity_map = sgm_correlate( left, right, left_mask, right_mask, search_range,
+                                         Vector2i(xkernel, ykernel), lrthresh, corrscore_thresh,
+                                         cost_blur, vm.count("pyramid") > 0,
+                                         stereo::LogStereoPreprocessingFilter(log) );
+        else
+          disparity_map = sgm_correlate( left, right, left_mask, right_mask, search_range,
+                                         Vector2i(xkernel, ykernel), lrthresh, corrscore_thresh,
+                                         cost_blur, vm.count("pyramid") > 0,
+                                         stereo::SlogStereoPreprocessingFilter(slog) );
+      }
     } else if (vm.count("pyramid")) {
       vw::stereo::PyramidCorrelator correlator( BBox2(Vector2(h_corr_min, v_corr_min),
                                                       Vector2(h_corr_max, v_corr_max)),
@@ -33,6 +33,7 @@ std::string mosaic_name;
 std::string output_file_type;
 std::string channel_type_str;
 bool draft;
+bool local_pyramids = false;
 unsigned int tilesize;
 bool tile_output = false;
 unsigned int patch_size, patch_overlap;
@@ -112,6 +113,7 @@ void do_blend() {
 
   vw::mosaic::ImageComposite<float_pixel_type> composite;
   if( draft ) composite.set_draft_mode( true );
+  if( local_pyramids ) composite.set_local_pyramids( true );
 
   double smallest_x_scale = vw::ScalarTypeLimits<float>::highest();
   double smallest_y_scale = vw::ScalarTypeLimits<float>::highest();
@@ -287,6 +289,7 @@ int main( int argc, char *argv[] ) {
       ("patch-size", po::value<unsigned int>(&patch_size)->default_value(256), "Patch size for tiled output, in pixels")
       ("patch-overlap", po::value<unsigned int>(&patch_overlap)->default_value(0), "Patch overlap for tiled output, in pixels")
       ("draft", "Draft mode (no blending)")
+      ("local-pyramids", "Build each image's pyramid one patch at a time, to bound memory use for large mosaics")
       ("ignore-alpha", "Ignore the alpha channel of the input images, and don't write an alpha channel in output.")
       ("nodata-value", po::value<float>(&nodata_value), "Pixel value to use for nodata in input and output (when there's no alpha channel)")
       ("channel-type", po::value<std::string>(&channel_type_str), "Images' channel type. One of [uint8, uint16, int16, float].")
@@ -335,6 +338,7 @@ int main( int argc, char *argv[] ) {
     }
 
     if(vm.count("tile-output")) tile_output = true;
+    if(vm.count("local-pyramids")) local_pyramids = true;
 
     if( patch_size <= 0 ) {
       std::cerr << "Error: The patch size must be a positive number!  (You specified " << patch_size << ".)" << std::endl;
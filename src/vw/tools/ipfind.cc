@@ -105,7 +105,7 @@ int main(int argc, char** argv) {
   std::string interest_operator, descriptor_generator;
   float ip_gain;
   uint32 max_points;
-  int tile_size, num_threads;
+  int tile_size, tile_halo, num_threads;
   ImageView<double> integral;
 
   const float IDEAL_LOG_THRESHOLD = .03;
@@ -117,6 +117,7 @@ int main(int argc, char** argv) {
     ("help,h", "Display this help message")
     ("num-threads", po::value(&num_threads)->default_value(0), "Set the number of threads for interest point detection.  Setting the num_threads to zero causes ipfind to use the visionworkbench default number of threads.")
     ("tile-size,t", po::value(&tile_size), "Specify the tile size for processing interest points. (Useful when working with large images). VW usually picks 1024 px.")
+    ("tile-halo", po::value(&tile_halo)->default_value(0), "Detect interest points in each tile together with this many pixels of its neighbors, so that points along the tile seams are neither lost nor duplicated.  Zero processes each tile on its own.")
     ("lowe,l", "Save the interest points in an ASCII data format that is compatible with the Lowe-SIFT toolchain.")
     ("debug-image,d", "Write out debug images.")
 
@@ -223,11 +224,11 @@ int main(int argc, char** argv) {
       if (!vm.count("single-scale")) {
         ScaledInterestPointDetector<HarrisInterestOperator> detector(interest_operator,
                                                                      tile_max_points);
-        ip = detect_interest_points(image, detector);
+        ip = detect_interest_points(image, detector, tile_halo);
       } else {
         InterestPointDetector<HarrisInterestOperator> detector(interest_operator,
                                                                tile_max_points);
-        ip = detect_interest_points(image, detector);
+        ip = detect_interest_points(image, detector, tile_halo);
       }
     } else if ( interest_operator == "log") {
       // Use a scale-space Laplacian of Gaussian feature detector. The
@@ -237,18 +238,18 @@ int main(int argc, char** argv) {
       if (!vm.count("single-scale")) {
         ScaledInterestPointDetector<LogInterestOperator> detector(interest_operator,
                                                                   tile_max_points);
-        ip = detect_interest_points(image, detector);
+        ip = detect_interest_points(image, detector, tile_halo);
       } else {
         InterestPointDetector<LogInterestOperator> detector(interest_operator,
                                                             tile_max_points);
-        ip = detect_interest_points(image, detector);
+        ip = detect_interest_points(image, detector, tile_halo);
       }
     } else if ( interest_operator == "obalog") {
       // OBALoG threshold is inversely proportional to gain ..
       OBALoGInterestOperator interest_operator(IDEAL_OBALOG_THRESHOLD/ip_gain);
       IntegralInterestPointDetector<OBALoGInterestOperator> detector( interest_operator,
                                                                       tile_max_points );
-      ip = detect_interest_points(image, detector);
+      ip = detect_interest_points(image, detector, tile_halo);
     }
 
     // Removing Interest Points on nodata or within 1/px
@@ -100,6 +100,7 @@ int main(int argc, char** argv) {
     ("help,h", "Display this help message")
     ("matcher-threshold,t", po::value(&matcher_threshold)->default_value(0.6), "Threshold for the interest point matcher.")
     ("non-kdtree", "Use an implementation of the interest matcher that is not reliant on a KDTree algorithm")
+    ("mutual", "Only keep matches whose points are each other's nearest neighbors.")
     ("ransac-constraint,r", po::value(&ransac_constraint)->default_value("similarity"), "RANSAC constraint type.  Choose one of: [similarity, homography, fundamental, or none].")
     ("inlier-threshold,i", po::value(&inlier_threshold)->default_value(10), "RANSAC inlier threshold.")
     ("debug-image,d", "Write out debug images.");
@@ -154,7 +155,8 @@ int main(int argc, char** argv) {
 
       if ( !vm.count("non-kdtree") ) {
         // Run interest point matcher that uses KDTree algorithm.
-        InterestPointMatcher<L2NormMetric,NullConstraint> matcher(matcher_threshold);
+        InterestPointMatcher<L2NormMetric,NullConstraint> matcher(matcher_threshold, L2NormMetric(),
+                                                                  NullConstraint(), vm.count("mutual"));
         matcher(ip1, ip2, matched_ip1, matched_ip2, false,
                 TerminalProgressCallback( "tools.ipmatch","Matching:"));
       } else {